@@ -83,7 +83,7 @@ void AbstractOutput::change_blocks_impl(Blocks& blocks) const {
 void AbstractOutput::initialize_work_impl() const {
     impl_->main_thread_ = false;
     std::string file = opt_value("file").as<std::string>();
-    impl_->out_ = name_to_ostream(file);
+    impl_->out_ = name_to_ostream(file, binary_output());
     print_header(*impl_->out_);
     prepare();
 }
@@ -128,5 +128,9 @@ void AbstractOutput::print_header(std::ostream& o) const {
 void AbstractOutput::print_footer(std::ostream& o) const {
 }
 
+bool AbstractOutput::binary_output() const {
+    return false;
+}
+
 }
 
@@ -53,6 +53,11 @@ protected:
     */
     virtual void print_footer(std::ostream& o) const;
 
+    /** Return if output file is opened in binary mode.
+    By default, returns false.
+    */
+    virtual bool binary_output() const;
+
 private:
     struct Impl;
     Impl* impl_;
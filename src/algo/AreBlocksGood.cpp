@@ -48,12 +48,15 @@ std::ostream& AreBlocksGood::get_out() const {
 }
 
 bool AreBlocksGood::are_blocks_good() const {
+    return are_blocks_good(get_out());
+}
+
+bool AreBlocksGood::are_blocks_good(std::ostream& out) const {
     TimeIncrementer ti(this);
     bool good = true;
     UniqueNames un;
     Rest r(block_set());
     r.run();
-    std::ostream& out = get_out();
     if (!r.block_set()->empty()) {
         good = false;
         out << "Sequences must be covered entirely by blocks. ";
@@ -75,6 +78,7 @@ bool AreBlocksGood::are_blocks_good() const {
     SetFc fc;
     fc.set_cycles_allowed(false);
     BOOST_FOREACH (Block* b, *block_set()) {
+        check_interruption();
         bool minor = !b->name().empty() && b->name()[0] == 'm';
         bool m = respect_minor && minor;
         AlignmentStat al_stat;
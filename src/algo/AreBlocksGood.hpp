@@ -40,6 +40,11 @@ public:
     /** Return if all blocks are good and print messages to output */
     bool are_blocks_good() const;
 
+    /** Return if all blocks are good and print messages to the stream.
+    The check can be stopped by interrupt().
+    */
+    bool are_blocks_good(std::ostream& out) const;
+
 protected:
     void run_impl() const;
 
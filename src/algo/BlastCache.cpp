@@ -0,0 +1,360 @@
+/*
+ * NPG-explorer, Nucleotide PanGenome explorer
+ * Copyright (C) 2012-2016 Boris Nagaev
+ *
+ * See the LICENSE file for terms of use.
+ */
+
+#include <istream>
+#include <ostream>
+#include <cstdlib>
+#include <algorithm>
+#include <boost/foreach.hpp>
+#include <boost/functional/hash.hpp>
+
+#include "BlastCache.hpp"
+#include "name_to_stream.hpp"
+#include "cast.hpp"
+
+namespace npge {
+
+static void finish_record(BlastRecord& record, const std::string& seq) {
+    record.length = seq.size();
+    record.hash = boost::hash_value(seq);
+}
+
+void read_blast_records(BlastRecords& records, const Strings& files) {
+    BOOST_FOREACH (const std::string& file, files) {
+        boost::shared_ptr<std::istream> stream = name_to_istream(file);
+        std::string seq;
+        for (std::string line; std::getline(*stream, line);) {
+            if (!line.empty() && line[0] == '>') {
+                if (!records.empty()) {
+                    finish_record(records.back(), seq);
+                }
+                seq.clear();
+                BlastRecord record;
+                std::string header = line.substr(1);
+                record.name = header.substr(0, header.find(' '));
+                record.index = records.size();
+                records.push_back(record);
+            } else if (records.empty()) {
+                continue;
+            } else {
+                seq += line;
+            }
+            records.back().text += line;
+            records.back().text += "\n";
+        }
+        if (!records.empty()) {
+            finish_record(records.back(), seq);
+        }
+    }
+}
+
+BlastCache::BlastCache():
+    last_volume_(0), keep_files_(false),
+    max_hits_(1000000), hits_(0), busy_(false) {
+}
+
+BlastCache::~BlastCache() {
+    clear();
+}
+
+BlastCache* BlastCache::global() {
+    static BlastCache cache;
+    return &cache;
+}
+
+bool BlastCache::acquire() {
+    boost::mutex::scoped_lock lock(mutex_);
+    if (busy_) {
+        return false;
+    }
+    busy_ = true;
+    return true;
+}
+
+void BlastCache::release() {
+    boost::mutex::scoped_lock lock(mutex_);
+    busy_ = false;
+}
+
+void BlastCache::set_keep_files(bool keep_files) {
+    keep_files_ = keep_files;
+}
+
+void BlastCache::set_max_hits(int max_hits) {
+    max_hits_ = max_hits;
+}
+
+int BlastCache::hits() const {
+    return hits_;
+}
+
+void BlastCache::update(const BlastRecords& records,
+                        const std::string& settings,
+                        BlastRecordPtrs& fresh) {
+    if (settings != settings_) {
+        clear();
+        settings_ = settings;
+    }
+    // find entries of current records
+    std::map<int, int> alive;
+    Entries current;
+    hits_ = 0;
+    BOOST_FOREACH (const BlastRecord& record, records) {
+        Entries::iterator it = entries_.find(record.name);
+        if (it != entries_.end() && it->second.hash == record.hash) {
+            Entry& entry = current[record.name];
+            entry.hash = record.hash;
+            entry.volume = it->second.volume;
+            entry.old = true;
+            entry.hits.swap(it->second.hits);
+            hits_ += entry.hits.size();
+            alive[entry.volume] += 1;
+        }
+    }
+    entries_.swap(current);
+    // remove sparse volumes
+    std::vector<int> sparse;
+    typedef std::map<int, Volume>::value_type IntVolume;
+    BOOST_FOREACH (const IntVolume& v, volumes_) {
+        if (alive[v.first] * 2 < v.second.size) {
+            sparse.push_back(v.first);
+        }
+    }
+    BOOST_FOREACH (int volume, sparse) {
+        remove_volume(volume);
+    }
+    for (Entries::iterator it = entries_.begin();
+            it != entries_.end();) {
+        if (volumes_.find(it->second.volume) == volumes_.end()) {
+            hits_ -= it->second.hits.size();
+            entries_.erase(it++);
+        } else {
+            ++it;
+        }
+    }
+    BOOST_FOREACH (const BlastRecord& record, records) {
+        if (entries_.find(record.name) == entries_.end()) {
+            fresh.push_back(&record);
+        }
+    }
+}
+
+static std::string volume_prefix(int volume) {
+    return "v" + TO_S(volume) + "_";
+}
+
+void BlastCache::add_volume(const std::string& bank,
+                            const BlastRecordPtrs& fresh,
+                            std::ostream& fasta) {
+    last_volume_ += 1;
+    Volume& volume = volumes_[last_volume_];
+    volume.bank = bank;
+    volume.size = fresh.size();
+    std::string prefix = volume_prefix(last_volume_);
+    BOOST_FOREACH (const BlastRecord* record, fresh) {
+        fasta << ">" << prefix << record->text.substr(1);
+        Entry& entry = entries_[record->name];
+        entry.hash = record->hash;
+        entry.volume = last_volume_;
+        entry.old = false;
+        hits_ -= entry.hits.size();
+        entry.hits.clear();
+    }
+}
+
+Strings BlastCache::banks() const {
+    Strings result;
+    typedef std::map<int, Volume>::value_type IntVolume;
+    BOOST_FOREACH (const IntVolume& v, volumes_) {
+        result.push_back(v.second.bank);
+    }
+    return result;
+}
+
+bool BlastCache::is_old(const std::string& name) const {
+    Entries::const_iterator it = entries_.find(name);
+    return it != entries_.end() && it->second.old;
+}
+
+// number of fields in blast output (-m 8)
+const int BLAST_FIELDS = 12;
+
+/** Find offsets of fields, return number of fields */
+static int find_fields(const std::string& line, std::size_t* starts) {
+    int n = 0;
+    starts[n++] = 0;
+    for (std::size_t i = 0; i < line.size() && n < BLAST_FIELDS; i++) {
+        if (line[i] == '\t') {
+            starts[n++] = i + 1;
+        }
+    }
+    // end of field i is starts[i + 1] - 1
+    starts[n] = line.size() + 1;
+    return n;
+}
+
+static void append_field(std::string& out, const std::string& line,
+                         const std::size_t* starts, int field) {
+    if (!out.empty()) {
+        out += '\t';
+    }
+    std::size_t begin = starts[field];
+    out.append(line, begin, starts[field + 1] - 1 - begin);
+}
+
+static void reverse_hit(std::string& out, const std::string& line,
+                        const std::size_t* starts, int n) {
+    int q1 = 8, q2 = 9, s1 = 6, s2 = 7;
+    long start = std::strtol(line.c_str() + starts[8], 0, 10);
+    long stop = std::strtol(line.c_str() + starts[9], 0, 10);
+    if (start > stop) {
+        // query is always direct in blast output
+        std::swap(q1, q2);
+        std::swap(s1, s2);
+    }
+    out.clear();
+    append_field(out, line, starts, 1);
+    append_field(out, line, starts, 0);
+    for (int i = 2; i < 6; i++) {
+        append_field(out, line, starts, i);
+    }
+    append_field(out, line, starts, q1);
+    append_field(out, line, starts, q2);
+    append_field(out, line, starts, s1);
+    append_field(out, line, starts, s2);
+    if (n > 10) {
+        // the rest of the line as is
+        out += '\t';
+        out.append(line, starts[10], std::string::npos);
+    }
+}
+
+bool BlastCache::filter_line(std::string& line,
+                             std::string& reversed) const {
+    reversed.clear();
+    std::size_t starts[BLAST_FIELDS + 1];
+    int n = find_fields(line, starts);
+    if (n < 10) {
+        // let importer report the error
+        return true;
+    }
+    // subject is "v<volume>_<name>"
+    std::size_t begin = starts[1], end = starts[2] - 1;
+    std::size_t sep = line.find('_', begin);
+    if (begin == end || line[begin] != 'v' || sep >= end) {
+        return true;
+    }
+    char* volume_end;
+    long volume = std::strtol(line.c_str() + begin + 1, &volume_end, 10);
+    if (volume_end != line.c_str() + sep) {
+        return true;
+    }
+    // reversed is used as a buffer for the name
+    std::string& subject = reversed;
+    subject.assign(line, sep + 1, end - sep - 1);
+    Entries::const_iterator it = entries_.find(subject);
+    if (it == entries_.end() || it->second.volume != volume) {
+        // outdated sequence, which is still in old volume
+        subject.clear();
+        return false;
+    }
+    line.erase(begin, sep + 1 - begin);
+    bool same = line.compare(0, starts[1] - 1, subject) == 0;
+    if (it->second.old && !same) {
+        find_fields(line, starts);
+        reverse_hit(reversed, line, starts, n);
+    } else {
+        subject.clear();
+    }
+    return true;
+}
+
+void BlastCache::add_hit(const std::string& line) {
+    std::string query = line.substr(0, line.find('\t'));
+    boost::mutex::scoped_lock lock(mutex_);
+    Entries::iterator it = entries_.find(query);
+    if (it != entries_.end()) {
+        it->second.hits.push_back(line);
+        hits_ += 1;
+    }
+}
+
+void BlastCache::cached_hits(Strings& out) {
+    BOOST_FOREACH (Entries::value_type& name_entry, entries_) {
+        Entry& entry = name_entry.second;
+        if (!entry.old) {
+            continue;
+        }
+        Strings hits;
+        BOOST_FOREACH (const std::string& line, entry.hits) {
+            std::string subject = line.substr(line.find('\t') + 1);
+            subject = subject.substr(0, subject.find('\t'));
+            if (is_old(subject)) {
+                hits.push_back(line);
+            }
+        }
+        hits_ -= entry.hits.size() - hits.size();
+        entry.hits.swap(hits);
+        out.insert(out.end(), entry.hits.begin(), entry.hits.end());
+    }
+}
+
+struct MoreHits {
+    template<typename It>
+    bool operator()(It a, It b) const {
+        return a->second.hits.size() > b->second.hits.size() ||
+               (a->second.hits.size() == b->second.hits.size() &&
+                a->first < b->first);
+    }
+};
+
+void BlastCache::trim() {
+    if (hits_ <= max_hits_) {
+        return;
+    }
+    typedef std::vector<Entries::iterator> Its;
+    Its its;
+    for (Entries::iterator it = entries_.begin();
+            it != entries_.end(); ++it) {
+        its.push_back(it);
+    }
+    std::sort(its.begin(), its.end(), MoreHits());
+    BOOST_FOREACH (Entries::iterator it, its) {
+        if (hits_ <= max_hits_) {
+            break;
+        }
+        // the sequence stays in its volume as outdated one
+        hits_ -= it->second.hits.size();
+        entries_.erase(it);
+    }
+}
+
+void BlastCache::remove_volume(int volume) {
+    std::map<int, Volume>::iterator it = volumes_.find(volume);
+    if (it != volumes_.end()) {
+        const std::string& bank = it->second.bank;
+        if (!keep_files_) {
+            remove_file(bank);
+            remove_file(bank + ".nhr");
+            remove_file(bank + ".nin");
+            remove_file(bank + ".nsq");
+        }
+        volumes_.erase(it);
+    }
+}
+
+void BlastCache::clear() {
+    while (!volumes_.empty()) {
+        remove_volume(volumes_.begin()->first);
+    }
+    entries_.clear();
+    settings_.clear();
+    hits_ = 0;
+}
+
+}
+
@@ -0,0 +1,177 @@
+/*
+ * NPG-explorer, Nucleotide PanGenome explorer
+ * Copyright (C) 2012-2016 Boris Nagaev
+ *
+ * See the LICENSE file for terms of use.
+ */
+
+#ifndef NPGE_BLAST_CACHE_HPP_
+#define NPGE_BLAST_CACHE_HPP_
+
+#include <map>
+#include <iosfwd>
+#include <string>
+#include <vector>
+#include <boost/utility.hpp>
+#include "boost-xtime.hpp"
+#include <boost/thread/mutex.hpp>
+
+#include "global.hpp"
+
+namespace npge {
+
+/** Sequence from fasta file passed to blast */
+struct BlastRecord {
+    std::string name;
+    std::string text; /**< Record as in fasta file */
+    int length;
+    int index;
+    std::size_t hash; /**< Hash of sequence */
+};
+
+typedef std::vector<BlastRecord> BlastRecords;
+typedef std::vector<const BlastRecord*> BlastRecordPtrs;
+
+/** Read fasta files */
+void read_blast_records(BlastRecords& records, const Strings& files);
+
+/** Blast banks and hits kept between runs of BlastRunner.
+
+Bank consists of volumes. Each volume is made from sequences,
+which were new in some run. Sequence is identified by name
+and contents. If a sequence disappears, it stays in its volume,
+until less than a half of the volume is alive;
+then the volume is removed and its alive sequences are
+considered new (searched and put to new volume).
+
+Only new sequences are searched against the bank.
+Hits between old sequences are taken from the cache.
+Names of sequences in volumes are prefixed with volume id,
+so that hits with outdated sequences are recognized.
+
+Results may differ from full search: e-values are computed
+against the bank including outdated sequences of old volumes,
+and hits of old queries against new subjects are obtained by
+reversing hits of new queries, while blast is not symmetric.
+
+Number of kept hits is limited (set_max_hits()). If the limit is
+exceeded, entries with most hits are dropped; their sequences
+are considered new in next run.
+
+Usage: acquire(), call update(), make volume of new
+sequences and call add_volume(), run blast with banks()
+for new sequences, pass each line of output through
+filter_line() and add_hit(), append cached_hits(),
+call trim() and release().
+*/
+class BlastCache : boost::noncopyable {
+public:
+    /** Constructor */
+    BlastCache();
+
+    /** Destructor. Removes files of banks unless keep_files */
+    ~BlastCache();
+
+    /** Return the cache shared by all BlastRunner's */
+    static BlastCache* global();
+
+    /** Try to start using the cache.
+    Return false if the cache is used by other run.
+    The mutex is locked only inside this method and release(),
+    so concurrent runs are not serialized: a run which failed to
+    acquire the cache should use its own cache.
+    */
+    bool acquire();
+
+    /** Stop using the cache */
+    void release();
+
+    /** Set if files of banks are kept */
+    void set_keep_files(bool keep_files);
+
+    /** Set max number of kept hits (default 1000000) */
+    void set_max_hits(int max_hits);
+
+    /** Return number of kept hits */
+    int hits() const;
+
+    /** Start new run.
+    If settings differ from settings of previous run,
+    the cache is cleared.
+    \param records Current sequences
+    \param settings Blast settings
+    \param fresh Sequences, which must be searched (output)
+    */
+    void update(const BlastRecords& records,
+                const std::string& settings,
+                BlastRecordPtrs& fresh);
+
+    /** Register volume made from fresh sequences.
+    Fasta file of the volume is written to the stream.
+    */
+    void add_volume(const std::string& bank,
+                    const BlastRecordPtrs& fresh,
+                    std::ostream& fasta);
+
+    /** Return list of banks of volumes */
+    Strings banks() const;
+
+    /** Process line of blast output of new sequence.
+    Volume prefix is removed from the subject in place.
+    Return false if the hit must be skipped: its subject
+    is not present any more.
+    If subject is old, the hit in reverse (subject as query)
+    is written to reversed, since old sequences are not searched;
+    otherwise reversed is cleared.
+    Memory is not allocated if reversed has enough capacity,
+    so pass the same string for all lines.
+    This method is thread-safe.
+    */
+    bool filter_line(std::string& line, std::string& reversed) const;
+
+    /** Remember line accepted by filter_line() (thread-safe) */
+    void add_hit(const std::string& line);
+
+    /** Append hits with old queries and old subjects to out */
+    void cached_hits(Strings& out);
+
+    /** Drop entries with most hits until number of hits
+    does not exceed max hits */
+    void trim();
+
+    /** Remove all banks and hits */
+    void clear();
+
+private:
+    struct Entry {
+        std::size_t hash;
+        int volume;
+        bool old;
+        Strings hits;
+    };
+
+    typedef std::map<std::string, Entry> Entries;
+
+    struct Volume {
+        std::string bank;
+        int size;
+    };
+
+    std::map<int, Volume> volumes_;
+    int last_volume_;
+    Entries entries_;
+    std::string settings_;
+    bool keep_files_;
+    int max_hits_;
+    int hits_;
+    bool busy_;
+    boost::mutex mutex_;
+
+    void remove_volume(int volume);
+    bool is_old(const std::string& name) const;
+};
+
+}
+
+#endif
+
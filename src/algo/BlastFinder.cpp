@@ -13,6 +13,7 @@
 #include "ImportBlastHits.hpp"
 #include "FileCopy.hpp"
 #include "FileRemover.hpp"
+#include "HomologyFinder.hpp"
 #include "BlockSet.hpp"
 #include "name_to_stream.hpp"
 
@@ -30,10 +31,13 @@ BlastFinder::BlastFinder() {
     add(runner);
     runner->fix_opt_getter("in-consensus", c);
     runner->fix_opt_getter("out-hits", h);
+    // hits are imported while blast is running
     ImportBlastHits* importer = new ImportBlastHits;
-    add(importer);
+    importer->set_parent(this);
+    importer->point_bs("target=target", this);
     importer->point_bs("other=target", this);
     importer->fix_opt_getter("blast-hits", h);
+    runner->set_importer(importer);
     FileCopy* copy_c = new FileCopy;
     add(copy_c);
     copy_c->set_opt_prefix("blast-cons-");
@@ -48,11 +52,21 @@ BlastFinder::BlastFinder() {
     FileRemover* rm_h = new FileRemover;
     add(rm_h);
     rm_h->fix_opt_getter("filename", h);
+    native_ = new HomologyFinder;
+    native_->set_parent(this);
+    native_->point_bs("target=target", this);
+    add_gopt("blast-native", "Use built-in seed-and-extend search "
+             "instead of blast", "BLAST_NATIVE");
     declare_bs("target", "Blockset in which hits are searched");
 }
 
 void BlastFinder::run_impl() const {
-    if (!block_set()->seqs().empty()) {
+    if (block_set()->seqs().empty()) {
+        return;
+    }
+    if (opt_value("blast-native").as<bool>()) {
+        native_->run();
+    } else {
         Pipe::run_impl();
     }
 }
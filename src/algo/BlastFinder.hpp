@@ -12,9 +12,13 @@
 
 namespace npge {
 
+class HomologyFinder;
+
 /** Takes sequences, add blast hits as blocks of these sequences.
 Run BlastFinder on sequence-only blockset (without blocks).
 It adds blast hits as blocks to this blockset.
+If option blast-native is set, HomologyFinder is used
+instead of blast.
 */
 class BlastFinder : public Pipe {
 public:
@@ -25,6 +29,7 @@ protected:
     void run_impl() const;
 
 private:
+    HomologyFinder* native_;
     mutable std::string consensus_;
     mutable std::string hits_;
 
@@ -6,11 +6,21 @@
  */
 
 #include <cstdlib>
+#include <istream>
+#include <ostream>
+#include <algorithm>
+#include <boost/bind.hpp>
+#include <boost/foreach.hpp>
 #include <boost/algorithm/string/join.hpp>
 #include <boost/algorithm/string/replace.hpp>
 
 #include "BlastRunner.hpp"
+#include "ImportBlastHits.hpp"
+#include "BlastCache.hpp"
+#include "CommandReader.hpp"
+#include "simple_task.hpp"
 #include "name_to_stream.hpp"
+#include "temp_file.hpp"
 #include "throw_assert.hpp"
 #include "Exception.hpp"
 #include "cast.hpp"
@@ -22,7 +32,8 @@ namespace npge {
 BlastRunner::BlastRunner():
     file_reader_(this, "in-consensus", "Input files with consensuses"),
     file_writer_(this, "out-hits",
-                 "Output file with blast hits", true) {
+                 "Output file with blast hits", true),
+    importer_(0) {
     add_gopt("blast-plus", "Use blast+ (otherwise blast)",
              "BLAST_PLUS");
     add_gopt("evalue", "Max acceptable e-value of hit",
@@ -30,20 +41,20 @@ BlastRunner::BlastRunner():
     add_gopt("skip-low-complexity-regions",
              "Tell blast not to search in "
              "low complexity regions", "BLAST_DUST");
+    add_opt("blast-shards", "Number of blast processes run "
+            "in parallel (0 means number of workers)", 0);
+    add_gopt("blast-cache", "Keep blast banks and hits "
+             "between runs, search only new sequences",
+             "BLAST_CACHE");
+    add_opt("blast-cache-hits", "Max number of hits kept "
+            "in blast cache", 1000000);
+    add_opt_rule("blast-shards >= 0");
+    add_opt_rule("blast-cache-hits >= 0");
 }
 
-struct BlastDeleter {
-    std::string bank;
-
-    ~BlastDeleter() {
-        if (!bank.empty()) {
-            remove_file(bank);
-            remove_file(bank + ".nhr");
-            remove_file(bank + ".nin");
-            remove_file(bank + ".nsq");
-        }
-    }
-};
+void BlastRunner::set_importer(const ImportBlastHits* importer) {
+    importer_ = importer;
+}
 
 static std::string name_in_cmd(const std::string& cmd) {
     int space_in_cmd = cmd.find(' ');
@@ -54,30 +65,160 @@ static std::string name_in_cmd(const std::string& cmd) {
     }
 }
 
+struct LongerRecord {
+    bool operator()(const BlastRecord* a, const BlastRecord* b) const {
+        return a->length > b->length ||
+               (a->length == b->length && a->index < b->index);
+    }
+};
+
+struct RecordIndexLess {
+    bool operator()(const BlastRecord* a, const BlastRecord* b) const {
+        return a->index < b->index;
+    }
+};
+
+Strings BlastRunner::make_shards(const BlastRecordPtrs& records,
+                                 int shards) const {
+    shards = std::max(1, std::min(shards, int(records.size())));
+    // longest record goes to the least loaded shard
+    BlastRecordPtrs sorted(records);
+    std::sort(sorted.begin(), sorted.end(), LongerRecord());
+    std::vector<long> loads(shards, 0);
+    std::vector<BlastRecordPtrs> shard_records(shards);
+    BOOST_FOREACH (const BlastRecord* record, sorted) {
+        int shard = std::min_element(loads.begin(), loads.end()) -
+                    loads.begin();
+        loads[shard] += record->length;
+        shard_records[shard].push_back(record);
+    }
+    Strings result;
+    for (int shard = 0; shard < shards; shard++) {
+        BlastRecordPtrs& shard_r = shard_records[shard];
+        std::sort(shard_r.begin(), shard_r.end(), RecordIndexLess());
+        std::string file = tmp_file();
+        boost::shared_ptr<std::ostream> out = name_to_ostream(file);
+        BOOST_FOREACH (const BlastRecord* record, shard_r) {
+            (*out) << record->text;
+        }
+        result.push_back(file);
+    }
+    return result;
+}
+
+/** Release the cache when leaving scope */
+struct CacheUser {
+    BlastCache* cache_;
+
+    CacheUser(BlastCache* cache):
+        cache_(cache) {
+    }
+
+    ~CacheUser() {
+        if (cache_) {
+            cache_->release();
+        }
+    }
+};
+
+struct BlastShard {
+    std::string cmd;
+    std::string out; // empty if output is read through a pipe
+    std::string hits_file; // empty if hits are not written
+    boost::shared_ptr<std::ostream> hits;
+    std::string reversed; // buffer for BlastCache::filter_line
+    ImportBlastHits::Part part;
+    int code;
+    std::string error;
+};
+
+static void add_filtered_line(BlastShard* shard, const std::string& line,
+                              const ImportBlastHits* importer,
+                              BlastCache* hits_cache) {
+    if (shard->hits) {
+        (*shard->hits) << line << "\n";
+    }
+    if (hits_cache) {
+        hits_cache->add_hit(line);
+    }
+    if (importer && !line.empty()) {
+        importer->import_line(line, shard->part);
+    }
+}
+
+static void add_hit_line(BlastShard* shard, std::string& line,
+                         const ImportBlastHits* importer,
+                         const BlastCache* cache, BlastCache* hits_cache) {
+    if (!cache->filter_line(line, shard->reversed)) {
+        return;
+    }
+    add_filtered_line(shard, line, importer, hits_cache);
+    if (!shard->reversed.empty()) {
+        add_filtered_line(shard, shard->reversed, importer, hits_cache);
+    }
+}
+
+/** Run blast and pass its hits to importer, file and cache.
+If hits_cache is 0, hits are not added to the cache.
+*/
+static void run_shard(BlastShard* shard,
+                      const ImportBlastHits* importer,
+                      const BlastCache* cache, BlastCache* hits_cache) {
+    try {
+        if (shard->out.empty()) {
+            CommandReader reader(shard->cmd);
+            std::string line;
+            while (reader.getline(line)) {
+                add_hit_line(shard, line, importer, cache,
+                             hits_cache);
+            }
+            shard->code = reader.close();
+        } else {
+            shard->code = system(shard->cmd.c_str());
+            if (shard->code == 0) {
+                boost::shared_ptr<std::istream> stream =
+                    name_to_istream(shard->out);
+                for (std::string line; std::getline(*stream, line);) {
+                    add_hit_line(shard, line, importer, cache,
+                                 hits_cache);
+                }
+            }
+            remove_file(shard->out);
+        }
+    } catch (std::exception& e) {
+        shard->error = e.what();
+    }
+    shard->hits.reset(); // flush and close
+}
+
+/** Append hits written by the shard to out and remove its file */
+static void copy_shard_hits(const BlastShard& shard, std::ostream* out) {
+    if (shard.hits_file.empty()) {
+        return;
+    }
+    if (out) {
+        boost::shared_ptr<std::istream> in =
+            name_to_istream(shard.hits_file);
+        // inserting empty streambuf would set failbit of out
+        if (in->peek() != std::char_traits<char>::eof()) {
+            (*out) << in->rdbuf();
+        }
+    }
+    remove_file(shard.hits_file);
+}
+
 void BlastRunner::run_impl() const {
     std::string output_file = file_writer_.output_file();
     ASSERT_MSG(!output_file.empty(),
                "BlastRunner, empty output_file");
     Strings inputs = file_reader_.input_files();
-    std::string input = boost::algorithm::join(inputs, " ");
-    std::string bank = tmp_file();
-    BlastDeleter bd;
-    if (!go("NPGE_DEBUG").as<bool>()) {
-        bd.bank = bank;
-    }
+    BlastRecords records;
+    read_blast_records(records, inputs);
     bool blast_plus = opt_value("blast-plus").as<bool>();
     std::string k1 = blast_plus ? "MAKEBLASTDB" : "FORMATDB";
     std::string cmd1 = make_external_cmd(meta(), k1);
     using namespace boost::algorithm;
-    replace_first(cmd1, "{in}", escape_backslash(input));
-    replace_first(cmd1, "{bank}", escape_backslash(bank));
     replace_first(cmd1, "{nul}", go("DEV_NULL").to_s());
-    int r = system(cmd1.c_str());
-    if (r) {
-        std::string c = name_in_cmd(cmd1);
-        throw Exception(c + " failed with code " + TO_S(r) +
-                        ". Command: " + cmd1);
-    }
     bool slcr = opt_value("skip-low-complexity-regions").as<bool>();
     std::string F = slcr ? "T" : "F";
     if (blast_plus) {
@@ -86,18 +227,132 @@ void BlastRunner::run_impl() const {
     Decimal evalue = opt_value("evalue").as<Decimal>();
     std::string k2 = blast_plus ? "BLASTN" : "BLASTALL";
     std::string cmd2 = make_external_cmd(meta(), k2);
-    replace_first(cmd2, "{bank}", escape_backslash(bank));
-    replace_first(cmd2, "{in}", escape_backslash(input));
     replace_first(cmd2, "{evalue}", TO_S(evalue));
-    replace_first(cmd2, "{workers}", TO_S(workers()));
     replace_first(cmd2, "{F}", F);
-    replace_first(cmd2, "{out}", escape_backslash(output_file));
-    r = system(cmd2.c_str());
-    if (r) {
-        std::string c = name_in_cmd(cmd2);
-        throw Exception(c + " failed with code " + TO_S(r) +
-                        ". Command: " + cmd2);
+    bool debug = go("NPGE_DEBUG").as<bool>();
+    BlastCache local_cache;
+    BlastCache* cache = &local_cache;
+    BlastCache* global = BlastCache::global();
+    // if other run uses the global cache, do not wait for it
+    bool use_global = opt_value("blast-cache").as<bool>() &&
+                      global->acquire();
+    CacheUser cache_user(use_global ? global : 0);
+    if (use_global) {
+        cache = global;
+    }
+    cache->set_keep_files(debug);
+    cache->set_max_hits(opt_value("blast-cache-hits").as<int>());
+    BlastRecordPtrs fresh;
+    cache->update(records, cmd1 + "\n" + cmd2, fresh);
+    Strings cached;
+    cache->cached_hits(cached);
+    if (!fresh.empty()) {
+        // bank outlives this processor, if the cache is global
+        std::string bank = temp_file();
+        std::string fasta = tmp_file();
+        cache->add_volume(bank, fresh, *name_to_ostream(fasta));
+        replace_first(cmd1, "{in}", escape_backslash(fasta));
+        replace_first(cmd1, "{bank}", escape_backslash(bank));
+        int r = system(cmd1.c_str());
+        if (!debug) {
+            remove_file(fasta);
+        }
+        if (r) {
+            cache->clear();
+            std::string c = name_in_cmd(cmd1);
+            throw Exception(c + " failed with code " + TO_S(r) +
+                            ". Command: " + cmd1);
+        }
+    }
+    Strings banks;
+    BOOST_FOREACH (const std::string& bank, cache->banks()) {
+        banks.push_back(escape_backslash(bank));
+    }
+    std::string bank = join(banks, " ");
+    if (banks.size() >= 2) {
+        bank = "\"" + bank + "\"";
+    }
+    replace_first(cmd2, "{bank}", bank);
+    // read output through pipe if the template allows
+    bool to_pipe = (cmd2.find("> {out}") != std::string::npos);
+    replace_first(cmd2, "> {out}", "");
+    int shards = opt_value("blast-shards").as<int>();
+    if (shards == 0) {
+        shards = workers();
+    }
+    Strings shard_inputs;
+    if (!fresh.empty()) {
+        shard_inputs = make_shards(fresh, shards);
+    }
+    shards = shard_inputs.size();
+    int shard_workers = std::max(1, workers() / std::max(1, shards));
+    // hits of local cache are not used after the run
+    BlastCache* hits_cache = use_global ? cache : 0;
+    // hits are streamed to per-shard files, which are concatenated
+    // in shard order afterwards, so nothing is kept in memory
+    bool write_hits = (output_file != ":null");
+    std::vector<BlastShard> blast_shards(shards);
+    Tasks tasks;
+    for (int i = 0; i < shards; i++) {
+        BlastShard& shard = blast_shards[i];
+        shard.cmd = cmd2;
+        replace_first(shard.cmd, "{in}",
+                      escape_backslash(shard_inputs[i]));
+        replace_first(shard.cmd, "{workers}", TO_S(shard_workers));
+        if (!to_pipe) {
+            shard.out = tmp_file();
+            replace_first(shard.cmd, "{out}",
+                          escape_backslash(shard.out));
+        }
+        if (write_hits) {
+            shard.hits_file = tmp_file();
+            shard.hits = name_to_ostream(shard.hits_file);
+        }
+        shard.code = 0;
+        tasks.push_back(boost::bind(run_shard, &shard,
+                                    importer_, cache, hits_cache));
+    }
+    if (importer_) {
+        importer_->start_import();
+    }
+    do_tasks(tasks_to_generator(tasks), shards);
+    if (!debug) {
+        BOOST_FOREACH (const std::string& shard_input, shard_inputs) {
+            remove_file(shard_input);
+        }
+    }
+    BOOST_FOREACH (const BlastShard& shard, blast_shards) {
+        std::string error = shard.error;
+        if (error.empty() && shard.code) {
+            error = name_in_cmd(shard.cmd) + " failed with code " +
+                    TO_S(shard.code);
+        }
+        if (!error.empty()) {
+            BOOST_FOREACH (const BlastShard& s, blast_shards) {
+                copy_shard_hits(s, 0);
+            }
+            cache->clear();
+            throw Exception(error + ". Command: " + shard.cmd);
+        }
+    }
+    boost::shared_ptr<std::ostream> out = name_to_ostream(output_file);
+    BOOST_FOREACH (BlastShard& shard, blast_shards) {
+        copy_shard_hits(shard, out.get());
+        if (importer_) {
+            importer_->finish_import(shard.part);
+        }
+    }
+    ImportBlastHits::Part cached_part;
+    BOOST_FOREACH (const std::string& line, cached) {
+        (*out) << line << "\n";
+        if (importer_) {
+            importer_->import_line(line, cached_part);
+        }
+    }
+    if (importer_) {
+        importer_->finish_import(cached_part);
     }
+    cache->trim();
 }
 
 const char* BlastRunner::name_impl() const {
@@ -11,17 +11,33 @@
 #include "Processor.hpp"
 #include "FileReader.hpp"
 #include "FileWriter.hpp"
+#include "BlastCache.hpp"
 
 namespace npge {
 
+class ImportBlastHits;
+
 /** Run blast all-against-all for given file.
 \warning Output file name must be set using set_output_file() or set_rand_name()
+
+Query sequences are split into shards of similar total length.
+Shards are searched by concurrent blast processes.
+If the command template writes to "> {out}", the output of
+each process is read through a pipe while blast runs.
+Output of all shards is written to out-hits in order of shards.
 */
 class BlastRunner : public Processor {
 public:
     /** Constructor */
     BlastRunner();
 
+    /** Set importer of hits.
+    If importer is set, each hit is passed to the importer
+    as soon as it is read from blast output.
+    After blast finishes, blocks are added in order of shards.
+    */
+    void set_importer(const ImportBlastHits* importer);
+
 protected:
     void run_impl() const;
 
@@ -30,6 +46,10 @@ protected:
 private:
     FileReader file_reader_;
     FileWriter file_writer_;
+    const ImportBlastHits* importer_;
+
+    Strings make_shards(const BlastRecordPtrs& records,
+                        int shards) const;
 };
 
 }
@@ -5,6 +5,7 @@
  * See the LICENSE file for terms of use.
  */
 
+#include <stdint.h>
 #include <cmath>
 #include <vector>
 #include <algorithm>
@@ -12,6 +13,7 @@
 #include <boost/cast.hpp>
 #include <boost/scoped_ptr.hpp>
 #include <boost/foreach.hpp>
+#include <boost/unordered_map.hpp>
 #include <boost/algorithm/string/join.hpp>
 
 #include "ConsensusTree.hpp"
@@ -24,6 +26,8 @@
 #include "Block.hpp"
 #include "BlockSet.hpp"
 #include "block_stat.hpp"
+#include "BlockMatrix.hpp"
+#include "char_to_size.hpp"
 #include "Exception.hpp"
 #include "tree.hpp"
 #include "throw_assert.hpp"
@@ -34,13 +38,40 @@ namespace npge {
 typedef std::map<std::string, double> LeafLength;
 typedef std::map<std::string, Blocks> BranchBlocks;
 
+/** Set of leafs (genomes or rows), bit i is leaf i */
+typedef std::vector<uint64_t> LeafBits;
+
+static void add_leaf(LeafBits& bits, int leaf) {
+    bits[leaf / 64] |= uint64_t(1) << (leaf % 64);
+}
+
+static bool has_leaf(const LeafBits& bits, int leaf) {
+    return (bits[leaf / 64] >> (leaf % 64)) & 1;
+}
+
+typedef std::map<std::string, int> GenomeIndex;
+
+struct BranchInfo {
+    double weight;
+    Blocks blocks;
+
+    BranchInfo():
+        weight(0) {
+    }
+};
+
+typedef boost::unordered_map<LeafBits, BranchInfo> BranchHash;
+
 class BranchData : public ThreadData {
 public:
-    BranchTable table;
-    BranchBlocks branch_blocks;
-    LeafLength leaf_length;
+    BranchHash branches;
+    std::vector<double> leaf_length;
 };
 
+/** Build trees of blocks and accumulate their branches.
+Branches are keyed by bits of genomes in each thread
+and converted to strings of '0' and '1' in finish_work().
+*/
 class BranchGenerator : public BlocksJobs {
 public:
     mutable BranchTable table;
@@ -61,28 +92,19 @@ public:
         table.clear();
         branch_blocks.clear();
         leaf_length.clear();
+        branches_.clear();
+        genomes_ = genomes_list(block_set());
+        genome_index_.clear();
+        for (int i = 0; i < genomes_.size(); i++) {
+            genome_index_[genomes_[i]] = i;
+        }
+        leaf_length_.assign(genomes_.size(), 0.0);
     }
 
     ThreadData* before_thread_impl() const {
-        return new BranchData;
-    }
-
-    struct GenomeNameCompare {
-        bool operator()(const LeafNode* l1, const LeafNode* l2) const {
-            const FragmentLeaf* fl1, *fl2;
-            fl1 = boost::polymorphic_downcast<const FragmentLeaf*>(l1);
-            fl2 = boost::polymorphic_downcast<const FragmentLeaf*>(l2);
-            const Fragment* f1 = fl1->fragment();
-            const Fragment* f2 = fl2->fragment();
-            return f1->seq()->genome() < f2->seq()->genome();
-        }
-    };
-
-    static void add_table(BranchTable& dst, const BranchTable& src) {
-        BOOST_FOREACH (const BranchTable::value_type& branch_length,
-                      src) {
-            dst[branch_length.first] += branch_length.second;
-        }
+        BranchData* d = new BranchData;
+        d->leaf_length.assign(genomes_.size(), 0.0);
+        return d;
     }
 
     void process_block_impl(Block* block, ThreadData* data) const {
@@ -97,44 +119,123 @@ public:
             block_weight = log(block_weight);
         }
         boost::scoped_ptr<TreeNode> tree(print_tree_->make_tree(block));
-        Leafs leafs;
-        tree->all_leafs(leafs);
-        std::sort(leafs.begin(), leafs.end(), GenomeNameCompare());
-        BranchTable t;
-        tree->branch_table(t, leafs, block_weight);
-        add_table(d->table, t);
-        BOOST_FOREACH (const BranchTable::value_type& branch_length,
-                      t) {
-            d->branch_blocks[branch_length.first].push_back(block);
+        Branches branches;
+        LeafBits all(words(), 0);
+        int leafs = add_leafs(all, branches, tree.get(), d, block_weight);
+        // two children of root are the same branch
+        BlockBranches block_branches;
+        BOOST_FOREACH (Branch& branch, branches) {
+            LeafBits& bits = branch.first;
+            if (has_leaf(bits, first_leaf(all))) {
+                // first leaf is always in '0' part
+                for (int i = 0; i < bits.size(); i++) {
+                    bits[i] ^= all[i];
+                }
+            }
+            int size = 0;
+            for (int g = 0; g < genomes_.size(); g++) {
+                size += has_leaf(bits, g);
+            }
+            if (size >= 2 && leafs - size >= 2) {
+                block_branches[bits] += branch.second;
+            }
         }
-        BOOST_FOREACH (LeafNode* leaf, leafs) {
-            FragmentLeaf* fl;
-            fl = boost::polymorphic_downcast<FragmentLeaf*>(leaf);
-            std::string genome = fl->fragment()->seq()->genome();
-            d->leaf_length[genome] += leaf->length() * block_weight;
+        BOOST_FOREACH (const BlockBranches::value_type& bb,
+                      block_branches) {
+            BranchInfo& info = d->branches[bb.first];
+            info.weight += bb.second;
+            info.blocks.push_back(block);
         }
     }
 
     void after_thread_impl(ThreadData* data) const {
         BranchData* d = boost::polymorphic_downcast<BranchData*>(data);
-        add_table(table, d->table);
-        BOOST_FOREACH (const LeafLength::value_type& ll,
-                      d->leaf_length) {
-            leaf_length[ll.first] += ll.second;
+        BOOST_FOREACH (const BranchHash::value_type& bi, d->branches) {
+            BranchInfo& dst = branches_[bi.first];
+            dst.weight += bi.second.weight;
+            dst.blocks.insert(dst.blocks.end(),
+                              bi.second.blocks.begin(),
+                              bi.second.blocks.end());
         }
-        BOOST_FOREACH (const BranchBlocks::value_type& bb,
-                      d->branch_blocks) {
-            const std::string& branch_str = bb.first;
-            const Blocks& blocks = bb.second;
-            Blocks& dst_blocks = branch_blocks[branch_str];
-            BOOST_FOREACH (Block* block, blocks) {
-                dst_blocks.push_back(block);
+        for (int g = 0; g < genomes_.size(); g++) {
+            leaf_length_[g] += d->leaf_length[g];
+        }
+    }
+
+    void finish_work_impl() const {
+        BOOST_FOREACH (BranchHash::value_type& bi, branches_) {
+            std::string branch_str(genomes_.size(), '0');
+            for (int g = 0; g < genomes_.size(); g++) {
+                if (has_leaf(bi.first, g)) {
+                    branch_str[g] = '1';
+                }
             }
+            table[branch_str] = bi.second.weight;
+            Blocks& blocks = branch_blocks[branch_str];
+            blocks.swap(bi.second.blocks);
+            // blocks of threads are merged in random order
+            sort_blocks(blocks);
+        }
+        branches_.clear();
+        for (int g = 0; g < genomes_.size(); g++) {
+            leaf_length[genomes_[g]] = leaf_length_[g];
         }
     }
 
 private:
     PrintTree* print_tree_;
+    mutable Strings genomes_;
+    mutable GenomeIndex genome_index_;
+    mutable BranchHash branches_;
+    mutable std::vector<double> leaf_length_;
+
+    typedef std::pair<LeafBits, double> Branch;
+    typedef std::vector<Branch> Branches;
+    typedef std::map<LeafBits, double> BlockBranches;
+
+    int words() const {
+        return (genomes_.size() + 63) / 64;
+    }
+
+    int first_leaf(const LeafBits& bits) const {
+        for (int g = 0; g < genomes_.size(); g++) {
+            if (has_leaf(bits, g)) {
+                return g;
+            }
+        }
+        return 0;
+    }
+
+    /** Add leafs of node to bits, return number of leafs.
+    Branches of descendants are appended to branches.
+    */
+    int add_leafs(LeafBits& bits, Branches& branches,
+                  const TreeNode* node, BranchData* d,
+                  double weight) const {
+        const FragmentLeaf* leaf;
+        leaf = dynamic_cast<const FragmentLeaf*>(node);
+        if (leaf) {
+            std::string genome = leaf->fragment()->seq()->genome();
+            GenomeIndex::const_iterator it = genome_index_.find(genome);
+            ASSERT_TRUE(it != genome_index_.end());
+            add_leaf(bits, it->second);
+            d->leaf_length[it->second] += leaf->length() * weight;
+            return 1;
+        }
+        int leafs = 0;
+        BOOST_FOREACH (const TreeNode* child, node->children()) {
+            LeafBits child_bits(words(), 0);
+            leafs += add_leafs(child_bits, branches, child, d, weight);
+            if (!dynamic_cast<const LeafNode*>(child)) {
+                branches.push_back(Branch(child_bits,
+                                          child->length() * weight));
+            }
+            for (int i = 0; i < bits.size(); i++) {
+                bits[i] |= child_bits[i];
+            }
+        }
+        return leafs;
+    }
 };
 
 bool check_bootstrap_values(std::string& message,
@@ -263,13 +364,13 @@ BootstrapValues parse_bv(const std::string& bv) {
     }
 }
 
+/** Count diagnostic positions of clades of consensus tree.
+Each block is decoded once. Rows having the same letter in a column
+form a set of rows; the column is diagnostic for a clade
+if the set is equal to rows of the clade (see is_diagnostic()).
+*/
 class BootstrapDiagnosticPositions : public BlocksJobs {
 public:
-    typedef std::set<std::string> StringSet;
-    typedef std::pair<TreeNode*, StringSet> Clade;
-    typedef std::vector<Clade> Clades;
-    typedef std::map<TreeNode*, double> Bootstrap;
-
     void set_tree(TreeNode* cons_tree) {
         cons_tree_ = cons_tree;
     }
@@ -280,78 +381,142 @@ public:
 
 private:
     mutable Nodes nodes_;
-    mutable Clades clades_;
-    mutable Bootstrap bootstrap_;
+    mutable std::vector<LeafBits> clades_; // bits of genomes
+    mutable std::vector<double> bootstrap_;
+    mutable GenomeIndex genome_index_;
 
     TreeNode* cons_tree_;
     int min_block_size_;
 
     struct BPSData : public ThreadData {
-        Bootstrap bootstrap_;
+        std::vector<double> bootstrap_;
     };
 
+    typedef boost::unordered_map<LeafBits, int> RowsCount;
+
 protected:
     void initialize_work_impl() const {
+        nodes_.clear();
+        clades_.clear();
+        genome_index_.clear();
+        Leafs all_leafs;
+        cons_tree_->all_leafs(all_leafs);
+        BOOST_FOREACH (LeafNode* leaf, all_leafs) {
+            std::string genome = leaf->name();
+            if (genome_index_.find(genome) == genome_index_.end()) {
+                int index = genome_index_.size();
+                genome_index_[genome] = index;
+            }
+        }
+        int words = (genome_index_.size() + 63) / 64;
         cons_tree_->all_descendants(nodes_);
         BOOST_FOREACH (TreeNode* node, nodes_) {
             Leafs leafs;
             node->all_leafs_and_this(leafs);
-            StringSet genomes;
+            LeafBits genomes(words, 0);
             BOOST_FOREACH (LeafNode* leaf, leafs) {
-                genomes.insert(leaf->name());
+                add_leaf(genomes, genome_index_[leaf->name()]);
             }
-            Clade clade((node), genomes);
-            clades_.push_back(clade);
+            clades_.push_back(genomes);
         }
+        bootstrap_.assign(nodes_.size(), 0.0);
     }
 
     ThreadData* before_thread_impl() const {
-        return new BPSData;
+        BPSData* d = new BPSData;
+        d->bootstrap_.assign(nodes_.size(), 0.0);
+        return d;
+    }
+
+    /** Count columns by sets of rows having the same letter */
+    static void count_rows(RowsCount& count, const BlockMatrix& matrix) {
+        int rows = matrix.rows();
+        int words = (rows + 63) / 64;
+        const int LETTERS_AND_GAP = LETTERS_NUMBER + 1;
+        std::vector<uint64_t> letter_rows(LETTERS_AND_GAP * words);
+        LeafBits key;
+        for (int col = 0; col < matrix.columns(); col++) {
+            std::fill(letter_rows.begin(), letter_rows.end(), 0);
+            int used = 0; // bits of letters
+            for (int row = 0; row < rows; row++) {
+                char c = matrix.at(row, col);
+                int l = c ? char_to_size(c) : LETTERS_NUMBER;
+                letter_rows[l * words + row / 64] |=
+                    uint64_t(1) << (row % 64);
+                used |= 1 << l;
+            }
+            if ((used & (used - 1)) == 0) {
+                // identical column
+                continue;
+            }
+            for (int l = 0; l < LETTERS_AND_GAP; l++) {
+                if (used & (1 << l)) {
+                    key.assign(letter_rows.begin() + l * words,
+                               letter_rows.begin() + (l + 1) * words);
+                    count[key] += 1;
+                }
+            }
+        }
     }
 
     void process_block_impl(Block* block, ThreadData* data) const {
         if (block->size() < min_block_size_) {
             return;
         }
-        int length = block->alignment_length();
         BPSData* d = boost::polymorphic_downcast<BPSData*>(data);
-        Bootstrap& b = d->bootstrap_;
-        BOOST_FOREACH (const Clade& clade, clades_) {
-            TreeNode* node = clade.first;
-            const StringSet& genomes = clade.second;
-            Fragments ff, other;
-            BOOST_FOREACH (Fragment* f, *block) {
-                ASSERT_TRUE(f->seq());
-                std::string genome = f->seq()->genome();
-                if (genomes.find(genome) != genomes.end()) {
-                    ff.push_back(f);
-                } else {
-                    other.push_back(f);
+        pos_t length = block->alignment_length();
+        BlockMatrix matrix;
+        RowsCount count;
+        for (pos_t w = 0; w < length; w += BLOCK_MATRIX_WINDOW) {
+            pos_t w_stop = std::min(length, w + BLOCK_MATRIX_WINDOW) - 1;
+            matrix.build(block, w, w_stop);
+            count_rows(count, matrix);
+        }
+        if (count.empty()) {
+            return;
+        }
+        int rows = matrix.rows();
+        std::vector<int> row_genome(rows, -1);
+        for (int row = 0; row < rows; row++) {
+            const Fragment* f = matrix.fragments()[row];
+            ASSERT_TRUE(f->seq());
+            GenomeIndex::const_iterator it;
+            it = genome_index_.find(f->seq()->genome());
+            if (it != genome_index_.end()) {
+                row_genome[row] = it->second;
+            }
+        }
+        LeafBits key((rows + 63) / 64);
+        for (int i = 0; i < clades_.size(); i++) {
+            const LeafBits& genomes = clades_[i];
+            std::fill(key.begin(), key.end(), 0);
+            int in_clade = 0;
+            for (int row = 0; row < rows; row++) {
+                int g = row_genome[row];
+                if (g != -1 && has_leaf(genomes, g)) {
+                    add_leaf(key, row);
+                    in_clade += 1;
                 }
             }
-            if (!ff.empty() && !other.empty()) {
-                int diagnostic_cols = 0;
-                for (int col = 0; col < length; col++) {
-                    if (is_diagnostic(col, ff, other)) {
-                        diagnostic_cols += 1;
-                    }
+            if (in_clade != 0 && in_clade != rows) {
+                RowsCount::const_iterator it = count.find(key);
+                if (it != count.end()) {
+                    d->bootstrap_[i] += it->second;
                 }
-                b[node] += diagnostic_cols;
             }
         }
     }
 
     void after_thread_impl(ThreadData* data) const {
         BPSData* d = boost::polymorphic_downcast<BPSData*>(data);
-        Bootstrap& b = d->bootstrap_;
-        BOOST_FOREACH (TreeNode* node, nodes_) {
-            bootstrap_[node] += b[node];
+        for (int i = 0; i < nodes_.size(); i++) {
+            bootstrap_[i] += d->bootstrap_[i];
         }
     }
 
     void finish_work_impl() const {
-        BOOST_FOREACH (TreeNode* node, nodes_) {
-            node->set_bootstrap(bootstrap_[node]);
+        for (int i = 0; i < nodes_.size(); i++) {
+            nodes_[i]->set_bootstrap(bootstrap_[i]);
         }
     }
 };
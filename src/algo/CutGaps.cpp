@@ -5,12 +5,14 @@
  * See the LICENSE file for terms of use.
  */
 
+#include <vector>
 #include <boost/foreach.hpp>
 
 #include "CutGaps.hpp"
 #include "Block.hpp"
 #include "Fragment.hpp"
 #include "AlignmentRow.hpp"
+#include "AlignmentCursor.hpp"
 #include "RowStorage.hpp"
 #include "throw_assert.hpp"
 #include "Exception.hpp"
@@ -28,8 +30,9 @@ static void slice_fragment(Fragment* f, int al_from, int al_to, RowType type,
     AlignmentRow* old_row = f->row();
     ASSERT_TRUE(old_row);
     int fr_from = -1;
-    for (int i = al_from; i <= al_to; i++) {
-        fr_from = old_row->map_to_fragment(i);
+    AlignmentCursor c1(old_row, 1, al_from);
+    for (; c1.valid() && c1.column() <= al_to; c1.next()) {
+        fr_from = c1.fragment_pos();
         if (fr_from != -1) {
             break;
         }
@@ -39,18 +42,16 @@ static void slice_fragment(Fragment* f, int al_from, int al_to, RowType type,
         return;
     }
     int fr_to = -1;
-    for (int i = al_to; i >= al_from; i--) {
-        fr_to = old_row->map_to_fragment(i);
+    AlignmentCursor c2(old_row, -1, al_to);
+    for (; c2.valid() && c2.column() >= al_from; c2.next()) {
+        fr_to = c2.fragment_pos();
         if (fr_to != -1) {
             break;
         }
     }
     ASSERT_NE(fr_to, -1);
     int length = al_to - al_from + 1;
-    std::stringstream ss;
-    f->print_contents(ss, '-', /* line */ 0);
-    std::string data = ss.str();
-    std::string new_data = data.substr(al_from, length);
+    std::string new_data = f->str('-').substr(al_from, length);
     AlignmentRow* new_row = AlignmentRow::new_row(type);
     new_row->grow(new_data);
     f->set_row(new_row);
@@ -60,7 +61,7 @@ static void slice_fragment(Fragment* f, int al_from, int al_to, RowType type,
     f->set_last_pos(last);
 }
 
-static void find_boundaries_strict(const Block* block, int& from, int& to) {
+static void check_rows(const Block* block) {
     int length = block->alignment_length();
     BOOST_FOREACH (Fragment* f, *block) {
         AlignmentRow* row = f->row();
@@ -72,55 +73,53 @@ static void find_boundaries_strict(const Block* block, int& from, int& to) {
                     ") differs from block alignment length (" +
                     boost::lexical_cast<std::string>(length)).c_str());
     }
-    from = 0;
-    to = length - 1;
-    for (; from <= to; from++) {
-        bool gapless_column = true;
-        BOOST_FOREACH (Fragment* f, *block) {
-            AlignmentRow* row = f->row();
-            if (row->map_to_fragment(from) == -1) {
-                gapless_column = false;
-                break;
-            }
-        }
-        if (gapless_column) {
-            break;
-        }
+}
+
+/** Return first column without gaps in direction ori.
+If there is no such column, return -1 or length.
+*/
+static int gapless_column(const Block* block, int length, int ori) {
+    std::vector<AlignmentCursor> cursors;
+    BOOST_FOREACH (Fragment* f, *block) {
+        cursors.push_back(AlignmentCursor(f->row(), ori));
     }
-    for (; to >= from; to--) {
+    int begin = (ori == 1) ? 0 : length - 1;
+    for (int i = 0; i < length; i++) {
         bool gapless_column = true;
-        BOOST_FOREACH (Fragment* f, *block) {
-            AlignmentRow* row = f->row();
-            if (row->map_to_fragment(to) == -1) {
+        BOOST_FOREACH (const AlignmentCursor& c, cursors) {
+            if (!c.valid() || c.fragment_pos() == -1) {
                 gapless_column = false;
                 break;
             }
         }
         if (gapless_column) {
-            break;
+            return begin + i * ori;
+        }
+        BOOST_FOREACH (AlignmentCursor& c, cursors) {
+            c.next();
         }
     }
+    return (ori == 1) ? length : -1;
+}
+
+static void find_boundaries_strict(const Block* block, int& from, int& to) {
+    check_rows(block);
+    int length = block->alignment_length();
+    from = gapless_column(block, length, 1);
+    to = gapless_column(block, length, -1);
 }
 
 static void find_boundaries_permissive(const Block* block, int& from, int& to) {
+    check_rows(block);
     int length = block->alignment_length();
     from = 0;
     to = length - 1;
     BOOST_FOREACH (Fragment* f, *block) {
-        AlignmentRow* row = f->row();
-        ASSERT_MSG(row, ("No alignment row is set, fragment " +
-                         f->id()).c_str());
-        ASSERT_MSG(row->length() == length,
-                   ("Length of row of fragment " + f->id() + " (" +
-                    boost::lexical_cast<std::string>(f->row()->length()) +
-                    ") differs from block alignment length (" +
-                    boost::lexical_cast<std::string>(length)).c_str());
         for (int ori = -1; ori <= 1; ori += 2) {
-            int begin = (ori == 1) ? 0 : length - 1;
-            int i;
-            for (i = 0; i < length; i++) {
-                int al_pos = begin + i * ori;
-                if (row->map_to_fragment(al_pos) != -1) {
+            AlignmentCursor c(f->row(), ori);
+            for (; c.valid(); c.next()) {
+                if (c.fragment_pos() != -1) {
+                    int al_pos = c.column();
                     if (ori == 1 && al_pos > from) {
                         from = al_pos;
                     } else if (ori == -1 && al_pos < to) {
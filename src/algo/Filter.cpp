@@ -18,6 +18,7 @@
 #include "Block.hpp"
 #include "BlockSet.hpp"
 #include "goodSlices.hpp"
+#include "BlockMatrix.hpp"
 #include "block_stat.hpp"
 #include "boundaries.hpp"
 #include "char_to_size.hpp"
@@ -137,21 +138,12 @@ static int minIdentCount(Decimal min_identity) {
 
 static Coordinates goodSubblocks(const Block* block,
         const LengthRequirements& lr) {
-    int nrows = block->size();
-    Fragments ff(block->begin(), block->end());
-    std::vector<std::string> rows(nrows);
-    std::vector<const char*> crows(nrows);
-    for (int i = 0; i < nrows; i++) {
-        Fragment* f = ff[i];
-        rows[i] = f->str();
-        crows[i] = rows[i].c_str();
-    }
-    int length = block->alignment_length();
+    std::vector<unsigned char> flags;
+    BlockMatrix::classify_block(block, flags);
     int min_length = lr.min_fragment_length;
     int frame_length = lr.frame_length;
     int min_identity = minIdentCount(lr.min_identity);
-    Scores scores = goodColumns(&crows[0], nrows, length,
-            min_identity, min_length);
+    Scores scores = goodColumns(flags, min_identity, min_length);
     return goodSlices(scores,
         frame_length, lr.min_end,
         min_identity, min_length);
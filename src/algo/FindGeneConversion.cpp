@@ -129,11 +129,14 @@ void FindGeneConversion::process_block_impl(Block* block,
     }
     Distances distances;
     Fragments fragments(block->begin(), block->end());
-    for (int i = 0; i < fragments.size(); i++) {
+    std::vector<FragmentDistance::Distance> all;
+    distance_->all_distances(all, fragments);
+    int n = fragments.size();
+    for (int i = 0; i < n; i++) {
         Fragment* f1 = fragments[i];
-        for (int j = i + 1; j < fragments.size(); j++) {
+        for (int j = i + 1; j < n; j++) {
             Fragment* f2 = fragments[j];
-            double ratio = distance_->fragment_distance(f1, f2).ratio();
+            double ratio = all[i * n + j].ratio();
             distances[std::make_pair(f1, f2)] = ratio;
             distances[std::make_pair(f2, f1)] = ratio;
         }
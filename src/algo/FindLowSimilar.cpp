@@ -7,6 +7,8 @@
 
 #include <memory>
 #include <algorithm>
+#include <queue>
+#include <functional>
 #include <boost/cast.hpp>
 #include <boost/foreach.hpp>
 
@@ -15,9 +17,9 @@
 #include "Block.hpp"
 #include "Fragment.hpp"
 #include "BlockSet.hpp"
-#include "block_stat.hpp"
+#include "BlockMatrix.hpp"
+#include "column_kernels.hpp"
 #include "block_hash.hpp"
-#include "char_to_size.hpp"
 #include "throw_assert.hpp"
 #include "global.hpp"
 
@@ -118,26 +120,88 @@ Regions FindLowSimilar::merge_region(Regions& regions, int index) {
     return result;
 }
 
+/* Regions are kept in a linked list, shortest one is taken
+from a heap of (weight, index). Merged region takes place of its
+left neighbour, so order of indices is order of regions and
+ties are resolved as in find_min_region. Weight of a region only
+grows, so outdated heap entries are detected by weight.
+*/
 void FindLowSimilar::reduce_regions(Regions& regions, int min_length) {
-    while (regions.size() >= 2) {
-        int min_region_index = find_min_region(regions);
-        const Region& min_region = regions[min_region_index];
-        if (min_region.weight_ >= min_length) {
+    int n = regions.size();
+    if (n < 2) {
+        return;
+    }
+    std::vector<int> prev(n), next(n);
+    std::vector<bool> alive(n, true);
+    typedef std::pair<int, int> Entry;
+    std::priority_queue<Entry, std::vector<Entry>,
+        std::greater<Entry> > heap;
+    for (int i = 0; i < n; i++) {
+        prev[i] = i - 1;
+        next[i] = (i + 1 < n) ? (i + 1) : -1;
+        heap.push(Entry(regions[i].weight_, i));
+    }
+    int size = n;
+    while (size >= 2) {
+        ASSERT_FALSE(heap.empty());
+        Entry entry = heap.top();
+        heap.pop();
+        int index = entry.second;
+        if (!alive[index] || regions[index].weight_ != entry.first) {
+            continue;
+        }
+        if (entry.first >= min_length) {
             break;
         }
-        regions = merge_region(regions, min_region_index);
+        int p = prev[index], q = next[index];
+        Region new_region = regions[index];
+        if (p != -1) {
+            new_region.start_ = regions[p].start_;
+            new_region.weight_ += regions[p].weight_;
+            ASSERT_NE(regions[p].good_, regions[index].good_);
+        }
+        if (q != -1) {
+            new_region.stop_ = regions[q].stop_;
+            new_region.weight_ += regions[q].weight_;
+            ASSERT_NE(regions[q].good_, regions[index].good_);
+            alive[q] = false;
+            size -= 1;
+        }
+        new_region.good_ = (new_region.good_ == 0) ? 1 : 0;
+        int slot = index;
+        if (p != -1) {
+            slot = p;
+            alive[index] = false;
+            size -= 1;
+        }
+        int after = (q != -1) ? next[q] : -1;
+        next[slot] = after;
+        if (after != -1) {
+            prev[after] = slot;
+        }
+        regions[slot] = new_region;
+        heap.push(Entry(new_region.weight_, slot));
+    }
+    if (size == n) {
+        return;
+    }
+    Regions result;
+    result.reserve(size);
+    for (int i = 0; i != -1; i = next[i]) {
+        result.push_back(regions[i]);
     }
+    regions.swap(result);
 }
 
 void FindLowSimilar::process_block_impl(Block* block,
                                         ThreadData* data) const {
     int L = block->alignment_length();
     std::vector<bool> good_col((L));
+    std::vector<unsigned char> flags;
+    BlockMatrix::classify_block(block, flags);
     for (int col = 0; col < L; col++) {
-        bool ident, gap, pure_gap;
-        int atgc[LETTERS_NUMBER];
-        test_column(block, col, ident, gap, pure_gap, atgc);
-        good_col[col] = ident && !gap;
+        int f = flags[col] & (IDENT_COLUMN | GAP_COLUMN);
+        good_col[col] = (f == IDENT_COLUMN);
     }
     int min_length = opt_value("min-fragment").as<int>();
     Decimal min_identity = opt_value("min-identity").as<Decimal>();
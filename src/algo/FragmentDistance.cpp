@@ -5,32 +5,101 @@
  * See the LICENSE file for terms of use.
  */
 
+#include <stdint.h>
+#include <algorithm>
 #include <vector>
 
 #include "FragmentDistance.hpp"
 #include "Block.hpp"
 #include "Fragment.hpp"
 #include "AlignmentRow.hpp"
+#include "BlockMatrix.hpp"
+#include "char_to_size.hpp"
 #include "Exception.hpp"
 
 namespace npge {
 
-static int substitution(char a, char b) {
-    // TODO move to util/, see PairAligner
-    return (a == b && a != 'N') ? 0 : 1;
+typedef uint64_t Word;
+const int WORD_BITS = 64;
+
+/** Number of 64-bit words per column group of encoded row:
+three bits of letter code and gap mask */
+const int PLANES = 4;
+
+static int popcount(Word w) {
+#ifdef __GNUC__
+    return __builtin_popcountll(w);
+#else
+    int result = 0;
+    for (; w; w &= w - 1) {
+        result += 1;
+    }
+    return result;
+#endif
 }
 
-static void equal_at(const Fragment* a, const Fragment* b,
-                     pos_t pos, bool& eq, bool& gap) {
-    char ac = a->alignment_at(pos);
-    char bc = b->alignment_at(pos);
-    eq = (ac == bc);
-    gap = (ac == '\0');
+/** Encode cells of row to bit planes.
+Letter code of column has three bits: 'A', 'T', 'G', 'C', 'N'
+are 0-4, gap is 7. Columns after the end of row are gaps.
+*/
+static void encode_row(Word* planes, const char* cells, int length) {
+    int words = (length + WORD_BITS - 1) / WORD_BITS;
+    std::fill(planes, planes + words * PLANES, Word(0));
+    for (int w = 0; w < words; w++) {
+        Word* p = planes + w * PLANES;
+        for (int bit = 0; bit < WORD_BITS; bit++) {
+            int col = w * WORD_BITS + bit;
+            char c = (col < length) ? cells[col] : '\0';
+            int code = c ? char_to_size(c) : 7;
+            Word mask = Word(1) << bit;
+            if (code & 1) {
+                p[0] |= mask;
+            }
+            if (code & 2) {
+                p[1] |= mask;
+            }
+            if (code & 4) {
+                p[2] |= mask;
+            }
+            if (code == 7) {
+                p[3] |= mask;
+            }
+        }
+    }
 }
 
-FragmentDistance::Distance FragmentDistance::fragment_distance(
-    const Fragment* a, const Fragment* b) const {
-    TimeIncrementer ti(this);
+/** Return penalty of pair of encoded rows.
+Penalty is number of columns, differing in two rows, such that
+previous and next columns have equal letters in both rows.
+So long gap is counted as one mutation.
+*/
+static int penalty_of(const Word* a, const Word* b, int words) {
+    int penalty = 0;
+    Word prev_good = 0; // good columns of previous word
+    Word good = 0, bad = 0; // of current word
+    for (int w = 0; w <= words; w++) {
+        Word next_good = 0, next_bad = 0;
+        if (w < words) {
+            const Word* pa = a + w * PLANES;
+            const Word* pb = b + w * PLANES;
+            Word eq = ~((pa[0] ^ pb[0]) | (pa[1] ^ pb[1]) |
+                        (pa[2] ^ pb[2]));
+            next_good = eq & ~pa[3];
+            next_bad = ~eq;
+        }
+        if (w > 0) {
+            Word before = (good << 1) | (prev_good >> (WORD_BITS - 1));
+            Word after = (good >> 1) | (next_good << (WORD_BITS - 1));
+            penalty += popcount(before & bad & after);
+        }
+        prev_good = good;
+        good = next_good;
+        bad = next_bad;
+    }
+    return penalty;
+}
+
+static int checked_length(const Fragment* a, const Fragment* b) {
     AlignmentRow* ar = a->row();
     AlignmentRow* br = b->row();
     if (!ar || !br) {
@@ -39,33 +108,73 @@ FragmentDistance::Distance FragmentDistance::fragment_distance(
     if (ar->length() != br->length()) {
         throw Exception("Alignment rows of different lengths");
     }
-    int length = ar->length();
+    return ar->length();
+}
+
+/** Encode fragments, return number of words per row */
+static int encode_rows(std::vector<Word>& planes,
+                       const Fragments& fragments, int length) {
+    int words = (length + WORD_BITS - 1) / WORD_BITS;
+    planes.resize(fragments.size() * words * PLANES);
+    std::vector<char> cells(length);
+    for (int i = 0; i < fragments.size(); i++) {
+        std::fill(cells.begin(), cells.end(), '\0');
+        if (length) {
+            BlockMatrix::decode_fragment(&cells[0], fragments[i],
+                                         0, length - 1);
+        }
+        encode_row(&planes[i * words * PLANES], &cells[0], length);
+    }
+    return words;
+}
+
+FragmentDistance::Distance FragmentDistance::fragment_distance(
+    const Fragment* a, const Fragment* b) const {
+    TimeIncrementer ti(this);
+    int length = checked_length(a, b);
     Distance result;
     result.total = length;
     result.penalty = 0;
     if (length < 3) {
         return result;
     }
-    // cycle buffer
-    bool eq[3];
-    bool gap[3];
-    for (int i = 0; i < 2; i++) {
-        equal_at(a, b, i, eq[i], gap[i]);
+    Fragments fragments;
+    fragments.push_back(const_cast<Fragment*>(a));
+    fragments.push_back(const_cast<Fragment*>(b));
+    std::vector<Word> planes;
+    int words = encode_rows(planes, fragments, length);
+    result.penalty = penalty_of(&planes[0], &planes[words * PLANES],
+                                words);
+    return result;
+}
+
+void FragmentDistance::all_distances(std::vector<Distance>& distances,
+                                     const Fragments& fragments) const {
+    TimeIncrementer ti(this);
+    int n = fragments.size();
+    distances.resize(n * n);
+    if (n == 0) {
+        return;
     }
-    for (int i = 2; i < length; i++) {
-        // i is index of third letter (added)
-        int prev = (i - 2) % 3;
-        int curr = (i - 1) % 3;
-        int next = i % 3;
-        equal_at(a, b, i, eq[next], gap[next]);
-        bool prev_good = eq[prev] && !gap[prev];
-        bool curr_good = !eq[curr];
-        bool next_good = eq[next] && !gap[next];
-        if (prev_good && curr_good && next_good) {
-            result.penalty += 1;
+    int length = 0;
+    for (int i = 0; i < n; i++) {
+        length = checked_length(fragments[0], fragments[i]);
+    }
+    std::vector<Word> planes;
+    int words = encode_rows(planes, fragments, length);
+    for (int i = 0; i < n; i++) {
+        for (int j = i; j < n; j++) {
+            Distance& d = distances[i * n + j];
+            d.total = length;
+            d.penalty = 0;
+            if (i != j && length >= 3) {
+                d.penalty = penalty_of(&planes[i * words * PLANES],
+                                       &planes[j * words * PLANES],
+                                       words);
+            }
+            distances[j * n + i] = d;
         }
     }
-    return result;
 }
 
 double FragmentDistance::Distance::ratio() const {
@@ -78,15 +187,19 @@ FragmentDistance::FragmentDistance() {
 }
 
 void FragmentDistance::print_block(std::ostream& o, Block* block) const {
-    std::vector<const Fragment*> fragments(block->begin(), block->end());
-    for (int i = 0; i < fragments.size(); i++) {
+    TimeIncrementer ti(this);
+    Fragments fragments(block->begin(), block->end());
+    std::vector<Distance> distances;
+    all_distances(distances, fragments);
+    int n = fragments.size();
+    for (int i = 0; i < n; i++) {
         const Fragment* f1 = fragments[i];
-        for (int j = i + 1; j < fragments.size(); j++) {
+        for (int j = i + 1; j < n; j++) {
             const Fragment* f2 = fragments[j];
             o << block->name() << '\t';
             o << f1->id() << '\t';
             o << f2->id() << '\t';
-            o << fragment_distance(f1, f2).ratio() << '\n';
+            o << distances[i * n + j].ratio() << '\n';
         }
     }
 }
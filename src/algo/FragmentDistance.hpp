@@ -8,6 +8,8 @@
 #ifndef NPGE_FRAGMENT_DISTANCE_HPP_
 #define NPGE_FRAGMENT_DISTANCE_HPP_
 
+#include <vector>
+
 #include "AbstractOutput.hpp"
 #include "global.hpp"
 
@@ -34,6 +36,17 @@ public:
     */
     Distance fragment_distance(const Fragment* a, const Fragment* b) const;
 
+    /** Distances between all pairs of fragments.
+    Each row is encoded once to bit planes and pairs of rows
+    are compared 64 columns at once.
+    \param distances Output, distances[i * n + j] is distance between
+        fragments[i] and fragments[j], n = fragments.size().
+    \param fragments Fragments.
+    \warning Fragments must be aligned! Otherwise Exception is thrown.
+    */
+    void all_distances(std::vector<Distance>& distances,
+                       const Fragments& fragments) const;
+
     /** Print table block - fr1 - fr2 - distance */
     void print_block(std::ostream& o, Block* block) const;
 
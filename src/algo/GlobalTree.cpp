@@ -67,15 +67,16 @@ private:
 
 void add_dist(Dist& dist, FragmentDistance* d, Block* block) {
     Fragments ff(block->begin(), block->end());
-    for (int i = 0; i < ff.size(); i++) {
+    std::vector<FragmentDistance::Distance> distances;
+    d->all_distances(distances, ff);
+    int n = ff.size();
+    for (int i = 0; i < n; i++) {
         Fragment* f1 = ff[i];
         std::string genome1 = f1->seq()->genome();
         for (int j = 0; j < i; j++) {
             Fragment* f2 = ff[j];
             std::string genome2 = f2->seq()->genome();
-            FragmentDistance::Distance di;
-            di = d->fragment_distance(f1, f2);
-            int mutations = di.penalty;
+            int mutations = distances[i * n + j].penalty;
             dist[genome1][genome2] += mutations;
             dist[genome2][genome1] += mutations;
         }
@@ -99,7 +100,7 @@ void GlobalTree::run_impl() const {
         GenomeLeaf* leaf = new GenomeLeaf(genome, &dist);
         tree->add_child(leaf);
     }
-    tree->neighbor_joining();
+    tree->neighbor_joining(workers());
     //
     add_diagnostic(tree.get(), copy,
                    genomes_v.size(), workers());
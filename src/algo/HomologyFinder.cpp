@@ -0,0 +1,83 @@
+/*
+ * NPG-explorer, Nucleotide PanGenome explorer
+ * Copyright (C) 2012-2016 Boris Nagaev
+ *
+ * See the LICENSE file for terms of use.
+ */
+
+#include <boost/foreach.hpp>
+
+#include "HomologyFinder.hpp"
+#include "homology.hpp"
+#include "Block.hpp"
+#include "BlockSet.hpp"
+#include "Fragment.hpp"
+#include "cast.hpp"
+
+namespace npge {
+
+HomologyFinder::HomologyFinder() {
+    add_opt("homology-seed", "length of seed (exact match)", 16);
+    add_opt("homology-sampling",
+            "only each N-th seed (by hash) is indexed", 4);
+    add_opt("homology-max-hits",
+            "seeds found more times are skipped", 100);
+    add_opt("homology-xdrop",
+            "extension stops when score drops by this value", 20);
+    add_opt("homology-batch", "length of window of gapped extension",
+            100);
+    add_gopt("homology-max-errors",
+             "max number of errors in window of gapped extension",
+             "ALIGNER_MAX_ERRORS");
+    add_gopt("homology-gap-range", "max distance from main diagonal",
+             "ALIGNER_GAP_RANGE");
+    add_gopt("homology-gap-penalty", "gap penalty",
+             "ALIGNER_GAP_PENALTY");
+    add_gopt("homology-mismatch-penalty", "mismatch penalty",
+             "ALIGNER_MISMATCH_PENALTY");
+    add_gopt("blast-min-length", "min length of hit", "MIN_LENGTH");
+    add_opt_rule("homology-seed > 0");
+    add_opt_rule("homology-seed <= " + TO_S(MAX_ANCHOR_SIZE));
+    add_opt_rule("homology-sampling >= 1");
+    add_opt_rule("homology-max-hits >= 2");
+    add_opt_rule("homology-xdrop >= 0");
+    add_opt_rule("homology-batch > 0");
+    add_opt_rule("blast-min-length >= 0");
+    declare_bs("target", "Where hits are searched and added");
+}
+
+void HomologyFinder::run_impl() const {
+    HomologyOptions opt;
+    opt.seed = opt_value("homology-seed").as<int>();
+    opt.sampling = opt_value("homology-sampling").as<int>();
+    opt.max_occurrences = opt_value("homology-max-hits").as<int>();
+    opt.xdrop = opt_value("homology-xdrop").as<int>();
+    opt.batch = opt_value("homology-batch").as<int>();
+    opt.max_errors = opt_value("homology-max-errors").as<int>();
+    opt.gap_range = opt_value("homology-gap-range").as<int>();
+    opt.gap_penalty = opt_value("homology-gap-penalty").as<int>();
+    opt.mismatch_penalty =
+        opt_value("homology-mismatch-penalty").as<int>();
+    opt.min_length = opt_value("blast-min-length").as<int>();
+    opt.workers = workers();
+    BlockSet& bs = *block_set();
+    SeqBase base(bs);
+    base.anchor_ = opt.seed;
+    base.make_seqs();
+    HomologyHits hits;
+    find_homology(hits, base, opt);
+    BOOST_FOREACH (const HomologyHit& hit, hits) {
+        Block* block = new Block;
+        block->insert(new Fragment(hit.a, hit.a_min, hit.a_max, 1));
+        block->insert(new Fragment(hit.b, hit.b_min, hit.b_max,
+                                   hit.ori));
+        bs.insert(block);
+    }
+}
+
+const char* HomologyFinder::name_impl() const {
+    return "Find homologous regions (seed and extend)";
+}
+
+}
+
@@ -0,0 +1,37 @@
+/*
+ * NPG-explorer, Nucleotide PanGenome explorer
+ * Copyright (C) 2012-2016 Boris Nagaev
+ *
+ * See the LICENSE file for terms of use.
+ */
+
+#ifndef NPGE_HOMOLOGY_FINDER_HPP_
+#define NPGE_HOMOLOGY_FINDER_HPP_
+
+#include "Processor.hpp"
+
+namespace npge {
+
+/** Find pairs of homologous regions without blast.
+Sampled exact seeds are extended by ungapped and then
+by banded gapped X-drop extension.
+Each hit is added to blockset as a block of two fragments,
+like ImportBlastHits does.
+
+Run HomologyFinder on sequence-only blockset (without blocks).
+*/
+class HomologyFinder : public Processor {
+public:
+    /** Constructor */
+    HomologyFinder();
+
+protected:
+    void run_impl() const;
+
+    const char* name_impl() const;
+};
+
+}
+
+#endif
+
@@ -5,16 +5,15 @@
  * See the LICENSE file for terms of use.
  */
 
-#include <map>
 #include <vector>
+#include <istream>
+#include <cstring>
+#include <algorithm>
+#include <boost/bind.hpp>
 #include <boost/foreach.hpp>
-#include <boost/assert.hpp>
-#include <boost/lexical_cast.hpp>
-#include <boost/algorithm/string/split.hpp>
-#include <boost/algorithm/string/trim.hpp>
-#include <boost/algorithm/string/classification.hpp>
-#include <boost/tuple/tuple.hpp>
-#include <boost/tuple/tuple_comparison.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/unordered_set.hpp>
+#include <boost/functional/hash.hpp>
 
 #include "ImportBlastHits.hpp"
 #include "BlockSet.hpp"
@@ -28,154 +27,461 @@
 #include "po.hpp"
 #include "throw_assert.hpp"
 #include "name_to_stream.hpp"
+#include "simple_task.hpp"
 #include "block_stat.hpp"
 #include "global.hpp"
 
 namespace npge {
 
-ImportBlastHits::ImportBlastHits():
-    file_reader_(this, "blast-hits", "results of blast -m 8") {
-    add_gopt("blast-min-length", "min length of blast hit",
-             "MIN_LENGTH");
-    add_opt("filtered-blast-hits",
-            "File to write out filtered blast hits", std::string(""));
-    add_gopt("filtered-min-ident", "min identity of hit to write out",
-             "MIN_IDENTITY");
-    add_opt_rule("blast-min-length >= 0");
-    declare_bs("target", "Where hits are added");
-    declare_bs("other", "Consensuses (blocks or sequences) "
-               "on which blast was run");
+typedef ImportBlastHits::Hit Hit;
+typedef std::vector<Hit> Hits;
+
+static bool is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
 }
 
-struct BlastItem {
-    std::string id;
-    int start;
-    int stop;
+static int parse_int(const char* begin, const char* end) {
+    const char* p = begin;
+    bool negative = false;
+    if (p != end && (*p == '-' || *p == '+')) {
+        negative = (*p == '-');
+        p++;
+    }
+    if (p == end) {
+        throw Exception("Bad number in blast hits: '" +
+                        std::string(begin, end) + "'");
+    }
+    int result = 0;
+    for (; p != end; p++) {
+        if (*p < '0' || *p > '9') {
+            throw Exception("Bad number in blast hits: '" +
+                            std::string(begin, end) + "'");
+        }
+        result = result * 10 + (*p - '0');
+    }
+    return negative ? -result : result;
+}
+
+const int BLAST_FIELDS = 12;
+
+/** Parse line of blast output -m 8 without copying.
+Offsets of fields are counted from base.
+Return false if the line is blank.
+*/
+static bool parse_hit(Hit& hit, const char* base,
+                      const char* begin, const char* end) {
+    while (begin != end && is_space(*begin)) {
+        begin++;
+    }
+    while (begin != end && is_space(end[-1])) {
+        end--;
+    }
+    if (begin == end) {
+        return false;
+    }
+    const char* fields[BLAST_FIELDS + 1];
+    int n = 0;
+    fields[n++] = begin;
+    for (const char* p = begin; p != end; p++) {
+        if (*p == '\t') {
+            if (n <= BLAST_FIELDS) {
+                fields[n] = p + 1;
+            }
+            n += 1;
+        }
+    }
+    if (n < BLAST_FIELDS) {
+        throw Exception("Number of fields in blast hits fasta"
+                        " (" + TO_S(n) + ") must be >= 12");
+    }
+#define NPGE_FIELD_END(i) (fields[(i) + 1] - 1)
+    hit.line = begin - base;
+    hit.line_size = end - begin;
+    for (int i = 0; i < 2; i++) {
+        hit.id[i] = fields[i] - base;
+        hit.id_size[i] = NPGE_FIELD_END(i) - fields[i];
+        hit.start[i] = parse_int(fields[6 + 2 * i],
+                                 NPGE_FIELD_END(6 + 2 * i));
+        hit.stop[i] = parse_int(fields[7 + 2 * i],
+                                NPGE_FIELD_END(7 + 2 * i));
+    }
+    hit.length = parse_int(fields[3], NPGE_FIELD_END(3));
+#undef NPGE_FIELD_END
+    // identity, mismatches, gap openings, evalue and bitscore
+    // are not used
+    return true;
+}
+
+static int compare_items(const char* base, const Hit& a, int i, int j) {
+    int size = std::min(a.id_size[i], a.id_size[j]);
+    int cmp = std::memcmp(base + a.id[i], base + a.id[j], size);
+    if (cmp != 0) {
+        return cmp;
+    }
+    if (a.id_size[i] != a.id_size[j]) {
+        return a.id_size[i] - a.id_size[j];
+    }
+    if (a.start[i] != a.start[j]) {
+        return a.start[i] < a.start[j] ? -1 : 1;
+    }
+    if (a.stop[i] != a.stop[j]) {
+        return a.stop[i] < a.stop[j] ? -1 : 1;
+    }
+    return 0;
+}
 
-    bool operator<(const BlastItem& o) const {
-        typedef boost::tuple<const std::string&, int, int> Tie;
-        return Tie(id, start, stop) < Tie(o.id, o.start, o.stop);
+/** Hit with indices of resolved targets */
+struct HitKey {
+    int target[2];
+    int start[2];
+    int stop[2];
+
+    bool operator==(const HitKey& other) const {
+        return std::equal(target, target + 2, other.target) &&
+               std::equal(start, start + 2, other.start) &&
+               std::equal(stop, stop + 2, other.stop);
     }
 };
 
-struct BlastHit {
-    BlastHit(std::string line) {
-        using namespace boost::algorithm;
-        trim(line);
-        Strings parts;
-        split(parts, line, is_any_of("\t"));
-        if (parts.size() < 12) {
-            throw Exception("Number of fields in blast hits fasta"
-                            " (" + TO_S(parts.size()) + ") "
-                            "must be >= 12");
-        }
-        items[0].id = parts[0];
-        items[1].id = parts[1];
-        ident = Decimal(parts[2]) / 100;
-        length = boost::lexical_cast<int>(parts[3]);
-        mismatches = boost::lexical_cast<int>(parts[4]);
-        gap_openings = boost::lexical_cast<int>(parts[5]);
-        items[0].start = boost::lexical_cast<int>(parts[6]);
-        items[0].stop = boost::lexical_cast<int>(parts[7]);
-        items[1].start = boost::lexical_cast<int>(parts[8]);
-        items[1].stop = boost::lexical_cast<int>(parts[9]);
-        // evalue and bitscore are not used
-    }
-
-    BlastItem items[2];
-    Decimal ident; // not used
-    int length;
-    int mismatches;
-    int gap_openings;
+static std::size_t hash_value(const HitKey& key) {
+    std::size_t seed = 0;
+    for (int i = 0; i < 2; i++) {
+        boost::hash_combine(seed, key.target[i]);
+        boost::hash_combine(seed, key.start[i]);
+        boost::hash_combine(seed, key.stop[i]);
+    }
+    return seed;
+}
+
+/** Where blast hit item points to */
+struct HitTarget {
+    Sequence* seq;
+    boost::shared_ptr<Fragment> fragment;
+    const Block* block;
+
+    HitTarget():
+        seq(0), block(0) {
+    }
 };
 
-typedef std::map<std::string, Block*> NameToBlock;
-typedef std::map<std::string, Sequence*> NameToSeq;
+typedef boost::unordered_map<std::string, Sequence*> NameToSeq;
+typedef boost::unordered_map<std::string, int> NameToIndex;
+typedef std::vector<HitTarget> HitTargets;
+typedef boost::unordered_set<HitKey> HitKeys;
 
-static void add_blast_item(const BlockSet* bs,
+static void resolve_target(HitTarget& target, const std::string& id,
                            const NameToSeq& name2seq,
-                           const NameToBlock& name2block,
-                           Block* new_block, const BlastItem& item) {
-    Sequence* seq = 0;
-    NameToSeq::const_iterator it = name2seq.find(item.id);
+                           const BlockSet& other) {
+    NameToSeq::const_iterator it = name2seq.find(id);
     if (it != name2seq.end()) {
-        seq = it->second;
+        target.seq = it->second;
+        return;
     }
-    Fragment* f = 0;
-    std::string f_seq_name = Fragment::seq_name_from_id(item.id);
+    std::string f_seq_name = Fragment::seq_name_from_id(id);
     if (!f_seq_name.empty()) {
         NameToSeq::const_iterator it2 = name2seq.find(f_seq_name);
         if (it2 != name2seq.end()) {
             Sequence* s = it2->second;
-            f = s->fragment_from_id(item.id);
+            target.fragment.reset(s->fragment_from_id(id));
+            if (target.fragment) {
+                return;
+            }
         }
     }
-    if (seq) {
-        Fragment* new_fragment = new Fragment(seq);
-        new_fragment->set_begin_last(item.start - 1, item.stop - 1);
+    target.block = other.find_block(id);
+    if (!target.block) {
+        throw Exception("Bad block name: " + id);
+    }
+}
+
+static void add_blast_item(Block* new_block, const HitTarget& target,
+                           int start, int stop) {
+    if (target.seq) {
+        Fragment* new_fragment = new Fragment(target.seq);
+        new_fragment->set_begin_last(start - 1, stop - 1);
         new_block->insert(new_fragment);
-    } else if (f) {
-        new_block->insert(f->subfragment(item.start - 1,
-                                         item.stop - 1));
-        delete f;
+    } else if (target.fragment) {
+        new_block->insert(target.fragment->subfragment(start - 1,
+                          stop - 1));
     } else {
-        NameToBlock::const_iterator it = name2block.find(item.id);
-        if (it == name2block.end()) {
-            throw Exception("Bad block name: " + item.id);
-        }
-        const Block* block = it->second;
-        ASSERT_TRUE(block);
+        const Block* block = target.block;
         int block_length = block->alignment_length();
         BOOST_FOREACH (Fragment* fr, *block) {
-            int start = fragment_pos(fr, item.start - 1, block_length);
-            ASSERT_NE(start, -1);
-            int stop = fragment_pos(fr, item.stop - 1, block_length);
-            ASSERT_NE(stop, -1);
-            new_block->insert(fr->subfragment(start, stop));
+            int f_start = fragment_pos(fr, start - 1, block_length);
+            ASSERT_NE(f_start, -1);
+            int f_stop = fragment_pos(fr, stop - 1, block_length);
+            ASSERT_NE(f_stop, -1);
+            new_block->insert(fr->subfragment(f_start, f_stop));
         }
     }
 }
 
-void ImportBlastHits::run_impl() const {
-    NameToSeq name2seq;
-    BOOST_FOREACH (SequencePtr seq, other()->seqs()) {
-        name2seq[seq->name()] = seq.get();
+/** Hit to be converted to block */
+struct NewHit {
+    const Hit* hit;
+    HitKey key;
+};
+
+typedef std::vector<NewHit> NewHits;
+
+/** Blocks made from a slice of new hits */
+struct NewBlocks {
+    Blocks blocks;
+    std::string filtered;
+
+    ~NewBlocks() {
+        BOOST_FOREACH (Block* block, blocks) {
+            delete block;
+        }
     }
-    NameToBlock name2block;
-    BOOST_FOREACH (Block* block, *other()) {
-        name2block[block->name()] = block;
+};
+
+class ImportBlastHits::Impl {
+public:
+    NameToSeq name2seq_;
+    BlockSetPtr other_;
+    NameToIndex target_index_;
+    HitTargets targets_;
+    HitKeys seen_;
+    int min_length_;
+    Decimal min_ident_;
+    boost::shared_ptr<std::ostream> filtered_file_;
+
+    bool accept(const char* base, const Hit& hit) const {
+        return compare_items(base, hit, 0, 1) < 0 &&
+               hit.length >= min_length_;
     }
-    BlockSet* bs = other().get();
-    int min_length = opt_value("blast-min-length").as<int>();
-    Decimal min_ident = opt_value("filtered-min-ident").as<Decimal>();
+
+    /** Return index of target, resolve it if needed */
+    int target_of(const std::string& id) {
+        NameToIndex::iterator it = target_index_.find(id);
+        if (it != target_index_.end()) {
+            return it->second;
+        }
+        int index = targets_.size();
+        targets_.push_back(HitTarget());
+        resolve_target(targets_.back(), id, name2seq_, *other_);
+        target_index_[id] = index;
+        return index;
+    }
+
+    /** Make blocks from hits (thread-safe) */
+    void make_blocks(const char* base, const NewHit* begin,
+                     const NewHit* end, NewBlocks* result) const {
+        for (const NewHit* h = begin; h != end; h++) {
+            Block* new_block = new Block;
+            result->blocks.push_back(new_block);
+            for (int i = 0; i < 2; i++) {
+                add_blast_item(new_block, targets_[h->key.target[i]],
+                               h->key.start[i], h->key.stop[i]);
+            }
+            if (filtered_file_) {
+                AlignmentStat stat;
+                make_stat(stat, new_block);
+                Decimal identity = block_identity(stat);
+                if (identity > min_ident_) {
+                    result->filtered.append(base + h->hit->line,
+                                            h->hit->line_size);
+                    result->filtered += "\n";
+                }
+            }
+        }
+    }
+
+    /** Parse lines, remember accepted hits (thread-safe) */
+    void parse_chunk(Hits* hits, const char* base,
+                     const char* begin, const char* end,
+                     std::string* error) const {
+        try {
+            while (begin != end) {
+                const char* stop = std::find(begin, end, '\n');
+                Hit hit;
+                if (parse_hit(hit, base, begin, stop) &&
+                        accept(base, hit)) {
+                    hits->push_back(hit);
+                }
+                begin = (stop == end) ? end : stop + 1;
+            }
+        } catch (std::exception& e) {
+            *error = e.what();
+        }
+    }
+};
+
+ImportBlastHits::ImportBlastHits():
+    file_reader_(this, "blast-hits", "results of blast -m 8"),
+    impl_(new Impl) {
+    add_gopt("blast-min-length", "min length of blast hit",
+             "MIN_LENGTH");
+    add_opt("filtered-blast-hits",
+            "File to write out filtered blast hits", std::string(""));
+    add_gopt("filtered-min-ident", "min identity of hit to write out",
+             "MIN_IDENTITY");
+    add_opt_rule("blast-min-length >= 0");
+    declare_bs("target", "Where hits are added");
+    declare_bs("other", "Consensuses (blocks or sequences) "
+               "on which blast was run");
+}
+
+ImportBlastHits::~ImportBlastHits() {
+    delete impl_;
+}
+
+void ImportBlastHits::start_import() const {
+    impl_->name2seq_.clear();
+    BOOST_FOREACH (SequencePtr seq, other()->seqs()) {
+        impl_->name2seq_[seq->name()] = seq.get();
+    }
+    impl_->other_ = other();
+    impl_->target_index_.clear();
+    impl_->targets_.clear();
+    impl_->seen_.clear();
+    impl_->min_length_ = opt_value("blast-min-length").as<int>();
+    impl_->min_ident_ = opt_value("filtered-min-ident").as<Decimal>();
     std::string filtered_filename =
         opt_value("filtered-blast-hits").as<std::string>();
-    boost::shared_ptr<std::ostream> filtered_file;
+    impl_->filtered_file_.reset();
     if (!filtered_filename.empty()) {
-        filtered_file = name_to_ostream(filtered_filename);
+        impl_->filtered_file_ = name_to_ostream(filtered_filename);
     }
-    BOOST_FOREACH (std::istream& input_file, file_reader_) {
-        for (std::string line; std::getline(input_file, line);) {
-            BlastHit hit(line);
-            if (hit.items[0] < hit.items[1] &&
-                    hit.length >= min_length) {
-                Block* new_block = new Block;
-                add_blast_item(bs, name2seq, name2block,
-                               new_block, hit.items[0]);
-                add_blast_item(bs, name2seq, name2block,
-                               new_block, hit.items[1]);
-                block_set()->insert(new_block);
-                if (filtered_file) {
-                    AlignmentStat stat;
-                    make_stat(stat, new_block);
-                    Decimal identity = block_identity(stat);
-                    if (identity > min_ident) {
-                        (*filtered_file) << line << "\n";
-                    }
-                }
-            }
+}
+
+void ImportBlastHits::import_line(const std::string& line,
+                                  Part& part) const {
+    Hit hit;
+    const char* begin = line.c_str();
+    if (parse_hit(hit, begin, begin, begin + line.size()) &&
+            impl_->accept(begin, hit)) {
+        // offsets in text of the part
+        std::size_t offset = part.text.size();
+        hit.line += offset;
+        hit.id[0] += offset;
+        hit.id[1] += offset;
+        part.text += line;
+        part.text += "\n";
+        part.hits.push_back(hit);
+    }
+}
+
+void ImportBlastHits::finish_import(Part& part) const {
+    const char* base = part.external ? part.external : part.text.c_str();
+    // remove repeated hits, resolve names of consensuses once
+    NewHits new_hits;
+    std::string id;
+    BOOST_FOREACH (const Hit& hit, part.hits) {
+        NewHit h;
+        h.hit = &hit;
+        for (int i = 0; i < 2; i++) {
+            id.assign(base + hit.id[i], hit.id_size[i]);
+            h.key.target[i] = impl_->target_of(id);
+            h.key.start[i] = hit.start[i];
+            h.key.stop[i] = hit.stop[i];
+        }
+        if (impl_->seen_.insert(h.key).second) {
+            new_hits.push_back(h);
+        }
+    }
+    // make blocks in parallel, add them in order of hits
+    int slices = std::max(1, std::min(workers() * 4,
+                                      int(new_hits.size())));
+    std::vector<NewBlocks> results(slices);
+    Tasks tasks;
+    const NewHit* first = new_hits.empty() ? 0 : &new_hits[0];
+    for (int i = 0; i < slices; i++) {
+        const NewHit* b = first + new_hits.size() * i / slices;
+        const NewHit* e = first + new_hits.size() * (i + 1) / slices;
+        tasks.push_back(boost::bind(&Impl::make_blocks, impl_, base,
+                                    b, e, &results[i]));
+    }
+    do_tasks(tasks_to_generator(tasks), workers());
+    BOOST_FOREACH (NewBlocks& result, results) {
+        BOOST_FOREACH (Block* block, result.blocks) {
+            block_set()->insert(block);
+        }
+        result.blocks.clear();
+        if (impl_->filtered_file_) {
+            (*impl_->filtered_file_) << result.filtered;
+        }
+    }
+    if (impl_->filtered_file_) {
+        impl_->filtered_file_->flush();
+    }
+    part.hits.clear();
+    part.text.clear();
+    part.external = 0;
+}
+
+void ImportBlastHits::import_text(const std::string& text) const {
+    // split text into chunks by lines
+    int chunks = std::max(1, workers()) * 4;
+    std::vector<const char*> bounds;
+    const char* begin = text.c_str();
+    const char* end = begin + text.size();
+    bounds.push_back(begin);
+    for (int i = 1; i < chunks; i++) {
+        const char* p = begin + text.size() * i / chunks;
+        p = std::find(std::max(p, bounds.back()), end, '\n');
+        bounds.push_back((p == end) ? end : p + 1);
+    }
+    bounds.push_back(end);
+    // parse and filter chunks in parallel
+    std::vector<Hits> hits(chunks);
+    Strings errors(chunks);
+    Tasks tasks;
+    for (int i = 0; i < chunks; i++) {
+        tasks.push_back(boost::bind(&Impl::parse_chunk, impl_, &hits[i],
+                                    begin, bounds[i], bounds[i + 1],
+                                    &errors[i]));
+    }
+    do_tasks(tasks_to_generator(tasks), workers());
+    BOOST_FOREACH (const std::string& error, errors) {
+        if (!error.empty()) {
+            throw Exception(error);
+        }
+    }
+    Part part;
+    part.external = begin;
+    BOOST_FOREACH (const Hits& chunk_hits, hits) {
+        part.hits.insert(part.hits.end(),
+                         chunk_hits.begin(), chunk_hits.end());
+    }
+    finish_import(part);
+}
+
+void ImportBlastHits::import_stream(std::istream& input,
+                                   std::size_t chunk_size) const {
+    chunk_size = std::max(chunk_size, std::size_t(1));
+    std::string text;
+    while (input) {
+        // text starts with the incomplete line of previous chunk
+        std::size_t old_size = text.size();
+        text.resize(old_size + chunk_size);
+        input.read(&text[old_size], chunk_size);
+        text.resize(old_size + input.gcount());
+        if (!input) {
+            break;
         }
+        std::size_t last_end = text.rfind('\n');
+        if (last_end == std::string::npos) {
+            // no complete line yet, read more
+            continue;
+        }
+        std::string rest(text, last_end + 1);
+        text.resize(last_end + 1);
+        import_text(text);
+        text.swap(rest);
+    }
+    if (!text.empty()) {
+        import_text(text);
+    }
+}
+
+void ImportBlastHits::run_impl() const {
+    start_import();
+    BOOST_FOREACH (std::istream& input_file, file_reader_) {
+        import_stream(input_file);
     }
+    impl_->filtered_file_.reset();
 }
 
 const char* ImportBlastHits::name_impl() const {
@@ -8,6 +8,8 @@
 #ifndef NPGE_IMPORT_BLAST_HITS_HPP_
 #define NPGE_IMPORT_BLAST_HITS_HPP_
 
+#include <iosfwd>
+
 #include "global.hpp"
 #include "Processor.hpp"
 #include "FileReader.hpp"
@@ -16,12 +18,86 @@ namespace npge {
 
 /** Add blocks from blast hits (blast output -m 8).
 \note This processor depends on processor Read.
+
+Hits can also be imported while blast is running
+(see BlastRunner::set_importer):
+start_import() is called first, then several threads
+call import_line() for their own parts,
+then finish_import() is called for each part.
+
+Lines are parsed and filtered without allocation of
+fragments and blocks. Repeated hits are removed by
+finish_import(): only first occurrence since start_import()
+is added. Blocks are made by finish_import() in several threads.
 */
 class ImportBlastHits : public Processor {
 public:
+    /** Parsed blast hit.
+    Fields are offsets in text of part.
+    */
+    struct Hit {
+        std::size_t line;
+        int line_size;
+        std::size_t id[2];
+        int id_size[2];
+        int start[2];
+        int stop[2];
+        int length;
+    };
+
+    /** Accepted hits, not yet converted to blocks */
+    struct Part {
+        /** Lines of hits passed to import_line() */
+        std::string text;
+
+        /** Text of hits instead of own text, if not 0 */
+        const char* external;
+
+        /** Hits accepted by filters */
+        std::vector<Hit> hits;
+
+        /** Constructor */
+        Part():
+            external(0) {
+        }
+    };
+
     /** Constructor */
     ImportBlastHits();
 
+    /** Destructor */
+    ~ImportBlastHits();
+
+    /** Prepare to import_line() calls */
+    void start_import() const;
+
+    /** Parse the line and add it to the part if it is accepted.
+    This method can be called from several threads
+    for different parts.
+    Blank lines are ignored. Exception is thrown on bad lines.
+    */
+    void import_line(const std::string& line, Part& part) const;
+
+    /** Add blocks made from new hits of the part to blockset.
+    Parts are added in order of finish_import() calls.
+    The part is cleared.
+    */
+    void finish_import(Part& part) const;
+
+    /** Add blocks made from text of blast output.
+    Lines are parsed in several threads.
+    Must be called after start_import().
+    */
+    void import_text(const std::string& text) const;
+
+    /** Add blocks made from blast output read from the stream.
+    The stream is read by chunks of about chunk_size bytes,
+    each chunk ends at a line end and is passed to import_text().
+    Must be called after start_import().
+    */
+    void import_stream(std::istream& input,
+                       std::size_t chunk_size = 64 * 1024 * 1024) const;
+
 protected:
     void run_impl() const;
 
@@ -29,6 +105,9 @@ protected:
 
 private:
     FileReader file_reader_;
+
+    class Impl;
+    Impl* impl_;
 };
 
 }
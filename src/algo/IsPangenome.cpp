@@ -5,8 +5,14 @@
  * See the LICENSE file for terms of use.
  */
 
+#include <sstream>
+#include <algorithm>
 #include <boost/foreach.hpp>
+#include <boost/bind.hpp>
+#include <boost/function.hpp>
 #include <boost/lexical_cast.hpp>
+#include "boost-xtime.hpp"
+#include <boost/thread/mutex.hpp>
 
 #include "IsPangenome.hpp"
 #include "SizeLimits.hpp"
@@ -29,7 +35,9 @@
 #include "boundaries.hpp"
 #include "hit.hpp"
 #include "block_hash.hpp"
+#include "simple_task.hpp"
 #include "throw_assert.hpp"
+#include "Exception.hpp"
 #include "global.hpp"
 
 namespace npge {
@@ -54,6 +62,10 @@ IsPangenome::IsPangenome() {
     declare_bs("all-blast-hits", "All blast hits");
     declare_bs("non-internal-hits", "Non-internal blast hits");
     declare_bs("joined", "Results of joining neighbour blocks");
+    add_opt("parallel-checks", "Run independent checks concurrently",
+            false);
+    add_opt("fail-fast", "Stop checks after the first failed check",
+            false);
 }
 
 static void remove_non_internal_hits(const BlockSetPtr& hits,
@@ -113,23 +125,31 @@ static void remove_almost_similar(
     }
 }
 
-void IsPangenome::run_impl() const {
+bool IsPangenome::check_blocks(std::ostream& out, int workers) const {
     ASSERT_EQ(are_blocks_good_->block_set(), block_set());
-    bool good = are_blocks_good_->are_blocks_good();
-    //
+    are_blocks_good_->set_workers(workers);
+    return are_blocks_good_->are_blocks_good(out);
+}
+
+bool IsPangenome::check_joined(std::ostream& out, int workers) const {
+    bool good = true;
     UniqueNames un;
-    std::ostream& out = are_blocks_good_->get_out();
+    un.set_workers(workers);
+    try_join_->set_workers(workers);
     try_join_->block_set()->clear();
     Union u;
+    u.set_workers(workers);
     u.set_bs("other", block_set());
     u.set_bs("target", try_join_->block_set());
     u.run();
     LiteFilter f;
+    f.set_workers(workers);
     f.set_opt_value("min-block", 2);
     f.set_opt_value("min-fragment", 0);
     f.apply(try_join_->block_set());
     try_join_->run();
     Subtract subtract;
+    subtract.set_workers(workers);
     subtract.set_other(block_set());
     subtract.set_block_set(try_join_->block_set());
     subtract.set_opt_value("subtract-equal", true);
@@ -141,16 +161,24 @@ void IsPangenome::run_impl() const {
         out << "Some blocks can be joined" << "\n";
         un.apply(try_join_->block_set());
     }
-    //
-    SharedProcessor rm = meta()->get("RemoveMinorBlocks");
-    rm->apply(abb_->block_set());
+    return good;
+}
+
+bool IsPangenome::check_blast(std::ostream& out, int workers) const {
+    bool good = true;
+    UniqueNames un;
+    un.set_workers(workers);
+    abb_->set_workers(workers);
+    align_->set_workers(workers);
     Rest rest;
+    rest.set_workers(workers);
     rest.set_bs("other", abb_->block_set());
     rest.set_bs("target", abb_->block_set());
     rest.run();
     abb_->run();
     BlockSetPtr hits = abb_->block_set();
     Union all_hits(hits);
+    all_hits.set_workers(workers);
     all_hits.apply(get_bs("all-blast-hits"));
     un.apply(get_bs("all-blast-hits"));
     if (!hits->empty()) {
@@ -158,6 +186,7 @@ void IsPangenome::run_impl() const {
         fix_self_overlaps_in_hits(hits);
         align_->apply(hits);
         Union non_internal_hits(hits);
+        non_internal_hits.set_workers(workers);
         non_internal_hits.apply(get_bs("non-internal-hits"));
         un.apply(get_bs("non-internal-hits"));
         if (!hits->empty()) {
@@ -191,6 +220,155 @@ void IsPangenome::run_impl() const {
             un.apply(hits);
         }
     }
+    return good;
+}
+
+typedef boost::function<bool(std::ostream&, int)> PangenomeCheck;
+
+struct CheckState {
+    PangenomeCheck check;
+    std::vector<Processor*> processors; // interrupted to stop the check
+    std::stringstream out;
+    int workers;
+    bool running;
+    bool finished;
+    bool stopped;
+    bool good;
+    std::string error; // exception thrown by the check
+
+    CheckState():
+        workers(1), running(false), finished(false),
+        stopped(false), good(true) {
+    }
+};
+
+const int CHECKS = 3;
+
+struct ChecksState {
+    CheckState checks[CHECKS];
+    bool fail_fast;
+    boost::mutex mutex;
+};
+
+/** Stop checks following the failed one.
+Preceding checks are not stopped, so the result is the same
+as in sequential run: checks up to the first failed one.
+*/
+static void stop_next_checks(ChecksState* s, int index) {
+    for (int i = index + 1; i < CHECKS; i++) {
+        CheckState& other = s->checks[i];
+        if (!other.finished && !other.stopped) {
+            other.stopped = true;
+            if (other.running) {
+                BOOST_FOREACH (Processor* p, other.processors) {
+                    p->interrupt();
+                }
+            }
+        }
+    }
+}
+
+static void run_check(ChecksState* s, int index) {
+    CheckState& c = s->checks[index];
+    {
+        boost::mutex::scoped_lock lock(s->mutex);
+        if (c.stopped) {
+            return;
+        }
+        c.running = true;
+    }
+    bool good = false;
+    std::string error;
+    try {
+        good = c.check(c.out, c.workers);
+    } catch (std::exception& e) {
+        error = e.what();
+    } catch (...) {
+        error = "Unknown error";
+    }
+    boost::mutex::scoped_lock lock(s->mutex);
+    c.running = false;
+    if (!error.empty()) {
+        // reported by run_impl, after all checks finish
+        c.error = error;
+        return;
+    }
+    c.finished = true;
+    c.good = good;
+    if (!good && s->fail_fast) {
+        stop_next_checks(s, index);
+    }
+}
+
+void IsPangenome::run_impl() const {
+    // Meta is not accessed from threads of checks
+    SharedProcessor rm = meta()->get("RemoveMinorBlocks");
+    rm->apply(abb_->block_set());
+    ChecksState s;
+    s.fail_fast = opt_value("fail-fast").as<bool>();
+    s.checks[0].check = boost::bind(&IsPangenome::check_blocks,
+                                    this, _1, _2);
+    s.checks[0].processors.push_back(are_blocks_good_);
+    s.checks[1].check = boost::bind(&IsPangenome::check_joined,
+                                    this, _1, _2);
+    s.checks[1].processors.push_back(try_join_);
+    s.checks[2].check = boost::bind(&IsPangenome::check_blast,
+                                    this, _1, _2);
+    s.checks[2].processors.push_back(abb_);
+    s.checks[2].processors.push_back(align_);
+    bool parallel = opt_value("parallel-checks").as<bool>();
+    int w = workers();
+    for (int i = 0; i < CHECKS; i++) {
+        // concurrent checks share workers, the rest goes to blast
+        s.checks[i].workers = parallel ? std::max(1, w / CHECKS) : w;
+    }
+    if (parallel && w > CHECKS) {
+        s.checks[2].workers += w % CHECKS;
+    }
+    if (parallel) {
+        Tasks tasks;
+        for (int i = CHECKS - 1; i >= 0; i--) {
+            tasks.push_back(boost::bind(run_check, &s, i));
+        }
+        do_tasks(tasks_to_generator(tasks), CHECKS);
+    } else {
+        for (int i = 0; i < CHECKS; i++) {
+            run_check(&s, i);
+            if (!s.checks[i].error.empty()) {
+                break;
+            }
+        }
+    }
+    for (int i = 0; i < CHECKS; i++) {
+        CheckState& c = s.checks[i];
+        if (c.stopped) {
+            // the check could finish before noticing interruption
+            BOOST_FOREACH (Processor* p, c.processors) {
+                p->reset_interruption();
+            }
+        }
+        if (!c.error.empty()) {
+            if (!c.stopped) {
+                throw Exception(c.error);
+            }
+            write_log("Stopped check failed: " + c.error);
+        }
+    }
+    bool good = true;
+    std::ostream& out = are_blocks_good_->get_out();
+    for (int i = 0; i < CHECKS; i++) {
+        CheckState& c = s.checks[i];
+        if (c.stopped || !c.finished) {
+            good = false;
+            break;
+        }
+        out << c.out.str();
+        good &= c.good;
+        if (!c.good && s.fail_fast) {
+            // following checks could finish before being stopped
+            break;
+        }
+    }
     if (good) {
         out << "[good pangenome]" << std::endl;
     } else {
@@ -8,6 +8,8 @@
 #ifndef NPGE_IS_PANGENOME_HPP_
 #define NPGE_IS_PANGENOME_HPP_
 
+#include <iosfwd>
+
 #include "Processor.hpp"
 #include "FileWriter.hpp"
 #include "global.hpp"
@@ -35,6 +37,13 @@ Requirements of a good pangenome:
     All blast hits are saved in blockset "all-blast-hits".
     Non internal blast hits are saved in "non-internal-hits".
  - No blocks can be joined using Joiner. Blockset "joined".
+
+Checks of blocks, of joining and of blast hits are independent.
+Option "parallel-checks" runs them concurrently;
+workers are divided between the checks.
+Option "fail-fast" stops the checks following the first failed
+check (see interrupt()), so the output is the same as in
+sequential run: results of checks up to the failed one.
 */
 class IsPangenome : public Processor {
 public:
@@ -51,6 +60,10 @@ private:
     Align* align_;
     AddBlastBlocks* abb_;
     TrySmth* try_join_;
+
+    bool check_blocks(std::ostream& out, int workers) const;
+    bool check_joined(std::ostream& out, int workers) const;
+    bool check_blast(std::ostream& out, int workers) const;
 };
 
 }
@@ -5,7 +5,10 @@
  * See the LICENSE file for terms of use.
  */
 
+#include <map>
+#include <algorithm>
 #include <boost/foreach.hpp>
+#include <boost/bind.hpp>
 
 #include "Joiner.hpp"
 #include "MetaAligner.hpp"
@@ -14,6 +17,8 @@
 #include "Block.hpp"
 #include "BlockSet.hpp"
 #include "block_hash.hpp"
+#include "complement.hpp"
+#include "simple_task.hpp"
 #include "throw_assert.hpp"
 
 namespace npge {
@@ -231,34 +236,243 @@ Block* Joiner::try_join(Block* one, Block* another) const {
     return result;
 }
 
+int Joiner::join_ori(Block* one, Block* another,
+                     int match_ori) const {
+    if (one->weak() || another->weak()) {
+        return 0;
+    }
+    if (one->size() != another->size() || one->size() < 2) {
+        return 0;
+    }
+    for (int ori = 1; ori >= -1; ori -= 2) {
+        bool all = true;
+        BOOST_FOREACH (Fragment* f, *one) {
+            Fragment* f1 = s2f_.logical_neighbor(f, ori);
+            if (!f1 || f1->block() != another ||
+                    f1->seq() != f->seq() ||
+                    f1->ori() != f->ori() * match_ori) {
+                all = false;
+                break;
+            }
+        }
+        if (all) {
+            return ori;
+        }
+    }
+    return 0;
+}
+
+/* links[2 * i] is block joinable to blocks[i] at logical ori -1,
+links[2 * i + 1] - at logical ori 1.
+link_oris are relative oris of these blocks (-1 if inversed).
+*/
+void Joiner::find_links(const Blocks* blocks, int first, int last,
+                        Blocks* links,
+                        std::vector<int>* link_oris) const {
+    for (int i = first; i < last; i++) {
+        Block* block = (*blocks)[i];
+        for (int ori = -1; ori <= 1; ori += 2) {
+            Block* other_block = neighbor_block(block, ori);
+            if (!other_block || other_block == block) {
+                continue;
+            }
+            int match_ori = Block::match(block, other_block);
+            if (!match_ori) {
+                continue;
+            }
+            int logical_ori = join_ori(block, other_block, match_ori);
+            if (logical_ori) {
+                int index = 2 * i + (logical_ori + 1) / 2;
+                (*links)[index] = other_block;
+                (*link_oris)[index] = match_ori;
+            }
+        }
+    }
+}
+
+/* Blocks of chain are listed in logical order of the first block
+of the chain with ori = 1; oris are relative oris of blocks.
+Result has ori of block with ori = 1.
+*/
+void Joiner::join_chain(const Blocks* chain, const std::vector<int>* oris,
+                        Block** result) const {
+    TimeIncrementer ti(this);
+    const Blocks& blocks = *chain;
+    int length = blocks.size();
+    ASSERT_GTE(length, 2);
+    bool aln = true;
+    Block* main_block = 0;
+    for (int j = 0; j < length; j++) {
+        aln &= has_alignment(blocks[j]);
+        if ((*oris)[j] == 1 && !main_block) {
+            main_block = blocks[j];
+        }
+    }
+    ASSERT_TRUE(main_block);
+    // fragments of chain, one row per fragment of first block
+    std::vector<Fragments> rows_fragments;
+    BOOST_FOREACH (Fragment* f, *blocks[0]) {
+        int ori = f->ori() * (*oris)[0];
+        Fragments fragments(1, f);
+        for (int j = 1; j < length; j++) {
+            Fragment* f1 = s2f_.neighbor(fragments.back(), ori);
+            ASSERT_TRUE(f1);
+            ASSERT_EQ(f1->block(), blocks[j]);
+            fragments.push_back(f1);
+        }
+        rows_fragments.push_back(fragments);
+    }
+    int size = rows_fragments.size();
+    Strings rows(size);
+    if (aln) {
+        for (int i = 0; i < size; i++) {
+            Fragment* f = rows_fragments[i][0];
+            std::string& row = rows[i];
+            row = f->str();
+            if ((*oris)[0] == -1) {
+                complement(row);
+            }
+        }
+        for (int j = 1; j < length; j++) {
+            Strings middle(size);
+            for (int i = 0; i < size; i++) {
+                Fragment* f = rows_fragments[i][j - 1];
+                Fragment* f1 = rows_fragments[i][j];
+                int ori = f->ori() * (*oris)[j - 1];
+                pos_t min_pos, max_pos;
+                if (ori == 1) {
+                    min_pos = f->max_pos() + 1;
+                    max_pos = f1->min_pos() - 1;
+                } else {
+                    min_pos = f1->max_pos() + 1;
+                    max_pos = f->min_pos() - 1;
+                }
+                if (max_pos >= min_pos) {
+                    Fragment between(f->seq(), min_pos, max_pos, ori);
+                    middle[i] = between.str(0);
+                }
+            }
+            aligner_->align_seqs(middle);
+            for (int i = 0; i < size; i++) {
+                std::string f1_row = rows_fragments[i][j]->str();
+                if ((*oris)[j] == -1) {
+                    complement(f1_row);
+                }
+                rows[i] += middle[i] + f1_row;
+            }
+        }
+    }
+    Block* new_block = new Block;
+    RowType type = aln ? main_block->front()->row()->type() : COMPACT_ROW;
+    for (int i = 0; i < size; i++) {
+        const Fragments& fragments = rows_fragments[i];
+        Fragment* f = fragments[0];
+        Fragment* new_fragment = new Fragment(f->seq());
+        pos_t min_pos = f->min_pos(), max_pos = f->max_pos();
+        BOOST_FOREACH (Fragment* f1, fragments) {
+            min_pos = std::min(min_pos, f1->min_pos());
+            max_pos = std::max(max_pos, f1->max_pos());
+        }
+        new_fragment->set_min_pos(min_pos);
+        new_fragment->set_max_pos(max_pos);
+        new_fragment->set_ori(f->ori() * (*oris)[0]);
+        new_block->insert(new_fragment);
+        if (aln) {
+            AlignmentRow* new_row = AlignmentRow::new_row(type);
+            new_fragment->set_row(new_row);
+            new_row->grow(rows[i]);
+        }
+    }
+    *result = new_block;
+}
+
 void Joiner::run_impl() const {
     s2f_.set_cycles_allowed(false);
     s2f_.clear();
     s2f_.add_bs(*block_set());
     Blocks bs(block_set()->begin(), block_set()->end());
     std::sort(bs.begin(), bs.end(), BlockGreater());
-    BOOST_FOREACH (Block* block, bs) {
-        if (block_set()->has(block)) {
-            for (int ori = -1; ori <= 1; ori += 2) {
-                while (Block* other_block =
-                            neighbor_block(block, ori)) {
-                    Block* new_block =
-                        try_join(block, other_block);
-                    if (new_block) {
-                        s2f_.remove_block(block);
-                        block_set()->erase(block);
-                        s2f_.remove_block(other_block);
-                        block_set()->erase(other_block);
-                        block_set()->insert(new_block);
-                        s2f_.add_block(new_block);
-                        block = new_block;
-                    } else {
-                        break;
-                    }
+    int n = bs.size();
+    // find joinable neighbours of blocks
+    Blocks links(2 * n);
+    std::vector<int> link_oris(2 * n);
+    Tasks tasks;
+    int chunk = std::max(1, n / (workers() * 4));
+    for (int first = 0; first < n; first += chunk) {
+        int last = std::min(n, first + chunk);
+        tasks.push_back(boost::bind(&Joiner::find_links, this, &bs,
+                                    first, last, &links, &link_oris));
+    }
+    do_tasks(tasks_to_generator(tasks), workers());
+    // build maximal chains
+    std::map<Block*, int> block2index;
+    for (int i = 0; i < n; i++) {
+        block2index[bs[i]] = i;
+    }
+    std::vector<char> visited(n);
+    std::vector<Blocks> chains;
+    std::vector<std::vector<int> > chains_oris;
+    for (int i = 0; i < n; i++) {
+        if (visited[i]) {
+            continue;
+        }
+        visited[i] = true;
+        // go to the left (-1) and to the right (1) of block i
+        Blocks sides[2];
+        std::vector<int> sides_oris[2];
+        for (int dir = -1; dir <= 1; dir += 2) {
+            int side = (dir + 1) / 2;
+            int index = i;
+            int ori = 1;
+            while (true) {
+                int link = 2 * index + (dir * ori + 1) / 2;
+                Block* next = links[link];
+                if (!next) {
+                    break;
                 }
+                int next_index = block2index[next];
+                if (visited[next_index]) {
+                    break;
+                }
+                visited[next_index] = true;
+                ori *= link_oris[link];
+                index = next_index;
+                sides[side].push_back(next);
+                sides_oris[side].push_back(ori);
             }
         }
+        if (sides[0].empty() && sides[1].empty()) {
+            continue;
+        }
+        chains.push_back(Blocks());
+        chains_oris.push_back(std::vector<int>());
+        Blocks& chain = chains.back();
+        std::vector<int>& oris = chains_oris.back();
+        chain.assign(sides[0].rbegin(), sides[0].rend());
+        oris.assign(sides_oris[0].rbegin(), sides_oris[0].rend());
+        chain.push_back(bs[i]);
+        oris.push_back(1);
+        chain.insert(chain.end(), sides[1].begin(), sides[1].end());
+        oris.insert(oris.end(), sides_oris[1].begin(),
+                    sides_oris[1].end());
+    }
+    // join chains
+    int chains_number = chains.size();
+    Blocks joined(chains_number);
+    tasks.clear();
+    for (int c = 0; c < chains_number; c++) {
+        tasks.push_back(boost::bind(&Joiner::join_chain, this,
+                                    &chains[c], &chains_oris[c],
+                                    &joined[c]));
+    }
+    do_tasks(tasks_to_generator(tasks), workers());
+    for (int c = 0; c < chains_number; c++) {
+        BOOST_FOREACH (Block* block, chains[c]) {
+            block_set()->erase(block);
+        }
+        block_set()->insert(joined[c]);
     }
+    s2f_.clear();
 }
 
 const char* Joiner::name_impl() const {
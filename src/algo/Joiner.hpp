@@ -21,6 +21,10 @@ class MetaAligner;
 Blocks/fragments must be joinable (Block::can_join and Fragment::can_join).
 
 \ref Block::weak() "Weak" blocks can't be joined.
+
+Joinable pairs of neighbour blocks are found in parallel.
+They form chains of collinear blocks; each maximal chain
+is joined at once (chains are joined in parallel).
 */
 class Joiner : public Processor {
 public:
@@ -78,6 +82,11 @@ private:
                          const Block* another,
                          int logical_ori) const;
     Block* neighbor_block(Block* b, int ori) const;
+    int join_ori(Block* one, Block* another, int match_ori) const;
+    void find_links(const Blocks* blocks, int first, int last,
+                    Blocks* links, std::vector<int>* link_oris) const;
+    void join_chain(const Blocks* chain, const std::vector<int>* oris,
+                    Block** result) const;
     MetaAligner* aligner_;
     mutable SetFc s2f_;
 };
@@ -5,9 +5,9 @@
  * See the LICENSE file for terms of use.
  */
 
-#include <map>
 #include <algorithm>
 #include <boost/foreach.hpp>
+#include <boost/unordered_map.hpp>
 
 #include "LinkEqualFragments.hpp"
 #include "BlockSet.hpp"
@@ -17,7 +17,7 @@
 namespace npge {
 
 struct LinkEqualFragments::Impl {
-    typedef std::map<Fragment, Fragment*> F2F;
+    typedef boost::unordered_map<FragmentKey, Fragment*> F2F;
     F2F f2f_;
 };
 
@@ -38,7 +38,7 @@ LinkEqualFragments::~LinkEqualFragments() {
 void LinkEqualFragments::change_blocks_impl(std::vector<Block*>&) const {
     BOOST_FOREACH (Block* b, *other()) {
         BOOST_FOREACH (Fragment* f, *b) {
-            impl_->f2f_[*f] = f;
+            impl_->f2f_[f->key()] = f;
         }
     }
 }
@@ -50,7 +50,7 @@ void LinkEqualFragments::process_block_impl(Block* block, ThreadData*) const {
     }
     std::vector<Fragment*> copies;
     BOOST_FOREACH (Fragment* fragment, *block) {
-        Impl::F2F::const_iterator it = impl_->f2f_.find(*fragment);
+        Impl::F2F::const_iterator it = impl_->f2f_.find(fragment->key());
         if (it == impl_->f2f_.end()) {
             // one of fragments can't be replaced
             return;
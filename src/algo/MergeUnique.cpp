@@ -8,6 +8,7 @@
 #include <set>
 #include <algorithm>
 #include <boost/foreach.hpp>
+#include <boost/bind.hpp>
 
 #include "MergeUnique.hpp"
 #include "FragmentCollection.hpp"
@@ -16,6 +17,7 @@
 #include "Fragment.hpp"
 #include "block_hash.hpp"
 #include "Meta.hpp"
+#include "simple_task.hpp"
 #include "global.hpp"
 #include "throw_assert.hpp"
 
@@ -59,7 +61,7 @@ static void merge_fragments(
 }
 
 static bool isJoinableFragment(const Fragment* n,
-                               int min_length) {
+                               pos_t min_length) {
     if (!n) {
         return false;
     }
@@ -76,60 +78,122 @@ static bool isJoinableFragment(const Fragment* n,
     return true;
 }
 
+/** Groups of unique fragments to be merged around a block.
+Proposals are made in parallel for unchanged blockset and
+applied sequentially. A proposal is made again if some of
+fragments it depends on were merged after it was made.
+*/
+struct MergeProposal {
+    Fragments examined;
+    std::vector<FragmentsSet> groups;
+};
+
+typedef std::vector<MergeProposal> MergeProposals;
+
 // merge unique fragments surrounded by same blocks
-static void inspect_neighbours2(const VectorFc& fc,
-                                Block* b, BlockSet& bs,
-                                int ori, int min_length) {
+static void propose_neighbours2(const VectorFc& fc,
+                                Block* b, int ori, pos_t min_length,
+                                MergeProposal& proposal) {
     ASSERT_GTE(b->size(), 2);
     typedef std::pair<Block*, int> BlockOri;
-    typedef std::map<BlockOri, Fragments> UniqueOf;
+    typedef std::map<BlockOri, FragmentsSet> UniqueOf;
     UniqueOf unique_of;
     BOOST_FOREACH (Fragment* f, *b) {
         Fragment* n = fc.logical_neighbor(f, ori);
+        if (n) {
+            proposal.examined.push_back(n);
+        }
         if (isJoinableFragment(n, min_length)) {
             Fragment* in_2 = fc.another_neighbor(n, f);
             // in_2 can be == f,
             // if the sequence has only 2 fragments
             if (in_2 && in_2 != f) {
+                proposal.examined.push_back(in_2);
                 Block* in_2_b = in_2->block();
                 ASSERT_TRUE(in_2_b);
                 if (in_2_b->size() >= 2) {
                     int o = f->ori() * in_2->ori();
-                    unique_of[BlockOri(in_2_b, o)].push_back(n);
+                    unique_of[BlockOri(in_2_b, o)].insert(n);
                 }
             }
         }
     }
     BOOST_FOREACH (const UniqueOf::value_type& u, unique_of) {
-        const Fragments& ff0 = u.second;
-        // exclude used fragments
-        FragmentsSet ff;
-        BOOST_FOREACH (Fragment* f, ff0) {
-            ASSERT_TRUE(f->block());
-            if (isJoinableFragment(f, min_length)) {
-                ff.insert(f);
-            }
-        }
-        if (ff.size() >= 2) {
-            merge_fragments(ff, fc, b, bs, ori);
+        if (u.second.size() >= 2) {
+            proposal.groups.push_back(u.second);
         }
     }
 }
 
 // merge unique neighbours of a block
-static void inspect_neighbours1(const VectorFc& fc,
-                                Block* b, BlockSet& bs,
-                                int ori, int min_length) {
+static void propose_neighbours1(const VectorFc& fc,
+                                Block* b, int ori, pos_t min_length,
+                                MergeProposal& proposal) {
     ASSERT_GTE(b->size(), 2);
     FragmentsSet unique;
     BOOST_FOREACH (Fragment* f, *b) {
         Fragment* n = fc.logical_neighbor(f, ori);
+        if (n) {
+            proposal.examined.push_back(n);
+        }
         if (isJoinableFragment(n, min_length)) {
             unique.insert(n);
         }
     }
     if (unique.size() >= 2) {
-        merge_fragments(unique, fc, b, bs, ori);
+        proposal.groups.push_back(unique);
+    }
+}
+
+static void propose(const VectorFc& fc, Block* b, int ori,
+                    bool both, pos_t min_length,
+                    MergeProposal& proposal) {
+    if (both) {
+        propose_neighbours2(fc, b, ori, min_length, proposal);
+    } else {
+        propose_neighbours1(fc, b, ori, min_length, proposal);
+    }
+}
+
+static void propose_range(const VectorFc* fc, const Blocks* blocks,
+                          int begin, int end,
+                          bool both, pos_t min_length,
+                          MergeProposals* proposals) {
+    for (int i = begin; i < end; i++) {
+        for (int ori = -1; ori <= 1; ori += 2) {
+            MergeProposal& proposal = (*proposals)[i * 2 + (ori + 1) / 2];
+            propose(*fc, (*blocks)[i], ori, both, min_length, proposal);
+        }
+    }
+}
+
+static bool is_stale(const MergeProposal& proposal,
+                     const FragmentsSet& merged) {
+    BOOST_FOREACH (Fragment* f, proposal.examined) {
+        if (merged.find(f) != merged.end()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void apply_proposal(const MergeProposal& proposal,
+                           const VectorFc& fc, Block* b,
+                           BlockSet& bs, int ori, pos_t min_length,
+                           FragmentsSet& merged) {
+    BOOST_FOREACH (const FragmentsSet& ff0, proposal.groups) {
+        // exclude used fragments
+        FragmentsSet ff;
+        BOOST_FOREACH (Fragment* f, ff0) {
+            ASSERT_TRUE(f->block());
+            if (isJoinableFragment(f, min_length)) {
+                ff.insert(f);
+            }
+        }
+        if (ff.size() >= 2) {
+            merge_fragments(ff, fc, b, bs, ori);
+            merged.insert(ff.begin(), ff.end());
+        }
     }
 }
 
@@ -142,7 +206,7 @@ struct BlockSizeCmpRev {
 void MergeUnique::run_impl() const {
     bool both = opt_value("both-neighbours").as<bool>();
     bool merge_long = opt_value("merge-long").as<bool>();
-    int min_length = meta()->get_opt("MIN_LENGTH").as<int>();
+    pos_t min_length = meta()->get_opt("MIN_LENGTH").as<int>();
     if (merge_long) {
         min_length = npge::MAX_POS;
     }
@@ -157,13 +221,29 @@ void MergeUnique::run_impl() const {
         }
     }
     std::sort(blocks.begin(), blocks.end(), BlockSizeCmpRev());
-    BOOST_FOREACH (Block* b, blocks) {
+    int n = blocks.size();
+    MergeProposals proposals(n * 2);
+    int parts = std::min(n, workers() * 4);
+    Tasks tasks;
+    for (int part = 0; part < parts; part++) {
+        int begin = n * part / parts;
+        int end = n * (part + 1) / parts;
+        tasks.push_back(boost::bind(propose_range, &fc, &blocks,
+                                    begin, end, both, min_length,
+                                    &proposals));
+    }
+    do_tasks(tasks_to_generator(tasks), workers());
+    FragmentsSet merged;
+    for (int i = 0; i < n; i++) {
+        Block* b = blocks[i];
         for (int ori = -1; ori <= 1; ori += 2) {
-            if (both) {
-                inspect_neighbours2(fc, b, bs, ori, min_length);
-            } else {
-                inspect_neighbours1(fc, b, bs, ori, min_length);
+            MergeProposal& proposal = proposals[i * 2 + (ori + 1) / 2];
+            if (is_stale(proposal, merged)) {
+                proposal = MergeProposal();
+                propose(fc, b, ori, both, min_length, proposal);
             }
+            apply_proposal(proposal, fc, b, bs, ori, min_length, merged);
+            proposal = MergeProposal();
         }
     }
 }
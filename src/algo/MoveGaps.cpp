@@ -12,6 +12,7 @@
 #include "Block.hpp"
 #include "Fragment.hpp"
 #include "AlignmentRow.hpp"
+#include "AlignmentCursor.hpp"
 #include "RowStorage.hpp"
 #include "throw_assert.hpp"
 #include "cast.hpp"
@@ -45,12 +46,11 @@ bool MoveGaps::move_gaps(Block* block) const {
         typedef std::pair<int, int> TailGap;
         TailGap moves[3]; // index is ori + 1
         for (int ori = -1; ori <= 1; ori += 2) {
-            int begin = (ori == 1) ? 0 : length - 1;
+            AlignmentCursor c(row, ori);
             int tail = 0;
             int i;
-            for (i = 0; i < max_tail + 1; i++) {
-                int al_pos = begin + i * ori;
-                if (row->map_to_fragment(al_pos) != -1) {
+            for (i = 0; i < max_tail + 1; i++, c.next()) {
+                if (c.valid() && c.fragment_pos() != -1) {
                     tail += 1;
                 } else {
                     break;
@@ -59,9 +59,8 @@ bool MoveGaps::move_gaps(Block* block) const {
             if (0 < tail && tail <= max_tail) {
                 int gap = 0;
                 int max_pos = length / 2;
-                for (; i < max_pos; i++) {
-                    int al_pos = begin + i * ori;
-                    if (row->map_to_fragment(al_pos) == -1) {
+                for (; i < max_pos; i++, c.next()) {
+                    if (c.fragment_pos() == -1) {
                         gap += 1;
                     } else {
                         break;
@@ -76,9 +75,7 @@ bool MoveGaps::move_gaps(Block* block) const {
         }
         if (moves[-1 + 1].first != 0 || moves[1 + 1].first != 0) {
             result = true;
-            std::stringstream ss;
-            f->print_contents(ss, '-', /* line */ 0);
-            std::string data = ss.str();
+            std::string data = f->str('-');
             for (int ori = -1; ori <= 1; ori += 2) {
                 int begin = (ori == 1) ? 0 : length - 1;
                 int tail = moves[ori + 1].first;
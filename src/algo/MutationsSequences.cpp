@@ -53,14 +53,14 @@ ThreadData* MutationsSequences::before_thread_impl() const {
     return d;
 }
 
-typedef std::set<int> Positions;
+typedef std::set<pos_t> Positions;
 
 static void add_positions(Positions& positions,
                           const Mutation& m,
-                          int distance, int block_length) {
-    int start = std::max(m.start - distance, 0);
-    int stop = std::min(m.stop + distance, block_length - 1);
-    for (int pos = start; pos <= stop; pos++) {
+                          int distance, pos_t block_length) {
+    pos_t start = std::max(m.start - distance, pos_t(0));
+    pos_t stop = std::min(m.stop + distance, block_length - 1);
+    for (pos_t pos = start; pos <= stop; pos++) {
         positions.insert(pos);
     }
 }
@@ -69,7 +69,7 @@ void MutationsSequences::process_block_impl(Block* block,
         ThreadData* data) const {
     Positions positions;
     int distance = opt_value("mutation-distance").as<int>();
-    int block_length = block->alignment_length();
+    pos_t block_length = block->alignment_length();
     print_mutations_->find_mutations(block,
                                      boost::bind(add_positions,
                                              boost::ref(positions),
@@ -95,7 +95,7 @@ void MutationsSequences::process_block_impl(Block* block,
         std::string& s = genome2str[genome];
         // Forgot RemoveNonStem --exact=1?
         ASSERT_EQ(s.size(), block2start[block]);
-        BOOST_FOREACH (int pos, positions) {
+        BOOST_FOREACH (pos_t pos, positions) {
             // set is ordered
             char c = f->alignment_at(pos);
             if (c == '\0') {
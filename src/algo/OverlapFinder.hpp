@@ -40,7 +40,7 @@ protected:
     const char* name_impl() const;
 
 private:
-    mutable VectorFc s2f_;
+    mutable IntervalFc s2f_;
     mutable SBlocks hits_;
 };
 
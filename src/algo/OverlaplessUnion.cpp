@@ -19,6 +19,7 @@
 #include "BlockSet.hpp"
 #include "Block.hpp"
 #include "Fragment.hpp"
+#include "simple_task.hpp"
 
 namespace npge {
 
@@ -51,6 +52,146 @@ OverlaplessUnion::OverlaplessUnion() {
     declare_bs("other", "Source of blocks addition");
 }
 
+/** Fragment of candidate block */
+struct CandidateFragment {
+    pos_t min_pos;
+    pos_t max_pos;
+    int block; // index of block in sorted list
+
+    bool operator<(const CandidateFragment& other) const {
+        return min_pos < other.min_pos;
+    }
+};
+
+typedef std::vector<CandidateFragment> CandidateFragments;
+typedef std::map<Sequence*, CandidateFragments> Seq2Candidates;
+typedef std::pair<int, int> IntPair;
+typedef std::vector<IntPair> IntPairs;
+
+static void check_target(const SetFc* s2f, const Blocks* blocks,
+                         std::vector<char>* bad, int first, int last) {
+    for (int i = first; i < last; i++) {
+        (*bad)[i] = s2f->block_has_overlap((*blocks)[i]);
+    }
+}
+
+/** Sweep fragments of one sequence, find pairs of blocks,
+which connect all overlapping fragments */
+static void sweep_seq(CandidateFragments* fragments, IntPairs* edges) {
+    std::sort(fragments->begin(), fragments->end());
+    const CandidateFragment* longest = 0;
+    BOOST_FOREACH (const CandidateFragment& f, *fragments) {
+        if (longest && f.min_pos <= longest->max_pos) {
+            // f overlaps the fragment with max max_pos among previous
+            edges->push_back(IntPair(longest->block, f.block));
+        }
+        if (!longest || f.max_pos > longest->max_pos) {
+            longest = &f;
+        }
+    }
+}
+
+static int find_root(std::vector<int>& parent, int i) {
+    while (parent[i] != i) {
+        parent[i] = parent[parent[i]];
+        i = parent[i];
+    }
+    return i;
+}
+
+/** Greedy selection inside connected component of conflict graph */
+static void resolve_component(const Blocks* blocks,
+                              const std::vector<int>* component,
+                              std::vector<char>* selected) {
+    SetFc s2f;
+    BOOST_FOREACH (int i, *component) {
+        Block* block = (*blocks)[i];
+        if (!s2f.block_has_overlap(block)) {
+            s2f.add_block(block);
+            (*selected)[i] = true;
+        }
+    }
+}
+
+/* Blocks are processed in the order of BlockLengthLess.
+Block is selected if it does not overlap target and
+previously selected blocks.
+Overlaps with target are checked in parallel.
+Then other blocks are divided into connected components
+of the graph of overlaps; the greedy selection is done
+in each component separately (in parallel).
+The result is the same as of serial greedy selection.
+*/
+static void select_blocks(std::vector<char>& selected,
+                          const Blocks& blocks, const SetFc& s2f,
+                          bool filter, int workers) {
+    int n = blocks.size();
+    std::vector<char> bad(n);
+    Tasks tasks;
+    int chunk = std::max(1, n / (workers * 4));
+    for (int first = 0; first < n; first += chunk) {
+        int last = std::min(n, first + chunk);
+        tasks.push_back(boost::bind(check_target, &s2f, &blocks,
+                                    &bad, first, last));
+    }
+    do_tasks(tasks_to_generator(tasks), workers);
+    selected.resize(n);
+    if (filter) {
+        // blocks are not added, so they can't conflict
+        for (int i = 0; i < n; i++) {
+            selected[i] = !bad[i];
+        }
+        return;
+    }
+    Seq2Candidates seq2candidates;
+    for (int i = 0; i < n; i++) {
+        if (bad[i]) {
+            continue;
+        }
+        BOOST_FOREACH (Fragment* f, *blocks[i]) {
+            CandidateFragment cf;
+            cf.min_pos = f->min_pos();
+            cf.max_pos = f->max_pos();
+            cf.block = i;
+            seq2candidates[f->seq()].push_back(cf);
+        }
+    }
+    std::vector<IntPairs> edges(seq2candidates.size());
+    tasks.clear();
+    int seq_index = 0;
+    BOOST_FOREACH (Seq2Candidates::value_type& s_c, seq2candidates) {
+        tasks.push_back(boost::bind(sweep_seq, &s_c.second,
+                                    &edges[seq_index]));
+        seq_index += 1;
+    }
+    do_tasks(tasks_to_generator(tasks), workers);
+    std::vector<int> parent(n);
+    for (int i = 0; i < n; i++) {
+        parent[i] = i;
+    }
+    BOOST_FOREACH (const IntPairs& seq_edges, edges) {
+        BOOST_FOREACH (const IntPair& edge, seq_edges) {
+            int a = find_root(parent, edge.first);
+            int b = find_root(parent, edge.second);
+            parent[std::max(a, b)] = std::min(a, b);
+        }
+    }
+    // components, members are in order of priority
+    std::map<int, std::vector<int> > components;
+    for (int i = 0; i < n; i++) {
+        if (!bad[i]) {
+            components[find_root(parent, i)].push_back(i);
+        }
+    }
+    tasks.clear();
+    typedef std::map<int, std::vector<int> >::value_type Component;
+    BOOST_FOREACH (const Component& component, components) {
+        tasks.push_back(boost::bind(resolve_component, &blocks,
+                                    &component.second, &selected));
+    }
+    do_tasks(tasks_to_generator(tasks), workers);
+}
+
 void OverlaplessUnion::run_impl() const {
     bool move = opt_value("ou-move").as<bool>();
     bool filter = opt_value("ou-filter").as<bool>();
@@ -60,13 +201,14 @@ void OverlaplessUnion::run_impl() const {
     s2f.add_bs(t);
     Blocks blocks(o.begin(), o.end());
     std::sort(blocks.begin(), blocks.end(), BlockLengthLess());
-    BOOST_FOREACH (Block* block, blocks) {
-        bool overlaps = s2f.block_has_overlap(block);
-        if (overlaps && filter) {
+    std::vector<char> selected;
+    select_blocks(selected, blocks, s2f, filter, workers());
+    for (int i = 0; i < blocks.size(); i++) {
+        Block* block = blocks[i];
+        if (!selected[i] && filter) {
             o.erase(block);
         }
-        if (!overlaps && !filter) {
-            s2f.add_block(block);
+        if (selected[i] && !filter) {
             if (move) {
                 o.detach(block);
                 t.insert(block);
@@ -8,14 +8,15 @@
 #include <boost/foreach.hpp>
 
 #include "Partition.hpp"
-#include "FragmentCollection.hpp"
+#include "CoverageIndex.hpp"
+#include "Fragment.hpp"
 #include "Block.hpp"
 #include "global.hpp"
 
 namespace npge {
 
 struct Partition::Impl {
-    VectorFc fc_;
+    CoverageIndexPtr index_;
 };
 
 Partition::Partition() {
@@ -30,16 +31,14 @@ Partition::~Partition() {
 }
 
 void Partition::change_blocks_impl(std::vector<Block*>& /* blocks */) const {
-    impl_->fc_.clear();
-    impl_->fc_.add_bs(*other());
-    impl_->fc_.prepare();
+    impl_->index_ = CoverageIndex::of(*other(), workers());
 }
 
 void Partition::process_block_impl(Block* block, ThreadData*) const {
     std::vector<Fragment*> new_fragments;
     BOOST_FOREACH (Fragment* fragment, *block) {
         std::vector<Fragment> overlaps;
-        impl_->fc_.find_overlaps(overlaps, fragment);
+        impl_->index_->find_overlaps(overlaps, fragment);
         BOOST_FOREACH (const Fragment& overlap, overlaps) {
             Fragment* new_fragment = new Fragment(overlap);
             new_fragment->set_ori(fragment->ori());
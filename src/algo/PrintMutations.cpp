@@ -5,23 +5,39 @@
  * See the LICENSE file for terms of use.
  */
 
+#include <stdint.h>
 #include <string>
+#include <vector>
+#include <algorithm>
 #include <boost/foreach.hpp>
 #include <boost/bind.hpp>
 
 #include "PrintMutations.hpp"
 #include "Block.hpp"
 #include "Fragment.hpp"
+#include "BlockMatrix.hpp"
 #include "throw_assert.hpp"
 #include "global.hpp"
 
 namespace npge {
 
+static bool check_format(std::string& message, Processor* p) {
+    std::string format = p->opt_value("format").as<std::string>();
+    if (format != "tsv" && format != "binary") {
+        message = "bad format: " + format;
+        return false;
+    }
+    return true;
+}
+
 PrintMutations::PrintMutations() {
     declare_bs("target", "Target blockset");
     add_opt("compress", "Compress output by printing . "
             "instead of repeated block or fragment name",
             true);
+    add_opt("format", "Format of output file (tsv/binary)",
+            std::string("tsv"));
+    add_opt_check(boost::bind(check_format, _1, this));
 }
 
 void PrintMutations::find_mutations(const Block* block,
@@ -32,32 +48,40 @@ void PrintMutations::find_mutations(const Block* block,
     if (size == 1) {
         ASSERT_EQ(block->alignment_length(), cons.size());
     }
+    pos_t length = cons.size();
+    std::vector<char> cells;
     BOOST_FOREACH (Fragment* f, *block) {
+        // gap run is carried across windows
         int gaps = 0;
-        for (int pos = 0; pos < cons.size(); pos++) {
-            char x = f->alignment_at(pos);
-            if (size == 1) {
-                ASSERT_EQ(x, cons[pos]);
-            }
-            if (x == '\0') {
-                gaps += 1;
-            }
-            if (x != '\0' && gaps) {
-                Mutation m;
-                m.fragment = f;
-                m.start = pos - gaps;
-                m.stop = pos - 1;
-                m.change = '-';
-                func(m);
-                gaps = 0;
-            }
-            if (x != '\0' && x != cons[pos]) {
-                Mutation m;
-                m.fragment = f;
-                m.start = pos;
-                m.stop = pos;
-                m.change = x;
-                func(m);
+        for (pos_t w = 0; w < length; w += BLOCK_MATRIX_WINDOW) {
+            pos_t w_stop = std::min(length, w + BLOCK_MATRIX_WINDOW) - 1;
+            cells.assign(w_stop - w + 1, '\0');
+            BlockMatrix::decode_fragment(&cells[0], f, w, w_stop);
+            for (pos_t pos = w; pos <= w_stop; pos++) {
+                char x = cells[pos - w];
+                if (size == 1) {
+                    ASSERT_EQ(x, cons[pos]);
+                }
+                if (x == '\0') {
+                    gaps += 1;
+                }
+                if (x != '\0' && gaps) {
+                    Mutation m;
+                    m.fragment = f;
+                    m.start = pos - gaps;
+                    m.stop = pos - 1;
+                    m.change = '-';
+                    func(m);
+                    gaps = 0;
+                }
+                if (x != '\0' && x != cons[pos]) {
+                    Mutation m;
+                    m.fragment = f;
+                    m.start = pos;
+                    m.stop = pos;
+                    m.change = x;
+                    func(m);
+                }
             }
         }
     }
@@ -68,7 +92,7 @@ static void print_change(std::ostream& o, const Mutation& m) {
     const Block* block = f->block();
     if (m.stop > m.start) {
         ASSERT_EQ(m.change, '-');
-        for (int i = m.start; i <= m.stop; i++) {
+        for (pos_t i = m.start; i <= m.stop; i++) {
             o << block->name() << '\t' << f->id() << '\t';
             o << i << '\t' << m.change << '\n';
         }
@@ -115,9 +139,100 @@ struct CompressedPrinter {
     }
 };
 
+static void put_u16(std::string& buffer, int value) {
+    ASSERT_GTE(value, 0);
+    ASSERT_LT(value, 1 << 16);
+    buffer += char(value & 0xFF);
+    buffer += char((value >> 8) & 0xFF);
+}
+
+static void put_u32(std::string& buffer, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        buffer += char((value >> (i * 8)) & 0xFF);
+    }
+}
+
+static void put_u64(std::string& buffer, uint64_t value) {
+    for (int i = 0; i < 8; i++) {
+        buffer += char((value >> (i * 8)) & 0xFF);
+    }
+}
+
+// positions are written as is, version byte tells their width
+const char BINARY_VERSION = (sizeof(pos_t) == 8) ? 2 : 1;
+
+static void put_pos(std::string& buffer, pos_t value) {
+    ASSERT_GTE(value, 0);
+    if (sizeof(pos_t) == 8) {
+        put_u64(buffer, value);
+    } else {
+        put_u32(buffer, value);
+    }
+}
+
+static void put_str(std::string& buffer, const std::string& str) {
+    put_u16(buffer, str.size());
+    buffer += str;
+}
+
+/** Collects mutations of a block into columns */
+struct BinaryChunk {
+    std::vector<const Fragment*> fragments_;
+    std::vector<uint32_t> fragment_;
+    std::vector<pos_t> start_;
+    std::vector<pos_t> stop_;
+    std::string change_;
+
+    void add(const Mutation& m) {
+        if (fragments_.empty() || fragments_.back() != m.fragment) {
+            // mutations of a fragment are consecutive
+            fragments_.push_back(m.fragment);
+        }
+        fragment_.push_back(fragments_.size() - 1);
+        start_.push_back(m.start);
+        stop_.push_back(m.stop);
+        change_ += m.change;
+    }
+
+    void write(std::ostream& o, const Block* block) const {
+        int n = change_.size();
+        if (n == 0) {
+            return;
+        }
+        std::string buffer;
+        buffer.reserve(n * (5 + 2 * sizeof(pos_t)) +
+                       fragments_.size() * 16);
+        put_str(buffer, block->name());
+        put_u32(buffer, fragments_.size());
+        BOOST_FOREACH (const Fragment* f, fragments_) {
+            put_str(buffer, f->id());
+        }
+        put_u32(buffer, n);
+        BOOST_FOREACH (uint32_t value, fragment_) {
+            put_u32(buffer, value);
+        }
+        const std::vector<pos_t>* columns[] = {&start_, &stop_};
+        BOOST_FOREACH (const std::vector<pos_t>* column, columns) {
+            BOOST_FOREACH (pos_t value, *column) {
+                put_pos(buffer, value);
+            }
+        }
+        buffer += change_;
+        std::string size;
+        put_u32(size, buffer.size());
+        o.write(size.c_str(), size.size());
+        o.write(buffer.c_str(), buffer.size());
+    }
+};
+
 void PrintMutations::print_block(std::ostream& o, Block* block) const {
     TimeIncrementer ti(this);
-    if (opt_value("compress").as<bool>()) {
+    if (binary_output()) {
+        BinaryChunk chunk;
+        find_mutations(block, boost::bind(
+                           &BinaryChunk::add, &chunk, _1));
+        chunk.write(o, block);
+    } else if (opt_value("compress").as<bool>()) {
         CompressedPrinter p(o);
         find_mutations(block, boost::bind(
                            &CompressedPrinter::print, &p, _1));
@@ -128,11 +243,20 @@ void PrintMutations::print_block(std::ostream& o, Block* block) const {
 }
 
 void PrintMutations::print_header(std::ostream& o) const {
+    if (binary_output()) {
+        o.write("NPGEMUT", 7);
+        o.put(BINARY_VERSION);
+        return;
+    }
     o << "block" << '\t' << "fragment"
       << '\t' << "start" << '\t'
       << "stop(gaps)/change" << '\n';
 }
 
+bool PrintMutations::binary_output() const {
+    return opt_value("format").as<std::string>() == "binary";
+}
+
 const char* PrintMutations::name_impl() const {
     return "Find all mutations in block";
 }
@@ -18,15 +18,37 @@ namespace npge {
 /** Mutation description */
 struct Mutation {
     Fragment* fragment;
-    int start;
-    int stop;
+    pos_t start;
+    pos_t stop;
     char change;
 };
 
 /** Function processing a mutation */
 typedef boost::function<void(const Mutation&)> MutationHandler;
 
-/** Find all mutations in block */
+/** Find all mutations in block.
+
+Option "format" selects format of output file: "tsv" (table,
+see print_block()) or "binary".
+
+Binary file starts with "NPGEMUT" and version byte, followed by chunks,
+one chunk per block with mutations, in order of blocks.
+Version is 1 if positions are 32-bit and 2 if positions are
+64-bit (NPGE_POS64). pos is u32 in version 1 and u64 in version 2.
+All integers are little-endian, str is u16 length and bytes.
+Chunk:
+    - u32 size of the rest of chunk in bytes
+    - str block name
+    - u32 F, number of fragments; F x str fragment ids
+    - u32 N, number of mutations
+    - u32[N] fragment (index in fragment ids)
+    - pos[N] start
+    - pos[N] stop (stop > start only for gaps)
+    - u8[N] change (new letter or '-' for gap)
+
+Chunks of blocks are encoded in parallel and written in order.
+See tool/parse-mutations-file.py for reader of both formats.
+*/
 class PrintMutations : public AbstractOutput {
 public:
     /** Constructor */
@@ -35,7 +57,7 @@ public:
     /** Find mutations and calls f() for each mutation */
     void find_mutations(const Block* block, const MutationHandler& f) const;
 
-    /** Print table.
+    /** Print table or binary chunk.
     Table columns:
         - block
         - fr
@@ -48,6 +70,8 @@ public:
     void print_header(std::ostream& o) const;
 
 protected:
+    bool binary_output() const;
+
     const char* name_impl() const;
 };
 
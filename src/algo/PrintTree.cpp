@@ -30,13 +30,22 @@ PrintTree::PrintTree() {
 }
 
 FragmentLeaf::FragmentLeaf(const Fragment* f, const FragmentDistance* distance):
-    f_(f), distance_(distance) {
+    f_(f), distance_(distance), index_(-1) {
+}
+
+FragmentLeaf::FragmentLeaf(const Fragment* f,
+                           const FragmentDistance* distance,
+                           const DistanceTablePtr& table, int index):
+    f_(f), distance_(distance), table_(table), index_(index) {
 }
 
 double FragmentLeaf::distance_to_impl(const LeafNode* leaf) const {
-    ASSERT_TRUE(distance_);
     const FragmentLeaf* fl;
     fl = boost::polymorphic_downcast<const FragmentLeaf*>(leaf);
+    if (table_ && fl->table_ == table_) {
+        return table_->ratios[index_ * table_->n + fl->index_];
+    }
+    ASSERT_TRUE(distance_);
     return distance_->fragment_distance(f_, fl->f_).ratio();
 }
 
@@ -45,15 +54,24 @@ std::string FragmentLeaf::name_impl() const {
 }
 
 TreeNode* FragmentLeaf::clone_impl() const {
-    return new FragmentLeaf(f_, distance_);
+    return new FragmentLeaf(f_, distance_, table_, index_);
 }
 
 TreeNode* PrintTree::make_tree(const Block* block,
                                const std::string& method) const {
     TimeIncrementer ti(this);
+    Fragments fragments(block->begin(), block->end());
+    std::vector<FragmentDistance::Distance> distances;
+    distance_->all_distances(distances, fragments);
+    boost::shared_ptr<DistanceTable> table(new DistanceTable);
+    table->n = fragments.size();
+    for (int i = 0; i < distances.size(); i++) {
+        table->ratios.push_back(distances[i].ratio());
+    }
     TreeNode* tree = new TreeNode;
-    BOOST_FOREACH (const Fragment* f, *block) {
-        tree->add_child(new FragmentLeaf(f, distance_));
+    for (int i = 0; i < fragments.size(); i++) {
+        tree->add_child(new FragmentLeaf(fragments[i], distance_,
+                                         table, i));
     }
     if (method == "upgma") {
         tree->upgma();
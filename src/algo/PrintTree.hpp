@@ -8,6 +8,9 @@
 #ifndef NPGE_PRINT_TREE_HPP_
 #define NPGE_PRINT_TREE_HPP_
 
+#include <vector>
+#include <boost/shared_ptr.hpp>
+
 #include "AbstractOutput.hpp"
 #include "tree.hpp"
 #include "global.hpp"
@@ -16,11 +19,30 @@ namespace npge {
 
 class FragmentDistance;
 
+/** Table of distances between all pairs of n leafs */
+struct DistanceTable {
+    int n;
+    std::vector<double> ratios; ///< distance(i, j) is ratios[i * n + j]
+};
+
+typedef boost::shared_ptr<const DistanceTable> DistanceTablePtr;
+
 class FragmentLeaf : public LeafNode {
 public:
     FragmentLeaf(const Fragment* f,
                  const FragmentDistance* distance = 0);
 
+    /** Constructor with precomputed distances.
+    Distance to other leaf sharing the same table is read
+    from the table, otherwise it is calculated by distance.
+    \param f Fragment.
+    \param distance Fragment distance.
+    \param table Table of distances between all leafs.
+    \param index Index of the leaf in the table.
+    */
+    FragmentLeaf(const Fragment* f, const FragmentDistance* distance,
+                 const DistanceTablePtr& table, int index);
+
     double distance_to_impl(const LeafNode* leaf) const;
 
     std::string name_impl() const;
@@ -34,6 +56,8 @@ public:
 private:
     const Fragment* f_;
     const FragmentDistance* distance_;
+    DistanceTablePtr table_;
+    int index_;
 };
 
 /** Print tree.
@@ -23,6 +23,7 @@
 
 #include "Processor.hpp"
 #include "BlockSet.hpp"
+#include "CoverageIndex.hpp"
 #include "FileWriter.hpp"
 #include "class_name.hpp"
 #include "string_arguments.hpp"
@@ -649,6 +650,19 @@ void Processor::apply_string_options(const std::string& options) {
     apply_vector_options(opts);
 }
 
+/** Drop coverage index of blockset when leaving scope */
+struct CoverageForgetter {
+    BlockSetPtr bs_;
+
+    CoverageForgetter(const BlockSetPtr& bs):
+        bs_(bs) {
+    }
+
+    ~CoverageForgetter() {
+        CoverageIndex::forget(*bs_);
+    }
+};
+
 void Processor::run() const {
     TimeIncrementer ti(this);
     check_interruption();
@@ -665,6 +679,8 @@ void Processor::run() const {
         // RTTI would be invalid in ~Processor()
     }
     if (workers() != 0 && block_set()) {
+        // fragments of target can be changed in place
+        CoverageForgetter forgetter(block_set());
         run_impl();
     }
     if (timing1) {
@@ -951,6 +967,10 @@ void Processor::interrupt() {
     impl_->interrupted_ = true;
 }
 
+void Processor::reset_interruption() {
+    impl_->interrupted_ = false;
+}
+
 bool Processor::is_interrupted() const {
     const Processor* p = this;
     while (p) {
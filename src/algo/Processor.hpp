@@ -451,6 +451,11 @@ public:
     */
     void interrupt();
 
+    /** Mark current processor as non-interrupted.
+    Ancestors are not changed.
+    */
+    void reset_interruption();
+
     /** Return if this processor or any of its ancestors is interrupted */
     bool is_interrupted() const;
 
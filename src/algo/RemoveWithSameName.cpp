@@ -9,7 +9,6 @@
 #include <boost/cast.hpp>
 
 #include "RemoveWithSameName.hpp"
-#include "SortedVector.hpp"
 #include "BlockSet.hpp"
 #include "Block.hpp"
 
@@ -20,17 +19,6 @@ RemoveWithSameName::RemoveWithSameName() {
     declare_bs("target", "Modified blockset");
 }
 
-typedef SortedVector<std::string> SortedStrings;
-
-void RemoveWithSameName::initialize_work_impl() const {
-    names_.clear();
-    BOOST_FOREACH (Block* b, *other()) {
-        names_.push_back(b->name());
-    }
-    SortedStrings& nn = static_cast<SortedStrings&>(names_);
-    nn.sort_unique();
-}
-
 struct RWSNData: public ThreadData {
     Blocks removed_;
 };
@@ -43,8 +31,7 @@ void RemoveWithSameName::process_block_impl(Block* block,
         ThreadData* d) const {
     RWSNData* data = boost::polymorphic_downcast<RWSNData*>(d);
     Blocks& removed = data->removed_;
-    SortedStrings& nn = static_cast<SortedStrings&>(names_);
-    if (nn.has_elem(block->name())) {
+    if (other()->find_block(block->name())) {
         removed.push_back(block);
     }
 }
@@ -58,10 +45,6 @@ void RemoveWithSameName::after_thread_impl(ThreadData* d) const {
     }
 }
 
-void RemoveWithSameName::finish_work_impl() const {
-    names_.clear();
-}
-
 const char* RemoveWithSameName::name_impl() const {
     return "Remove from target blocks with names from other";
 }
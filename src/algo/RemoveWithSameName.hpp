@@ -20,15 +20,10 @@ public:
     RemoveWithSameName();
 
 protected:
-    void initialize_work_impl() const;
     ThreadData* before_thread_impl() const;
     void process_block_impl(Block* block, ThreadData*) const;
     void after_thread_impl(ThreadData* data) const;
-    void finish_work_impl() const;
     const char* name_impl() const;
-
-private:
-    mutable Strings names_; // sorted
 };
 
 }
@@ -13,7 +13,7 @@
 #include "Fragment.hpp"
 #include "Sequence.hpp"
 #include "BlockSet.hpp"
-#include "FragmentCollection.hpp"
+#include "CoverageIndex.hpp"
 #include "throw_assert.hpp"
 
 namespace npge {
@@ -45,31 +45,20 @@ void Rest::run_impl() const {
         return;
     }
     BlockSet& self = *block_set();
-    VectorFc fc;
-    fc.add_bs(*other());
-    fc.prepare();
+    CoverageIndexPtr index = CoverageIndex::of(*other(), workers());
     self.add_sequences(other()->seqs());
     std::set<Sequence*> seqs;
     BOOST_FOREACH (SequencePtr s, other()->seqs()) {
         seqs.insert(s.get());
     }
-    BOOST_FOREACH (Sequence* s, fc.seqs()) {
+    BOOST_FOREACH (Sequence* s, index->seqs()) {
         seqs.insert(s);
     }
     BOOST_FOREACH (Sequence* seq, seqs) {
-        if (!fc.has_seq(seq)) {
-            add_f(self, seq, 0, int(seq->size()) - 1);
-        } else {
-            const Fragments& ff = fc.fragments_of(seq);
-            ASSERT_GT(ff.size(), 0);
-            add_f(self, seq, 0, int(ff[0]->min_pos()) - 1);
-            for (int i = 1; i < ff.size(); i++) {
-                add_f(self, seq,
-                      int(ff[i - 1]->max_pos()) + 1,
-                      int(ff[i]->min_pos()) - 1);
-            }
-            add_f(self, seq, int(ff.back()->max_pos()) + 1,
-                  int(seq->size()) - 1);
+        PosRanges gaps;
+        index->gaps(gaps, seq);
+        BOOST_FOREACH (const PosRange& gap, gaps) {
+            add_f(self, seq, gap.first, gap.second);
         }
     }
 }
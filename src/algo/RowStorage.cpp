@@ -14,9 +14,9 @@
 namespace npge {
 
 static bool check_row_type(std::string& message, Processor* p) {
-    if (p->opt_value("row-type").as<std::string>() != "map" &&
-            p->opt_value("row-type").as<std::string>() != "compact") {
-        message = "row-type must be 'map' or 'compact'";
+    std::string type = p->opt_value("row-type").as<std::string>();
+    if (type != "map" && type != "compact" && type != "gaps") {
+        message = "row-type must be 'map', 'compact' or 'gaps'";
         return false;
     }
     return true;
@@ -24,14 +24,21 @@ static bool check_row_type(std::string& message, Processor* p) {
 
 void add_row_storage_options(Processor* p) {
     p->add_opt("row-type",
-               "way of storing alignments in memory ('map' or 'compact')",
+               "way of storing alignments in memory "
+               "('map', 'compact' or 'gaps')",
                std::string("compact"));
     p->add_opt_check(boost::bind(check_row_type, _1, p));
 }
 
 RowType row_type(const Processor* p) {
-    return (p->opt_value("row-type").as<std::string>() == "map") ?
-           MAP_ROW : COMPACT_ROW;
+    std::string type = p->opt_value("row-type").as<std::string>();
+    if (type == "map") {
+        return MAP_ROW;
+    } else if (type == "gaps") {
+        return GAPS_ROW;
+    } else {
+        return COMPACT_ROW;
+    }
 }
 
 AlignmentRow* create_row(const Processor* p) {
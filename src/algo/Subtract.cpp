@@ -13,7 +13,7 @@
 #include "BlockSet.hpp"
 #include "Block.hpp"
 #include "Fragment.hpp"
-#include "FragmentCollection.hpp"
+#include "CoverageIndex.hpp"
 #include "throw_assert.hpp"
 #include "cast.hpp"
 #include "global.hpp"
@@ -21,7 +21,7 @@
 namespace npge {
 
 struct Subtract::Impl {
-    DirectVectorFc fc_;
+    CoverageIndexPtr index_;
 };
 
 Subtract::Subtract() {
@@ -39,9 +39,7 @@ Subtract::~Subtract() {
 }
 
 void Subtract::change_blocks_impl(std::vector<Block*>& /* blocks */) const {
-    impl_->fc_.clear();
-    impl_->fc_.add_bs(*other());
-    impl_->fc_.prepare();
+    impl_->index_ = CoverageIndex::of(*other(), workers());
 }
 
 typedef std::pair<Block*, Fragment*> BF;
@@ -69,7 +67,7 @@ void Subtract::process_block_impl(Block* block,
     BOOST_FOREACH (Fragment* fragment, block_fragments) {
         if (equal) {
             Fragments oo;
-            impl_->fc_.find_overlap_fragments(oo, fragment);
+            impl_->index_->find_overlap_fragments(oo, fragment);
             bool to_delete = false;
             BOOST_FOREACH (Fragment* o, oo) {
                 if (positions_equal(o, fragment)) {
@@ -80,7 +78,7 @@ void Subtract::process_block_impl(Block* block,
             if (to_delete) {
                 sd->to_erase_.push_back(BF(block, fragment));
             }
-        } else if (impl_->fc_.has_overlap(fragment)) {
+        } else if (impl_->index_->has_overlap(fragment)) {
             sd->to_erase_.push_back(BF(block, fragment));
         }
     }
@@ -7,7 +7,10 @@
 
 #include <algorithm>
 #include <boost/foreach.hpp>
+#include <boost/bind.hpp>
 #include <boost/lexical_cast.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/unordered_set.hpp>
 
 #include "UniqueNames.hpp"
 #include "Block.hpp"
@@ -15,6 +18,7 @@
 #include "BlockSet.hpp"
 #include "rand_name.hpp"
 #include "block_hash.hpp"
+#include "simple_task.hpp"
 #include "cast.hpp"
 
 namespace npge {
@@ -36,26 +40,40 @@ void UniqueNames::process_block_impl(Block* b, ThreadData* td) const {
     }
 }
 
+typedef boost::unordered_map<std::string, Blocks> NameToBlocks;
+
+static void rename_duplicates(Blocks* blocks,
+                              const NameToBlocks* name_to_blocks) {
+    // the greatest block keeps the name
+    std::sort(blocks->begin(), blocks->end(), block_greater);
+    std::string base_name = blocks->front()->name() + "n";
+    int i = 0;
+    for (int j = 1; j < blocks->size(); j++) {
+        std::string name;
+        do {
+            i += 1;
+            name = base_name + TO_S(i);
+        } while (name_to_blocks->find(name) != name_to_blocks->end());
+        (*blocks)[j]->set_name(name);
+    }
+}
+
 void UniqueNames::finish_work_impl() const {
-    std::set<std::string> names;
-    typedef std::map<std::string, int> String2Int;
-    String2Int last_n;
-    Blocks blocks(block_set()->begin(), block_set()->end());
-    std::sort(blocks.begin(), blocks.end(), block_greater);
-    BOOST_FOREACH (Block* b, blocks) {
-        if (names.find(b->name()) != names.end()) {
-            std::string orig_name = b->name();
-            std::string base_name = orig_name + "n";
-            int& i = last_n[orig_name];
-            do {
-                i += 1;
-                b->set_name(base_name + TO_S(i));
-            } while (names.find(b->name()) != names.end());
+    NameToBlocks name_to_blocks;
+    BOOST_FOREACH (Block* b, *block_set()) {
+        name_to_blocks[b->name()].push_back(b);
+    }
+    Tasks tasks;
+    BOOST_FOREACH (NameToBlocks::value_type& name_blocks, name_to_blocks) {
+        if (name_blocks.second.size() >= 2) {
+            tasks.push_back(boost::bind(rename_duplicates,
+                                        &name_blocks.second,
+                                        &name_to_blocks));
         }
-        names.insert(b->name());
     }
+    do_tasks(tasks_to_generator(tasks), workers());
     //
-    names.clear();
+    boost::unordered_set<std::string> names;
     BOOST_FOREACH (const SequencePtr& seq, block_set()->seqs()) {
         while (seq->name().empty() ||
                 names.find(seq->name()) != names.end()) {
@@ -14,7 +14,10 @@ namespace npge {
 
 /** Set unique names to all blocks of this blockset.
 If name is not default and not unique:
- - "n<num>" is appended with num minimum number to make name unique.
+ - the greatest block (see block_greater()) keeps the name;
+ - "n<num>" is appended to names of other blocks, where num is
+   minimum number making the name different from names of all blocks.
+ Blocks with different names are processed in parallel.
 
 If (name is default or "") and not unique:
  - block_name() is used, if name is null.
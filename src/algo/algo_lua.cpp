@@ -480,6 +480,7 @@ static luabind::scope register_processor() {
            .def("fix_opt_value", &processor_fix_opt_value)
            .def("fix_opt_getter", &processor_fix_opt_getter)
            .def("interrupt", &Processor::interrupt)
+           .def("reset_interruption", &Processor::reset_interruption)
            .def("is_interrupted", &Processor::is_interrupted)
            .def("tmp_file", &Processor::tmp_file)
            .def("processor_name", &processor_name)
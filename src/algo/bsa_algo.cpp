@@ -11,6 +11,7 @@
 #include <ostream>
 #include <boost/foreach.hpp>
 #include <boost/scoped_ptr.hpp>
+#include <boost/unordered_map.hpp>
 #include <boost/algorithm/string/split.hpp>
 #include <boost/algorithm/string/classification.hpp>
 #include <boost/algorithm/string/trim.hpp>
@@ -863,7 +864,7 @@ void bsa_input(BlockSet& bs, std::istream& in) {
     BOOST_FOREACH (SequencePtr seq, bs.seqs()) {
         name2seq[seq->name()] = seq.get();
     }
-    std::map<std::string, Fragment*> id2fr;
+    boost::unordered_map<std::string, Fragment*> id2fr;
     BOOST_FOREACH (Block* block, bs) {
         BOOST_FOREACH (Fragment* fr, *block) {
             id2fr[fr->id()] = fr;
@@ -3,35 +3,13 @@
  * See the LICENSE file for terms of use.
  */
 
+#include <vector>
+
 #include "goodColumns.hpp"
+#include "column_kernels.hpp"
 
 namespace npge {
 
-bool isColumnGood(const char** rows, int nrows, int i) {
-    char first = rows[0][i];
-    bool ok = true;
-    for (int irow = 0; irow < nrows; irow++) {
-        char letter = rows[irow][i];
-        ok &= (letter == first);
-    }
-    return ok && first != '-' && first != 'N';
-}
-
-bool isColumnIdentGap(const char** rows, int nrows, int i) {
-    bool gap = false;
-    int A = 0, T = 0, G = 0, C = 0, N = 0;
-    for (int irow = 0; irow < nrows; irow++) {
-        char letter = rows[irow][i];
-        gap |= (letter == '-');
-        A |= (letter == 'A');
-        T |= (letter == 'T');
-        G |= (letter == 'G');
-        C |= (letter == 'C');
-        N |= (letter == 'N');
-    }
-    return gap && (A + T + G + C == 1) && !N;
-}
-
 // produced by the following script:
 //
 // local function log2(x)
@@ -174,8 +152,18 @@ static void mapGap(Scores& scores, int start, int length,
     }
 }
 
-Scores goodColumns(const char** rows, int nrows, int length,
+Scores goodColumns(const char* const* rows, int nrows, int length,
+                   int min_identity, int min_length, char gap) {
+    std::vector<unsigned char> flags(length);
+    if (length > 0) {
+        classify_columns(&flags[0], rows, nrows, length, gap);
+    }
+    return goodColumns(flags, min_identity, min_length);
+}
+
+Scores goodColumns(const std::vector<unsigned char>& flags,
                    int min_identity, int min_length) {
+    int length = flags.size();
     if (min_length == -1) {
         // longest than all possible gaps
         min_length = length;
@@ -185,10 +173,13 @@ Scores goodColumns(const char** rows, int nrows, int length,
         min_identity = MAX_COLUMN_SCORE;
     }
     Scores scores(length);
+    const int IDENT_GAP = IDENT_COLUMN | GAP_COLUMN;
+    const int MASK = IDENT_GAP | PURE_GAP_COLUMN | N_COLUMN;
     int gap_length = 0;
     for (int i = 0; i < length; i++) {
-        bool good = isColumnGood(rows, nrows, i);
-        bool ident_gap = isColumnIdentGap(rows, nrows, i);
+        int f = flags[i];
+        bool good = (f & (IDENT_GAP | N_COLUMN)) == IDENT_COLUMN;
+        bool ident_gap = (f & MASK) == IDENT_GAP;
         if (good) {
             scores[i] = MAX_COLUMN_SCORE;
         }
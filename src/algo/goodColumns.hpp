@@ -16,7 +16,20 @@ const int MAX_COLUMN_SCORE = 100;
 
 typedef std::vector<int> Scores;
 
-Scores goodColumns(const char** rows, int nrows, int length,
+/** Return scores of columns of alignment.
+Column is good if it has one letter (not N) and no gaps.
+Gapped columns having one letter (not N) form gaps, which get
+scores depending on their length.
+*/
+Scores goodColumns(const char* const* rows, int nrows, int length,
+                   int min_identity, int min_length, char gap = '-');
+
+/** Return scores of columns of alignment from flags of columns.
+\param flags Combinations of ColumnFlag per column
+    (see classify_columns()).
+\see goodColumns(const char* const*, int, int, int, int, char)
+*/
+Scores goodColumns(const std::vector<unsigned char>& flags,
                    int min_identity, int min_length);
 
 }
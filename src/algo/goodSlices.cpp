@@ -3,6 +3,7 @@
  * See the LICENSE file for terms of use.
  */
 
+#include <queue>
 #include <boost/foreach.hpp>
 
 #include "goodSlices.hpp"
@@ -20,6 +21,10 @@ private:
     // prefix sums
     std::vector<int> score_sum_;
     std::vector<int> gapless_sum_;
+    // nearest good left end at or after i, or block_length_
+    std::vector<int> next_left_end_;
+    // nearest good right end at or before i, or -1
+    std::vector<int> prev_right_end_;
     int frame_length_;
     int end_length_;
     int frame_score_;
@@ -53,6 +58,19 @@ public:
                 ? MAX_COLUMN_SCORE : std::min(score_[i], 0);
             gapless_sum_[i + 1] = gapless_sum_[i] + value;
         }
+        next_left_end_.resize(block_length_ + 1);
+        next_left_end_[block_length_] = block_length_;
+        for (int i = block_length_ - 1; i >= 0; i--) {
+            bool good = (i + end_length_ <= block_length_) &&
+                        goodLeftEnd(i);
+            next_left_end_[i] = good ? i : next_left_end_[i + 1];
+        }
+        prev_right_end_.resize(block_length_);
+        for (int i = 0; i < block_length_; i++) {
+            bool good = (i - end_length_ + 1 >= 0) && goodRightEnd(i);
+            int prev = (i > 0) ? prev_right_end_[i - 1] : -1;
+            prev_right_end_[i] = good ? i : prev;
+        }
     }
 
     int countScore(int start, int stop) const {
@@ -109,19 +127,21 @@ public:
         return StartStop(start1, stop1);
     }
 
+    // Move ends inwards to nearest good ends,
+    // but keep at least end_length_ + 1 columns
     StartStop strip(const StartStop& self) const {
         if (!valid(self)) {
             return self;
         }
         int start1 = self.first;
         int stop1 = self.second;
-        while (!goodLeftEnd(start1) &&
-                start1 + end_length_ - 1 < stop1) {
-            start1 = start1 + 1;
+        if (start1 + end_length_ - 1 < stop1) {
+            start1 = std::min(next_left_end_[start1],
+                              stop1 - end_length_ + 1);
         }
-        while (!goodRightEnd(stop1) &&
-                start1 + end_length_ - 1 < stop1) {
-            stop1 = stop1 - 1;
+        if (start1 + end_length_ - 1 < stop1) {
+            stop1 = std::max(prev_right_end_[stop1],
+                             start1 + end_length_ - 1);
         }
         return StartStop(start1, stop1);
     }
@@ -148,8 +168,8 @@ public:
             goodFrame(self);
     }
 
-    // Return list of joined slices
-    Coordinates joinedSlices() const {
+    // Return list of joined slices and slices before stripping
+    void joinedSlices(Coordinates& slices, Coordinates& parents) const {
         Coordinates slices0;
         bool prev_good = false;
         int max_i = block_length_ - frame_length_;
@@ -168,42 +188,13 @@ public:
             }
             prev_good = curr_good;
         }
-        Coordinates slices;
         BOOST_FOREACH (const StartStop& slice, slices0) {
             StartStop slice1 = strip(slice);
             if (valid(slice1)) {
                 slices.push_back(slice1);
+                parents.push_back(slice);
             }
         }
-        return slices;
-    }
-
-    StartStop maxSlice(const Coordinates& slices) const {
-        StartStop result = slices.front();
-        BOOST_FOREACH (const StartStop& slice, slices) {
-            if (ssLength(slice) > ssLength(result)) {
-                result = slice;
-            }
-        }
-        return result;
-    }
-
-    // Exclude selected slice from slices, return new slices
-    Coordinates excludeSlice(const Coordinates& slices,
-                             const StartStop& selected) const {
-        Coordinates slices1;
-        BOOST_FOREACH (const StartStop& slice, slices) {
-            if (!overlaps(slice, selected)) {
-                slices1.push_back(slice);
-            } else {
-                StartStop slice1 = exclude(slice, selected);
-                slice1 = strip(slice1);
-                if (valid(slice1) && goodEnds(slice1)) {
-                    slices1.push_back(slice1);
-                }
-            }
-        }
-        return slices1;
     }
 
     bool parametersAreCorrect() const {
@@ -226,20 +217,74 @@ public:
         return true;
     }
 
+    /** Select longest slices greedily.
+    Slices stay in a linked list (in order of parents).
+    Longest slice is taken from a heap (first one of equal),
+    changed slices are pushed again, outdated entries skipped.
+    Parents are ordered by both start and stop, so slices
+    overlapping the selected one are found next to it.
+    */
     Coordinates calculate() const {
         if (!parametersAreCorrect()) {
             return Coordinates();
         }
-        Coordinates slices = joinedSlices();
+        Coordinates slices, parents;
+        joinedSlices(slices, parents);
+        int n = slices.size();
+        std::vector<int> prev(n), next(n);
+        std::vector<bool> alive(n, true);
+        // (length, -index)
+        typedef std::pair<int, int> Entry;
+        std::priority_queue<Entry> heap;
+        for (int i = 0; i < n; i++) {
+            prev[i] = i - 1;
+            next[i] = (i + 1 < n) ? (i + 1) : -1;
+            heap.push(Entry(ssLength(slices[i]), -i));
+        }
         Coordinates result;
-        while (!slices.empty()) {
-            StartStop selected = maxSlice(slices);
-            if (valid(selected) && goodEnds(selected)) {
-                result.push_back(selected);
-                slices = excludeSlice(slices, selected);
-            } else {
+        std::vector<int> neighbours;
+        while (!heap.empty()) {
+            Entry entry = heap.top();
+            heap.pop();
+            int index = -entry.second;
+            if (!alive[index] || ssLength(slices[index]) != entry.first) {
+                continue;
+            }
+            StartStop selected = slices[index];
+            if (!valid(selected) || !goodEnds(selected)) {
                 break;
             }
+            result.push_back(selected);
+            neighbours.clear();
+            for (int i = index; i != -1 &&
+                    parents[i].second >= selected.first; i = prev[i]) {
+                neighbours.push_back(i);
+            }
+            for (int i = next[index]; i != -1 &&
+                    parents[i].first <= selected.second; i = next[i]) {
+                neighbours.push_back(i);
+            }
+            BOOST_FOREACH (int i, neighbours) {
+                if (!overlaps(slices[i], selected)) {
+                    continue;
+                }
+                StartStop slice1 = exclude(slices[i], selected);
+                slice1 = strip(slice1);
+                if (valid(slice1) && goodEnds(slice1)) {
+                    if (ssLength(slice1) != ssLength(slices[i])) {
+                        heap.push(Entry(ssLength(slice1), -i));
+                    }
+                    slices[i] = slice1;
+                } else {
+                    alive[i] = false;
+                    if (prev[i] != -1) {
+                        next[prev[i]] = next[i];
+                    }
+                    if (next[i] != -1) {
+                        prev[next[i]] = prev[i];
+                    }
+                }
+            }
         }
         return result;
     }
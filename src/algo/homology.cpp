@@ -0,0 +1,422 @@
+/*
+ * NPG-explorer, Nucleotide PanGenome explorer
+ * Copyright (C) 2012-2016 Boris Nagaev
+ *
+ * See the LICENSE file for terms of use.
+ */
+
+#include <algorithm>
+#include <boost/bind.hpp>
+#include <boost/foreach.hpp>
+#include <boost/tuple/tuple.hpp>
+#include <boost/tuple/tuple_comparison.hpp>
+
+#include "homology.hpp"
+#include "GeneralAligner.hpp"
+#include "simple_task.hpp"
+#include "Sequence.hpp"
+#include "complement.hpp"
+#include "throw_assert.hpp"
+
+namespace npge {
+
+HomologyOptions::HomologyOptions():
+    seed(16), sampling(4), max_occurrences(100), xdrop(20),
+    batch(100), gap_range(15), gap_penalty(2),
+    mismatch_penalty(1), max_errors(11), min_length(100),
+    workers(1) {
+}
+
+typedef boost::tuple<const Sequence*, pos_t, pos_t,
+        const Sequence*, pos_t, pos_t, int> HitTie;
+
+static HitTie hit_tie(const HomologyHit& h) {
+    return HitTie(h.a, h.a_min, h.a_max, h.b, h.b_min, h.b_max, h.ori);
+}
+
+bool HomologyHit::operator<(const HomologyHit& other) const {
+    return hit_tie(*this) < hit_tie(other);
+}
+
+bool HomologyHit::operator==(const HomologyHit& other) const {
+    return hit_tie(*this) == hit_tie(other);
+}
+
+/** Occurrence of seed in sequence */
+struct SeedPos {
+    hash_t hash;
+    int seq;
+    pos_t pos;
+    bool direct;
+
+    bool operator<(const SeedPos& other) const {
+        typedef boost::tuple<hash_t, int, pos_t> Tie;
+        return Tie(hash, seq, pos) <
+               Tie(other.hash, other.seq, other.pos);
+    }
+};
+
+typedef std::vector<SeedPos> SeedPoss;
+
+/** Pair of equal seeds, a <= b */
+struct SeedPair {
+    int a;
+    int b;
+    int ori;
+    pos_t a_pos;
+    pos_t b_pos;
+
+    bool operator<(const SeedPair& other) const {
+        typedef boost::tuple<int, int, int, pos_t, pos_t> Tie;
+        return Tie(a, b, ori, a_pos, b_pos) <
+               Tie(other.a, other.b, other.ori,
+                   other.a_pos, other.b_pos);
+    }
+
+    bool same_run(const SeedPair& other) const {
+        return a == other.a && b == other.b && ori == other.ori;
+    }
+};
+
+typedef std::vector<SeedPair> SeedPairs;
+
+static bool is_sampled(hash_t hash, int sampling) {
+    // mix bits, since hash of seed is just packed nucleotides
+    hash_t mixed = hash * hash_t(0x9E3779B97F4A7C15ULL);
+    return (mixed >> 32) % sampling == 0;
+}
+
+static void index_seq(SeedPoss* out, Sequence* seq, int seq_index,
+                      const SeqBase* base, int sampling) {
+    SeqI s(seq, const_cast<SeqBase*>(base));
+    s.init_state();
+    while (true) {
+        if (s.ns_ == 0) {
+            hash_t hash = std::min(s.dir_, s.rev_);
+            if (is_sampled(hash, sampling)) {
+                SeedPos sp;
+                sp.hash = hash;
+                sp.seq = seq_index;
+                sp.pos = s.pos_;
+                sp.direct = (s.dir_ <= s.rev_);
+                out->push_back(sp);
+            }
+        }
+        if (s.pos_ + s.anchor_ >= seq->size()) {
+            break;
+        }
+        s.next_hash();
+    }
+}
+
+/** Walks along the sequence in one direction */
+struct Cursor {
+    const Sequence* seq_;
+    pos_t start_;
+    int step_;
+    bool complement_;
+    pos_t size_;
+
+    Cursor():
+        seq_(0), start_(0), step_(1), complement_(false), size_(0) {
+    }
+
+    Cursor(const Sequence* seq, pos_t start, int step, bool comp):
+        seq_(seq), start_(start), step_(step), complement_(comp) {
+        size_ = (step == 1) ? seq->size() - start : start + 1;
+        if (size_ < 0) {
+            size_ = 0;
+        }
+    }
+
+    char at(pos_t i) const {
+        char c = seq_->char_at(start_ + step_ * i);
+        return complement_ ? complement(c) : c;
+    }
+
+    Cursor shifted(pos_t i) const {
+        Cursor result = *this;
+        result.start_ += step_ * i;
+        result.size_ -= i;
+        return result;
+    }
+};
+
+/** Contents for GeneralAligner: window of two cursors */
+struct CursorContents {
+    Cursor a_;
+    Cursor b_;
+    int a_size_;
+    int b_size_;
+    int mismatch_penalty_;
+
+    CursorContents():
+        a_size_(0), b_size_(0), mismatch_penalty_(1) {
+    }
+
+    int first_size() const {
+        return a_size_;
+    }
+
+    int second_size() const {
+        return b_size_;
+    }
+
+    int substitution(int row, int col) const {
+        char a = a_.at(row);
+        char b = b_.at(col);
+        return (a == b && a != 'N') ? 0 : mismatch_penalty_;
+    }
+};
+
+typedef GeneralAligner<CursorContents> CursorAligner;
+
+/** Extend the match from cursors, return lengths of extension.
+Both ungapped and gapped parts are scored +1 per match and
+-2 per mismatch or gap. Extension is cut at the best score.
+*/
+static void extend(pos_t& a_length, pos_t& b_length,
+                   const Cursor& a, const Cursor& b,
+                   const HomologyOptions& opt,
+                   CursorAligner& aligner) {
+    // ungapped X-drop
+    pos_t limit = std::min(a.size_, b.size_);
+    int score = 0, best = 0;
+    pos_t best_i = 0;
+    for (pos_t i = 0; i < limit; i++) {
+        char ca = a.at(i);
+        score += (ca == b.at(i) && ca != 'N') ? 1 : -2;
+        if (score > best) {
+            best = score;
+            best_i = i + 1;
+        } else if (best - score > opt.xdrop) {
+            break;
+        }
+    }
+    a_length = best_i;
+    b_length = best_i;
+    // gapped, window by window, starting from the best point
+    score = best;
+    pos_t a_start = a_length, b_start = b_length;
+    PairAlignment alignment;
+    while (true) {
+        CursorContents contents;
+        contents.a_ = a.shifted(a_start);
+        contents.b_ = b.shifted(b_start);
+        contents.a_size_ = std::min(pos_t(opt.batch),
+                                    contents.a_.size_);
+        contents.b_size_ = std::min(pos_t(opt.batch),
+                                    contents.b_.size_);
+        contents.mismatch_penalty_ = opt.mismatch_penalty;
+        if (contents.a_size_ == 0 || contents.b_size_ == 0) {
+            break;
+        }
+        aligner.set_contents(contents);
+        int a_last, b_last;
+        aligner.align(a_last, b_last);
+        if (a_last == -1 || b_last == -1) {
+            break;
+        }
+        alignment.clear();
+        aligner.export_alignment(a_last, b_last, alignment);
+        bool dropped = false;
+        BOOST_FOREACH (const AlignmentPair& pair, alignment) {
+            int row = pair.first, col = pair.second;
+            bool match = row != -1 && col != -1 &&
+                         contents.substitution(row, col) == 0;
+            score += match ? 1 : -2;
+            if (score > best) {
+                best = score;
+                a_length = a_start + row + 1;
+                b_length = b_start + col + 1;
+            } else if (best - score > opt.xdrop) {
+                dropped = true;
+                break;
+            }
+        }
+        bool consumed = (a_last + 1 == contents.a_size_ ||
+                         b_last + 1 == contents.b_size_);
+        if (dropped || !consumed) {
+            break;
+        }
+        a_start += a_last + 1;
+        b_start += b_last + 1;
+    }
+}
+
+/** Return if the seed lies on the alignment of the hit.
+Seed must overlap the hit in both sequences and be not
+farther than gap range from its diagonal.
+*/
+static bool covers(const HomologyHit& hit, pos_t a_pos, pos_t b_pos,
+                   int seed, int gap_range) {
+    pos_t a_last = a_pos + seed - 1, b_last = b_pos + seed - 1;
+    if (a_last < hit.a_min || a_pos > hit.a_max ||
+            b_last < hit.b_min || b_pos > hit.b_max) {
+        return false;
+    }
+    pos_t diag, diag1, diag2;
+    if (hit.ori == 1) {
+        diag = b_pos - a_pos;
+        diag1 = hit.b_min - hit.a_min;
+        diag2 = hit.b_max - hit.a_max;
+    } else {
+        diag = b_last + a_pos;
+        diag1 = hit.b_max + hit.a_min;
+        diag2 = hit.b_min + hit.a_max;
+    }
+    return diag >= std::min(diag1, diag2) - gap_range &&
+           diag <= std::max(diag1, diag2) + gap_range;
+}
+
+static bool ends_before(pos_t a_pos, const HomologyHit& hit) {
+    return hit.a_max < a_pos;
+}
+
+static void extend_run(HomologyHits* out,
+                       SeedPairs::const_iterator begin,
+                       SeedPairs::const_iterator end,
+                       const Sequences* seqs,
+                       const HomologyOptions* options) {
+    const HomologyOptions& opt = *options;
+    CursorAligner aligner;
+    aligner.set_gap_range(opt.gap_range);
+    aligner.set_gap_penalty(opt.gap_penalty);
+    aligner.set_max_errors(opt.max_errors);
+    HomologyHits active;
+    for (SeedPairs::const_iterator it = begin; it != end; ++it) {
+        const SeedPair& sp = *it;
+        active.erase(std::remove_if(active.begin(), active.end(),
+                                    boost::bind(ends_before,
+                                                sp.a_pos, _1)),
+                     active.end());
+        bool covered = false;
+        BOOST_FOREACH (const HomologyHit& hit, active) {
+            if (covers(hit, sp.a_pos, sp.b_pos, opt.seed,
+                       opt.gap_range)) {
+                covered = true;
+                break;
+            }
+        }
+        if (covered) {
+            continue;
+        }
+        const Sequence* a = (*seqs)[sp.a];
+        const Sequence* b = (*seqs)[sp.b];
+        pos_t a0 = sp.a_pos, b0 = sp.b_pos, k = opt.seed;
+        pos_t right_a, right_b, left_a, left_b;
+        HomologyHit hit;
+        hit.a = (*seqs)[sp.a];
+        hit.b = (*seqs)[sp.b];
+        hit.ori = sp.ori;
+        if (sp.ori == 1) {
+            extend(right_a, right_b,
+                   Cursor(a, a0 + k, 1, false),
+                   Cursor(b, b0 + k, 1, false), opt, aligner);
+            extend(left_a, left_b,
+                   Cursor(a, a0 - 1, -1, false),
+                   Cursor(b, b0 - 1, -1, false), opt, aligner);
+            hit.b_min = b0 - left_b;
+            hit.b_max = b0 + k - 1 + right_b;
+        } else {
+            extend(right_a, right_b,
+                   Cursor(a, a0 + k, 1, false),
+                   Cursor(b, b0 - 1, -1, true), opt, aligner);
+            extend(left_a, left_b,
+                   Cursor(a, a0 - 1, -1, false),
+                   Cursor(b, b0 + k, 1, true), opt, aligner);
+            hit.b_min = b0 - right_b;
+            hit.b_max = b0 + k - 1 + left_b;
+        }
+        hit.a_min = a0 - left_a;
+        hit.a_max = a0 + k - 1 + right_a;
+        active.push_back(hit);
+        if (std::max(hit.a_max - hit.a_min,
+                     hit.b_max - hit.b_min) + 1 >= opt.min_length) {
+            out->push_back(hit);
+        }
+    }
+    std::sort(out->begin(), out->end());
+    out->erase(std::unique(out->begin(), out->end()), out->end());
+}
+
+struct CmpSeqName {
+    bool operator()(const Sequence* a, const Sequence* b) const {
+        return a->name() < b->name();
+    }
+};
+
+void find_homology(HomologyHits& hits, const SeqBase& base,
+                   const HomologyOptions& opt) {
+    ASSERT_EQ(opt.seed, base.anchor_);
+    ASSERT_LTE(opt.seed, MAX_ANCHOR_SIZE);
+    ASSERT_GTE(opt.sampling, 1);
+    // numbers of sequences must not depend on order of blockset
+    Sequences seqs(base.seqs_);
+    std::sort(seqs.begin(), seqs.end(), CmpSeqName());
+    int workers = std::max(opt.workers, 1);
+    // index of seeds
+    std::vector<SeedPoss> seq_seeds(seqs.size());
+    Tasks tasks;
+    for (int i = 0; i < seqs.size(); i++) {
+        tasks.push_back(boost::bind(index_seq, &seq_seeds[i],
+                                    seqs[i], i, &base, opt.sampling));
+    }
+    do_tasks(tasks_to_generator(tasks), workers);
+    SeedPoss index;
+    BOOST_FOREACH (SeedPoss& s, seq_seeds) {
+        index.insert(index.end(), s.begin(), s.end());
+        SeedPoss().swap(s);
+    }
+    std::sort(index.begin(), index.end());
+    // pairs of equal seeds
+    SeedPairs pairs;
+    for (int begin = 0; begin < index.size();) {
+        int end = begin + 1;
+        while (end < index.size() &&
+                index[end].hash == index[begin].hash) {
+            end += 1;
+        }
+        if (end - begin <= opt.max_occurrences) {
+            for (int i = begin; i < end; i++) {
+                for (int j = i + 1; j < end; j++) {
+                    SeedPair sp;
+                    sp.a = index[i].seq;
+                    sp.b = index[j].seq;
+                    sp.a_pos = index[i].pos;
+                    sp.b_pos = index[j].pos;
+                    sp.ori = (index[i].direct == index[j].direct) ?
+                             1 : -1;
+                    pairs.push_back(sp);
+                }
+            }
+        }
+        begin = end;
+    }
+    SeedPoss().swap(index);
+    std::sort(pairs.begin(), pairs.end());
+    // extend seeds, one task per pair of sequences and ori
+    std::vector<HomologyHits> run_hits;
+    std::vector<int> run_starts;
+    for (int i = 0; i < pairs.size(); i++) {
+        if (i == 0 || !pairs[i].same_run(pairs[i - 1])) {
+            run_starts.push_back(i);
+        }
+    }
+    run_starts.push_back(pairs.size());
+    run_hits.resize(run_starts.size() - 1);
+    tasks.clear();
+    for (int r = 0; r + 1 < run_starts.size(); r++) {
+        SeedPairs::const_iterator begin = pairs.begin() + run_starts[r];
+        SeedPairs::const_iterator end = pairs.begin() + run_starts[r + 1];
+        tasks.push_back(boost::bind(extend_run, &run_hits[r],
+                                    begin, end, &seqs, &opt));
+    }
+    do_tasks(tasks_to_generator(tasks), workers);
+    BOOST_FOREACH (const HomologyHits& h, run_hits) {
+        hits.insert(hits.end(), h.begin(), h.end());
+    }
+}
+
+}
+
@@ -0,0 +1,90 @@
+/*
+ * NPG-explorer, Nucleotide PanGenome explorer
+ * Copyright (C) 2012-2016 Boris Nagaev
+ *
+ * See the LICENSE file for terms of use.
+ */
+
+#ifndef NPGE_HOMOLOGY_HPP_
+#define NPGE_HOMOLOGY_HPP_
+
+#include <vector>
+
+#include "global.hpp"
+#include "SeqI.hpp"
+
+namespace npge {
+
+/** Parameters of seed-and-extend homology search */
+struct HomologyOptions {
+    /** Length of seed (exact match), <= MAX_ANCHOR_SIZE */
+    int seed;
+
+    /** Only seeds, hash of which is divisible by sampling,
+    are indexed. Equal seeds are sampled equally,
+    so all copies of a seed are either indexed or skipped.
+    */
+    int sampling;
+
+    /** Seeds with more occurrences are skipped (repeats) */
+    int max_occurrences;
+
+    /** Ungapped extension stops when score drops by xdrop */
+    int xdrop;
+
+    /** Length of window of gapped extension */
+    int batch;
+
+    /** Max distance from main diagonal in gapped extension */
+    int gap_range;
+
+    /** Gap penalty of gapped extension */
+    int gap_penalty;
+
+    /** Mismatch penalty of gapped extension */
+    int mismatch_penalty;
+
+    /** Max number of errors in window of gapped extension */
+    int max_errors;
+
+    /** Min length of hit */
+    int min_length;
+
+    /** Number of threads */
+    int workers;
+
+    /** Constructor */
+    HomologyOptions();
+};
+
+/** Pair of homologous regions found by find_homology() */
+struct HomologyHit {
+    Sequence* a;
+    pos_t a_min;
+    pos_t a_max;
+    Sequence* b;
+    pos_t b_min;
+    pos_t b_max;
+    int ori; /**< Ori of b if a is direct */
+
+    bool operator<(const HomologyHit& other) const;
+
+    bool operator==(const HomologyHit& other) const;
+};
+
+typedef std::vector<HomologyHit> HomologyHits;
+
+/** Find pairs of homologous regions in sequences.
+Sequences of base are indexed by seeds of length base.anchor_.
+Pairs of equal seeds are extended by ungapped X-drop extension,
+and then by banded gapped extension (GeneralAligner).
+Hits are ordered by names of sequences, ori and positions.
+They do not depend on number of workers.
+*/
+void find_homology(HomologyHits& hits, const SeqBase& base,
+                   const HomologyOptions& options);
+
+}
+
+#endif
+
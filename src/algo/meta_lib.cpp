@@ -13,6 +13,7 @@
 #include "AddGenes.hpp"
 #include "SliceNless.hpp"
 #include "BlastFinder.hpp"
+#include "HomologyFinder.hpp"
 #include "BlastRunner.hpp"
 #include "ImportBlastHits.hpp"
 #include "AddBlastBlocks.hpp"
@@ -105,6 +106,7 @@ void add_meta_lib(Meta* meta) {
     meta->set_processor<AddGenes>();
     meta->set_processor<SliceNless>();
     meta->set_processor<BlastFinder>();
+    meta->set_processor<HomologyFinder>();
     meta->set_processor<BlastRunner>();
     meta->set_processor<ImportBlastHits>();
     meta->set_processor<AddBlastBlocks>();
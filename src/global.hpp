@@ -15,6 +15,8 @@
 #include <boost/shared_ptr.hpp>
 #include <boost/make_shared.hpp>
 
+#include "config.hpp"
+
 namespace boost {
 namespace program_options {
 
@@ -56,6 +58,7 @@ class AlignmentRow;
 class MapAlignmentRow;
 class CompactAlignmentRow;
 class BlockSetFastaReader;
+class CoverageIndex;
 
 // algo
 class BloomFilter;
@@ -79,6 +82,9 @@ typedef boost::shared_ptr<Sequence> SequencePtr;
 /** Shared pointer to BlockSet */
 typedef boost::shared_ptr<BlockSet> BlockSetPtr;
 
+/** Shared pointer to constant CoverageIndex */
+typedef boost::shared_ptr<const CoverageIndex> CoverageIndexPtr;
+
 /** Shared pointer to PairAligner */
 typedef boost::shared_ptr<PairAligner> PairAlignerPtr;
 
@@ -100,7 +106,8 @@ enum SequenceType {
 /** Type of AlignmentRow */
 enum RowType {
     MAP_ROW, /**< MapAlignmentRow */
-    COMPACT_ROW /**< CompactAlignmentRow */
+    COMPACT_ROW, /**< CompactAlignmentRow */
+    GAPS_ROW /**< GapsAlignmentRow */
 };
 
 /** Creat new BlockSet and return shared pointer to it */
@@ -112,9 +119,17 @@ typedef std::vector<std::string> Strings;
 
 typedef uint64_t hash_t;
 
+#ifdef NPGE_POS64
+/** Position in sequence or alignment */
+typedef int64_t pos_t;
+
+const pos_t MAX_POS = static_cast<pos_t>(~uint64_t(0) >> 1);
+#else
+/** Position in sequence or alignment */
 typedef int pos_t;
 
 const pos_t MAX_POS = INT_MAX;
+#endif
 
 /** Pair from alignment */
 typedef std::pair<int, int> AlignmentPair;
@@ -0,0 +1,98 @@
+/*
+ * NPG-explorer, Nucleotide PanGenome explorer
+ * Copyright (C) 2012-2016 Boris Nagaev
+ *
+ * See the LICENSE file for terms of use.
+ */
+
+#include <algorithm>
+
+#include "AlignmentCursor.hpp"
+#include "AlignmentRow.hpp"
+#include "Fragment.hpp"
+#include "throw_assert.hpp"
+
+namespace npge {
+
+// first window is small, because cursors are often stopped early
+const int MIN_WINDOW = 32;
+const int MAX_WINDOW = 4096;
+
+AlignmentCursor::AlignmentCursor(const Fragment* fragment, int ori,
+                                 pos_t column):
+    fragment_(fragment), row_(fragment->row()) {
+    length_ = row_ ? row_->length() : fragment->length();
+    init(ori, column);
+}
+
+AlignmentCursor::AlignmentCursor(const AlignmentRow* row, int ori,
+                                 pos_t column):
+    fragment_(0), row_(row) {
+    length_ = row->length();
+    init(ori, column);
+}
+
+void AlignmentCursor::init(int ori, pos_t column) {
+    ASSERT_TRUE(ori == 1 || ori == -1);
+    ori_ = ori;
+    if (column == -1) {
+        column = (ori == 1) ? 0 : length_ - 1;
+    }
+    column_ = column;
+    window_ = MIN_WINDOW;
+    load();
+}
+
+void AlignmentCursor::load() {
+    positions_.clear();
+    letters_.clear();
+    index_ = 0;
+    if (!valid()) {
+        return;
+    }
+    pos_t start, stop;
+    if (ori_ == 1) {
+        start = column_;
+        stop = std::min(column_ + window_ - 1, length_ - 1);
+    } else {
+        start = std::max(column_ - window_ + 1, pos_t(0));
+        stop = column_;
+    }
+    window_ = std::min(window_ * 2, MAX_WINDOW);
+    int n = stop - start + 1;
+    positions_.resize(n);
+    if (row_) {
+        row_->map_range(&positions_[0], start, stop);
+    } else {
+        for (int i = 0; i < n; i++) {
+            positions_[i] = start + i;
+        }
+    }
+    letters_.assign(n, '\0');
+    index_ = column_ - start;
+    if (!fragment_) {
+        return;
+    }
+    pos_t length = fragment_->length();
+    pos_t min_pos = length, max_pos = -1;
+    for (int i = 0; i < n; i++) {
+        pos_t pos = positions_[i];
+        if (pos >= 0 && pos < length) {
+            min_pos = std::min(min_pos, pos);
+            max_pos = std::max(max_pos, pos);
+        }
+    }
+    if (min_pos > max_pos) {
+        return;
+    }
+    std::string text = fragment_->substr(min_pos, max_pos);
+    for (int i = 0; i < n; i++) {
+        pos_t pos = positions_[i];
+        if (pos >= 0 && pos < length) {
+            letters_[i] = text[pos - min_pos];
+        }
+    }
+}
+
+}
+
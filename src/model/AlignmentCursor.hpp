@@ -0,0 +1,92 @@
+/*
+ * NPG-explorer, Nucleotide PanGenome explorer
+ * Copyright (C) 2012-2016 Boris Nagaev
+ *
+ * See the LICENSE file for terms of use.
+ */
+
+#ifndef NPGE_ALIGNMENT_CURSOR_HPP_
+#define NPGE_ALIGNMENT_CURSOR_HPP_
+
+#include <string>
+#include <vector>
+
+#include "global.hpp"
+
+namespace npge {
+
+/** Sequential reader of columns of alignment row.
+
+Cursor visits columns one by one forward (ori = 1) or
+backward (ori = -1) and yields column, position in fragment
+and letter. Columns are mapped with AlignmentRow::map_range()
+and letters are read with one Fragment::substr() per window
+of columns, so each step costs amortized O(1).
+
+Fragment and row must not be changed while cursor is used.
+*/
+class AlignmentCursor {
+public:
+    /** Constructor.
+    \param fragment Fragment (with or without alignment row)
+    \param ori Direction (1 or -1)
+    \param column First column to visit (-1 means first column
+        in the direction)
+    */
+    AlignmentCursor(const Fragment* fragment, int ori = 1,
+                    pos_t column = -1);
+
+    /** Constructor.
+    Letters are not available, letter() returns 0.
+    */
+    AlignmentCursor(const AlignmentRow* row, int ori = 1,
+                    pos_t column = -1);
+
+    /** Return if current column is inside of the row */
+    bool valid() const {
+        return column_ >= 0 && column_ < length_;
+    }
+
+    /** Go to next column in the direction */
+    void next() {
+        column_ += ori_;
+        index_ += ori_;
+        if (index_ < 0 || index_ >= int(positions_.size())) {
+            load();
+        }
+    }
+
+    /** Return current column */
+    pos_t column() const {
+        return column_;
+    }
+
+    /** Return position in fragment of current column or -1 (gap) */
+    pos_t fragment_pos() const {
+        return positions_[index_];
+    }
+
+    /** Return letter of current column, 0 means gap */
+    char letter() const {
+        return letters_[index_];
+    }
+
+private:
+    const Fragment* fragment_;
+    const AlignmentRow* row_;
+    int ori_;
+    pos_t length_;
+    pos_t column_;
+    int index_;
+    int window_;
+    std::vector<pos_t> positions_;
+    std::string letters_;
+
+    void init(int ori, pos_t column);
+    void load();
+};
+
+}
+
+#endif
+
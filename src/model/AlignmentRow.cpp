@@ -6,7 +6,9 @@
  */
 
 #include <cctype>
+#include <cstdlib>
 #include <algorithm>
+#include <boost/foreach.hpp>
 #include <boost/lexical_cast.hpp>
 
 #include "AlignmentRow.hpp"
@@ -35,15 +37,29 @@ void AlignmentRow::clear() {
     clear_impl();
 }
 
-int AlignmentRow::map_to_alignment(int fragment_pos) const {
+pos_t AlignmentRow::map_to_alignment(pos_t fragment_pos) const {
     return map_to_alignment_impl(fragment_pos);
 }
 
-int AlignmentRow::map_to_fragment(int align_pos) const {
+pos_t AlignmentRow::map_to_fragment(pos_t align_pos) const {
     return map_to_fragment_impl(align_pos);
 }
 
-void AlignmentRow::bind(int fragment_pos, int align_pos) {
+void AlignmentRow::map_range(pos_t* fragment_pos,
+                             pos_t start, pos_t stop) const {
+    if (start <= stop) {
+        map_range_impl(fragment_pos, start, stop);
+    }
+}
+
+void AlignmentRow::map_range_impl(pos_t* fragment_pos,
+                                  pos_t start, pos_t stop) const {
+    for (pos_t align_pos = start; align_pos <= stop; align_pos++) {
+        fragment_pos[align_pos - start] = map_to_fragment(align_pos);
+    }
+}
+
+void AlignmentRow::bind(pos_t fragment_pos, pos_t align_pos) {
     bind_impl(fragment_pos, align_pos);
 }
 
@@ -53,9 +69,9 @@ void AlignmentRow::grow(const std::string& alignment_string) {
 
 void AlignmentRow::grow_impl(
     const std::string& alignment_string) {
-    int align_pos = length();
-    int fragment_pos = nearest_in_fragment(align_pos) + 1; // -1 -> 0
-    for (int i = 0; i < alignment_string.size(); i++) {
+    pos_t align_pos = length();
+    pos_t fragment_pos = nearest_in_fragment(align_pos) + 1; // -1 -> 0
+    for (size_t i = 0; i < alignment_string.size(); i++) {
         if (isalpha(alignment_string[i])) {
             ASSERT_MSG(!fragment() || fragment()->length() == 1 ||
                        fragment_pos < fragment()->length(),
@@ -94,16 +110,16 @@ void AlignmentRow::grow_impl(
     set_length(length() + alignment_string.length());
 }
 
-int AlignmentRow::nearest_in_fragment(int align_pos) const {
+pos_t AlignmentRow::nearest_in_fragment(pos_t align_pos) const {
     return nearest_in_fragment_impl(align_pos);
 }
 
-int AlignmentRow::nearest_in_fragment_impl(
-    int align_pos) const {
+pos_t AlignmentRow::nearest_in_fragment_impl(
+    pos_t align_pos) const {
     // FIXME do smth with this
-    for (int distance = 0; distance <= length(); distance++) {
+    for (pos_t distance = 0; distance <= length(); distance++) {
         for (int ori = -1; ori <= 1; ori += 2) {
-            int new_align_pos = align_pos + ori * distance;
+            pos_t new_align_pos = align_pos + ori * distance;
             if (map_to_fragment(new_align_pos) != -1) {
                 return map_to_fragment(new_align_pos);
             }
@@ -113,17 +129,16 @@ int AlignmentRow::nearest_in_fragment_impl(
 }
 
 void AlignmentRow::assign(const AlignmentRow& other,
-                          int start, int stop) {
+                          pos_t start, pos_t stop) {
     assign_impl(other, start, stop);
 }
 
 void AlignmentRow::assign_impl(const AlignmentRow& other,
-                               int start, int stop) {
+                               pos_t start, pos_t stop) {
     clear();
-    int length = (stop == -1) ? (other.length() - start) : (stop - start + 1);
-    int align_pos = start;
-    for (int align_pos = start; align_pos < start + length; align_pos++) {
-        int fragment_pos = other.map_to_fragment(align_pos);
+    pos_t length = (stop == -1) ? (other.length() - start) : (stop - start + 1);
+    for (pos_t align_pos = start; align_pos < start + length; align_pos++) {
+        pos_t fragment_pos = other.map_to_fragment(align_pos);
         if (fragment_pos != -1) {
             bind(fragment_pos, align_pos);
         }
@@ -134,6 +149,8 @@ void AlignmentRow::assign_impl(const AlignmentRow& other,
 AlignmentRow* AlignmentRow::new_row(RowType type) {
     if (type == COMPACT_ROW) {
         return new CompactAlignmentRow;
+    } else if (type == GAPS_ROW) {
+        return new GapsAlignmentRow;
     } else {
         // default = MAP_ROW
         return new MapAlignmentRow;
@@ -150,18 +167,22 @@ AlignmentRow* AlignmentRow::clone() const {
     return result;
 }
 
-AlignmentRow* AlignmentRow::slice(int start, int stop) const {
+AlignmentRow* AlignmentRow::slice(pos_t start, pos_t stop) const {
     ASSERT_LT(stop, length());
     ASSERT_LT(start, length());
-    int min = std::min(start, stop);
-    int max = std::max(start, stop);
+    return slice_impl(start, stop);
+}
+
+AlignmentRow* AlignmentRow::slice_impl(pos_t start, pos_t stop) const {
+    pos_t min = std::min(start, stop);
+    pos_t max = std::max(start, stop);
     int ori = (min == start) ? 1 : -1;
     AlignmentRow* new_row = AlignmentRow::new_row(type());
-    int l = max - min + 1;
+    pos_t l = max - min + 1;
     new_row->set_length(l);
-    int fragment_pos = 0;
-    for (int new_row_pos = 0; new_row_pos < l; new_row_pos++) {
-        int old_row_pos = start + new_row_pos * ori;
+    pos_t fragment_pos = 0;
+    for (pos_t new_row_pos = 0; new_row_pos < l; new_row_pos++) {
+        pos_t old_row_pos = start + new_row_pos * ori;
         if (map_to_fragment(old_row_pos) != -1) {
             new_row->bind(fragment_pos, new_row_pos);
             fragment_pos += 1;
@@ -172,68 +193,141 @@ AlignmentRow* AlignmentRow::slice(int start, int stop) const {
 
 MapAlignmentRow::MapAlignmentRow(const std::string& alignment_string,
                                  Fragment* fragment):
-    AlignmentRow(fragment) {
+    AlignmentRow(fragment), storage_(new Storage) {
     grow(alignment_string);
 }
 
+MapAlignmentRow::Storage& MapAlignmentRow::mutable_storage() {
+    if (!storage_.unique()) {
+        storage_.reset(new Storage(*storage_));
+    }
+    return *storage_;
+}
+
 void MapAlignmentRow::clear_impl() {
-    fragment_to_alignment_.clear();
-    alignment_to_fragment_.clear();
+    if (storage_.unique()) {
+        storage_->fragment_to_alignment_.clear();
+        storage_->alignment_to_fragment_.clear();
+    } else {
+        storage_.reset(new Storage);
+    }
     set_length(0);
 }
 
-void MapAlignmentRow::bind_impl(int fragment_pos,
-                                int align_pos) {
-    fragment_to_alignment_[fragment_pos] = align_pos;
-    alignment_to_fragment_[align_pos] = fragment_pos;
+void MapAlignmentRow::bind_impl(pos_t fragment_pos,
+                                pos_t align_pos) {
+    Storage& storage = mutable_storage();
+    storage.fragment_to_alignment_[fragment_pos] = align_pos;
+    storage.alignment_to_fragment_[align_pos] = fragment_pos;
+}
+
+void MapAlignmentRow::assign_impl(const AlignmentRow& other,
+                                  pos_t start, pos_t stop) {
+    const MapAlignmentRow* o = dynamic_cast<const MapAlignmentRow*>(&other);
+    if (o && start == 0 && (stop == -1 || stop == other.length() - 1)) {
+        storage_ = o->storage_;
+        set_length(other.length());
+    } else {
+        AlignmentRow::assign_impl(other, start, stop);
+    }
 }
 
-int MapAlignmentRow::map_to_alignment_impl(
-    int fragment_pos) const {
+pos_t MapAlignmentRow::map_to_alignment_impl(
+    pos_t fragment_pos) const {
     if (fragment_pos >= length() || fragment_pos < 0) {
         return -1;
     }
     if (fragment() && fragment_pos >= fragment()->length()) {
         return -1;
     }
-    Pos2Pos::const_iterator it2 = fragment_to_alignment_.find(fragment_pos);
-    if (it2 == fragment_to_alignment_.end()) {
+    const Pos2Pos& f2a = storage_->fragment_to_alignment_;
+    Pos2Pos::const_iterator it2 = f2a.find(fragment_pos);
+    if (it2 == f2a.end()) {
         return -1;
     } else {
         return it2->second;
     }
 }
 
-int MapAlignmentRow::map_to_fragment_impl(
-    int align_pos) const {
+pos_t MapAlignmentRow::map_to_fragment_impl(
+    pos_t align_pos) const {
     if (align_pos >= length() || align_pos < 0) {
         return -1;
     }
-    Pos2Pos::const_iterator it2 = alignment_to_fragment_.find(align_pos);
-    if (it2 == alignment_to_fragment_.end()) {
+    const Pos2Pos& a2f = storage_->alignment_to_fragment_;
+    Pos2Pos::const_iterator it2 = a2f.find(align_pos);
+    if (it2 == a2f.end()) {
         return -1;
     } else {
         return it2->second;
     }
 }
 
+void MapAlignmentRow::map_range_impl(pos_t* fragment_pos,
+                                     pos_t start, pos_t stop) const {
+    std::fill(fragment_pos, fragment_pos + (stop - start + 1), -1);
+    pos_t first = std::max(start, pos_t(0));
+    pos_t last = std::min(stop, length() - 1);
+    const Pos2Pos& a2f = storage_->alignment_to_fragment_;
+    Pos2Pos::const_iterator it = a2f.lower_bound(first);
+    for (; it != a2f.end() && it->first <= last; ++it) {
+        fragment_pos[it->first - start] = it->second;
+    }
+}
+
 RowType MapAlignmentRow::type_impl() const {
     return MAP_ROW;
 }
 
 CompactAlignmentRow::CompactAlignmentRow(const std::string& alignment_string,
         Fragment* fragment):
-    AlignmentRow(fragment) {
+    AlignmentRow(fragment), storage_(new Storage) {
     grow(alignment_string);
 }
 
+// Chunk::pos_in_fragment is relative to base of superblock
+static pos_t default_superblock_chunks = 1 << 20;
+
+CompactAlignmentRow::Storage::Storage():
+    superblock_chunks_(default_superblock_chunks) {
+}
+
+void CompactAlignmentRow::set_superblock_chunks(pos_t superblock_chunks) {
+    ASSERT_GT(superblock_chunks, 0);
+    default_superblock_chunks = superblock_chunks;
+}
+
+CompactAlignmentRow::Storage& CompactAlignmentRow::mutable_storage() {
+    if (!storage_.unique()) {
+        storage_.reset(new Storage(*storage_));
+    }
+    return *storage_;
+}
+
 void CompactAlignmentRow::clear_impl() {
-    data_.clear();
+    if (storage_.unique()) {
+        storage_->data_.clear();
+        storage_->bases_.clear();
+    } else {
+        storage_.reset(new Storage);
+    }
     set_length(0);
 }
 
-void CompactAlignmentRow::bind_impl(int /* fragment_pos */,
-                                    int align_pos) {
+void CompactAlignmentRow::assign_impl(const AlignmentRow& other,
+                                      pos_t start, pos_t stop) {
+    const CompactAlignmentRow* o =
+        dynamic_cast<const CompactAlignmentRow*>(&other);
+    if (o && start == 0 && (stop == -1 || stop == other.length() - 1)) {
+        storage_ = o->storage_;
+        set_length(other.length());
+    } else {
+        AlignmentRow::assign_impl(other, start, stop);
+    }
+}
+
+void CompactAlignmentRow::bind_impl(pos_t /* fragment_pos */,
+                                    pos_t align_pos) {
     Chunk& c = chunk(chunk_index(align_pos));
     int internal_pos = pos_in_chunk(align_pos);
     c.set(internal_pos);
@@ -241,45 +335,88 @@ void CompactAlignmentRow::bind_impl(int /* fragment_pos */,
 
 static struct ChunkCompare {
     typedef CompactAlignmentRow::Chunk Chunk;
-    bool operator()(const Chunk& c1, int pos) const {
+    bool operator()(const Chunk& c1, pos_t pos) const {
         return c1.pos_in_fragment > pos;
     }
 } cc;
 
-int CompactAlignmentRow::map_to_alignment_impl(
-    int fragment_pos) const {
+pos_t CompactAlignmentRow::map_to_alignment_impl(
+    pos_t fragment_pos) const {
     if (fragment_pos >= length() || fragment_pos < 0) {
         return -1;
     }
     if (fragment() && fragment_pos >= fragment()->length()) {
         return -1;
     }
-    Data::const_reverse_iterator it = std::lower_bound(data_.rbegin(),
-                                      data_.rend(), fragment_pos, cc);
-    if (it == data_.rend()) {
+    const Data& data = storage_->data_;
+    const Bases& bases = storage_->bases_;
+    // last superblock starting not after fragment_pos
+    Bases::const_iterator base = std::upper_bound(bases.begin(),
+                                 bases.end(), fragment_pos);
+    if (base == bases.begin()) {
+        return -1;
+    }
+    base--;
+    pos_t superblock = base - bases.begin();
+    pos_t chunks = storage_->superblock_chunks_;
+    Data::const_iterator first = data.begin() + superblock * chunks;
+    Data::const_iterator last = (data.end() - first > chunks) ?
+                                first + chunks : data.end();
+    typedef Data::const_reverse_iterator RIt;
+    RIt rend(first);
+    pos_t relative_pos = fragment_pos - *base;
+    RIt it = std::lower_bound(RIt(last), rend, relative_pos, cc);
+    if (it == rend) {
         return -1;
     } else {
         const Chunk& c = *it;
-        int internal_pos = fragment_pos - c.pos_in_fragment;
+        pos_t internal_pos = relative_pos - c.pos_in_fragment;
         ASSERT_LTE(0, internal_pos);
         ASSERT_LT(internal_pos, BITS_IN_CHUNK);
         return to_align_pos(&c) + c.map_to_alignment(internal_pos);
     }
 }
 
-int CompactAlignmentRow::map_to_fragment_impl(
-    int align_pos) const {
+pos_t CompactAlignmentRow::map_to_fragment_impl(
+    pos_t align_pos) const {
     if (align_pos >= length() || align_pos < 0) {
         return -1;
     }
-    int index = chunk_index(align_pos);
-    if (index >= data_.size()) {
+    pos_t index = chunk_index(align_pos);
+    const Data& data = storage_->data_;
+    if (index >= data.size()) {
         return -1;
     }
     int internal_pos = pos_in_chunk(align_pos);
-    const Chunk& chunk = data_[chunk_index(align_pos)];
+    const Chunk& chunk = data[index];
     int shift = chunk.map_to_fragment(internal_pos);
-    return shift == -1 ? -1 : chunk.pos_in_fragment + shift;
+    return shift == -1 ? -1 : chunk_start(index) + shift;
+}
+
+void CompactAlignmentRow::map_range_impl(pos_t* fragment_pos,
+        pos_t start, pos_t stop) const {
+    std::fill(fragment_pos, fragment_pos + (stop - start + 1), -1);
+    pos_t first = std::max(start, pos_t(0));
+    pos_t last = std::min(stop, length() - 1);
+    const Data& data = storage_->data_;
+    if (first > last || chunk_index(first) >= data.size()) {
+        return;
+    }
+    pos_t last_index = std::min(chunk_index(last),
+                                pos_t(data.size()) - 1);
+    for (pos_t index = chunk_index(first); index <= last_index; index++) {
+        const Chunk& chunk = data[index];
+        pos_t pos = chunk_start(index);
+        pos_t align_pos = index * BITS_IN_CHUNK;
+        for (int i = 0; i < BITS_IN_CHUNK; i++) {
+            if (chunk.get(i)) {
+                if (align_pos + i >= first && align_pos + i <= last) {
+                    fragment_pos[align_pos + i - start] = pos;
+                }
+                pos += 1;
+            }
+        }
+    }
 }
 
 RowType CompactAlignmentRow::type_impl() const {
@@ -337,30 +474,307 @@ void CompactAlignmentRow::Chunk::set(int align_pos) {
     bitset |= (0x01 << align_pos);
 }
 
-int CompactAlignmentRow::chunk_index(int align_pos) {
+pos_t CompactAlignmentRow::chunk_index(pos_t align_pos) {
     return align_pos / BITS_IN_CHUNK;
 }
 
-int CompactAlignmentRow::pos_in_chunk(int align_pos) {
+int CompactAlignmentRow::pos_in_chunk(pos_t align_pos) {
     return align_pos % BITS_IN_CHUNK;
 }
 
-CompactAlignmentRow::Chunk& CompactAlignmentRow::chunk(int index) {
-    if (index >= data_.size()) {
-        Chunk c;
-        if (!data_.empty()) {
-            const Chunk&  back = data_.back();
-            c.pos_in_fragment = back.pos_in_fragment + back.size();
+CompactAlignmentRow::Chunk& CompactAlignmentRow::chunk(pos_t index) {
+    Storage& storage = mutable_storage();
+    Data& data = storage.data_;
+    Bases& bases = storage.bases_;
+    if (index >= data.size()) {
+        pos_t start = 0;
+        if (!data.empty()) {
+            start = chunk_start(data.size() - 1) + data.back().size();
+        }
+        pos_t old_size = data.size();
+        data.resize(index + 1);
+        for (pos_t i = old_size; i <= index; i++) {
+            if (i % storage.superblock_chunks_ == 0) {
+                bases.push_back(start);
+            }
+            data[i].pos_in_fragment = start - bases.back();
+        }
+    }
+    return data[index];
+}
+
+pos_t CompactAlignmentRow::chunk_start(pos_t index) const {
+    return storage_->bases_[index / storage_->superblock_chunks_] +
+           storage_->data_[index].pos_in_fragment;
+}
+
+pos_t CompactAlignmentRow::to_align_pos(const Chunk* chunk) const {
+    return (chunk - &storage_->data_[0]) * BITS_IN_CHUNK;
+}
+
+GapsAlignmentRow::Storage::Storage():
+    end_(0) {
+}
+
+GapsAlignmentRow::GapsAlignmentRow(const std::string& alignment_string,
+                                   Fragment* fragment):
+    AlignmentRow(fragment), storage_(new Storage) {
+    grow(alignment_string);
+}
+
+GapsAlignmentRow::Storage& GapsAlignmentRow::mutable_storage() {
+    if (!storage_.unique()) {
+        storage_.reset(new Storage(*storage_));
+    }
+    return *storage_;
+}
+
+void GapsAlignmentRow::clear_impl() {
+    if (storage_.unique()) {
+        storage_->gaps_.clear();
+        storage_->end_ = 0;
+    } else {
+        storage_.reset(new Storage);
+    }
+    set_length(0);
+}
+
+void GapsAlignmentRow::add_gap(Storage& storage, pos_t start,
+                               pos_t length) {
+    ASSERT_GTE(start, storage.end_);
+    Gaps& gaps = storage.gaps_;
+    if (!gaps.empty() && gaps.back().stop() == start) {
+        gaps.back().length += length;
+    } else {
+        Gap gap;
+        gap.start = start;
+        gap.length = length;
+        gap.gaps_before = 0;
+        if (!gaps.empty()) {
+            gap.gaps_before = gaps.back().gaps_before + gaps.back().length;
+        }
+        gaps.push_back(gap);
+    }
+}
+
+void GapsAlignmentRow::grow_impl(const std::string& alignment_string) {
+    Storage& storage = mutable_storage();
+    pos_t align_pos = length();
+    for (size_t i = 0; i < alignment_string.size(); i++) {
+        if (isalpha(alignment_string[i])) {
+            pos_t col = align_pos + i;
+            if (col > storage.end_) {
+                add_gap(storage, storage.end_, col - storage.end_);
+            }
+            storage.end_ = col + 1;
+        }
+    }
+    set_length(length() + alignment_string.length());
+    ASSERT_MSG(!fragment() || fragment()->length() == 1 ||
+               map_to_fragment(storage.end_ - 1) <
+               fragment()->length(),
+               ("Fragment: " + fragment()->id() + "\n" +
+                "Alignment string: " + alignment_string + "\n" +
+                "Alignment row has more letters than fragment").c_str());
+}
+
+void GapsAlignmentRow::bind_impl(pos_t /* fragment_pos */,
+                                 pos_t align_pos) {
+    Storage& storage = mutable_storage();
+    ASSERT_GTE(align_pos, storage.end_);
+    if (align_pos > storage.end_) {
+        add_gap(storage, storage.end_, align_pos - storage.end_);
+    }
+    storage.end_ = align_pos + 1;
+}
+
+int GapsAlignmentRow::gap_before(pos_t align_pos) const {
+    const Gaps& gaps = storage_->gaps_;
+    int first = 0, last = gaps.size(); // result is in [first - 1, last)
+    while (first < last) {
+        int middle = (first + last) / 2;
+        if (gaps[middle].start <= align_pos) {
+            first = middle + 1;
+        } else {
+            last = middle;
+        }
+    }
+    return first - 1;
+}
+
+pos_t GapsAlignmentRow::map_to_alignment_impl(pos_t fragment_pos) const {
+    if (fragment_pos >= length() || fragment_pos < 0) {
+        return -1;
+    }
+    if (fragment() && fragment_pos >= fragment()->length()) {
+        return -1;
+    }
+    const Gaps& gaps = storage_->gaps_;
+    // last gap with letters_before <= fragment_pos
+    int first = 0, last = gaps.size();
+    while (first < last) {
+        int middle = (first + last) / 2;
+        if (gaps[middle].letters_before() <= fragment_pos) {
+            first = middle + 1;
+        } else {
+            last = middle;
         }
-        data_.resize(index + 1, c);
     }
-    return data_[index];
+    pos_t align_pos = fragment_pos;
+    if (first > 0) {
+        const Gap& gap = gaps[first - 1];
+        align_pos += gap.gaps_before + gap.length;
+    }
+    return (align_pos < storage_->end_) ? align_pos : -1;
 }
 
-int CompactAlignmentRow::to_align_pos(const Chunk* chunk) const {
-    return (reinterpret_cast<const char*>(chunk) -
-            reinterpret_cast<const char*>(&data_[0]))
-           / sizeof(Chunk) * BITS_IN_CHUNK;
+pos_t GapsAlignmentRow::map_to_fragment_impl(pos_t align_pos) const {
+    if (align_pos >= length() || align_pos < 0 ||
+            align_pos >= storage_->end_) {
+        return -1;
+    }
+    int index = gap_before(align_pos);
+    if (index == -1) {
+        return align_pos;
+    }
+    const Gap& gap = storage_->gaps_[index];
+    if (align_pos < gap.stop()) {
+        return -1;
+    }
+    return align_pos - gap.gaps_before - gap.length;
+}
+
+void GapsAlignmentRow::map_range_impl(pos_t* fragment_pos,
+                                      pos_t start, pos_t stop) const {
+    std::fill(fragment_pos, fragment_pos + (stop - start + 1), -1);
+    pos_t first = std::max(start, pos_t(0));
+    pos_t last = std::min(stop, std::min(length(), storage_->end_) - 1);
+    if (first > last) {
+        return;
+    }
+    const Gaps& gaps = storage_->gaps_;
+    int index = gap_before(first);
+    pos_t gaps_length = 0;
+    pos_t col = first;
+    if (index != -1) {
+        const Gap& gap = gaps[index];
+        gaps_length = gap.gaps_before + gap.length;
+        col = std::max(col, gap.stop());
+    }
+    index += 1;
+    while (col <= last) {
+        pos_t next_gap = (index < gaps.size()) ? gaps[index].start : last + 1;
+        for (; col < next_gap && col <= last; col++) {
+            fragment_pos[col - start] = col - gaps_length;
+        }
+        if (index < gaps.size()) {
+            gaps_length += gaps[index].length;
+            col = gaps[index].stop();
+            index += 1;
+        }
+    }
+}
+
+pos_t GapsAlignmentRow::nearest_in_fragment_impl(pos_t align_pos) const {
+    pos_t fragment_pos = map_to_fragment(align_pos);
+    if (fragment_pos != -1) {
+        return fragment_pos;
+    }
+    pos_t end = std::min(length(), storage_->end_);
+    if (end <= 0) {
+        return -1;
+    }
+    // nearest letters to the left and to the right
+    pos_t left = -1, right = -1;
+    if (align_pos >= end) {
+        left = end - 1;
+    } else if (align_pos < 0) {
+        const Gaps& gaps = storage_->gaps_;
+        right = (!gaps.empty() && gaps[0].start == 0) ? gaps[0].stop() : 0;
+    } else {
+        const Gap& gap = storage_->gaps_[gap_before(align_pos)];
+        left = gap.start - 1;
+        right = gap.stop() < end ? gap.stop() : -1;
+    }
+    pos_t nearest = left;
+    if (left == -1 || (right != -1 &&
+                       right - align_pos < align_pos - left)) {
+        nearest = right;
+    }
+    // same limit of distance as in AlignmentRow::nearest_in_fragment_impl
+    if (nearest == -1 || std::abs(nearest - align_pos) > length()) {
+        return -1;
+    }
+    return map_to_fragment(nearest);
+}
+
+RowType GapsAlignmentRow::type_impl() const {
+    return GAPS_ROW;
+}
+
+void GapsAlignmentRow::assign_impl(const AlignmentRow& other,
+                                   pos_t start, pos_t stop) {
+    const GapsAlignmentRow* o =
+        dynamic_cast<const GapsAlignmentRow*>(&other);
+    if (o && start == 0 && (stop == -1 || stop == other.length() - 1)) {
+        storage_ = o->storage_;
+        set_length(other.length());
+    } else {
+        AlignmentRow::assign_impl(other, start, stop);
+    }
+}
+
+AlignmentRow* GapsAlignmentRow::slice_impl(pos_t start, pos_t stop) const {
+    pos_t min = std::min(start, stop);
+    pos_t max = std::max(start, stop);
+    int ori = (min == start) ? 1 : -1;
+    pos_t l = max - min + 1;
+    // gaps of [min, max] in coordinates of new row, in order of ori
+    Gaps parts;
+    const Gaps& gaps = storage_->gaps_;
+    pos_t end = std::min(length(), storage_->end_);
+    int n = gaps.size();
+    // gap n is the tail after last letter
+    for (int i = std::max(gap_before(min), 0); i <= n; i++) {
+        Gap part;
+        part.start = (i < n) ? gaps[i].start : end;
+        pos_t part_stop = (i < n) ? gaps[i].stop() : length();
+        if (part.start > max) {
+            break;
+        }
+        part.start = std::max(part.start, min);
+        part_stop = std::min(part_stop, max + 1);
+        if (part.start >= part_stop) {
+            continue;
+        }
+        part.length = part_stop - part.start;
+        if (ori == 1) {
+            part.start -= min;
+        } else {
+            part.start = max + 1 - part_stop;
+        }
+        parts.push_back(part);
+    }
+    if (ori == -1) {
+        std::reverse(parts.begin(), parts.end());
+    }
+    GapsAlignmentRow* new_row = new GapsAlignmentRow;
+    Storage& storage = new_row->mutable_storage();
+    BOOST_FOREACH (const Gap& part, parts) {
+        if (part.stop() == l) {
+            // trailing gap
+            storage.end_ = part.start;
+            break;
+        }
+        add_gap(storage, part.start, part.length);
+        // gap is followed by letter
+        storage.end_ = part.stop() + 1;
+    }
+    if (parts.empty() || parts.back().stop() != l) {
+        storage.end_ = l;
+    }
+    new_row->set_length(l);
+    return new_row;
 }
 
 InversedRow::InversedRow(AlignmentRow* source):
@@ -377,12 +791,12 @@ void InversedRow::clear_impl() {
     throw "Tried to clear InversedRow";
 }
 
-void InversedRow::bind_impl(int fragment_pos, int align_pos) {
+void InversedRow::bind_impl(pos_t fragment_pos, pos_t align_pos) {
     throw "Tried to bind InversedRow";
 }
 
-int InversedRow::map_to_alignment_impl(
-    int fragment_pos) const {
+pos_t InversedRow::map_to_alignment_impl(
+    pos_t fragment_pos) const {
     if (fragment_pos >= length() || fragment_pos < 0) {
         return -1;
     }
@@ -392,7 +806,7 @@ int InversedRow::map_to_alignment_impl(
     ASSERT_GTE(fragment_pos, 0);
     ASSERT_LT(fragment_pos, fragment_length_);
     fragment_pos = fragment_length_ - fragment_pos - 1;
-    int align_pos = source()->map_to_alignment(fragment_pos);
+    pos_t align_pos = source()->map_to_alignment(fragment_pos);
     if (align_pos == -1) {
         return -1;
     } else {
@@ -403,14 +817,14 @@ int InversedRow::map_to_alignment_impl(
     }
 }
 
-int InversedRow::map_to_fragment_impl(int align_pos) const {
+pos_t InversedRow::map_to_fragment_impl(pos_t align_pos) const {
     if (align_pos >= length() || align_pos < 0) {
         return -1;
     }
     ASSERT_GTE(align_pos, 0);
     ASSERT_LT(align_pos, length());
     align_pos = length() - align_pos - 1;
-    int fragment_pos = source()->map_to_fragment(align_pos);
+    pos_t fragment_pos = source()->map_to_fragment(align_pos);
     if (fragment_pos == -1) {
         return -1;
     } else {
@@ -421,6 +835,20 @@ int InversedRow::map_to_fragment_impl(int align_pos) const {
     }
 }
 
+void InversedRow::map_range_impl(pos_t* fragment_pos,
+                                 pos_t start, pos_t stop) const {
+    // columns start..stop are source columns L-1-stop..L-1-start
+    pos_t n = stop - start + 1;
+    source()->map_range(fragment_pos, length() - 1 - stop,
+                        length() - 1 - start);
+    std::reverse(fragment_pos, fragment_pos + n);
+    for (pos_t i = 0; i < n; i++) {
+        if (fragment_pos[i] != -1) {
+            fragment_pos[i] = fragment_length_ - fragment_pos[i] - 1;
+        }
+    }
+}
+
 AlignmentRow* InversedRow::source() const {
     return source_;
 }
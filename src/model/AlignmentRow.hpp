@@ -12,13 +12,20 @@
 #include <vector>
 #include <string>
 #include <boost/utility.hpp>
+#include <boost/shared_ptr.hpp>
 
 #include "global.hpp"
+#include "config.hpp"
+#include "pool_alloc.hpp"
 
 namespace npge {
 
 class AlignmentRow : boost::noncopyable {
 public:
+#ifdef NPGE_POOL_ALLOC
+    NPGE_POOL_OPERATORS
+#endif
+
     AlignmentRow(Fragment* fragment = 0);
 
     virtual ~AlignmentRow();
@@ -30,20 +37,27 @@ public:
     */
     void grow(const std::string& alignment_string);
 
-    void bind(int fragment_pos, int align_pos);
+    void bind(pos_t fragment_pos, pos_t align_pos);
 
     /** Return position in alignment, corresponding to position in fragment.
     In case of non-existing position in fragment return -1.
     */
-    int map_to_alignment(int fragment_pos) const;
+    pos_t map_to_alignment(pos_t fragment_pos) const;
 
-    int map_to_fragment(int align_pos) const;
+    pos_t map_to_fragment(pos_t align_pos) const;
+
+    /** Write positions in fragment of columns start..stop to array.
+    fragment_pos[col - start] is set to map_to_fragment(col).
+    This is faster than map_to_fragment() for each column.
+    \see AlignmentCursor
+    */
+    void map_range(pos_t* fragment_pos, pos_t start, pos_t stop) const;
 
-    int length() const {
+    pos_t length() const {
         return length_;
     }
 
-    void set_length(int length) {
+    void set_length(pos_t length) {
         length_ = length;
     }
 
@@ -51,16 +65,20 @@ public:
         return fragment_;
     }
 
-    int nearest_in_fragment(int align_pos) const;
+    pos_t nearest_in_fragment(pos_t align_pos) const;
 
     void assign(const AlignmentRow& other,
-                int start = 0, int stop = -1);
+                pos_t start = 0, pos_t stop = -1);
 
     static AlignmentRow* new_row(RowType type);
 
+    /** Return copy of the row.
+    Map and compact rows share their data with the copy
+    until one of them is changed (copy-on-write).
+    */
     AlignmentRow* clone() const;
 
-    AlignmentRow* slice(int min, int max) const;
+    AlignmentRow* slice(pos_t min, pos_t max) const;
 
     RowType type() const;
 
@@ -70,21 +88,26 @@ protected:
     virtual void grow_impl(
         const std::string& alignment_string);
 
-    virtual void bind_impl(int fragment_pos,
-                           int align_pos) = 0;
+    virtual void bind_impl(pos_t fragment_pos,
+                           pos_t align_pos) = 0;
+
+    virtual pos_t map_to_alignment_impl(
+        pos_t fragment_pos) const = 0;
 
-    virtual int map_to_alignment_impl(
-        int fragment_pos) const = 0;
+    virtual pos_t map_to_fragment_impl(pos_t align_pos) const = 0;
 
-    virtual int map_to_fragment_impl(int align_pos) const = 0;
+    virtual void map_range_impl(pos_t* fragment_pos,
+                                pos_t start, pos_t stop) const;
 
-    virtual int nearest_in_fragment_impl(int align_pos) const;
+    virtual pos_t nearest_in_fragment_impl(pos_t align_pos) const;
 
     virtual void assign_impl(const AlignmentRow& other,
-                             int start = 0, int stop = -1);
+                             pos_t start = 0, pos_t stop = -1);
+
+    virtual AlignmentRow* slice_impl(pos_t start, pos_t stop) const;
 
 private:
-    int length_;
+    pos_t length_;
     Fragment* fragment_;
 
     void set_fragment(Fragment* fragment) {
@@ -102,19 +125,31 @@ public:
 protected:
     void clear_impl();
 
-    void bind_impl(int fragment_pos, int align_pos);
+    void bind_impl(pos_t fragment_pos, pos_t align_pos);
 
-    int map_to_alignment_impl(int fragment_pos) const;
+    pos_t map_to_alignment_impl(pos_t fragment_pos) const;
 
-    int map_to_fragment_impl(int align_pos) const;
+    pos_t map_to_fragment_impl(pos_t align_pos) const;
+
+    void map_range_impl(pos_t* fragment_pos, pos_t start, pos_t stop) const;
 
     RowType type_impl() const;
 
+    void assign_impl(const AlignmentRow& other,
+                     pos_t start = 0, pos_t stop = -1);
+
 private:
-    typedef std::map<int, int> Pos2Pos;
+    typedef std::map<pos_t, pos_t> Pos2Pos;
+
+    struct Storage {
+        Pos2Pos fragment_to_alignment_;
+        Pos2Pos alignment_to_fragment_;
+    };
+
+    /** Shared between copies of the row, see clone() */
+    boost::shared_ptr<Storage> storage_;
 
-    Pos2Pos fragment_to_alignment_;
-    Pos2Pos alignment_to_fragment_;
+    Storage& mutable_storage();
 };
 
 typedef unsigned int CAR_Bitset;
@@ -125,22 +160,33 @@ public:
     CompactAlignmentRow(const std::string& alignment_string = "",
                         Fragment* fragment = 0);
 
+    /** Set number of chunks in superblock of rows created later.
+    Default is 2^20. Tests use small values to get many superblocks.
+    */
+    static void set_superblock_chunks(pos_t superblock_chunks);
+
 protected:
     void clear_impl();
 
     // TODO Currently works only forward
-    void bind_impl(int fragment_pos, int align_pos);
+    void bind_impl(pos_t fragment_pos, pos_t align_pos);
+
+    pos_t map_to_alignment_impl(pos_t fragment_pos) const;
 
-    int map_to_alignment_impl(int fragment_pos) const;
+    pos_t map_to_fragment_impl(pos_t align_pos) const;
 
-    int map_to_fragment_impl(int align_pos) const;
+    void map_range_impl(pos_t* fragment_pos, pos_t start, pos_t stop) const;
 
     RowType type_impl() const;
 
+    void assign_impl(const AlignmentRow& other,
+                     pos_t start = 0, pos_t stop = -1);
+
 private:
     typedef CAR_Bitset Bitset;
     typedef unsigned int Index;
     struct Chunk {
+        /** Position in fragment relative to base of superblock */
         Index pos_in_fragment;
         Bitset bitset;
 
@@ -154,17 +200,107 @@ private:
         void set(int align_pos); // TODO value = true|false
     };
     typedef std::vector<Chunk> Data;
+    typedef std::vector<pos_t> Bases;
+
+    struct Storage {
+        Data data_;
 
-    Data data_;
+        /** Position in fragment of first chunk of each superblock.
+        Superblock is a run of superblock_chunks_ chunks, so
+        Chunk::pos_in_fragment fits 32 bits even if pos_t is 64-bit.
+        */
+        Bases bases_;
+
+        pos_t superblock_chunks_;
+
+        Storage();
+    };
 
-    static int chunk_index(int align_pos);
-    static int pos_in_chunk(int align_pos);
-    Chunk& chunk(int index);
-    int to_align_pos(const Chunk* chunk) const;
+    /** Shared between copies of the row, see clone() */
+    boost::shared_ptr<Storage> storage_;
+
+    Storage& mutable_storage();
+
+    static pos_t chunk_index(pos_t align_pos);
+    static int pos_in_chunk(pos_t align_pos);
+    Chunk& chunk(pos_t index);
+    pos_t chunk_start(pos_t index) const;
+    pos_t to_align_pos(const Chunk* chunk) const;
 
     friend struct ChunkCompare;
 };
 
+/** Alignment row storing runs of gaps.
+Memory is proportional to number of gap runs, which is small
+for most alignments. Positions are mapped in O(log(runs)).
+*/
+class GapsAlignmentRow : public AlignmentRow {
+public:
+    GapsAlignmentRow(const std::string& alignment_string = "",
+                     Fragment* fragment = 0);
+
+protected:
+    void clear_impl();
+
+    void grow_impl(const std::string& alignment_string);
+
+    /** Works only forward */
+    void bind_impl(pos_t fragment_pos, pos_t align_pos);
+
+    pos_t map_to_alignment_impl(pos_t fragment_pos) const;
+
+    pos_t map_to_fragment_impl(pos_t align_pos) const;
+
+    void map_range_impl(pos_t* fragment_pos, pos_t start, pos_t stop) const;
+
+    pos_t nearest_in_fragment_impl(pos_t align_pos) const;
+
+    RowType type_impl() const;
+
+    void assign_impl(const AlignmentRow& other,
+                     pos_t start = 0, pos_t stop = -1);
+
+    AlignmentRow* slice_impl(pos_t start, pos_t stop) const;
+
+private:
+    struct Gap {
+        pos_t start;
+        pos_t length;
+        /** Sum of lengths of previous gaps */
+        pos_t gaps_before;
+
+        pos_t stop() const {
+            return start + length;
+        }
+
+        /** Number of letters before the gap */
+        pos_t letters_before() const {
+            return start - gaps_before;
+        }
+    };
+    typedef std::vector<Gap> Gaps;
+
+    struct Storage {
+        Gaps gaps_;
+
+        /** Column after last letter, following columns are gaps */
+        pos_t end_;
+
+        Storage();
+    };
+
+    /** Shared between copies of the row, see clone() */
+    boost::shared_ptr<Storage> storage_;
+
+    Storage& mutable_storage();
+
+    /** Return index of last gap starting not after column or -1 */
+    int gap_before(pos_t align_pos) const;
+
+    /** Add gap after all gaps and letters */
+    static void add_gap(Storage& storage, pos_t start, pos_t length);
+};
+
 /** Proxy class for inversed row.
 Read-only.
 */
@@ -196,17 +332,19 @@ protected:
     void clear_impl();
 
     /** throws */
-    void bind_impl(int fragment_pos, int align_pos);
+    void bind_impl(pos_t fragment_pos, pos_t align_pos);
+
+    pos_t map_to_alignment_impl(pos_t fragment_pos) const;
 
-    int map_to_alignment_impl(int fragment_pos) const;
+    pos_t map_to_fragment_impl(pos_t align_pos) const;
 
-    int map_to_fragment_impl(int align_pos) const;
+    void map_range_impl(pos_t* fragment_pos, pos_t start, pos_t stop) const;
 
     RowType type_impl() const;
 
 private:
     AlignmentRow* source_;
-    int fragment_length_;
+    pos_t fragment_length_;
 };
 
 }
@@ -15,8 +15,10 @@
 
 #include "Block.hpp"
 #include "Fragment.hpp"
+#include "BlockSet.hpp"
 #include "AlignmentRow.hpp"
 #include "block_stat.hpp"
+#include "BlockMatrix.hpp"
 #include "block_hash.hpp"
 #include "rand_name.hpp"
 #include "char_to_size.hpp"
@@ -30,16 +32,21 @@ const int BLOCK_RAND_NAME_SIZE = 8;
 
 Block::Block():
     name_(BLOCK_RAND_NAME_SIZE, '0'),
-    weak_(false) {
+    weak_(false),
+    block_set_(0),
+    more_sets_(0) {
 }
 
 Block::Block(const std::string& name):
-    weak_(false) {
-    set_name(name);
+    name_(name),
+    weak_(false),
+    block_set_(0),
+    more_sets_(0) {
 }
 
 Block::~Block() {
     clear();
+    delete more_sets_;
 }
 
 void Block::insert(Fragment* fragment) {
@@ -47,6 +54,7 @@ void Block::insert(Fragment* fragment) {
     if (!weak() || !fragment->block_raw_ptr()) {
         fragment->set_block(this);
     }
+    notify_changed();
 }
 
 void Block::erase(Fragment* fragment) {
@@ -57,6 +65,7 @@ void Block::erase(Fragment* fragment) {
         fragment->set_block(0);
         delete fragment;
     }
+    notify_changed();
 }
 
 void Block::detach(Fragment* fragment) {
@@ -86,11 +95,16 @@ void Block::clear() {
         }
     }
     fragments_.clear();
+    notify_changed();
 }
 
 void Block::swap(Block& other) {
     fragments_.swap(other.fragments_);
+    notify_changed();
+    other.notify_changed();
     name_.swap(other.name_);
+    notify_renamed(other.name_);
+    other.notify_renamed(name_);
     std::swap(weak_, other.weak_);
     if (!this->weak()) {
         BOOST_FOREACH (Fragment* f, *this) {
@@ -165,7 +179,7 @@ char Block::consensus_char(pos_t pos, char gap) const {
     return gap;
 }
 
-void Block::consensus(std::ostream& o, char gap) const {
+void Block::consensus(std::ostream& o, char /* gap */) const {
     if (!empty() && !front()->row()) {
         Fragment* longest = front();
         BOOST_FOREACH (Fragment* f, *this) {
@@ -178,8 +192,13 @@ void Block::consensus(std::ostream& o, char gap) const {
         longest->print_contents(o, /* gap */ '-', /* line */ 0);
     } else {
         pos_t length = alignment_length();
-        for (pos_t pos = 0; pos < length; pos++) {
-            o << consensus_char(pos, gap);
+        BlockMatrix matrix;
+        std::string cons;
+        for (pos_t w = 0; w < length; w += BLOCK_MATRIX_WINDOW) {
+            pos_t w_stop = std::min(length, w + BLOCK_MATRIX_WINDOW) - 1;
+            matrix.build(this, w, w_stop);
+            matrix.count_columns(&cons, 0);
+            o << cons;
         }
     }
 }
@@ -343,6 +362,7 @@ void Block::merge(Block* other) {
         }
     }
     other->fragments_.clear();
+    other->notify_changed();
     BOOST_FOREACH (F2F::value_type& f_and_ptr, f2f) {
         Fragment* f = f_and_ptr.second;
         insert(f);
@@ -350,24 +370,82 @@ void Block::merge(Block* other) {
 }
 
 void Block::set_name(const std::string& name) {
-    name_ = name;
+    if (block_set_) {
+        std::string old_name = name_;
+        name_ = name;
+        notify_renamed(old_name);
+    } else {
+        name_ = name;
+    }
 }
 
 void Block::set_random_name() {
     set_name(rand_name(BLOCK_RAND_NAME_SIZE));
 }
 
+void Block::add_block_set(BlockSet* block_set) {
+    if (!block_set_) {
+        block_set_ = block_set;
+    } else {
+        if (!more_sets_) {
+            more_sets_ = new std::vector<BlockSet*>;
+        }
+        more_sets_->push_back(block_set);
+    }
+}
+
+void Block::remove_block_set(BlockSet* block_set) {
+    if (more_sets_) {
+        std::vector<BlockSet*>& sets = *more_sets_;
+        if (block_set_ == block_set) {
+            block_set_ = sets.back();
+            sets.pop_back();
+        } else {
+            sets.erase(std::find(sets.begin(), sets.end(), block_set));
+        }
+        if (sets.empty()) {
+            delete more_sets_;
+            more_sets_ = 0;
+        }
+    } else if (block_set_ == block_set) {
+        block_set_ = 0;
+    }
+}
+
+void Block::notify_renamed(const std::string& old_name) {
+    if (block_set_) {
+        block_set_->block_renamed(this, old_name);
+    }
+    if (more_sets_) {
+        BOOST_FOREACH (BlockSet* block_set, *more_sets_) {
+            block_set->block_renamed(this, old_name);
+        }
+    }
+}
+
+void Block::notify_changed() {
+    if (block_set_) {
+        block_set_->reset_coverage_index();
+    }
+    if (more_sets_) {
+        BOOST_FOREACH (BlockSet* block_set, *more_sets_) {
+            block_set->reset_coverage_index();
+        }
+    }
+}
+
 void Block::set_name_from_fragments() {
     const char* const NAME_ABC = "0123456789abcdef";
     const int NAME_ABC_SIZE = 16;
     hash_t a = block_hash(this);
-    name_.resize(8);
+    std::string name(8, ' ');
     for (int byte_index = 0; byte_index < 4; byte_index++) {
         int byte = 0xFF & (a >> (8 * (3 - byte_index)));
-        name_[byte_index * 2] = NAME_ABC[byte >> 4];
-        name_[byte_index * 2 + 1] = NAME_ABC[byte & 0x0F];
+        name[byte_index * 2] = NAME_ABC[byte >> 4];
+        name[byte_index * 2 + 1] = NAME_ABC[byte & 0x0F];
     }
-    name_[0] = 'b';
+    name[0] = 'b';
+    set_name(name);
 }
 
 void Block::set_weak(bool weak) {
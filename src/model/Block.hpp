@@ -16,6 +16,8 @@
 
 #include "global.hpp"
 #include "Decimal.hpp"
+#include "config.hpp"
+#include "pool_alloc.hpp"
 
 namespace npge {
 
@@ -33,6 +35,10 @@ Make sure fragments being deleted are not accessed from weak blocks.
 */
 class Block : boost::noncopyable {
 public:
+#ifdef NPGE_POOL_ALLOC
+    NPGE_POOL_OPERATORS
+#endif
+
     /** Type of implementation container.
     Do not rely on ths type!
     To traverse all fragments, use BOOST_FOREACH (Fragment* f, block).
@@ -207,6 +213,19 @@ private:
     Impl fragments_;
     std::string name_;
     bool weak_;
+
+    // blocksets containing the block, notified of renaming
+    // and of changes of fragments;
+    // the first one is stored inline, others in more_sets_
+    BlockSet* block_set_;
+    std::vector<BlockSet*>* more_sets_;
+
+    void add_block_set(BlockSet* block_set);
+    void remove_block_set(BlockSet* block_set);
+    void notify_renamed(const std::string& old_name);
+    void notify_changed();
+
+    friend class BlockSet;
 };
 
 /** Streaming operator */
@@ -0,0 +1,87 @@
+/*
+ * NPG-explorer, Nucleotide PanGenome explorer
+ * Copyright (C) 2012-2016 Boris Nagaev
+ *
+ * See the LICENSE file for terms of use.
+ */
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "BlockMatrix.hpp"
+#include "Block.hpp"
+#include "Fragment.hpp"
+#include "AlignmentCursor.hpp"
+#include "column_kernels.hpp"
+
+namespace npge {
+
+BlockMatrix::BlockMatrix():
+    columns_(0) {
+}
+
+BlockMatrix::BlockMatrix(const Block* block, pos_t start, pos_t stop):
+    columns_(0) {
+    build(block, start, stop);
+}
+
+void BlockMatrix::build(const Block* block, pos_t start, pos_t stop) {
+    if (stop == -1) {
+        stop = block->alignment_length() - 1;
+    }
+    fragments_.assign(block->begin(), block->end());
+    columns_ = std::max(stop - start + 1, pos_t(0));
+    data_.assign(columns_ * rows(), 0);
+    row_begins_.resize(rows());
+    for (int row = 0; row < rows(); row++) {
+        row_begins_[row] = data_.empty() ? 0 : &data_[row * columns_];
+        if (columns_) {
+            decode_fragment(&data_[row * columns_], fragments_[row],
+                            start, stop);
+        }
+    }
+}
+
+void BlockMatrix::classify_columns(std::vector<unsigned char>& flags) const {
+    flags.resize(columns_);
+    if (columns_) {
+        npge::classify_columns(&flags[0], row_begins(), rows(),
+                               columns_, 0);
+    }
+}
+
+void BlockMatrix::count_columns(std::string* consensus, int* atgc) const {
+    if (consensus) {
+        consensus->resize(columns_);
+    }
+    if (columns_) {
+        char* cons = consensus ? &(*consensus)[0] : 0;
+        npge::count_columns(cons, atgc, row_begins(), rows(),
+                            columns_, 0);
+    }
+}
+
+void BlockMatrix::classify_block(const Block* block,
+                                 std::vector<unsigned char>& flags) {
+    pos_t length = block->alignment_length();
+    flags.resize(length);
+    BlockMatrix matrix;
+    for (pos_t w = 0; w < length; w += BLOCK_MATRIX_WINDOW) {
+        pos_t w_stop = std::min(length, w + BLOCK_MATRIX_WINDOW) - 1;
+        matrix.build(block, w, w_stop);
+        npge::classify_columns(&flags[w], matrix.row_begins(),
+                               matrix.rows(), matrix.columns(), 0);
+    }
+}
+
+void BlockMatrix::decode_fragment(char* cells, const Fragment* fragment,
+                                  pos_t start, pos_t stop) {
+    AlignmentCursor cursor(fragment, 1, std::max(start, pos_t(0)));
+    for (; cursor.valid() && cursor.column() <= stop; cursor.next()) {
+        cells[cursor.column() - start] = cursor.letter();
+    }
+}
+
+}
+
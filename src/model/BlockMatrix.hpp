@@ -0,0 +1,124 @@
+/*
+ * NPG-explorer, Nucleotide PanGenome explorer
+ * Copyright (C) 2012-2016 Boris Nagaev
+ *
+ * See the LICENSE file for terms of use.
+ */
+
+#ifndef NPGE_BLOCK_MATRIX_HPP_
+#define NPGE_BLOCK_MATRIX_HPP_
+
+#include <string>
+#include <vector>
+
+#include "global.hpp"
+
+namespace npge {
+
+/** Number of columns decoded at once when whole block is scanned.
+Memory of the matrix is bounded by rows x BLOCK_MATRIX_WINDOW.
+*/
+const pos_t BLOCK_MATRIX_WINDOW = 64 * 1024;
+
+/** Alignment of block decoded into array rows x columns.
+
+Cell (row, col) is equal to fragments()[row]->alignment_at(col),
+gaps and positions outside of fragment are 0.
+Cells of a row are stored contiguously, so that column kernels
+(see column_kernels.hpp) process many columns at once.
+
+Each fragment is decoded with AlignmentCursor, so column scans
+do not call virtual methods per cell.
+
+The matrix is a copy and is not updated if the block changes.
+*/
+class BlockMatrix {
+public:
+    /** Constructor of empty matrix */
+    BlockMatrix();
+
+    /** Constructor.
+    \see build()
+    */
+    BlockMatrix(const Block* block, pos_t start = 0, pos_t stop = -1);
+
+    /** Decode columns of block.
+    \param block Block
+    \param start first column to decode
+    \param stop last column to decode (-1 means last column of alignment)
+    Column indices of the matrix start from 0 (column start of block).
+    */
+    void build(const Block* block, pos_t start = 0, pos_t stop = -1);
+
+    /** Return number of rows (fragments) */
+    int rows() const {
+        return fragments_.size();
+    }
+
+    /** Return number of columns */
+    pos_t columns() const {
+        return columns_;
+    }
+
+    /** Return fragments in order of rows */
+    const Fragments& fragments() const {
+        return fragments_;
+    }
+
+    /** Return cell, 0 means gap */
+    char at(int row, pos_t col) const {
+        return data_[row * columns_ + col];
+    }
+
+    /** Return pointer to cells of row (columns() chars) */
+    const char* row(int row) const {
+        return row_begins_[row];
+    }
+
+    /** Return array of pointers to rows */
+    const char* const* row_begins() const {
+        return row_begins_.empty() ? 0 : &row_begins_[0];
+    }
+
+    /** Classify columns.
+    \param flags Output, combinations of ColumnFlag per column.
+    \see classify_columns()
+    */
+    void classify_columns(std::vector<unsigned char>& flags) const;
+
+    /** Count letters in columns.
+    \param consensus Output, consensus of columns (may be 0).
+    \param atgc Array of LETTERS_NUMBER counters (may be 0).
+    \see count_columns(), Block::consensus_char
+    */
+    void count_columns(std::string* consensus, int* atgc) const;
+
+    /** Classify all columns of block.
+    The block is decoded in windows of BLOCK_MATRIX_WINDOW columns,
+    so only flags are allocated for whole alignment.
+    \param flags Output, combinations of ColumnFlag per column.
+    */
+    static void classify_block(const Block* block,
+                               std::vector<unsigned char>& flags);
+
+    /** Write cells of fragment to array.
+    \param cells Output; cell of column col is written to
+        cells[col - start]. Gaps are not written.
+    \param fragment Fragment
+    \param start first column to decode
+    \param stop last column to decode
+    */
+    static void decode_fragment(char* cells, const Fragment* fragment,
+                                pos_t start, pos_t stop);
+
+private:
+    Fragments fragments_;
+    pos_t columns_;
+    std::vector<char> data_;
+    std::vector<const char*> row_begins_;
+};
+
+}
+
+#endif
+
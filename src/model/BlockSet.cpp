@@ -14,7 +14,8 @@
 #include <boost/lexical_cast.hpp>
 #include <boost/tuple/tuple.hpp>
 #include <boost/tuple/tuple_comparison.hpp>
-#include <boost/thread/shared_mutex.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/unordered_map.hpp>
 
 #include "BlockSet.hpp"
 #include "read_block_set.hpp"
@@ -26,17 +27,81 @@
 #include "Exception.hpp"
 #include "throw_assert.hpp"
 #include "block_hash.hpp"
+#include "CoverageIndex.hpp"
 #include "global.hpp"
+#include "pool_alloc.hpp"
 
 namespace npge {
 
 typedef std::map<std::string, SequencePtr> Name2Seq;
 typedef std::map<std::string, BSA> Name2BSA;
+typedef boost::unordered_map<const Block*, size_t> Block2Slot;
+typedef boost::unordered_multimap<std::string, Block*> Name2Block;
 
 struct BlockSet::I {
     BlockSet::Impl blocks_;
+    Block2Slot slots_;
     std::set<SequencePtr> seqs_;
     Name2BSA bsas_;
+
+    // number of existing iterators over blocks_
+    BlockSetIterator::Counter iterators_;
+
+    // indices built on demand: names (by find_block)
+    // and covered positions (by CoverageIndex::of)
+    boost::mutex index_mutex_;
+    Name2Block names_;
+    bool has_names_;
+    CoverageIndexPtr coverage_;
+
+    I():
+        iterators_(0), has_names_(false) {
+    }
+
+    void compact() {
+        size_t live = slots_.size();
+        if (blocks_.size() <= 2 * live || iterators_ != 0) {
+            return;
+        }
+        size_t dst = 0;
+        for (size_t src = 0; src < blocks_.size(); src++) {
+            Block* block = blocks_[src];
+            if (block) {
+                blocks_[dst] = block;
+                slots_[block] = dst;
+                dst += 1;
+            }
+        }
+        blocks_.resize(dst);
+    }
+
+    void reset_names() {
+        names_.clear();
+        has_names_ = false;
+    }
+
+    void remove_name(Block* block, const std::string& name) {
+        typedef Name2Block::iterator It;
+        std::pair<It, It> range = names_.equal_range(name);
+        for (It it = range.first; it != range.second; ++it) {
+            if (it->second == block) {
+                names_.erase(it);
+                return;
+            }
+        }
+        // not expected: all blocksets of a block are notified
+        reset_names();
+    }
+
+    void build_names() {
+        names_.clear();
+        BOOST_FOREACH (Block* block, blocks_) {
+            if (block) {
+                names_.insert(std::make_pair(block->name(), block));
+            }
+        }
+        has_names_ = true;
+    }
 };
 
 BlockSet::BlockSet() {
@@ -73,8 +138,17 @@ std::string BlockSet::block_from_description(const std::string& description) {
 
 void BlockSet::insert(Block* block) {
     Impl& blocks = impl_->blocks_;
-    ASSERT_TRUE(blocks.find(block) == blocks.end());
-    blocks.insert(block);
+    bool inserted = impl_->slots_.insert(std::make_pair(block,
+                                         blocks.size())).second;
+    ASSERT_TRUE(inserted);
+    blocks.push_back(block);
+    block->add_block_set(this);
+    impl_->compact();
+    boost::mutex::scoped_lock lock(impl_->index_mutex_);
+    if (impl_->has_names_) {
+        impl_->names_.insert(std::make_pair(block->name(), block));
+    }
+    impl_->coverage_.reset();
 }
 
 void BlockSet::erase(Block* block) {
@@ -83,29 +157,74 @@ void BlockSet::erase(Block* block) {
 }
 
 void BlockSet::detach(Block* block) {
-    impl_->blocks_.erase(block);
+    Block2Slot::iterator it = impl_->slots_.find(block);
+    if (it == impl_->slots_.end()) {
+        return;
+    }
+    Impl& blocks = impl_->blocks_;
+    blocks[it->second] = 0;
+    impl_->slots_.erase(it);
+    block->remove_block_set(this);
+    // empty slots in the middle are kept while iterators exist
+    while (!blocks.empty() && blocks.back() == 0) {
+        blocks.pop_back();
+    }
+    impl_->compact();
+    boost::mutex::scoped_lock lock(impl_->index_mutex_);
+    if (impl_->has_names_) {
+        impl_->remove_name(block, block->name());
+    }
+    impl_->coverage_.reset();
 }
 
 int BlockSet::size() const {
-    return impl_->blocks_.size();
+    return impl_->slots_.size();
 }
 
 bool BlockSet::empty() const {
-    return impl_->blocks_.empty();
+    return impl_->slots_.empty();
 }
 
 bool BlockSet::has(const Block* block) const {
-    Block* b = const_cast<Block*>(block);
-    return impl_->blocks_.find(b) != impl_->blocks_.end();
+    return impl_->slots_.find(block) != impl_->slots_.end();
 }
 
 Block* BlockSet::find_block(const std::string& name) const {
-    BOOST_FOREACH (Block* b, *this) {
-        if (b->name() == name) {
-            return b;
+    boost::mutex::scoped_lock lock(impl_->index_mutex_);
+    if (!impl_->has_names_) {
+        impl_->build_names();
+    }
+    Name2Block::const_iterator it = impl_->names_.find(name);
+    if (it == impl_->names_.end()) {
+        return 0;
+    }
+    return it->second;
+}
+
+void BlockSet::block_renamed(Block* block,
+                            const std::string& old_name) {
+    boost::mutex::scoped_lock lock(impl_->index_mutex_);
+    if (impl_->has_names_) {
+        impl_->remove_name(block, old_name);
+        if (impl_->has_names_) {
+            impl_->names_.insert(std::make_pair(block->name(), block));
         }
     }
-    return 0;
+}
+
+CoverageIndexPtr BlockSet::coverage_index(int workers) const {
+    boost::mutex::scoped_lock lock(impl_->index_mutex_);
+    if (!impl_->coverage_) {
+        boost::shared_ptr<CoverageIndex> index(new CoverageIndex);
+        index->build(*this, workers);
+        impl_->coverage_ = index;
+    }
+    return impl_->coverage_;
+}
+
+void BlockSet::reset_coverage_index() const {
+    boost::mutex::scoped_lock lock(impl_->index_mutex_);
+    impl_->coverage_.reset();
 }
 
 void BlockSet::clear() {
@@ -119,6 +238,16 @@ void BlockSet::clear_blocks() {
         delete block;
     }
     impl_->blocks_.clear();
+    impl_->slots_.clear();
+    {
+        boost::mutex::scoped_lock lock(impl_->index_mutex_);
+        impl_->reset_names();
+        impl_->coverage_.reset();
+    }
+#ifdef NPGE_POOL_ALLOC
+    // return slabs of deleted blocks to the system
+    pool_flush();
+#endif
 }
 
 void BlockSet::clear_seqs() {
@@ -159,9 +288,33 @@ void BlockSet::clear_bsas() {
 }
 
 void BlockSet::swap(BlockSet& other) {
+    // a block can be in both blocksets
+    BOOST_FOREACH (Block* block, *this) {
+        block->remove_block_set(this);
+    }
+    BOOST_FOREACH (Block* block, other) {
+        block->remove_block_set(&other);
+    }
     impl_->blocks_.swap(other.impl_->blocks_);
+    impl_->slots_.swap(other.impl_->slots_);
+    {
+        boost::mutex::scoped_lock lock(impl_->index_mutex_);
+        impl_->reset_names();
+        impl_->coverage_.reset();
+    }
+    {
+        boost::mutex::scoped_lock lock(other.impl_->index_mutex_);
+        other.impl_->reset_names();
+        other.impl_->coverage_.reset();
+    }
     impl_->seqs_.swap(other.impl_->seqs_);
     impl_->bsas_.swap(other.impl_->bsas_);
+    BOOST_FOREACH (Block* block, *this) {
+        block->add_block_set(this);
+    }
+    BOOST_FOREACH (Block* block, other) {
+        block->add_block_set(&other);
+    }
 }
 
 BlockSetPtr BlockSet::clone() const {
@@ -182,19 +335,21 @@ Block* BlockSet::front() const {
 }
 
 BlockSet::iterator BlockSet::begin() {
-    return impl_->blocks_.begin();
+    return iterator(&impl_->blocks_, 0, &impl_->iterators_);
 }
 
 BlockSet::const_iterator BlockSet::begin() const {
-    return impl_->blocks_.begin();
+    return const_iterator(&impl_->blocks_, 0, &impl_->iterators_);
 }
 
 BlockSet::iterator BlockSet::end() {
-    return impl_->blocks_.end();
+    return iterator(&impl_->blocks_, impl_->blocks_.size(),
+                    &impl_->iterators_);
 }
 
 BlockSet::const_iterator BlockSet::end() const {
-    return impl_->blocks_.end();
+    return const_iterator(&impl_->blocks_, impl_->blocks_.size(),
+                          &impl_->iterators_);
 }
 
 bool BlockSet::operator==(const BlockSet& other) const {
@@ -9,31 +9,143 @@
 #define NPGE_BLOCK_SET_HPP_
 
 #include <iosfwd>
-#include <set>
+#include <iterator>
 #include <vector>
 #include <map>
 #include "boost-xtime.hpp"
 #include <boost/utility.hpp>
+#include <boost/detail/atomic_count.hpp>
 
 #include "global.hpp"
 #include "block_set_alignment.hpp"
 
 namespace npge {
 
+/** Iterator over blocks of BlockSet.
+Empty slots (left by erased blocks) are skipped.
+Iterators remain valid when blocks are inserted or when other
+blocks are erased. Blocks inserted after end() was taken
+are not visited before that end.
+
+Iterators are counted by the blockset: empty slots are
+compacted only if no iterator of the blockset exists.
+*/
+class BlockSetIterator {
+public:
+    typedef std::forward_iterator_tag iterator_category;
+    typedef Block* value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef Block* const* pointer;
+    typedef Block* const& reference;
+
+    /** Counter of existing iterators */
+    typedef boost::detail::atomic_count Counter;
+
+    /** Constructor */
+    BlockSetIterator():
+        blocks_(0), index_(0), counter_(0) {
+    }
+
+    /** Constructor */
+    BlockSetIterator(const Blocks* blocks, size_t index,
+                     Counter* counter):
+        blocks_(blocks), index_(index), counter_(counter) {
+        ++(*counter_);
+        skip_empty();
+    }
+
+    /** Copy constructor */
+    BlockSetIterator(const BlockSetIterator& other):
+        blocks_(other.blocks_), index_(other.index_),
+        counter_(other.counter_) {
+        if (counter_) {
+            ++(*counter_);
+        }
+    }
+
+    /** Destructor */
+    ~BlockSetIterator() {
+        if (counter_) {
+            --(*counter_);
+        }
+    }
+
+    /** Assignment operator */
+    BlockSetIterator& operator=(const BlockSetIterator& other) {
+        if (other.counter_) {
+            ++(*other.counter_);
+        }
+        if (counter_) {
+            --(*counter_);
+        }
+        blocks_ = other.blocks_;
+        index_ = other.index_;
+        counter_ = other.counter_;
+        return *this;
+    }
+
+    /** Dereference */
+    reference operator*() const {
+        return (*blocks_)[index_];
+    }
+
+    /** Pre-increment */
+    BlockSetIterator& operator++() {
+        index_ += 1;
+        skip_empty();
+        return *this;
+    }
+
+    /** Post-increment */
+    BlockSetIterator operator++(int) {
+        BlockSetIterator result = *this;
+        ++(*this);
+        return result;
+    }
+
+    /** Comparison operator */
+    bool operator==(const BlockSetIterator& other) const {
+        return pos() == other.pos();
+    }
+
+    /** Comparison operator */
+    bool operator!=(const BlockSetIterator& other) const {
+        return pos() != other.pos();
+    }
+
+private:
+    const Blocks* blocks_;
+    size_t index_;
+    Counter* counter_;
+
+    size_t pos() const {
+        size_t size = blocks_ ? blocks_->size() : 0;
+        return index_ < size ? index_ : size;
+    }
+
+    void skip_empty() {
+        while (index_ < blocks_->size() && (*blocks_)[index_] == 0) {
+            index_ += 1;
+        }
+    }
+};
+
 /** Container of blocks.
+Blocks are iterated in order of insertion.
 */
 class BlockSet : boost::noncopyable {
 public:
     /** Type of implementation container.
     Do not rely on ths type!
+    Erased blocks leave empty slots (0), skipped by iterators.
     */
-    typedef std::set < Block*, std::less<Block*> > Impl;
+    typedef Blocks Impl;
 
     /** Iterator */
-    typedef Impl::iterator iterator;
+    typedef BlockSetIterator iterator;
 
     /** Constant iterator */
-    typedef Impl::const_iterator const_iterator;
+    typedef BlockSetIterator const_iterator;
 
     /** Constructor */
     BlockSet();
@@ -70,16 +182,20 @@ public:
 
     /** Add block.
     The same block can't be added twice.
+    The block is appended to the end of iteration order.
+    Empty slots may be compacted (see detach).
     */
     void insert(Block* block);
 
-    /** Remove fragment.
+    /** Remove block, amortized O(1).
     The block is deleted.
     */
     void erase(Block* block);
 
-    /** Remove fragment.
+    /** Remove block, amortized O(1).
     The block is not deleted.
+    If empty slots outnumber blocks and no iterator exists,
+    the slots are compacted.
     */
     void detach(Block* block);
 
@@ -92,7 +208,11 @@ public:
     /** Return if has the block */
     bool has(const Block* block) const;
 
-    /** Return a block of this name or 0 */
+    /** Return a block of this name or 0.
+    Index of names is built by first call and then kept up to date
+    by insert, erase and renaming of blocks of this blockset.
+    If several blocks have this name, any of them is returned.
+    */
     Block* find_block(const std::string& name) const;
 
     /** Remove all blocks and sequences.
@@ -167,6 +287,18 @@ private:
     struct I;
 
     I* impl_;
+
+    /** Update index of names after renaming of the block */
+    void block_renamed(Block* block, const std::string& old_name);
+
+    /** Return index of covered positions, build it if needed */
+    CoverageIndexPtr coverage_index(int workers) const;
+
+    /** Drop index of covered positions */
+    void reset_coverage_index() const;
+
+    friend class Block;
+    friend class CoverageIndex;
 };
 
 /** Streaming operator.
@@ -0,0 +1,144 @@
+/*
+ * NPG-explorer, Nucleotide PanGenome explorer
+ * Copyright (C) 2012-2016 Boris Nagaev
+ *
+ * See the LICENSE file for terms of use.
+ */
+
+#include <algorithm>
+#include <boost/foreach.hpp>
+#include <boost/bind.hpp>
+
+#include "CoverageIndex.hpp"
+#include "Sequence.hpp"
+#include "Fragment.hpp"
+#include "Block.hpp"
+#include "BlockSet.hpp"
+#include "simple_task.hpp"
+#include "throw_assert.hpp"
+
+namespace npge {
+
+CoverageIndex::CoverageIndex() {
+}
+
+void CoverageIndex::build_seq(SeqIndex* index) {
+    index->fragments.build();
+    PosRanges& covered = index->covered;
+    BOOST_FOREACH (Fragment* f, index->fragments) {
+        if (!covered.empty() && f->min_pos() <= covered.back().second + 1) {
+            covered.back().second = std::max(covered.back().second,
+                                             f->max_pos());
+        } else {
+            covered.push_back(PosRange(f->min_pos(), f->max_pos()));
+        }
+    }
+}
+
+void CoverageIndex::build(const BlockSet& bs, int workers) {
+    data_.clear();
+    BOOST_FOREACH (Block* block, bs) {
+        BOOST_FOREACH (Fragment* fragment, *block) {
+            data_[fragment->seq()].fragments.push_back(fragment);
+        }
+    }
+    Tasks tasks;
+    BOOST_FOREACH (Seq2Index::value_type& seq_index, data_) {
+        tasks.push_back(boost::bind(&CoverageIndex::build_seq,
+                                    &seq_index.second));
+    }
+    do_tasks(tasks_to_generator(tasks), workers);
+}
+
+CoverageIndexPtr CoverageIndex::of(const BlockSet& bs, int workers) {
+    return bs.coverage_index(workers);
+}
+
+void CoverageIndex::forget(const BlockSet& bs) {
+    bs.reset_coverage_index();
+}
+
+std::vector<Sequence*> CoverageIndex::seqs() const {
+    std::vector<Sequence*> result;
+    BOOST_FOREACH (const Seq2Index::value_type& seq_index, data_) {
+        result.push_back(seq_index.first);
+    }
+    return result;
+}
+
+bool CoverageIndex::has_seq(Sequence* seq) const {
+    return data_.find(seq) != data_.end();
+}
+
+void CoverageIndex::gaps(PosRanges& gaps, Sequence* seq) const {
+    pos_t length = seq->size();
+    Seq2Index::const_iterator it = data_.find(seq);
+    pos_t start = 0;
+    if (it != data_.end()) {
+        BOOST_FOREACH (const PosRange& range, it->second.covered) {
+            if (range.first > start) {
+                gaps.push_back(PosRange(start, range.first - 1));
+            }
+            start = std::max(start, range.second + 1);
+        }
+    }
+    if (start < length) {
+        gaps.push_back(PosRange(start, length - 1));
+    }
+}
+
+struct RangeLess {
+    bool operator()(const PosRange& range, pos_t pos) const {
+        return range.second < pos;
+    }
+};
+
+bool CoverageIndex::has_overlap(const Fragment* fragment) const {
+    Seq2Index::const_iterator it = data_.find(fragment->seq());
+    if (it == data_.end()) {
+        return false;
+    }
+    const PosRanges& covered = it->second.covered;
+    // first covered region ending at or after min_pos
+    PosRanges::const_iterator r = std::lower_bound(covered.begin(),
+                                  covered.end(), fragment->min_pos(),
+                                  RangeLess());
+    return r != covered.end() && r->first <= fragment->max_pos();
+}
+
+void CoverageIndex::find_overlap_fragments(Fragments& overlap_fragments,
+        const Fragment* fragment) const {
+    Seq2Index::const_iterator it = data_.find(fragment->seq());
+    if (it == data_.end()) {
+        return;
+    }
+    int first = overlap_fragments.size();
+    it->second.fragments.find_overlaps(overlap_fragments,
+                                       fragment->min_pos(),
+                                       fragment->max_pos());
+    // ascending order to order of FragmentCollection
+    Fragments::iterator begin = overlap_fragments.begin() + first;
+    Fragments::iterator end = overlap_fragments.end();
+    Fragments::iterator middle = begin;
+    while (middle != end && **middle < *fragment) {
+        ++middle;
+    }
+    std::reverse(begin, middle);
+    if (middle != end) {
+        std::rotate(begin, middle, middle + 1);
+    }
+}
+
+void CoverageIndex::find_overlaps(std::vector<Fragment>& overlaps,
+                                  const Fragment* fragment) const {
+    Fragments overlap_fragments;
+    find_overlap_fragments(overlap_fragments, fragment);
+    BOOST_FOREACH (Fragment* f, overlap_fragments) {
+        ASSERT_TRUE(f->common_positions(*fragment));
+        overlaps.push_back(f->common_fragment(*fragment));
+        ASSERT_EQ(overlaps.back().ori(), f->ori());
+    }
+}
+
+}
+
@@ -0,0 +1,104 @@
+/*
+ * NPG-explorer, Nucleotide PanGenome explorer
+ * Copyright (C) 2012-2016 Boris Nagaev
+ *
+ * See the LICENSE file for terms of use.
+ */
+
+#ifndef NPGE_COVERAGE_INDEX_HPP_
+#define NPGE_COVERAGE_INDEX_HPP_
+
+#include <map>
+#include <vector>
+#include <utility>
+
+#include "global.hpp"
+#include "FragmentCollection.hpp"
+
+namespace npge {
+
+/** Segment of sequence, [first, second] */
+typedef std::pair<pos_t, pos_t> PosRange;
+
+/** List of segments of sequence */
+typedef std::vector<PosRange> PosRanges;
+
+/** Per-sequence index of positions covered by fragments of blockset.
+
+For each sequence, fragments are stored in FragmentIntervals
+(interval tree) and sorted boundaries of covered regions
+are stored. Queries are answered by search in the tree
+and binary search over the regions.
+
+The index keeps pointers to fragments and must not be used
+after the blockset was changed.
+*/
+class CoverageIndex {
+public:
+    /** Constructor */
+    CoverageIndex();
+
+    /** Build index of fragments of blockset.
+    Sequences are processed in parallel.
+    */
+    void build(const BlockSet& bs, int workers = 1);
+
+    /** Return index of blockset.
+    The index is kept by the blockset until blocks are inserted
+    to or removed from the blockset or fragments are inserted to
+    or removed from its blocks. Processor drops the index
+    of its target blockset after run.
+    This function is thread-safe.
+    */
+    static CoverageIndexPtr of(const BlockSet& bs, int workers = 1);
+
+    /** Drop kept index of blockset.
+    Call this after fragments of blockset were changed in place.
+    This function is thread-safe.
+    */
+    static void forget(const BlockSet& bs);
+
+    /** Return sequences, which have fragments */
+    std::vector<Sequence*> seqs() const;
+
+    /** Return if the sequence has fragments */
+    bool has_seq(Sequence* seq) const;
+
+    /** Append regions of sequence not covered by fragments */
+    void gaps(PosRanges& gaps, Sequence* seq) const;
+
+    /** Return if the fragment overlaps any fragment */
+    bool has_overlap(const Fragment* fragment) const;
+
+    /** Append fragments overlapping with the fragment.
+    Fragments are ordered as in FragmentCollection:
+    the first fragment not less than the fragment,
+    then preceding fragments in descending order,
+    then following fragments in ascending order.
+    */
+    void find_overlap_fragments(Fragments& overlap_fragments,
+                                const Fragment* fragment) const;
+
+    /** Append overlaps between the fragment and fragments.
+    Ori of fragment from index is used.
+    */
+    void find_overlaps(std::vector<Fragment>& overlaps,
+                       const Fragment* fragment) const;
+
+private:
+    struct SeqIndex {
+        FIntervals fragments;
+        PosRanges covered; // sorted, non-overlapping
+    };
+
+    typedef std::map<Sequence*, SeqIndex> Seq2Index;
+
+    Seq2Index data_;
+
+    static void build_seq(SeqIndex* index);
+};
+
+}
+
+#endif
+
@@ -6,13 +6,13 @@
  */
 
 #include <stdint.h>
-#include <sstream>
 #include <ostream>
 #include <algorithm>
 #include "boost-xtime.hpp"
 
 #include "Fragment.hpp"
 #include "AlignmentRow.hpp"
+#include "AlignmentCursor.hpp"
 #include "Block.hpp"
 #include "Sequence.hpp"
 #include "complement.hpp"
@@ -134,10 +134,24 @@ void Fragment::inverse(bool inverse_row) {
     set_ori(ori() == 1 ? -1 : 1, inverse_row);
 }
 
+static std::string contents(const Fragment* f, char gap) {
+    std::string text;
+    const AlignmentRow* row = f->row();
+    if (row && gap) {
+        ASSERT_GTE(row->length(), f->length());
+        text.reserve(row->length());
+        for (AlignmentCursor c(f); c.valid(); c.next()) {
+            char letter = c.letter();
+            text += letter ? letter : gap;
+        }
+    } else if (f->length() > 0) {
+        text = f->substr(0, f->length() - 1);
+    }
+    return text;
+}
+
 std::string Fragment::str(char gap) const {
-    std::stringstream result;
-    print_contents(result, gap, /* line */ 0);
-    return result.str();
+    return contents(this, gap);
 }
 
 std::string Fragment::substr(pos_t min, pos_t max) const {
@@ -186,6 +200,23 @@ hash_t Fragment::hash() const {
     return seq()->hash(begin_pos(), length(), ori());
 }
 
+FragmentKey Fragment::key() const {
+    FragmentKey result;
+    result.seq = hash_t(reinterpret_cast<uintptr_t>(seq()));
+    result.min_pos = min_pos();
+    result.max_pos = max_pos();
+    result.ori = ori();
+    return result;
+}
+
+std::size_t hash_value(const FragmentKey& key) {
+    hash_t h = key.seq;
+    h = h * 0x9E3779B97F4A7C15ULL + hash_t(key.min_pos);
+    h = h * 0x9E3779B97F4A7C15ULL + hash_t(key.max_pos);
+    h = h * 0x9E3779B97F4A7C15ULL + hash_t(key.ori);
+    return std::size_t(h ^ (h >> 29));
+}
+
 std::string Fragment::seq_name_from_id(const std::string& id) {
     if (id.empty()) {
         return "";
@@ -342,32 +373,16 @@ void Fragment::print_header(std::ostream& o, const Block* b) const {
 }
 
 void Fragment::print_contents(std::ostream& o, char gap, int line) const {
-    int l = 0;
-    if (row_ && gap) {
-        pos_t row_length = row_->length();
-        ASSERT_GTE(row_length, length());
-        for (pos_t align_pos = 0; align_pos < row_length; align_pos++) {
-            if (l >= line && line != 0) {
-                o << std::endl;
-                l = 0;
-            }
-            pos_t fragment_pos = row_->map_to_fragment(align_pos);
-            if (fragment_pos == -1) {
-                o << gap;
-            } else {
-                o << raw_at(fragment_pos);
-            }
-            l += 1;
-        }
-    } else {
-        for (pos_t i = 0; i < length(); i++) {
-            if (l >= line && line != 0) {
-                o << std::endl;
-                l = 0;
-            }
-            o << raw_at(i);
-            l += 1;
+    std::string text = contents(this, gap);
+    if (line == 0) {
+        o << text;
+        return;
+    }
+    for (size_t i = 0; i < text.size(); i += line) {
+        if (i != 0) {
+            o << std::endl;
         }
+        o << text.substr(i, line);
     }
 }
 
@@ -13,9 +13,36 @@
 #include <string>
 
 #include "global.hpp"
+#include "config.hpp"
+#include "pool_alloc.hpp"
 
 namespace npge {
 
+/** Numeric key of fragment (sequence, min_pos, max_pos, ori).
+Keys are equal if and only if fragments are equal
+(see Fragment::operator==).
+*/
+struct FragmentKey {
+    hash_t seq; ///< Address of sequence
+    pos_t min_pos; ///< Minimum position
+    pos_t max_pos; ///< Maximum position
+    int ori; ///< Ori
+
+    /** Comparison operator */
+    bool operator==(const FragmentKey& other) const {
+        return seq == other.seq && min_pos == other.min_pos &&
+               max_pos == other.max_pos && ori == other.ori;
+    }
+
+    /** Comparison operator */
+    bool operator!=(const FragmentKey& other) const {
+        return !(*this == other);
+    }
+};
+
+/** Hash of fragment key (used by boost::unordered_map) */
+std::size_t hash_value(const FragmentKey& key);
+
 /** Part of sequence.
   - min_pos and max_pos
   - seq
@@ -25,6 +52,10 @@ namespace npge {
 */
 class Fragment {
 public:
+#ifdef NPGE_POOL_ALLOC
+    NPGE_POOL_OPERATORS
+#endif
+
     /** Invalid fragment */
     static const Fragment INVALID;
 
@@ -154,6 +185,9 @@ public:
     /** Return hash of this fragment */
     hash_t hash() const;
 
+    /** Return numeric key of this fragment */
+    FragmentKey key() const;
+
     /** Return sequence name built from fragment id.
     On error, returns empty string.
     */
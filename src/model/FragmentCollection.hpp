@@ -69,6 +69,336 @@ struct AssignFragment<Fragment*> {
     }
 };
 
+/** Vector of fragments of one sequence with implicit interval tree.
+Fragments are sorted by min_pos. Node of the tree is a fragment,
+level of node i is the number of trailing 1-bits of i,
+children of node i of level k are i - 2^(k-1) and i + 2^(k-1).
+For each node maximum end of its subtree is stored.
+This allows to find k fragments overlapping with given
+fragment in O(log n + k) even if fragments are long or nested.
+
+The tree is built by build() (called by prepare()).
+Removed fragments are marked and skipped until they outnumber
+other fragments, so the tree remains valid after remove().
+*/
+template<typename F>
+class FragmentIntervals {
+public:
+    /** Constant iterator, removed fragments are skipped */
+    class const_iterator {
+    public:
+        typedef std::bidirectional_iterator_tag iterator_category;
+        typedef F value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const F* pointer;
+        typedef const F& reference;
+
+        /** Constructor */
+        const_iterator():
+            c_(0), i_(0) {
+        }
+
+        /** Constructor */
+        const_iterator(const FragmentIntervals* c, int i):
+            c_(c), i_(i) {
+        }
+
+        /** Dereference */
+        reference operator*() const {
+            return c_->fragments_[i_];
+        }
+
+        /** Member access */
+        pointer operator->() const {
+            return &c_->fragments_[i_];
+        }
+
+        /** Pre-increment */
+        const_iterator& operator++() {
+            i_ = c_->next_kept(i_ + 1);
+            return *this;
+        }
+
+        /** Post-increment */
+        const_iterator operator++(int) {
+            const_iterator result = *this;
+            ++(*this);
+            return result;
+        }
+
+        /** Pre-decrement */
+        const_iterator& operator--() {
+            do {
+                i_ -= 1;
+            } while (c_->removed_[i_]);
+            return *this;
+        }
+
+        /** Post-decrement */
+        const_iterator operator--(int) {
+            const_iterator result = *this;
+            --(*this);
+            return result;
+        }
+
+        /** Comparison operator */
+        bool operator==(const const_iterator& other) const {
+            return i_ == other.i_;
+        }
+
+        /** Comparison operator */
+        bool operator!=(const const_iterator& other) const {
+            return i_ != other.i_;
+        }
+
+    private:
+        const FragmentIntervals* c_;
+        int i_;
+    };
+
+    /** Iterator */
+    typedef const_iterator iterator;
+
+    /** Value type */
+    typedef F value_type;
+
+    /** Constructor */
+    FragmentIntervals():
+        removed_count_(0), max_level_(-1) {
+    }
+
+    /** Return iterator to first fragment */
+    const_iterator begin() const {
+        return const_iterator(this, next_kept(0));
+    }
+
+    /** Return iterator after last fragment */
+    const_iterator end() const {
+        return const_iterator(this, fragments_.size());
+    }
+
+    /** Return number of fragments */
+    int size() const {
+        return fragments_.size() - removed_count_;
+    }
+
+    /** Return if there are no fragments */
+    bool empty() const {
+        return size() == 0;
+    }
+
+    /** Add fragment. build() must be called before queries */
+    void push_back(const F& f) {
+        fragments_.push_back(f);
+        removed_.push_back(false);
+        max_level_ = -1;
+    }
+
+    /** Remove fragment.
+    If the tree is built, the fragment is marked as removed,
+    O(log n) amortized. Otherwise it is erased, O(n).
+    */
+    void remove(const F& f) {
+        int n = fragments_.size();
+        if (!built()) {
+            // fragments are not sorted
+            for (int i = n - 1; i >= 0; i--) {
+                if (!removed_[i] && fragments_[i] == f) {
+                    fragments_.erase(fragments_.begin() + i);
+                    removed_.erase(removed_.begin() + i);
+                }
+            }
+            return;
+        }
+        // equal fragments are adjacent
+        int i = std::lower_bound(fragments_.begin(), fragments_.end(),
+                                 f, fc_) - fragments_.begin();
+        for (; i < n && !fc_(f, fragments_[i]); i++) {
+            if (!removed_[i] && fragments_[i] == f) {
+                removed_[i] = true;
+                removed_count_ += 1;
+            }
+        }
+        if (removed_count_ * 2 > n) {
+            drop_removed(true);
+            max_level_ = build_tree();
+        }
+    }
+
+    /** Sort fragments and build the tree, O(n log n) */
+    void build() {
+        drop_removed(false);
+        std::sort(fragments_.begin(), fragments_.end(), fc_);
+        int n = fragments_.size();
+        starts_.resize(n);
+        ends_.resize(n);
+        for (int i = 0; i < n; i++) {
+            Fragment* f = assigner_(fragments_[i]);
+            starts_[i] = f->min_pos();
+            ends_[i] = f->max_pos() + 1;
+        }
+        max_level_ = build_tree();
+    }
+
+    /** Return if the tree was built after last addition */
+    bool built() const {
+        return max_level_ != -1 || fragments_.empty();
+    }
+
+    /** Append fragments overlapping [min_pos, max_pos].
+    Fragments are appended in order of min_pos.
+    If first_only, then stop after first found fragment.
+    Return if any fragment was found.
+    */
+    bool find_overlaps(Fragments& overlaps, pos_t min_pos, pos_t max_pos,
+                       bool first_only = false) const {
+        ASSERT_TRUE(built());
+        if (fragments_.empty()) {
+            return false;
+        }
+        pos_t start = min_pos, stop = max_pos + 1;
+        int n = fragments_.size();
+        bool found = false;
+        // node, level, if left subtree was visited
+        Node stack[64];
+        int top = 0;
+        int root = (1 << max_level_) - 1;
+        stack[top++] = Node(root, max_level_, false);
+        while (top > 0) {
+            Node z = stack[--top];
+            if (z.level <= 3) {
+                // small subtree: linear scan
+                int i0 = z.x >> z.level << z.level;
+                int i1 = std::min(i0 + (1 << (z.level + 1)) - 1, n);
+                for (int i = i0; i < i1 && starts_[i] < stop; i++) {
+                    if (start < ends_[i] && !removed_[i]) {
+                        overlaps.push_back(assigner_(fragments_[i]));
+                        found = true;
+                        if (first_only) {
+                            return true;
+                        }
+                    }
+                }
+            } else if (!z.left_done) {
+                int y = z.x - (1 << (z.level - 1)); // left child
+                stack[top++] = Node(z.x, z.level, true);
+                if (y >= n || max_ends_[y] > start) {
+                    stack[top++] = Node(y, z.level - 1, false);
+                }
+            } else if (z.x < n && starts_[z.x] < stop) {
+                if (start < ends_[z.x] && !removed_[z.x]) {
+                    overlaps.push_back(assigner_(fragments_[z.x]));
+                    found = true;
+                    if (first_only) {
+                        return true;
+                    }
+                }
+                int y = z.x + (1 << (z.level - 1)); // right child
+                stack[top++] = Node(y, z.level - 1, false);
+            }
+        }
+        return found;
+    }
+
+    /** Return iterator to first fragment not less than f */
+    const_iterator lower_bound(const F& f) const {
+        int i = std::lower_bound(fragments_.begin(), fragments_.end(),
+                                 f, fc_) - fragments_.begin();
+        return const_iterator(this, next_kept(i));
+    }
+
+private:
+    struct Node {
+        int x;
+        int level;
+        bool left_done;
+
+        Node() {
+        }
+
+        Node(int x1, int level1, bool left_done1):
+            x(x1), level(level1), left_done(left_done1) {
+        }
+    };
+
+    std::vector<F> fragments_;
+    std::vector<bool> removed_;
+    int removed_count_;
+    std::vector<pos_t> starts_;
+    std::vector<pos_t> ends_;
+    std::vector<pos_t> max_ends_;
+    int max_level_;
+    AssignFragment<F> assigner_;
+
+    int next_kept(int i) const {
+        int n = fragments_.size();
+        while (i < n && removed_[i]) {
+            i += 1;
+        }
+        return i;
+    }
+
+    /** Erase removed fragments, keeping order.
+    If has_tree, starts and ends of fragments are kept in sync.
+    */
+    void drop_removed(bool has_tree) {
+        if (removed_count_ == 0) {
+            return;
+        }
+        int n = fragments_.size();
+        int dst = 0;
+        for (int src = 0; src < n; src++) {
+            if (!removed_[src]) {
+                fragments_[dst] = fragments_[src];
+                if (has_tree) {
+                    starts_[dst] = starts_[src];
+                    ends_[dst] = ends_[src];
+                }
+                dst += 1;
+            }
+        }
+        fragments_.resize(dst);
+        removed_.assign(dst, false);
+        if (has_tree) {
+            starts_.resize(dst);
+            ends_.resize(dst);
+        }
+        removed_count_ = 0;
+    }
+
+    int build_tree() {
+        int n = fragments_.size();
+        max_ends_.resize(n);
+        if (n == 0) {
+            return 0;
+        }
+        int last_i = 0;
+        pos_t last = 0;
+        for (int i = 0; i < n; i += 2) {
+            last_i = i;
+            last = max_ends_[i] = ends_[i];
+        }
+        int k = 1;
+        for (; (1 << k) <= n; k++) {
+            int x = 1 << (k - 1);
+            int i0 = (x << 1) - 1;
+            int step = x << 2;
+            for (int i = i0; i < n; i += step) {
+                pos_t el = max_ends_[i - x];
+                pos_t er = (i + x < n) ? max_ends_[i + x] : last;
+                pos_t e = ends_[i];
+                e = std::max(e, std::max(el, er));
+                max_ends_[i] = e;
+            }
+            last_i = ((last_i >> k) & 1) ? last_i - x : last_i + x;
+            if (last_i < n && max_ends_[last_i] > last) {
+                last = max_ends_[last_i];
+            }
+        }
+        return k - 1;
+    }
+};
+
 template<typename F, typename C>
 struct InsertFragment {
     void operator()(C& col, const F& fragment) const;
@@ -92,6 +422,15 @@ struct InsertFragment<F, std::set<F, FragmentCompare> > {
     }
 };
 
+template<typename F>
+struct InsertFragment<F, FragmentIntervals<F> > {
+    typedef FragmentIntervals<F> C;
+
+    void operator()(C& col, const F& f) const {
+        col.push_back(f);
+    }
+};
+
 template<typename F, typename C>
 struct RemoveFragment {
     void operator()(C& col, const F& fragment) const;
@@ -115,6 +454,15 @@ struct RemoveFragment<F, std::set<F, FragmentCompare> > {
     }
 };
 
+template<typename F>
+struct RemoveFragment<F, FragmentIntervals<F> > {
+    typedef FragmentIntervals<F> C;
+
+    void operator()(C& col, const F& f) const {
+        col.remove(f);
+    }
+};
+
 template<typename C>
 struct SortFragments {
     void operator()(C& col) const;
@@ -138,6 +486,15 @@ struct SortFragments<std::set<F, FragmentCompare> > {
     }
 };
 
+template<typename F>
+struct SortFragments<FragmentIntervals<F> > {
+    typedef FragmentIntervals<F> C;
+
+    void operator()(C& col) const {
+        col.build();
+    }
+};
+
 template<typename F, typename C>
 struct LowerBound {
     typename C::const_iterator
@@ -164,6 +521,99 @@ struct LowerBound<F, std::set<F, FragmentCompare> > {
     }
 };
 
+template<typename F>
+struct LowerBound<F, FragmentIntervals<F> > {
+    typedef FragmentIntervals<F> C;
+
+    typename C::const_iterator
+    operator()(const C& col, const F& fragment) const {
+        return col.lower_bound(fragment);
+    }
+};
+
+/** Find fragments from sorted container overlapping with the fragment.
+has_overlap checks only neighbours of the fragment,
+so it assumes that fragments of the container do not overlap.
+*/
+template<typename F, typename C>
+struct FindOverlaps {
+    bool has_overlap(const C& fragments, Fragment* fragment) const {
+        F f;
+        assigner_(f, fragment);
+        typename C::const_iterator i2 = lower_bound_(fragments, f);
+        if (i2 != fragments.end() &&
+                assigner_(*i2)->common_positions(*fragment)) {
+            return true;
+        } else if (i2 != fragments.begin()) {
+            i2--;
+            if (assigner_(*i2)->common_positions(*fragment)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /** Find overlaps with the fragment.
+    max_length is the length of the longest fragment of the container;
+    fragments starting earlier than fragment->min_pos() - max_length
+    can not overlap the fragment, so they are not visited.
+    */
+    void operator()(Fragments& overlap_fragments, const C& fragments,
+                    Fragment* fragment, pos_t max_length) const {
+        F f;
+        assigner_(f, fragment);
+        typename C::const_iterator i2 = lower_bound_(fragments, f);
+        typename C::const_iterator i2r = i2, i2l = i2;
+        if (i2 != fragments.end() &&
+                assigner_(*i2)->common_positions(*fragment)) {
+            overlap_fragments.push_back(assigner_(*i2));
+        }
+        pos_t min_pos = fragment->min_pos();
+        while (i2l != fragments.begin()) {
+            i2l--;
+            if (assigner_(*i2l)->min_pos() + max_length <= min_pos) {
+                // fragments are sorted by min_pos
+                break;
+            }
+            if (assigner_(*i2l)->common_positions(*fragment)) {
+                overlap_fragments.push_back(assigner_(*i2l));
+            }
+        }
+        pos_t max_pos = fragment->max_pos();
+        while (i2r != fragments.end()) {
+            i2r++;
+            if (i2r == fragments.end() ||
+                    assigner_(*i2r)->min_pos() > max_pos) {
+                // fragments are sorted by min_pos
+                break;
+            }
+            if (assigner_(*i2r)->common_positions(*fragment)) {
+                overlap_fragments.push_back(assigner_(*i2r));
+            }
+        }
+    }
+
+    AssignFragment<F> assigner_;
+    LowerBound<F, C> lower_bound_;
+};
+
+template<typename F>
+struct FindOverlaps<F, FragmentIntervals<F> > {
+    typedef FragmentIntervals<F> C;
+
+    bool has_overlap(const C& fragments, Fragment* fragment) const {
+        Fragments overlaps;
+        return fragments.find_overlaps(overlaps, fragment->min_pos(),
+                                       fragment->max_pos(), true);
+    }
+
+    void operator()(Fragments& overlap_fragments, const C& fragments,
+                    Fragment* fragment, pos_t /* max_length */) const {
+        fragments.find_overlaps(overlap_fragments, fragment->min_pos(),
+                                fragment->max_pos());
+    }
+};
+
 /** Collection of fragments.
 Template class.
 First template parameter is type used to store fragments:
@@ -173,6 +623,8 @@ First template parameter is type used to store fragments:
 Second template parameter is type used to store several fragments:
  - std::vector<F>
  - std::set<F, FragmentCompare>
+ - FragmentIntervals<F> (vector with interval tree,
+   fast search of overlaps with long or nested fragments)
 
 Add fragments using add_fragment(), add_block() and add_bs().
 Then call prepare().
@@ -208,6 +660,8 @@ public:
         ASSERT_TRUE(seq);
         C& col = data_[seq];
         inserter_(col, f);
+        pos_t& max_length = max_length_[seq];
+        max_length = std::max(max_length, fragment->length());
     }
 
     /** Remove a fragment to the collection.
@@ -268,12 +722,14 @@ public:
     /** Clear collection */
     void clear() {
         data_.clear();
+        max_length_.clear();
     }
 
-    /** Return if the fragment overlaps any fragment from the collection */
+    /** Return if the fragment overlaps any fragment from the collection.
+    Unless FragmentIntervals is used, only neighbours of the fragment
+    are checked, so fragments of the collection must not overlap.
+    */
     bool has_overlap(Fragment* fragment) const {
-        F f;
-        assigner_(f, fragment);
         Sequence* seq = fragment->seq();
         typename Seq2Fragments::const_iterator it = data_.find(seq);
         if (it == data_.end()) {
@@ -283,17 +739,7 @@ public:
         if (fragments.empty()) {
             return false;
         }
-        typename C::const_iterator i2 = lower_bound_(fragments, f);
-        if (i2 != fragments.end() &&
-                assigner_(*i2)->common_positions(*fragment)) {
-            return true;
-        } else if (i2 != fragments.begin()) {
-            i2--;
-            if (assigner_(*i2)->common_positions(*fragment)) {
-                return true;
-            }
-        }
-        return false;
+        return find_overlaps_.has_overlap(fragments, fragment);
     }
 
     /** Return if the block overlaps any fragment from the collection */
@@ -319,8 +765,6 @@ public:
     /** Find fragments overlapping with the fragment */
     void find_overlap_fragments(Fragments& overlap_fragments,
                                 Fragment* fragment) const {
-        F f;
-        assigner_(f, fragment);
         Sequence* seq = fragment->seq();
         typename Seq2Fragments::const_iterator it = data_.find(seq);
         if (it == data_.end()) {
@@ -328,25 +772,9 @@ public:
         }
         const C& fragments = it->second;
         ASSERT_FALSE(fragments.empty());
-        typename C::const_iterator i2 = lower_bound_(fragments, f);
-        typename C::const_iterator i2r = i2, i2l = i2;
-        if (i2 != fragments.end() &&
-                assigner_(*i2)->common_positions(*fragment)) {
-            overlap_fragments.push_back(assigner_(*i2));
-        }
-        while (i2l != fragments.begin()) {
-            i2l--;
-            if (assigner_(*i2l)->common_positions(*fragment)) {
-                overlap_fragments.push_back(assigner_(*i2l));
-            }
-        }
-        while (i2r != fragments.end()) {
-            i2r++;
-            if (i2r != fragments.end() &&
-                    assigner_(*i2r)->common_positions(*fragment)) {
-                overlap_fragments.push_back(assigner_(*i2r));
-            }
-        }
+        typename Seq2Length::const_iterator l = max_length_.find(seq);
+        ASSERT_TRUE(l != max_length_.end());
+        find_overlaps_(overlap_fragments, fragments, fragment, l->second);
     }
 
     /** Find overlaps between the fragment and fragments from the collection.
@@ -517,11 +945,15 @@ public:
 private:
     typedef std::map<Sequence*, C> Seq2Fragments;
     Seq2Fragments data_;
+    // upper bound of fragment length, not decreased on removal
+    typedef std::map<Sequence*, pos_t> Seq2Length;
+    Seq2Length max_length_;
     AssignFragment<F> assigner_;
     InsertFragment<F, C> inserter_;
     RemoveFragment<F, C> remover_;
     SortFragments<C> sorter_;
     LowerBound<F, C> lower_bound_;
+    FindOverlaps<F, C> find_overlaps_;
     bool cycles_allowed_;
 };
 
@@ -535,6 +967,11 @@ typedef FragmentCollection<Fragment, DirectFSet> DirectSetFc;
 typedef std::vector<Fragment> DirectFVec;
 typedef FragmentCollection<Fragment, DirectFVec> DirectVectorFc;
 
+typedef FragmentIntervals<Fragment*> FIntervals;
+typedef FragmentCollection<Fragment*, FIntervals> IntervalFc;
+typedef FragmentIntervals<Fragment> DirectFIntervals;
+typedef FragmentCollection<Fragment, DirectFIntervals> DirectIntervalFc;
+
 }
 
 #endif
@@ -111,27 +111,63 @@ bool Sequence::next_fragment_keeping_ori(Fragment& f) const {
     return f.max_pos() < size();
 }
 
+/** Read integer from p, move p to the first char after it */
+static bool read_int(const char*& p, pos_t& value) {
+    bool negative = (*p == '-');
+    if (negative) {
+        p++;
+    }
+    if (!isdigit(*p)) {
+        return false;
+    }
+    value = 0;
+    while (isdigit(*p)) {
+        value = value * 10 + (*p - '0');
+        p++;
+    }
+    if (negative) {
+        value = -value;
+    }
+    return true;
+}
+
 Fragment* Sequence::fragment_from_id(const std::string& id) {
-    using namespace boost::algorithm;
-    Strings parts;
-    split(parts, id, is_any_of("_"));
-    int begin_pos, last_pos, ori;
-    if (parts.size() == 3) {
+    size_t u1 = id.find('_');
+    if (u1 == std::string::npos) {
+        return 0;
+    }
+    // parse numbers without splitting id into strings
+    pos_t numbers[3];
+    int n = 0;
+    const char* p = id.c_str() + u1;
+    while (*p == '_') {
+        p++;
+        if (n == 3 || !read_int(p, numbers[n])) {
+            return 0;
+        }
+        n += 1;
+    }
+    if (*p != '\0') {
+        return 0;
+    }
+    pos_t begin_pos, last_pos;
+    int ori;
+    if (n == 2) {
         // old
-        begin_pos = L_CAST<int>(parts[1]);
-        last_pos = L_CAST<int>(parts[2]);
+        begin_pos = numbers[0];
+        last_pos = numbers[1];
         ori = (begin_pos <= last_pos) ? 1 : -1;
         if (last_pos == -1) {
             last_pos = begin_pos;
             ori = -1;
         }
-    } else if (parts.size() == 4) {
+    } else if (n == 3) {
         // lua-npge compatible
-        begin_pos = L_CAST<int>(parts[1]);
-        last_pos = L_CAST<int>(parts[2]);
-        ori = L_CAST<int>(parts[3]);
+        begin_pos = numbers[0];
+        last_pos = numbers[1];
+        ori = numbers[2];
         // detect if it is parted
-        int diff = last_pos - begin_pos;
+        pos_t diff = last_pos - begin_pos;
         if (diff * ori < 0) {
             // parted
             return 0;
@@ -139,8 +175,7 @@ Fragment* Sequence::fragment_from_id(const std::string& id) {
     } else {
         return 0;
     }
-    const std::string& seq_name = parts[0];
-    ASSERT_EQ(seq_name, name());
+    ASSERT_MSG(id.compare(0, u1, name()) == 0, id.c_str());
     Fragment* f = new Fragment(this);
     f->set_ori(ori);
     f->set_begin_pos(begin_pos);
@@ -6,12 +6,12 @@
  */
 
 #include <climits>
+#include <algorithm>
 #include <vector>
 #include <set>
 #include <string>
 #include <boost/cast.hpp>
 #include <boost/foreach.hpp>
-#include <boost/algorithm/string/join.hpp>
 
 #include "block_hash.hpp"
 #include "Sequence.hpp"
@@ -26,38 +26,49 @@
 
 namespace npge {
 
+/** FNV-1a hash of string (does not depend on platform) */
+static hash_t string_hash(const std::string& str) {
+    hash_t result = 14695981039346656037ULL;
+    for (int i = 0; i < str.size(); i++) {
+        result ^= (unsigned char)(str[i]);
+        result *= 1099511628211ULL;
+    }
+    return result;
+}
+
+/** Finalizer of splitmix64 */
+static hash_t mix(hash_t x) {
+    x ^= x >> 30;
+    x *= 0xBF58476D1CE4E5B9ULL;
+    x ^= x >> 27;
+    x *= 0x94D049BB133111EBULL;
+    x ^= x >> 31;
+    return x;
+}
+
 hash_t block_hash(const Block* block) {
-    Strings ids_dir, ids_inv;
-    BOOST_FOREACH (Fragment* f, *block) {
-        ids_dir.push_back(f->id());
-        f->inverse(/* inverse_row */ false);
-        ids_inv.push_back(f->id());
-        f->inverse(/* inverse_row */ false);
-    }
-    std::sort(ids_dir.begin(), ids_dir.end());
-    std::sort(ids_inv.begin(), ids_inv.end());
-    Strings& ids = (ids_dir < ids_inv) ? ids_dir : ids_inv;
-    std::string joint = boost::algorithm::join(ids, " ");
-    const int LOOP_SIZE = sizeof(hash_t) * 2;
-    // 2 = for * and for ^
-    int new_size = ((joint.size() + LOOP_SIZE - 1) / LOOP_SIZE)
-                   * LOOP_SIZE;
-    joint.resize(new_size, ' ');
-    const char* c = joint.c_str();
-    const hash_t* value = reinterpret_cast<const hash_t*>(c);
-    int loops = joint.size() / LOOP_SIZE;
-    hash_t a = 1;
-    for (int i = 0; i < loops; i++) {
-        a *= value[2 * i];
-        a ^= value[2 * i + 1];
-    }
-    return a;
+    // Sums of fragment keys do not depend on order of fragments.
+    // dir and inv are sums for the block and for inversed block.
+    hash_t dir = 0, inv = 0;
+    BOOST_FOREACH (const Fragment* f, *block) {
+        hash_t seq = f->seq() ? string_hash(f->seq()->name()) : 0;
+        hash_t pos = mix(seq ^ hash_t(f->min_pos()));
+        pos = mix(pos ^ (hash_t(f->max_pos()) << 1));
+        dir += mix(pos ^ (f->ori() == 1));
+        inv += mix(pos ^ (f->ori() != 1));
+    }
+    hash_t a = std::min(dir, inv);
+    hash_t b = std::max(dir, inv);
+    return mix(a) ^ b;
 }
 
 class HashTask;
 class HashWorker;
 class HashGroup;
 
+/** Number of blocks hashed by one task */
+const int HASH_TASK_BLOCKS = 256;
+
 class HashGroup : public ReusingThreadGroup {
 public:
     HashGroup(const BlockSet& block_set):
@@ -91,17 +102,19 @@ public:
 
 class HashTask : public ThreadTask {
 public:
-    HashTask(const Block* block, HashWorker* worker):
-        ThreadTask(worker), block_(block) {
+    HashTask(HashWorker* worker):
+        ThreadTask(worker) {
+        blocks_.reserve(HASH_TASK_BLOCKS);
     }
 
     void run_impl() {
         HashWorker* w = D_CAST<HashWorker*>(worker());
-        w->hash_ ^= block_hash(block_);
+        BOOST_FOREACH (const Block* block, blocks_) {
+            w->hash_ ^= block_hash(block);
+        }
     }
 
-private:
-    const Block* block_;
+    std::vector<const Block*> blocks_;
 };
 
 ThreadTask* HashGroup::create_task_impl(ThreadWorker* worker) {
@@ -110,12 +123,15 @@ ThreadTask* HashGroup::create_task_impl(ThreadWorker* worker) {
     }
     if (it_ == end_) {
         return 0;
-    } else {
-        HashWorker* w = D_CAST<HashWorker*>(worker);
-        HashTask* task = new HashTask(*it_, w);
+    }
+    HashTask* task = new HashTask(D_CAST<HashWorker*>(worker));
+    while (it_ != end_ && task->blocks_.size() < HASH_TASK_BLOCKS) {
+        if ((*it_)->size() > 1) {
+            task->blocks_.push_back(*it_);
+        }
         it_++;
-        return task;
     }
+    return task;
 }
 
 ThreadWorker* HashGroup::create_worker_impl() {
@@ -123,6 +139,15 @@ ThreadWorker* HashGroup::create_worker_impl() {
 }
 
 hash_t blockset_hash(const BlockSet& block_set, int workers) {
+    if (workers == 1) {
+        hash_t hash = 0;
+        BOOST_FOREACH (const Block* block, block_set) {
+            if (block->size() > 1) {
+                hash ^= block_hash(block);
+            }
+        }
+        return hash;
+    }
     HashGroup hash_group((block_set));
     hash_group.set_workers(workers);
     hash_group.perform();
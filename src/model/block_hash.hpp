@@ -13,9 +13,9 @@
 namespace npge {
 
 /** Return hash of block.
-Fragment::id() (i.e., sequence names, fragment positions and ori)
-affects hash value.
+Sequence names, fragment positions and ori affect hash value.
 Alignment and order of fragments does not.
+Inversed block has the same hash. Does not allocate memory.
 */
 hash_t block_hash(const Block* block);
 
@@ -6,6 +6,7 @@
  */
 
 #include <set>
+#include <algorithm>
 #include <boost/foreach.hpp>
 
 #include "block_stat.hpp"
@@ -13,6 +14,8 @@
 #include "Fragment.hpp"
 #include "Sequence.hpp"
 #include "BlockSet.hpp"
+#include "BlockMatrix.hpp"
+#include "column_kernels.hpp"
 #include "boundaries.hpp"
 #include "char_to_size.hpp"
 #include "throw_assert.hpp"
@@ -114,21 +117,30 @@ void make_stat(AlignmentStat& stat, const Block* block, int start, int stop) {
         stop = alignment_length - 1;
     }
     stat.impl_->total_ = stop - start + 1;
-    for (int pos = start; pos <= stop; pos++) {
-        bool ident, gap, pure_gap;
-        test_column(block, pos, ident, gap, pure_gap, stat.impl_->atgc_);
-        if (!pure_gap) {
-            if (ident && !gap) {
-                stat.impl_->ident_nogap_ += 1;
-            } else if (ident && gap) {
-                stat.impl_->ident_gap_ += 1;
-            } else if (!ident && !gap) {
-                stat.impl_->noident_nogap_ += 1;
-            } else if (!ident && gap) {
-                stat.impl_->noident_gap_ += 1;
+    BlockMatrix matrix;
+    std::vector<unsigned char> flags;
+    for (pos_t w = start; w <= stop; w += BLOCK_MATRIX_WINDOW) {
+        pos_t w_stop = std::min<pos_t>(stop, w + BLOCK_MATRIX_WINDOW - 1);
+        matrix.build(block, w, w_stop);
+        matrix.classify_columns(flags);
+        matrix.count_columns(0, stat.impl_->atgc_);
+        for (int col = 0; col < matrix.columns(); col++) {
+            bool ident = flags[col] & IDENT_COLUMN;
+            bool gap = flags[col] & GAP_COLUMN;
+            bool pure_gap = flags[col] & PURE_GAP_COLUMN;
+            if (!pure_gap) {
+                if (ident && !gap) {
+                    stat.impl_->ident_nogap_ += 1;
+                } else if (ident && gap) {
+                    stat.impl_->ident_gap_ += 1;
+                } else if (!ident && !gap) {
+                    stat.impl_->noident_nogap_ += 1;
+                } else if (!ident && gap) {
+                    stat.impl_->noident_gap_ += 1;
+                }
+            } else {
+                stat.impl_->pure_gap_ += 1;
             }
-        } else {
-            stat.impl_->pure_gap_ += 1;
         }
     }
     Integers lengths;
@@ -71,7 +71,7 @@ pos_t frag_to_seq(const Fragment* f, pos_t fragment_pos) {
 }
 
 pos_t seq_to_frag(const Fragment* f, pos_t seq_pos) {
-    return int(seq_pos - f->begin_pos()) * f->ori();
+    return (seq_pos - f->begin_pos()) * f->ori();
 }
 
 void find_slice(pos_t& min_col, pos_t& max_col,
@@ -26,7 +26,7 @@ pos_t fragment_pos(const Fragment* f, pos_t block_pos,
 pos_t frag_to_seq(const Fragment* f, pos_t fragment_pos);
 
 /** Return fragment pos, corresponding to given sequence pos */
-int seq_to_frag(const Fragment* f, pos_t seq_pos);
+pos_t seq_to_frag(const Fragment* f, pos_t seq_pos);
 
 /** Find columns at which slice is located */
 void find_slice(pos_t& min_col, pos_t& max_col,
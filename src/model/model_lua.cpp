@@ -467,7 +467,7 @@ static SequencePtr fragment_seq(const Fragment* f) {
     }
 }
 
-static int block_length(const Fragment* f) {
+static pos_t block_length(const Fragment* f) {
     if (f->block()) {
         return f->block()->alignment_length();
     } else {
@@ -475,11 +475,11 @@ static int block_length(const Fragment* f) {
     }
 }
 
-static pos_t block_pos1(const Fragment* f, int pos) {
+static pos_t block_pos1(const Fragment* f, pos_t pos) {
     return block_pos(f, pos, block_length(f));
 }
 
-static pos_t fragment_pos1(const Fragment* f, int pos) {
+static pos_t fragment_pos1(const Fragment* f, pos_t pos) {
     return fragment_pos(f, pos, block_length(f));
 }
 
@@ -563,7 +563,8 @@ static luabind::scope register_alignment_row() {
            class_<AlignmentRow>("AlignmentRow")
            .enum_("Type") [
                value("MAP_ROW", MAP_ROW),
-               value("COMPACT_ROW", COMPACT_ROW)
+               value("COMPACT_ROW", COMPACT_ROW),
+               value("GAPS_ROW", GAPS_ROW)
            ]
            .scope [
                def("new", &AlignmentRow::new_row),
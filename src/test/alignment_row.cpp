@@ -13,6 +13,7 @@
 #include "Sequence.hpp"
 #include "Fragment.hpp"
 #include "AlignmentRow.hpp"
+#include "AlignmentCursor.hpp"
 
 BOOST_AUTO_TEST_CASE (MapAlignmentRow_main) {
     using namespace npge;
@@ -144,6 +145,7 @@ BOOST_AUTO_TEST_CASE (AlignmentRow_map_to_alignment) {
     std::vector<RowType> types;
     types.push_back(MAP_ROW);
     types.push_back(COMPACT_ROW);
+    types.push_back(GAPS_ROW);
     for (int length = 0; length < 150; length++) {
         BOOST_FOREACH (RowType type, types) {
             AlignmentRow* row = AlignmentRow::new_row(type);
@@ -174,3 +176,159 @@ BOOST_AUTO_TEST_CASE (AlignmentRow_InversedRow) {
     BOOST_CHECK(f->str() == "CAT-T");
 }
 
+
+BOOST_AUTO_TEST_CASE (AlignmentRow_superblocks) {
+    using namespace npge;
+    // many chunks of compact row, several superblocks
+    CompactAlignmentRow::set_superblock_chunks(4);
+    const pos_t half = 5000;
+    std::string aln;
+    for (pos_t i = 0; i < half; i++) {
+        aln += (i % 3 == 0) ? "--" : "A-";
+    }
+    CompactAlignmentRow row(aln);
+    CompactAlignmentRow::set_superblock_chunks(1 << 20);
+    BOOST_REQUIRE(row.length() == half * 2);
+    pos_t fragment_pos = 0;
+    for (pos_t i = 0; i < half; i++) {
+        if (i % 3 != 0) {
+            fragment_pos = row.map_to_fragment(i * 2);
+            BOOST_CHECK(fragment_pos == i - i / 3 - 1);
+            BOOST_CHECK(row.map_to_alignment(fragment_pos) == i * 2);
+        } else {
+            BOOST_CHECK(row.map_to_fragment(i * 2) == -1);
+        }
+        BOOST_CHECK(row.map_to_fragment(i * 2 + 1) == -1);
+    }
+}
+
+BOOST_AUTO_TEST_CASE (AlignmentRow_clone_on_write) {
+    using namespace npge;
+    for (int type = MAP_ROW; type <= GAPS_ROW; type++) {
+        RowType row_type = RowType(type);
+        boost::scoped_ptr<AlignmentRow> row(AlignmentRow::new_row(row_type));
+        row->grow("A-T-G");
+        boost::scoped_ptr<AlignmentRow> copy(row->clone());
+        BOOST_CHECK(copy->type() == row_type);
+        BOOST_CHECK(copy->length() == 5);
+        BOOST_CHECK(copy->map_to_fragment(2) == 1);
+        copy->grow("-C");
+        BOOST_CHECK(copy->length() == 7);
+        BOOST_CHECK(copy->map_to_fragment(6) == 3);
+        BOOST_CHECK(row->length() == 5);
+        BOOST_CHECK(row->map_to_fragment(6) == -1);
+        row->clear();
+        BOOST_CHECK(copy->map_to_fragment(4) == 2);
+    }
+}
+
+BOOST_AUTO_TEST_CASE (AlignmentRow_cursor) {
+    using namespace npge;
+    std::string aln;
+    for (int i = 0; i < 300; i++) {
+        aln += (i % 7 == 0 || i % 11 == 0) ? "--" : "AC";
+    }
+    std::string letters;
+    BOOST_FOREACH (char c, aln) {
+        if (c != '-') {
+            letters += c;
+        }
+    }
+    SequencePtr s1 = boost::make_shared<InMemorySequence>(letters);
+    for (int type = MAP_ROW; type <= GAPS_ROW; type++) {
+        RowType row_type = RowType(type);
+        for (int ori = -1; ori <= 1; ori += 2) {
+            Fragment f(s1, 0, s1->size() - 1, ori);
+            AlignmentRow* row = AlignmentRow::new_row(row_type);
+            row->grow(ori == 1 ? aln : std::string(aln.rbegin(),
+                                                   aln.rend()));
+            f.set_row(row);
+            for (int inverse = 0; inverse < 2; inverse++) {
+                if (inverse) {
+                    f.inverse();
+                }
+                const AlignmentRow* r = f.row();
+                std::vector<pos_t> positions(r->length());
+                r->map_range(&positions[0], 0, r->length() - 1);
+                for (int col = 0; col < r->length(); col++) {
+                    BOOST_CHECK(positions[col] == r->map_to_fragment(col));
+                }
+                for (int dir = -1; dir <= 1; dir += 2) {
+                    int visited = 0;
+                    AlignmentCursor c(&f, dir);
+                    for (; c.valid(); c.next()) {
+                        pos_t col = c.column();
+                        BOOST_CHECK(c.fragment_pos() ==
+                                    r->map_to_fragment(col));
+                        BOOST_CHECK(c.letter() == f.alignment_at(col));
+                        visited += 1;
+                    }
+                    BOOST_CHECK(visited == r->length());
+                }
+                AlignmentCursor c(r, -1, 100);
+                for (int col = 100; col >= 0; col--) {
+                    BOOST_REQUIRE(c.valid());
+                    BOOST_CHECK(c.column() == col);
+                    BOOST_CHECK(c.fragment_pos() == r->map_to_fragment(col));
+                    BOOST_CHECK(c.letter() == 0);
+                    c.next();
+                }
+                BOOST_CHECK(!c.valid());
+            }
+        }
+    }
+    Fragment no_row(s1, 5, 10);
+    std::string text;
+    for (AlignmentCursor c(&no_row); c.valid(); c.next()) {
+        text += c.letter();
+    }
+    BOOST_CHECK(text == no_row.str());
+}
+
+BOOST_AUTO_TEST_CASE (AlignmentRow_gaps) {
+    using namespace npge;
+    for (int attempt = 0; attempt < 100; attempt++) {
+        std::string aln;
+        int parts = rand() % 10;
+        for (int i = 0; i < parts; i++) {
+            aln += std::string(rand() % 5, (i % 2) ? 'A' : '-');
+        }
+        MapAlignmentRow map_row;
+        GapsAlignmentRow row;
+        for (int i = 0; i < aln.size(); i += 3) {
+            map_row.grow(aln.substr(i, 3));
+            row.grow(aln.substr(i, 3));
+        }
+        boost::scoped_ptr<AlignmentRow> bound(AlignmentRow::new_row(GAPS_ROW));
+        bound->assign(map_row);
+        int L = aln.size();
+        BOOST_REQUIRE(row.length() == L);
+        BOOST_REQUIRE(bound->length() == L);
+        for (int i = -3; i < L + 3; i++) {
+            BOOST_CHECK(row.map_to_fragment(i) == map_row.map_to_fragment(i));
+            BOOST_CHECK(bound->map_to_fragment(i) ==
+                        map_row.map_to_fragment(i));
+            BOOST_CHECK(row.map_to_alignment(i) ==
+                        map_row.map_to_alignment(i));
+            BOOST_CHECK(row.nearest_in_fragment(i) ==
+                        map_row.nearest_in_fragment(i));
+        }
+        if (L == 0) {
+            continue;
+        }
+        std::vector<pos_t> positions(L);
+        row.map_range(&positions[0], 0, L - 1);
+        for (int i = 0; i < L; i++) {
+            BOOST_CHECK(positions[i] == map_row.map_to_fragment(i));
+        }
+        int start = rand() % L, stop = rand() % L;
+        boost::scoped_ptr<AlignmentRow> s1(row.slice(start, stop));
+        boost::scoped_ptr<AlignmentRow> s2(map_row.slice(start, stop));
+        BOOST_REQUIRE(s1->type() == GAPS_ROW);
+        BOOST_REQUIRE(s1->length() == s2->length());
+        for (int i = -1; i <= s1->length(); i++) {
+            BOOST_CHECK(s1->map_to_fragment(i) == s2->map_to_fragment(i));
+            BOOST_CHECK(s1->map_to_alignment(i) == s2->map_to_alignment(i));
+        }
+    }
+}
@@ -0,0 +1,234 @@
+/*
+ * NPG-explorer, Nucleotide PanGenome explorer
+ * Copyright (C) 2012-2016 Boris Nagaev
+ *
+ * See the LICENSE file for terms of use.
+ */
+
+#include <sstream>
+#include <algorithm>
+#include <boost/test/unit_test.hpp>
+#include <boost/foreach.hpp>
+#include <boost/functional/hash.hpp>
+
+#include "BlastCache.hpp"
+
+using namespace npge;
+
+static void add_record(BlastRecords& records, const std::string& name,
+                       const std::string& seq) {
+    BlastRecord record;
+    record.name = name;
+    record.text = ">" + name + "\n" + seq + "\n";
+    record.length = seq.size();
+    record.index = records.size();
+    record.hash = boost::hash_value(seq);
+    records.push_back(record);
+}
+
+static Strings names_of(const BlastRecordPtrs& records) {
+    Strings result;
+    BOOST_FOREACH (const BlastRecord* record, records) {
+        result.push_back(record->name);
+    }
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+static std::string hit(const std::string& query,
+                       const std::string& subject,
+                       const std::string& coords) {
+    return query + "\t" + subject + "\t100.00\t10\t0\t0\t" + coords +
+           "\t1e-5\t20.0";
+}
+
+static Strings filter(const BlastCache& cache, const std::string& line) {
+    Strings result;
+    std::string copy = line, reversed;
+    if (cache.filter_line(copy, reversed)) {
+        result.push_back(copy);
+    }
+    if (!reversed.empty()) {
+        result.push_back(reversed);
+    }
+    return result;
+}
+
+static void add_hits(BlastCache& cache, const Strings& lines) {
+    BOOST_FOREACH (const std::string& line, lines) {
+        cache.add_hit(line);
+    }
+}
+
+static Strings sorted_cached_hits(BlastCache& cache) {
+    Strings result;
+    cache.cached_hits(result);
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+BOOST_AUTO_TEST_CASE (BlastCache_acquire) {
+    BlastCache cache;
+    BOOST_CHECK(cache.acquire());
+    BOOST_CHECK(!cache.acquire());
+    cache.release();
+    BOOST_CHECK(cache.acquire());
+    cache.release();
+}
+
+BOOST_AUTO_TEST_CASE (BlastCache_volumes) {
+    BlastCache cache;
+    cache.set_keep_files(true);
+    BlastRecords records;
+    add_record(records, "a", "ACGTACGTAC");
+    add_record(records, "b", "TTTTACGTAC");
+    BlastRecordPtrs fresh;
+    cache.update(records, "s", fresh);
+    BOOST_REQUIRE(fresh.size() == 2);
+    std::stringstream fasta;
+    cache.add_volume("bank1", fresh, fasta);
+    BOOST_CHECK(fasta.str() == ">v1_a\nACGTACGTAC\n"
+                ">v1_b\nTTTTACGTAC\n");
+    BOOST_CHECK(cache.banks() == Strings(1, "bank1"));
+    // subjects of new volume are new: hits are not reversed
+    Strings ab = filter(cache, hit("a", "v1_b", "1\t10\t1\t10"));
+    BOOST_REQUIRE(ab.size() == 1);
+    BOOST_CHECK(ab[0] == hit("a", "b", "1\t10\t1\t10"));
+    // lines not from cache volumes are passed as is
+    BOOST_CHECK(filter(cache, hit("a", "b", "1\t10\t1\t10")) ==
+                Strings(1, hit("a", "b", "1\t10\t1\t10")));
+    BOOST_CHECK(filter(cache, "a\tv1_b\t100") ==
+                Strings(1, "a\tv1_b\t100"));
+    BOOST_CHECK(filter(cache, hit("a", "vx_b", "1\t10\t1\t10")) ==
+                Strings(1, hit("a", "vx_b", "1\t10\t1\t10")));
+    Strings ba = filter(cache, hit("b", "v1_a", "1\t10\t1\t10"));
+    add_hits(cache, ab);
+    add_hits(cache, ba);
+    BOOST_CHECK(cache.hits() == 2);
+    Strings cached;
+    cache.cached_hits(cached);
+    BOOST_CHECK(cached.empty());
+    // same sequences: volume is reused, nothing is searched
+    fresh.clear();
+    cache.update(records, "s", fresh);
+    BOOST_CHECK(fresh.empty());
+    BOOST_CHECK(cache.banks() == Strings(1, "bank1"));
+    Strings expected;
+    expected.push_back(hit("a", "b", "1\t10\t1\t10"));
+    expected.push_back(hit("b", "a", "1\t10\t1\t10"));
+    BOOST_CHECK(sorted_cached_hits(cache) == expected);
+    // other settings: cache is cleared
+    fresh.clear();
+    cache.update(records, "s2", fresh);
+    BOOST_CHECK(fresh.size() == 2);
+    BOOST_CHECK(cache.banks().empty());
+    BOOST_CHECK(cache.hits() == 0);
+}
+
+BOOST_AUTO_TEST_CASE (BlastCache_delta_volume) {
+    BlastCache cache;
+    cache.set_keep_files(true);
+    BlastRecords records;
+    add_record(records, "a", "ACGTACGTAC");
+    add_record(records, "b", "TTTTACGTAC");
+    BlastRecordPtrs fresh;
+    cache.update(records, "s", fresh);
+    std::stringstream fasta1;
+    cache.add_volume("bank1", fresh, fasta1);
+    add_hits(cache, filter(cache, hit("a", "v1_b", "1\t10\t1\t10")));
+    add_hits(cache, filter(cache, hit("b", "v1_a", "1\t10\t1\t10")));
+    // new sequence c goes to new volume
+    add_record(records, "c", "GGGGACGTAC");
+    fresh.clear();
+    cache.update(records, "s", fresh);
+    BOOST_CHECK(names_of(fresh) == Strings(1, "c"));
+    std::stringstream fasta2;
+    cache.add_volume("bank2", fresh, fasta2);
+    BOOST_CHECK(fasta2.str() == ">v2_c\nGGGGACGTAC\n");
+    Strings banks;
+    banks.push_back("bank1");
+    banks.push_back("bank2");
+    BOOST_CHECK(cache.banks() == banks);
+    // hit of new query against old subject is added in reverse
+    Strings ca = filter(cache, hit("c", "v1_a", "2\t9\t9\t2"));
+    BOOST_REQUIRE(ca.size() == 2);
+    BOOST_CHECK(ca[0] == hit("c", "a", "2\t9\t9\t2"));
+    BOOST_CHECK(ca[1] == hit("a", "c", "2\t9\t9\t2"));
+    Strings cc = filter(cache, hit("c", "v2_c", "1\t10\t1\t10"));
+    BOOST_CHECK(cc.size() == 1);
+    add_hits(cache, ca);
+    add_hits(cache, cc);
+    // next run takes all hits from the cache
+    fresh.clear();
+    cache.update(records, "s", fresh);
+    BOOST_CHECK(fresh.empty());
+    Strings cached = sorted_cached_hits(cache);
+    BOOST_CHECK(cached.size() == 5);
+    BOOST_CHECK(std::count(cached.begin(), cached.end(),
+                           hit("a", "c", "2\t9\t9\t2")) == 1);
+}
+
+BOOST_AUTO_TEST_CASE (BlastCache_outdated) {
+    BlastCache cache;
+    cache.set_keep_files(true);
+    BlastRecords records;
+    add_record(records, "a", "ACGTACGTAC");
+    add_record(records, "b", "TTTTACGTAC");
+    add_record(records, "c", "GGGGACGTAC");
+    BlastRecordPtrs fresh;
+    cache.update(records, "s", fresh);
+    std::stringstream fasta1;
+    cache.add_volume("bank1", fresh, fasta1);
+    add_hits(cache, filter(cache, hit("a", "v1_b", "1\t10\t1\t10")));
+    add_hits(cache, filter(cache, hit("a", "v1_c", "1\t10\t1\t10")));
+    add_hits(cache, filter(cache, hit("b", "v1_c", "1\t10\t1\t10")));
+    // contents of b changed
+    records[1].hash += 1;
+    fresh.clear();
+    cache.update(records, "s", fresh);
+    BOOST_CHECK(names_of(fresh) == Strings(1, "b"));
+    std::stringstream fasta2;
+    cache.add_volume("bank2", fresh, fasta2);
+    // hits with outdated b are dropped
+    BOOST_CHECK(filter(cache, hit("b", "v1_b", "1\t10\t1\t10")).empty());
+    BOOST_CHECK(filter(cache, hit("b", "v2_b",
+                                  "1\t10\t1\t10")).size() == 1);
+    Strings expected(1, hit("a", "c", "1\t10\t1\t10"));
+    BOOST_CHECK(sorted_cached_hits(cache) == expected);
+    // when less than a half of volume is alive, it is removed
+    records.erase(records.begin());
+    records.erase(records.begin() + 1);
+    fresh.clear();
+    cache.update(records, "s", fresh);
+    BOOST_CHECK(fresh.empty());
+    BOOST_CHECK(cache.banks() == Strings(1, "bank2"));
+    BOOST_CHECK(sorted_cached_hits(cache).empty());
+}
+
+BOOST_AUTO_TEST_CASE (BlastCache_trim) {
+    BlastCache cache;
+    cache.set_keep_files(true);
+    cache.set_max_hits(2);
+    BlastRecords records;
+    add_record(records, "a", "ACGTACGTAC");
+    add_record(records, "b", "TTTTACGTAC");
+    add_record(records, "c", "GGGGACGTAC");
+    BlastRecordPtrs fresh;
+    cache.update(records, "s", fresh);
+    std::stringstream fasta;
+    cache.add_volume("bank1", fresh, fasta);
+    add_hits(cache, filter(cache, hit("a", "v1_b", "1\t10\t1\t10")));
+    add_hits(cache, filter(cache, hit("a", "v1_c", "1\t10\t1\t10")));
+    add_hits(cache, filter(cache, hit("b", "v1_c", "1\t10\t1\t10")));
+    BOOST_CHECK(cache.hits() == 3);
+    cache.trim();
+    BOOST_CHECK(cache.hits() == 1);
+    // dropped sequence is searched again
+    fresh.clear();
+    cache.update(records, "s", fresh);
+    BOOST_CHECK(names_of(fresh) == Strings(1, "a"));
+    BOOST_CHECK(cache.banks() == Strings(1, "bank1"));
+    Strings expected(1, hit("b", "c", "1\t10\t1\t10"));
+    BOOST_CHECK(sorted_cached_hits(cache) == expected);
+}
+
@@ -623,5 +623,28 @@ BOOST_AUTO_TEST_CASE (Block_hash) {
     boost::scoped_ptr<Block> b2((b1->clone()));
     b2->inverse();
     BOOST_CHECK(block_hash(b1.get()) == block_hash(b2.get()));
+    // order of fragments does not matter
+    boost::scoped_ptr<Block> b3((new Block));
+    b3->insert(new Fragment(s1, 4, 5, -1));
+    b3->insert(new Fragment(s1, 0, 4));
+    BOOST_CHECK(block_hash(b1.get()) == block_hash(b3.get()));
+    // ori of one fragment matters
+    boost::scoped_ptr<Block> b4((new Block));
+    b4->insert(new Fragment(s1, 0, 4));
+    b4->insert(new Fragment(s1, 4, 5, 1));
+    BOOST_CHECK(block_hash(b1.get()) != block_hash(b4.get()));
+    // positions matter
+    boost::scoped_ptr<Block> b5((new Block));
+    b5->insert(new Fragment(s1, 0, 3));
+    b5->insert(new Fragment(s1, 4, 5, -1));
+    BOOST_CHECK(block_hash(b1.get()) != block_hash(b5.get()));
+    // name of sequence matters, not its address
+    SequencePtr s2 = boost::make_shared<InMemorySequence>("GaGaGaGaG");
+    boost::scoped_ptr<Block> b6((new Block));
+    b6->insert(new Fragment(s2, 0, 4));
+    b6->insert(new Fragment(s2, 4, 5, -1));
+    BOOST_CHECK(block_hash(b1.get()) == block_hash(b6.get()));
+    s2->set_name("other");
+    BOOST_CHECK(block_hash(b1.get()) != block_hash(b6.get()));
 }
 
@@ -0,0 +1,134 @@
+/*
+ * NPG-explorer, Nucleotide PanGenome explorer
+ * Copyright (C) 2012-2016 Boris Nagaev
+ *
+ * See the LICENSE file for terms of use.
+ */
+
+#include <boost/test/unit_test.hpp>
+
+#include "BlockMatrix.hpp"
+#include "Sequence.hpp"
+#include "Fragment.hpp"
+#include "AlignmentRow.hpp"
+#include "Block.hpp"
+#include "block_stat.hpp"
+#include "column_kernels.hpp"
+#include "char_to_size.hpp"
+
+using namespace npge;
+
+BOOST_AUTO_TEST_CASE (BlockMatrix_main) {
+    SequencePtr s1 = boost::make_shared<InMemorySequence>("TAGTCCGA");
+    SequencePtr s2 = boost::make_shared<InMemorySequence>("ACGTTGTA");
+    SequencePtr s3 = boost::make_shared<InMemorySequence>("TGCGA");
+    Block b;
+    Fragment* f1 = new Fragment(s1, 0, 6);
+    new CompactAlignmentRow("TAGTCCG-", f1);
+    b.insert(f1);
+    Fragment* f2 = new Fragment(s2, 1, 6, -1);
+    new MapAlignmentRow("ACAA-CG-", f2);
+    b.insert(f2);
+    Fragment* f3 = new Fragment(s3, 0, 3);
+    new MapAlignmentRow("TG---CG", f3);
+    b.insert(f3);
+    BlockMatrix matrix(&b);
+    BOOST_REQUIRE(matrix.rows() == 3);
+    BOOST_REQUIRE(matrix.columns() == 8);
+    for (int row = 0; row < matrix.rows(); row++) {
+        const Fragment* f = matrix.fragments()[row];
+        for (int col = 0; col < matrix.columns(); col++) {
+            BOOST_CHECK(matrix.at(row, col) == f->alignment_at(col));
+            BOOST_CHECK(matrix.row(row)[col] == matrix.at(row, col));
+        }
+    }
+    std::vector<unsigned char> flags;
+    matrix.classify_columns(flags);
+    std::string cons;
+    int atgc[LETTERS_NUMBER] = {0};
+    matrix.count_columns(&cons, atgc);
+    int atgc1[LETTERS_NUMBER] = {0};
+    for (int col = 0; col < matrix.columns(); col++) {
+        bool ident, gap, pure_gap;
+        test_column(&b, col, ident, gap, pure_gap, atgc1);
+        BOOST_CHECK(bool(flags[col] & IDENT_COLUMN) == ident);
+        BOOST_CHECK(bool(flags[col] & GAP_COLUMN) == gap);
+        BOOST_CHECK(bool(flags[col] & PURE_GAP_COLUMN) == pure_gap);
+        BOOST_CHECK(cons[col] == b.consensus_char(col));
+    }
+    for (int i = 0; i < LETTERS_NUMBER; i++) {
+        BOOST_CHECK(atgc[i] == atgc1[i]);
+    }
+    BlockMatrix part(&b, 2, 5);
+    BOOST_REQUIRE(part.columns() == 4);
+    for (int row = 0; row < part.rows(); row++) {
+        const Fragment* f = part.fragments()[row];
+        for (int col = 0; col < part.columns(); col++) {
+            BOOST_CHECK(part.at(row, col) == f->alignment_at(col + 2));
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE (BlockMatrix_no_rows) {
+    SequencePtr s1 = boost::make_shared<InMemorySequence>("TAGTCCGA");
+    Block b;
+    b.insert(new Fragment(s1, 0, 5));
+    b.insert(new Fragment(s1, 3, 7, -1));
+    BlockMatrix matrix(&b);
+    BOOST_REQUIRE(matrix.columns() == 6);
+    for (int row = 0; row < matrix.rows(); row++) {
+        const Fragment* f = matrix.fragments()[row];
+        for (int col = 0; col < matrix.columns(); col++) {
+            BOOST_CHECK(matrix.at(row, col) == f->alignment_at(col));
+        }
+    }
+    Block empty;
+    BlockMatrix empty_matrix(&empty);
+    BOOST_CHECK(empty_matrix.rows() == 0);
+    BOOST_CHECK(empty_matrix.columns() == 0);
+}
+
+BOOST_AUTO_TEST_CASE (BlockMatrix_windows) {
+    const int length = 2 * BLOCK_MATRIX_WINDOW + 100;
+    std::string text1, text2;
+    for (int i = 0; i < length; i++) {
+        text1 += "ATGC"[(i * 7 + i / 5) % 4];
+        text2 += (i % 11 == 0) ? 'A' : text1[i];
+    }
+    SequencePtr s1 = boost::make_shared<InMemorySequence>(text1);
+    SequencePtr s2 = boost::make_shared<InMemorySequence>(text2);
+    Block b;
+    Fragment* f1 = new Fragment(s1, 0, length - 1);
+    new CompactAlignmentRow(text1, f1);
+    b.insert(f1);
+    // gap at the end of first window
+    std::string row2 = text2.substr(0, length - 1);
+    row2.insert(BLOCK_MATRIX_WINDOW - 1, "-");
+    Fragment* f2 = new Fragment(s2, 0, length - 2);
+    new CompactAlignmentRow(row2, f2);
+    b.insert(f2);
+    BOOST_REQUIRE(b.alignment_length() == length);
+    AlignmentStat stat;
+    make_stat(stat, &b);
+    int ident_nogap = 0, ident_gap = 0, noident_nogap = 0;
+    int atgc[LETTERS_NUMBER] = {0};
+    std::string cons = b.consensus_string();
+    BOOST_REQUIRE(int(cons.size()) == length);
+    for (int col = 0; col < length; col++) {
+        bool ident, gap, pure_gap;
+        test_column(&b, col, ident, gap, pure_gap, atgc);
+        ident_nogap += ident && !gap;
+        ident_gap += ident && gap;
+        noident_nogap += !ident && !gap;
+        BOOST_REQUIRE(cons[col] == b.consensus_char(col));
+    }
+    BOOST_CHECK(stat.total() == length);
+    BOOST_CHECK(stat.ident_nogap() == ident_nogap);
+    BOOST_CHECK(stat.ident_gap() == ident_gap);
+    BOOST_CHECK(stat.ident_gap() == 1);
+    BOOST_CHECK(stat.noident_nogap() == noident_nogap);
+    BOOST_CHECK(stat.noident_gap() == 0);
+    for (int i = 0; i < LETTERS_NUMBER; i++) {
+        BOOST_CHECK(stat.letter_count(size_to_char(i)) == atgc[i]);
+    }
+}
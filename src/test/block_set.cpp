@@ -7,6 +7,7 @@
 
 #include <boost/test/unit_test.hpp>
 #include <boost/foreach.hpp>
+#include <boost/lexical_cast.hpp>
 
 #include "Sequence.hpp"
 #include "Fragment.hpp"
@@ -62,3 +63,148 @@ BOOST_AUTO_TEST_CASE (BlockSet_filter) {
     BOOST_CHECK(block_set->size() == 1);
 }
 
+
+BOOST_AUTO_TEST_CASE (BlockSet_erase_find) {
+    using namespace npge;
+    BlockSetPtr block_set = new_bs();
+    std::vector<Block*> blocks;
+    for (int i = 0; i < 5; i++) {
+        Block* b = new Block();
+        b->set_random_name();
+        blocks.push_back(b);
+        block_set->insert(b);
+    }
+    BOOST_CHECK(block_set->size() == 5);
+    BOOST_CHECK(block_set->front() == blocks[0]);
+    BOOST_CHECK(block_set->find_block(blocks[3]->name()) == blocks[3]);
+    // erase blocks while iterating
+    BOOST_FOREACH (Block* b, *block_set) {
+        if (b == blocks[1] || b == blocks[4]) {
+            block_set->erase(b);
+        }
+    }
+    BOOST_CHECK(block_set->size() == 3);
+    BOOST_CHECK(!block_set->has(blocks[1]));
+    BOOST_CHECK(block_set->has(blocks[2]));
+    std::vector<Block*> rest(block_set->begin(), block_set->end());
+    BOOST_REQUIRE(rest.size() == 3);
+    BOOST_CHECK(rest[0] == blocks[0]);
+    BOOST_CHECK(rest[1] == blocks[2]);
+    BOOST_CHECK(rest[2] == blocks[3]);
+    BOOST_CHECK(block_set->find_block(blocks[3]->name()) == blocks[3]);
+    blocks[3]->set_name("renamed");
+    BOOST_CHECK(block_set->find_block("renamed") == blocks[3]);
+    block_set->detach(blocks[0]);
+    BOOST_CHECK(block_set->front() == blocks[2]);
+    delete blocks[0];
+    Block* b = new Block("new");
+    block_set->insert(b);
+    BOOST_CHECK(block_set->find_block("new") == b);
+    BOOST_CHECK(block_set->size() == 3);
+}
+
+BOOST_AUTO_TEST_CASE (BlockSet_compact) {
+    using namespace npge;
+    BlockSetPtr block_set = new_bs();
+    std::vector<Block*> blocks;
+    for (int i = 0; i < 100; i++) {
+        Block* b = new Block(boost::lexical_cast<std::string>(i));
+        blocks.push_back(b);
+        block_set->insert(b);
+    }
+    // erase while iterating: slots are not compacted
+    int seen = 0;
+    BOOST_FOREACH (Block* b, *block_set) {
+        seen += 1;
+        if (b != blocks[50] && b != blocks[70]) {
+            block_set->erase(b);
+        }
+    }
+    BOOST_CHECK(seen == 100);
+    BOOST_CHECK(block_set->size() == 2);
+    BOOST_CHECK(block_set->front() == blocks[50]);
+    // compacted by insert, order is kept
+    Block* b = new Block("new");
+    block_set->insert(b);
+    std::vector<Block*> rest(block_set->begin(), block_set->end());
+    BOOST_REQUIRE(rest.size() == 3);
+    BOOST_CHECK(rest[0] == blocks[50]);
+    BOOST_CHECK(rest[1] == blocks[70]);
+    BOOST_CHECK(rest[2] == b);
+    BOOST_CHECK(block_set->has(blocks[70]));
+    block_set->erase(blocks[50]);
+    BOOST_CHECK(block_set->front() == blocks[70]);
+    BOOST_CHECK(block_set->find_block("70") == blocks[70]);
+    BOOST_CHECK(block_set->find_block("new") == b);
+}
+
+BOOST_AUTO_TEST_CASE (BlockSet_rename_find) {
+    using namespace npge;
+    BlockSetPtr block_set = new_bs();
+    BlockSetPtr other = new_bs();
+    Block* a = new Block("a");
+    Block* b = new Block("b");
+    Block* c = new Block("c");
+    block_set->insert(a);
+    block_set->insert(b);
+    other->insert(c);
+    BOOST_CHECK(block_set->find_block("a") == a);
+    BOOST_CHECK(other->find_block("c") == c);
+    a->set_name("a1");
+    BOOST_CHECK(block_set->find_block("a") == 0);
+    BOOST_CHECK(block_set->find_block("a1") == a);
+    a->swap(*b);
+    BOOST_CHECK(block_set->find_block("b") == a);
+    BOOST_CHECK(block_set->find_block("a1") == b);
+    b->swap(*c);
+    BOOST_CHECK(block_set->find_block("c") == b);
+    BOOST_CHECK(block_set->find_block("a1") == 0);
+    BOOST_CHECK(other->find_block("a1") == c);
+    // renamed while moved to other blockset
+    block_set->detach(a);
+    other->insert(a);
+    a->set_name("moved");
+    BOOST_CHECK(block_set->find_block("moved") == 0);
+    BOOST_CHECK(block_set->find_block("b") == 0);
+    BOOST_CHECK(other->find_block("moved") == a);
+    other->swap(*block_set);
+    a->set_name("swapped");
+    BOOST_CHECK(block_set->find_block("swapped") == a);
+    BOOST_CHECK(other->find_block("c") == b);
+}
+
+BOOST_AUTO_TEST_CASE (BlockSet_rename_find_shared) {
+    using namespace npge;
+    BlockSetPtr block_set = new_bs();
+    BlockSetPtr other = new_bs();
+    Block* a = new Block("a");
+    block_set->insert(a);
+    BOOST_CHECK(block_set->find_block("a") == a);
+    // temporary blockset, as in Processor::apply_to_block
+    {
+        BlockSetPtr tmp = new_bs();
+        tmp->insert(a);
+        BOOST_CHECK(tmp->find_block("a") == a);
+        a->set_name("t");
+        BOOST_CHECK(tmp->find_block("t") == a);
+        tmp->detach(a);
+    }
+    BOOST_CHECK(block_set->find_block("a") == 0);
+    BOOST_CHECK(block_set->find_block("t") == a);
+    a->set_name("a");
+    // the block in two blocksets
+    other->insert(a);
+    BOOST_CHECK(other->find_block("a") == a);
+    a->set_name("both");
+    BOOST_CHECK(block_set->find_block("both") == a);
+    BOOST_CHECK(other->find_block("both") == a);
+    block_set->swap(*other);
+    a->set_name("swapped");
+    BOOST_CHECK(block_set->find_block("swapped") == a);
+    BOOST_CHECK(other->find_block("swapped") == a);
+    block_set->detach(a);
+    a->set_name("other");
+    BOOST_CHECK(block_set->find_block("other") == 0);
+    BOOST_CHECK(other->find_block("other") == a);
+    BOOST_CHECK(other->find_block("swapped") == 0);
+}
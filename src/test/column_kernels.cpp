@@ -0,0 +1,139 @@
+/*
+ * NPG-explorer, Nucleotide PanGenome explorer
+ * Copyright (C) 2012-2016 Boris Nagaev
+ *
+ * See the LICENSE file for terms of use.
+ */
+
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <boost/test/unit_test.hpp>
+
+#include "column_kernels.hpp"
+#include "char_to_size.hpp"
+
+using namespace npge;
+
+static void check_kernels(const std::vector<std::string>& rows,
+                          int length, char gap) {
+    int nrows = rows.size();
+    std::vector<const char*> crows(nrows);
+    for (int i = 0; i < nrows; i++) {
+        crows[i] = rows[i].c_str();
+    }
+    const char* const* r = nrows ? &crows[0] : 0;
+    // expected values
+    std::vector<unsigned char> flags0(length);
+    std::string cons0(length, ' ');
+    int atgc0[LETTERS_NUMBER] = {0};
+    for (int col = 0; col < length; col++) {
+        int count[LETTERS_NUMBER] = {0};
+        int letters = 0;
+        bool has_gap = false;
+        for (int i = 0; i < nrows; i++) {
+            char c = rows[i][col];
+            if (c == gap) {
+                has_gap = true;
+            } else {
+                int l = char_to_size(c);
+                if (count[l] == 0) {
+                    letters += 1;
+                }
+                count[l] += 1;
+                atgc0[l] += 1;
+            }
+        }
+        int f = 0;
+        f |= (letters <= 1) ? IDENT_COLUMN : 0;
+        f |= has_gap ? GAP_COLUMN : 0;
+        f |= (letters == 0) ? PURE_GAP_COLUMN : 0;
+        f |= count[char_to_size('N')] ? N_COLUMN : 0;
+        flags0[col] = f;
+        int best = 0;
+        for (int l = 1; l < LETTERS_NUMBER; l++) {
+            if (count[l] > count[best]) {
+                best = l;
+            }
+        }
+        cons0[col] = size_to_char(best);
+    }
+    const char* isas[] = {"scalar", "sse2", "avx2"};
+    std::string orig_isa = column_kernels_isa();
+    for (int k = 0; k < 3; k++) {
+        if (!set_column_kernels_isa(isas[k])) {
+            continue;
+        }
+        std::vector<unsigned char> flags(length);
+        std::string cons(length, ' ');
+        int atgc[LETTERS_NUMBER] = {0};
+        if (length) {
+            classify_columns(&flags[0], r, nrows, length, gap);
+            count_columns(&cons[0], atgc, r, nrows, length, gap);
+        }
+        BOOST_CHECK_MESSAGE(flags == flags0, isas[k]);
+        BOOST_CHECK_MESSAGE(cons == cons0, isas[k]);
+        for (int l = 0; l < LETTERS_NUMBER; l++) {
+            BOOST_CHECK_MESSAGE(atgc[l] == atgc0[l], isas[k]);
+        }
+    }
+    BOOST_REQUIRE(set_column_kernels_isa(orig_isa));
+}
+
+static std::vector<std::string> rand_rows(int nrows, int length,
+        const std::string& alphabet, int mutation_percent) {
+    std::string base(length, ' ');
+    for (int col = 0; col < length; col++) {
+        base[col] = alphabet[rand() % alphabet.size()];
+    }
+    std::vector<std::string> rows(nrows, base);
+    for (int i = 0; i < nrows; i++) {
+        for (int col = 0; col < length; col++) {
+            if (rand() % 100 < mutation_percent) {
+                rows[i][col] = alphabet[rand() % alphabet.size()];
+            }
+        }
+    }
+    return rows;
+}
+
+BOOST_AUTO_TEST_CASE (column_kernels_main) {
+    std::vector<std::string> rows;
+    rows.push_back("AAAT-NA-");
+    rows.push_back("AACT-AA-");
+    rows.push_back("AAG--TA-");
+    check_kernels(rows, 8, '-');
+    std::vector<unsigned char> flags(8);
+    std::vector<const char*> crows;
+    for (int i = 0; i < rows.size(); i++) {
+        crows.push_back(rows[i].c_str());
+    }
+    classify_columns(&flags[0], &crows[0], 3, 8, '-');
+    BOOST_CHECK(flags[0] == IDENT_COLUMN);
+    BOOST_CHECK(flags[2] == 0);
+    BOOST_CHECK(flags[3] == (IDENT_COLUMN | GAP_COLUMN));
+    BOOST_CHECK(flags[4] == (IDENT_COLUMN | GAP_COLUMN |
+                             PURE_GAP_COLUMN));
+    BOOST_CHECK(flags[5] == N_COLUMN);
+    std::string cons(8, ' ');
+    count_columns(&cons[0], 0, &crows[0], 3, 8, '-');
+    BOOST_CHECK(cons == "AAATAAAA");
+}
+
+BOOST_AUTO_TEST_CASE (column_kernels_random) {
+    int lengths[] = {1, 15, 16, 17, 31, 32, 33, 100};
+    int nrows[] = {0, 1, 2, 5, 300};
+    for (int i = 0; i < 8; i++) {
+        for (int j = 0; j < 5; j++) {
+            check_kernels(rand_rows(nrows[j], lengths[i], "ATGCN-", 30),
+                          lengths[i], '-');
+            check_kernels(rand_rows(nrows[j], lengths[i], "ATGC-", 2),
+                          lengths[i], '-');
+            std::string zero_gap("ATGC");
+            zero_gap += '\0';
+            check_kernels(rand_rows(nrows[j], lengths[i], zero_gap, 10),
+                          lengths[i], '\0');
+        }
+    }
+}
+
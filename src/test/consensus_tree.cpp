@@ -0,0 +1,164 @@
+/*
+ * NPG-explorer, Nucleotide PanGenome explorer
+ * Copyright (C) 2012-2016 Boris Nagaev
+ *
+ * See the LICENSE file for terms of use.
+ */
+
+#include <cstdlib>
+#include <set>
+#include <string>
+#include <vector>
+#include <boost/foreach.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include "ConsensusTree.hpp"
+#include "Sequence.hpp"
+#include "Fragment.hpp"
+#include "AlignmentRow.hpp"
+#include "Block.hpp"
+#include "BlockSet.hpp"
+#include "block_stat.hpp"
+#include "tree.hpp"
+
+using namespace npge;
+
+class NamedLeaf : public LeafNode {
+public:
+    NamedLeaf(const std::string& name):
+        name_(name) {
+    }
+
+    double distance_to_impl(const LeafNode* /* leaf */) const {
+        return -1.0;
+    }
+
+    std::string name_impl() const {
+        return name_;
+    }
+
+    TreeNode* clone_impl() const {
+        return new NamedLeaf(name_);
+    }
+
+private:
+    std::string name_;
+};
+
+static Fragment* make_fragment(SequencePtr seq, pos_t start,
+                               const std::string& row) {
+    int length = 0;
+    BOOST_FOREACH (char c, row) {
+        length += (c != '-');
+    }
+    Fragment* f = new Fragment(seq, start, start + length - 1);
+    new CompactAlignmentRow(row, f);
+    return f;
+}
+
+BOOST_AUTO_TEST_CASE (ConsensusTree_add_diagnostic) {
+    const int GENOMES = 6, BLOCKS = 5, LENGTH = 70;
+    BlockSetPtr bs = new_bs();
+    std::vector<SequencePtr> seqs;
+    std::vector<std::vector<std::string> > rows(BLOCKS);
+    for (int b = 0; b < BLOCKS; b++) {
+        std::string base;
+        for (int i = 0; i < LENGTH; i++) {
+            base += "ATGC"[rand() % 4];
+        }
+        for (int g = 0; g < GENOMES; g++) {
+            std::string row = base;
+            for (int i = 0; i < LENGTH; i++) {
+                if (rand() % 100 < 20) {
+                    row[i] = "ATGCN-"[rand() % 6];
+                }
+            }
+            row[0] = base[0]; // no empty fragments
+            rows[b].push_back(row);
+        }
+    }
+    for (int g = 0; g < GENOMES; g++) {
+        std::string text;
+        for (int b = 0; b < BLOCKS; b++) {
+            BOOST_FOREACH (char c, rows[b][g]) {
+                if (c != '-') {
+                    text += c;
+                }
+            }
+        }
+        if (g == 0) {
+            // second fragment of genome 0 in the last block
+            BOOST_FOREACH (char c, rows[BLOCKS - 1][5]) {
+                if (c != '-') {
+                    text += c;
+                }
+            }
+        }
+        SequencePtr seq(new InMemorySequence(text));
+        seq->set_name("g" + boost::lexical_cast<std::string>(g) + "&c&c");
+        bs->add_sequence(seq);
+        seqs.push_back(seq);
+    }
+    std::vector<pos_t> pos(GENOMES, 0);
+    for (int b = 0; b < BLOCKS; b++) {
+        Block* block = new Block;
+        // last block has no genome 5 and two fragments of genome 0
+        int genomes = (b == BLOCKS - 1) ? GENOMES - 1 : GENOMES;
+        for (int g = 0; g < genomes; g++) {
+            Fragment* f = make_fragment(seqs[g], pos[g], rows[b][g]);
+            pos[g] = f->max_pos() + 1;
+            block->insert(f);
+        }
+        if (b == BLOCKS - 1) {
+            block->insert(make_fragment(seqs[0], pos[0], rows[b][5]));
+        }
+        bs->insert(block);
+    }
+    // ((g0, g1), (g2, (g3, g4)), g5)
+    TreeNode tree;
+    TreeNode* n01 = new TreeNode;
+    tree.add_child(n01);
+    n01->add_child(new NamedLeaf("g0"));
+    n01->add_child(new NamedLeaf("g1"));
+    TreeNode* n234 = new TreeNode;
+    tree.add_child(n234);
+    n234->add_child(new NamedLeaf("g2"));
+    TreeNode* n34 = new TreeNode;
+    n234->add_child(n34);
+    n34->add_child(new NamedLeaf("g3"));
+    n34->add_child(new NamedLeaf("g4"));
+    tree.add_child(new NamedLeaf("g5"));
+    for (int workers = 1; workers <= 2; workers++) {
+        add_diagnostic(&tree, bs, 4, workers);
+        Nodes nodes;
+        tree.all_descendants(nodes);
+        BOOST_FOREACH (TreeNode* node, nodes) {
+            Leafs leafs;
+            node->all_leafs_and_this(leafs);
+            std::set<std::string> genomes;
+            BOOST_FOREACH (LeafNode* leaf, leafs) {
+                genomes.insert(leaf->name());
+            }
+            int expected = 0;
+            BOOST_FOREACH (Block* block, *bs) {
+                Fragments clade, other;
+                BOOST_FOREACH (Fragment* f, *block) {
+                    if (genomes.count(f->seq()->genome())) {
+                        clade.push_back(f);
+                    } else {
+                        other.push_back(f);
+                    }
+                }
+                if (clade.empty() || other.empty()) {
+                    continue;
+                }
+                for (int col = 0; col < block->alignment_length(); col++) {
+                    expected += is_diagnostic(col, clade, other);
+                }
+            }
+            BOOST_CHECK_EQUAL(node->bootstrap(), expected);
+        }
+    }
+}
+
@@ -0,0 +1,172 @@
+/*
+ * NPG-explorer, Nucleotide PanGenome explorer
+ * Copyright (C) 2012-2016 Boris Nagaev
+ *
+ * See the LICENSE file for terms of use.
+ */
+
+#include <cstdlib>
+#include <set>
+#include <boost/test/unit_test.hpp>
+
+#include "CoverageIndex.hpp"
+#include "FragmentCollection.hpp"
+#include "Processor.hpp"
+#include "Sequence.hpp"
+#include "Fragment.hpp"
+#include "Block.hpp"
+#include "BlockSet.hpp"
+
+BOOST_AUTO_TEST_CASE (CoverageIndex_main) {
+    using namespace npge;
+    SequencePtr s1 = boost::make_shared<InMemorySequence>("tGGtccgagcgGAcggcc");
+    SequencePtr s2 = boost::make_shared<InMemorySequence>("tGGtccgagcggacggcc");
+    BlockSet bs;
+    Block* b1 = new Block;
+    b1->insert(new Fragment(s1, 1, 10));
+    b1->insert(new Fragment(s2, 1, 2));
+    Block* b2 = new Block;
+    Fragment* f21 = new Fragment(s1, 3, 4);
+    b2->insert(f21);
+    b2->insert(new Fragment(s1, 12, 13));
+    bs.insert(b1);
+    bs.insert(b2);
+    CoverageIndex index;
+    index.build(bs, /* workers */ 2);
+    BOOST_CHECK(index.has_seq(s1.get()));
+    BOOST_CHECK(index.has_seq(s2.get()));
+    PosRanges gaps;
+    index.gaps(gaps, s1.get());
+    BOOST_REQUIRE(gaps.size() == 3);
+    BOOST_CHECK(gaps[0] == PosRange(0, 0));
+    BOOST_CHECK(gaps[1] == PosRange(11, 11));
+    BOOST_CHECK(gaps[2] == PosRange(14, 17));
+    Fragment f(s1, 8, 11);
+    BOOST_CHECK(index.has_overlap(&f));
+    Fragment g(s1, 11, 11);
+    BOOST_CHECK(!index.has_overlap(&g));
+    Fragments overlaps;
+    Fragment h(s1, 4, 12);
+    index.find_overlap_fragments(overlaps, &h);
+    BOOST_REQUIRE(overlaps.size() == 3);
+    // order of FragmentCollection
+    BOOST_CHECK(overlaps[0]->min_pos() == 12);
+    BOOST_CHECK(overlaps[1] == f21);
+    BOOST_CHECK(overlaps[2]->min_pos() == 1);
+}
+
+BOOST_AUTO_TEST_CASE (CoverageIndex_order) {
+    using namespace npge;
+    SequencePtr s1 = boost::make_shared<InMemorySequence>(
+                         std::string(1000, 'A'));
+    BlockSet bs;
+    Block* b = new Block;
+    bs.insert(b);
+    std::set<std::pair<int, int> > added;
+    for (int i = 0; i < 300; i++) {
+        int start = rand() % 1000;
+        int length = (i % 10 == 0) ? rand() % 500 : rand() % 20;
+        int stop = std::min(start + length, 999);
+        if (added.insert(std::make_pair(start, stop)).second) {
+            b->insert(new Fragment(s1, start, stop));
+        }
+    }
+    CoverageIndex index;
+    index.build(bs);
+    VectorFc fc;
+    fc.add_bs(bs);
+    fc.prepare();
+    // Partition relies on this order
+    for (int i = 0; i < 300; i++) {
+        int start = rand() % 1000;
+        int stop = std::min(start + rand() % 50, 999);
+        Fragment query(s1, start, stop);
+        Fragments found, expected;
+        index.find_overlap_fragments(found, &query);
+        fc.find_overlap_fragments(expected, &query);
+        BOOST_CHECK(found == expected);
+    }
+}
+
+BOOST_AUTO_TEST_CASE (CoverageIndex_of) {
+    using namespace npge;
+    SequencePtr s1 = boost::make_shared<InMemorySequence>("tGGtccgagcgGAcggcc");
+    BlockSet bs;
+    Block* b1 = new Block;
+    Fragment* f = new Fragment(s1, 1, 10);
+    b1->insert(f);
+    bs.insert(b1);
+    CoverageIndexPtr i1 = CoverageIndex::of(bs);
+    CoverageIndexPtr i2 = CoverageIndex::of(bs);
+    BOOST_CHECK(i1 == i2);
+    // changed in place
+    f->set_max_pos(11);
+    CoverageIndex::forget(bs);
+    CoverageIndexPtr i3 = CoverageIndex::of(bs);
+    BOOST_CHECK(i3 != i1);
+    PosRanges gaps;
+    i3->gaps(gaps, s1.get());
+    BOOST_REQUIRE(gaps.size() == 2);
+    BOOST_CHECK(gaps[1] == PosRange(12, 17));
+    // fragment inserted to block of blockset
+    b1->insert(new Fragment(s1, 14, 15));
+    CoverageIndexPtr i4 = CoverageIndex::of(bs);
+    BOOST_CHECK(i4 != i3);
+    BOOST_CHECK(CoverageIndex::of(bs) == i4);
+    // block inserted to blockset
+    Block* b2 = new Block;
+    b2->insert(new Fragment(s1, 16, 17));
+    bs.insert(b2);
+    CoverageIndexPtr i5 = CoverageIndex::of(bs);
+    BOOST_CHECK(i5 != i4);
+    gaps.clear();
+    i5->gaps(gaps, s1.get());
+    BOOST_REQUIRE(gaps.size() == 2);
+    BOOST_CHECK(gaps[1] == PosRange(12, 13));
+}
+
+BOOST_AUTO_TEST_CASE (CoverageIndex_of_processor) {
+    using namespace npge;
+    SequencePtr s1 = boost::make_shared<InMemorySequence>("tGGtccgagcgGAcggcc");
+    BlockSetPtr bs = new_bs();
+    Block* b1 = new Block;
+    b1->insert(new Fragment(s1, 1, 10));
+    bs->insert(b1);
+    CoverageIndexPtr i1 = CoverageIndex::of(*bs);
+    // processor can change fragments of its target in place
+    Processor processor;
+    processor.apply(bs);
+    BOOST_CHECK(CoverageIndex::of(*bs) != i1);
+}
+
+
+BOOST_AUTO_TEST_CASE (CoverageIndex_of_identity) {
+    using namespace npge;
+    SequencePtr s1 = boost::make_shared<InMemorySequence>("tGGtccgagcgGAcggcc");
+    SequencePtr s2 = boost::make_shared<InMemorySequence>("tGGtccgagcgGAcggcc");
+    BlockSet bs1, bs2;
+    Block* b1 = new Block;
+    Fragment* f = new Fragment(s1, 1, 10);
+    b1->insert(f);
+    bs1.insert(b1);
+    Block* b2 = new Block;
+    b2->insert(new Fragment(s2, 1, 10));
+    bs2.insert(b2);
+    CoverageIndexPtr i1 = CoverageIndex::of(bs1);
+    CoverageIndexPtr i2 = CoverageIndex::of(bs2);
+    BOOST_CHECK(i1 != i2);
+    BOOST_CHECK(i1->has_seq(s1.get()) && !i1->has_seq(s2.get()));
+    BOOST_CHECK(i2->has_seq(s2.get()) && !i2->has_seq(s1.get()));
+    BOOST_CHECK(CoverageIndex::of(bs1) == i1);
+    // same positions on other sequence, memory of f can be reused
+    b1->erase(f);
+    b1->insert(new Fragment(s2, 1, 10));
+    CoverageIndexPtr i3 = CoverageIndex::of(bs1);
+    BOOST_CHECK(i3 != i1);
+    BOOST_CHECK(i3->has_seq(s2.get()) && !i3->has_seq(s1.get()));
+    // index is dropped when blocks are removed
+    bs1.clear();
+    CoverageIndexPtr i4 = CoverageIndex::of(bs1);
+    BOOST_CHECK(i4 != i3);
+    BOOST_CHECK(i4->seqs().empty());
+}
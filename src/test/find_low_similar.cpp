@@ -0,0 +1,64 @@
+/*
+ * NPG-explorer, Nucleotide PanGenome explorer
+ * Copyright (C) 2012-2016 Boris Nagaev
+ *
+ * See the LICENSE file for terms of use.
+ */
+
+#include <cstdlib>
+#include <vector>
+#include <boost/test/unit_test.hpp>
+
+#include "FindLowSimilar.hpp"
+
+using namespace npge;
+
+typedef FindLowSimilar::Regions Regions;
+
+static void naive_reduce_regions(Regions& regions, int min_length) {
+    while (regions.size() >= 2) {
+        int index = FindLowSimilar::find_min_region(regions);
+        if (regions[index].weight_ >= min_length) {
+            break;
+        }
+        regions = FindLowSimilar::merge_region(regions, index);
+    }
+}
+
+static bool equal_regions(const Regions& a, const Regions& b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (int i = 0; i < a.size(); i++) {
+        if (a[i].start_ != b[i].start_ || a[i].stop_ != b[i].stop_ ||
+                a[i].good_ != b[i].good_ ||
+                a[i].weight_ != b[i].weight_) {
+            return false;
+        }
+    }
+    return true;
+}
+
+BOOST_AUTO_TEST_CASE (FindLowSimilar_reduce_regions) {
+    for (int test = 0; test < 500; test++) {
+        int length = rand() % 300;
+        int good_percent = rand() % 100;
+        std::vector<bool> good_col(length);
+        for (int i = 0; i < length; i++) {
+            good_col[i] = (rand() % 100 < good_percent);
+        }
+        int weight_factor = 1 + rand() % 10;
+        int min_length = rand() % 100;
+        Regions regions = FindLowSimilar::make_regions(good_col,
+                          weight_factor);
+        Regions expected = regions;
+        naive_reduce_regions(expected, min_length);
+        FindLowSimilar::reduce_regions(regions, min_length);
+        BOOST_CHECK(equal_regions(regions, expected));
+        for (int i = 1; i < regions.size(); i++) {
+            BOOST_CHECK(regions[i].start_ == regions[i - 1].stop_ + 1);
+            BOOST_CHECK(regions[i].good_ != regions[i - 1].good_);
+        }
+    }
+}
+
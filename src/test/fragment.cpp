@@ -123,6 +123,28 @@ BOOST_AUTO_TEST_CASE (Fragment_equal) {
     BOOST_CHECK(f1 != f3);
 }
 
+BOOST_AUTO_TEST_CASE (Fragment_key) {
+    using namespace npge;
+    SequencePtr s1 = boost::make_shared<InMemorySequence>("TGGTCCGAGATGCGGGCC");
+    SequencePtr s2 = boost::make_shared<InMemorySequence>("TGGTCCGAGATGCGGGCC");
+    Fragment f1(s1, 0, 9, 1);
+    BOOST_CHECK(f1.key() == Fragment(s1, 0, 9, 1).key());
+    BOOST_CHECK(hash_value(f1.key()) ==
+                hash_value(Fragment(s1, 0, 9, 1).key()));
+    BOOST_CHECK(f1.key() != Fragment(s1, 0, 9, -1).key());
+    BOOST_CHECK(f1.key() != Fragment(s1, 1, 9, 1).key());
+    BOOST_CHECK(f1.key() != Fragment(s1, 0, 8, 1).key());
+    BOOST_CHECK(f1.key() != Fragment(s2, 0, 9, 1).key());
+    // max_pos * 2 would overflow 32 bits
+    pos_t big = MAX_POS - 1;
+    BOOST_CHECK(Fragment(s1, 0, big, 1).key() !=
+                Fragment(s1, 0, big, -1).key());
+    BOOST_CHECK(Fragment(s1, 0, big, 1).key() !=
+                Fragment(s1, 0, big / 2, 1).key());
+    BOOST_CHECK(Fragment(s1, 0, big, 1).key() ==
+                Fragment(s1, 0, big, 1).key());
+}
+
 BOOST_AUTO_TEST_CASE (Fragment_less) {
     using namespace npge;
     SequencePtr s1 = boost::make_shared<InMemorySequence>("TGGTCCGAGATGCGGGCC");
@@ -322,6 +344,13 @@ BOOST_AUTO_TEST_CASE (Fragment_reverse_of_length_1) {
     BOOST_CHECK(f4->id() == "a_0_0");
     FragmentSc f5((s1->fragment_from_id("a_0_0_-1")));
     BOOST_CHECK(f5->id() == "a_0_-1");
+    FragmentSc f6((s1->fragment_from_id("a_2_7")));
+    BOOST_CHECK(f6->id() == "a_2_7");
+    BOOST_CHECK(!s1->fragment_from_id("a_2"));
+    BOOST_CHECK(!s1->fragment_from_id("a_2_x"));
+    BOOST_CHECK(!s1->fragment_from_id("a_2_7_1_1"));
+    // parted
+    BOOST_CHECK(!s1->fragment_from_id("a_7_2_1"));
 }
 
 BOOST_AUTO_TEST_CASE (Fragment_is_fragment_name) {
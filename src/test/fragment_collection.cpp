@@ -0,0 +1,110 @@
+/*
+ * NPG-explorer, Nucleotide PanGenome explorer
+ * Copyright (C) 2012-2016 Boris Nagaev
+ *
+ * See the LICENSE file for terms of use.
+ */
+
+#include <cstdlib>
+#include <algorithm>
+#include <boost/test/unit_test.hpp>
+#include <boost/foreach.hpp>
+
+#include "Sequence.hpp"
+#include "Fragment.hpp"
+#include "Block.hpp"
+#include "BlockSet.hpp"
+#include "FragmentCollection.hpp"
+
+BOOST_AUTO_TEST_CASE (FragmentCollection_intervals) {
+    using namespace npge;
+    SequencePtr s1 = boost::make_shared<InMemorySequence>(
+                         std::string(1000, 'A'));
+    BlockSet bs;
+    Block* b = new Block;
+    bs.insert(b);
+    for (int i = 0; i < 300; i++) {
+        int start = rand() % 1000;
+        // many nested and long fragments
+        int length = (i % 10 == 0) ? rand() % 500 : rand() % 20;
+        int stop = std::min(start + length, 999);
+        b->insert(new Fragment(s1, start, stop, (i % 2) ? 1 : -1));
+    }
+    IntervalFc fc;
+    fc.add_bs(bs);
+    fc.prepare();
+    VectorFc vfc;
+    vfc.add_bs(bs);
+    vfc.prepare();
+    for (int i = 0; i < 300; i++) {
+        int start = rand() % 1000;
+        int stop = std::min(start + rand() % 50, 999);
+        Fragment query(s1, start, stop);
+        Fragments expected;
+        BOOST_FOREACH (Fragment* f, *b) {
+            if (f->common_positions(query)) {
+                expected.push_back(f);
+            }
+        }
+        Fragments found;
+        fc.find_overlap_fragments(found, &query);
+        std::sort(expected.begin(), expected.end());
+        std::sort(found.begin(), found.end());
+        BOOST_CHECK(found == expected);
+        BOOST_CHECK(fc.has_overlap(&query) == !expected.empty());
+        Fragments found2;
+        vfc.find_overlap_fragments(found2, &query);
+        std::sort(found2.begin(), found2.end());
+        BOOST_CHECK(found2 == expected);
+    }
+    Fragment* f = b->front();
+    fc.remove_fragment(f);
+    Fragments found;
+    fc.find_overlap_fragments(found, f);
+    BOOST_CHECK(std::find(found.begin(), found.end(), f) == found.end());
+}
+
+BOOST_AUTO_TEST_CASE (FragmentCollection_intervals_remove) {
+    using namespace npge;
+    SequencePtr s1 = boost::make_shared<InMemorySequence>(
+                         std::string(1000, 'A'));
+    BlockSet bs;
+    Block* b = new Block;
+    bs.insert(b);
+    for (int i = 0; i < 200; i++) {
+        int start = rand() % 1000;
+        int length = (i % 10 == 0) ? rand() % 500 : rand() % 20;
+        int stop = std::min(start + length, 999);
+        b->insert(new Fragment(s1, start, stop));
+    }
+    FIntervals intervals;
+    BOOST_FOREACH (Fragment* f, *b) {
+        intervals.push_back(f);
+    }
+    intervals.build();
+    Fragments kept(b->begin(), b->end());
+    // removed fragments are skipped, then compacted
+    while (kept.size() > 10) {
+        Fragment* removed = kept.back();
+        kept.pop_back();
+        intervals.remove(removed);
+        BOOST_REQUIRE(intervals.size() == kept.size());
+        Fragments all(intervals.begin(), intervals.end());
+        BOOST_REQUIRE(all.size() == kept.size());
+        BOOST_CHECK(std::find(all.begin(), all.end(), removed) == all.end());
+        int start = rand() % 1000;
+        int stop = std::min(start + rand() % 50, 999);
+        Fragment query(s1, start, stop);
+        Fragments expected;
+        BOOST_FOREACH (Fragment* f, kept) {
+            if (f->common_positions(query)) {
+                expected.push_back(f);
+            }
+        }
+        Fragments found;
+        intervals.find_overlaps(found, start, stop);
+        std::sort(expected.begin(), expected.end());
+        std::sort(found.begin(), found.end());
+        BOOST_CHECK(found == expected);
+    }
+}
@@ -0,0 +1,106 @@
+/*
+ * NPG-explorer, Nucleotide PanGenome explorer
+ * Copyright (C) 2012-2016 Boris Nagaev
+ *
+ * See the LICENSE file for terms of use.
+ */
+
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <boost/test/unit_test.hpp>
+
+#include "FragmentDistance.hpp"
+#include "Sequence.hpp"
+#include "Fragment.hpp"
+#include "AlignmentRow.hpp"
+#include "Block.hpp"
+
+using namespace npge;
+
+static int naive_penalty(const std::string& a, const std::string& b) {
+    int penalty = 0;
+    for (int i = 1; i + 1 < int(a.size()); i++) {
+        bool prev = a[i - 1] == b[i - 1] && a[i - 1] != '-';
+        bool curr = a[i] != b[i];
+        bool next = a[i + 1] == b[i + 1] && a[i + 1] != '-';
+        if (prev && curr && next) {
+            penalty += 1;
+        }
+    }
+    return penalty;
+}
+
+static Fragment* make_fragment(const std::string& row,
+                               std::vector<SequencePtr>& seqs) {
+    std::string seq;
+    for (int i = 0; i < row.size(); i++) {
+        if (row[i] != '-') {
+            seq += row[i];
+        }
+    }
+    SequencePtr s = boost::make_shared<InMemorySequence>(seq);
+    seqs.push_back(s);
+    Fragment* f = new Fragment(s, 0, seq.size() - 1);
+    new CompactAlignmentRow(row, f);
+    return f;
+}
+
+BOOST_AUTO_TEST_CASE (FragmentDistance_main) {
+    std::vector<SequencePtr> seqs;
+    Block b;
+    Fragment* f1 = make_fragment("ATGCATGC", seqs);
+    Fragment* f2 = make_fragment("ATCCAT-C", seqs);
+    b.insert(f1);
+    b.insert(f2);
+    FragmentDistance distance;
+    FragmentDistance::Distance d = distance.fragment_distance(f1, f2);
+    BOOST_CHECK(d.total == 8);
+    // substitution G/C and gap are two mutations
+    BOOST_CHECK(d.penalty == 2);
+}
+
+BOOST_AUTO_TEST_CASE (FragmentDistance_all_pairs) {
+    const std::string alphabet = "ATGCN-";
+    int lengths[] = {1, 3, 63, 64, 65, 128, 200};
+    for (int l = 0; l < 7; l++) {
+        int length = lengths[l];
+        std::string base(length, ' ');
+        for (int col = 0; col < length; col++) {
+            base[col] = alphabet[rand() % 4];
+        }
+        std::vector<SequencePtr> seqs;
+        Block b;
+        Fragments fragments;
+        std::vector<std::string> rows;
+        for (int i = 0; i < 6; i++) {
+            std::string row = base;
+            // first column is not mutated to avoid empty rows
+            for (int col = 1; col < length; col++) {
+                if (rand() % 100 < 15) {
+                    row[col] = alphabet[rand() % alphabet.size()];
+                }
+            }
+            rows.push_back(row);
+            Fragment* f = make_fragment(row, seqs);
+            b.insert(f);
+            fragments.push_back(f);
+        }
+        FragmentDistance distance;
+        std::vector<FragmentDistance::Distance> all;
+        distance.all_distances(all, fragments);
+        int n = fragments.size();
+        BOOST_REQUIRE(all.size() == n * n);
+        for (int i = 0; i < n; i++) {
+            for (int j = 0; j < n; j++) {
+                int penalty = naive_penalty(rows[i], rows[j]);
+                BOOST_CHECK(all[i * n + j].total == length);
+                BOOST_CHECK(all[i * n + j].penalty == penalty);
+                FragmentDistance::Distance d;
+                d = distance.fragment_distance(fragments[i], fragments[j]);
+                BOOST_CHECK(d.penalty == penalty);
+            }
+        }
+    }
+}
+
@@ -0,0 +1,61 @@
+/*
+ * NPG-explorer, Nucleotide PanGenome explorer
+ * Copyright (C) 2012-2016 Boris Nagaev
+ *
+ * See the LICENSE file for terms of use.
+ */
+
+#include <cstdlib>
+#include <boost/test/unit_test.hpp>
+
+#include "goodSlices.hpp"
+
+using namespace npge;
+
+BOOST_AUTO_TEST_CASE (goodSlices_main) {
+    Scores score(100, MAX_COLUMN_SCORE);
+    score[20] = 0;
+    for (int i = 60; i < 70; i++) {
+        score[i] = 0;
+    }
+    Coordinates slices = goodSlices(score, 10, 3, 90, 10);
+    BOOST_REQUIRE(slices.size() == 2);
+    BOOST_CHECK(slices[0] == StartStop(0, 59));
+    BOOST_CHECK(slices[1] == StartStop(70, 99));
+}
+
+BOOST_AUTO_TEST_CASE (goodSlices_random) {
+    for (int test = 0; test < 200; test++) {
+        int length = 1 + rand() % 1000;
+        Scores score(length);
+        for (int i = 0; i < length; i++) {
+            score[i] = (rand() % 100 < 85) ? MAX_COLUMN_SCORE :
+                       (rand() % 2) ? 0 : -(rand() % 200);
+        }
+        int min_length = 1 + rand() % 50;
+        int end_length = rand() % (min_length + 1);
+        int frame_length = 1 + rand() % 50;
+        Coordinates slices = goodSlices(score, frame_length,
+                                        end_length, 80, min_length);
+        std::vector<bool> used(length, false);
+        for (int i = 0; i < slices.size(); i++) {
+            const StartStop& slice = slices[i];
+            int slice_length = slice.second - slice.first + 1;
+            BOOST_REQUIRE(slice.first >= 0);
+            BOOST_REQUIRE(slice.second < length);
+            BOOST_CHECK(slice_length >= min_length);
+            BOOST_CHECK(score[slice.first] == MAX_COLUMN_SCORE);
+            BOOST_CHECK(score[slice.second] == MAX_COLUMN_SCORE);
+            if (i > 0) {
+                // longest slices are selected first
+                const StartStop& prev = slices[i - 1];
+                BOOST_CHECK(prev.second - prev.first + 1 >= slice_length);
+            }
+            for (int j = slice.first; j <= slice.second; j++) {
+                BOOST_CHECK(!used[j]);
+                used[j] = true;
+            }
+        }
+    }
+}
+
@@ -0,0 +1,127 @@
+/*
+ * NPG-explorer, Nucleotide PanGenome explorer
+ * Copyright (C) 2012-2016 Boris Nagaev
+ *
+ * See the LICENSE file for terms of use.
+ */
+
+#include <cstdlib>
+#include <algorithm>
+#include <boost/test/unit_test.hpp>
+
+#include "Sequence.hpp"
+#include "BlockSet.hpp"
+#include "homology.hpp"
+#include "complement.hpp"
+
+using namespace npge;
+
+static std::string random_dna(int length) {
+    std::string result;
+    for (int i = 0; i < length; i++) {
+        result += "ATGC"[rand() % 4];
+    }
+    return result;
+}
+
+// one mismatch per 20 nucleotides, one deletion per 200 nucleotides
+static std::string mutate(const std::string& s) {
+    std::string result;
+    for (int i = 0; i < s.size(); i++) {
+        if (i % 200 == 100) {
+            continue;
+        }
+        char c = s[i];
+        if (i % 20 == 10) {
+            c = (c == 'A') ? 'T' : 'A';
+        }
+        result += c;
+    }
+    return result;
+}
+
+// sequences of blockset are ordered by pointers, so hit can
+// start from any of two sequences
+static HomologyHit hit_of(const HomologyHit& hit, const SequencePtr& a) {
+    HomologyHit result = hit;
+    if (hit.a != a.get()) {
+        std::swap(result.a, result.b);
+        std::swap(result.a_min, result.b_min);
+        std::swap(result.a_max, result.b_max);
+    }
+    return result;
+}
+
+static void find(HomologyHits& hits, BlockSet& bs, int workers) {
+    HomologyOptions opt;
+    opt.workers = workers;
+    SeqBase base(bs);
+    base.anchor_ = opt.seed;
+    base.make_seqs();
+    find_homology(hits, base, opt);
+}
+
+BOOST_AUTO_TEST_CASE (homology_direct) {
+    std::string shared = random_dna(1000);
+    std::string s1 = random_dna(500) + shared + random_dna(500);
+    std::string s2 = random_dna(300) + mutate(shared) + random_dna(300);
+    SequencePtr a = boost::make_shared<InMemorySequence>(s1);
+    SequencePtr b = boost::make_shared<InMemorySequence>(s2);
+    a->set_name("a");
+    b->set_name("b");
+    BlockSet bs;
+    bs.add_sequence(a);
+    bs.add_sequence(b);
+    HomologyHits hits;
+    find(hits, bs, 1);
+    BOOST_REQUIRE(hits.size() == 1);
+    HomologyHit hit = hit_of(hits[0], a);
+    BOOST_CHECK(hit.a == a.get());
+    BOOST_CHECK(hit.ori == 1);
+    // random flanks can prolong the hit by chance
+    BOOST_CHECK(std::abs(hit.a_min - 500) < 40);
+    BOOST_CHECK(std::abs(hit.a_max - 1499) < 40);
+    BOOST_CHECK(std::abs(hit.b_min - 300) < 40);
+    BOOST_CHECK(std::abs(hit.b_max - (300 + 995 - 1)) < 40);
+}
+
+BOOST_AUTO_TEST_CASE (homology_reverse) {
+    std::string shared = random_dna(1000);
+    std::string m = mutate(shared);
+    complement(m);
+    std::string s1 = random_dna(500) + shared + random_dna(500);
+    std::string s2 = random_dna(300) + m + random_dna(300);
+    SequencePtr a = boost::make_shared<InMemorySequence>(s1);
+    SequencePtr b = boost::make_shared<InMemorySequence>(s2);
+    a->set_name("a");
+    b->set_name("b");
+    BlockSet bs;
+    bs.add_sequence(a);
+    bs.add_sequence(b);
+    HomologyHits hits;
+    find(hits, bs, 1);
+    BOOST_REQUIRE(hits.size() == 1);
+    HomologyHit hit = hit_of(hits[0], a);
+    BOOST_CHECK(hit.ori == -1);
+    BOOST_CHECK(std::abs(hit.a_min - 500) < 40);
+    BOOST_CHECK(std::abs(hit.a_max - 1499) < 40);
+    BOOST_CHECK(std::abs(hit.b_min - 300) < 40);
+    BOOST_CHECK(std::abs(hit.b_max - (300 + 995 - 1)) < 40);
+}
+
+BOOST_AUTO_TEST_CASE (homology_workers) {
+    std::string shared = random_dna(2000);
+    BlockSet bs;
+    for (int i = 0; i < 5; i++) {
+        std::string s = random_dna(100 * i) + mutate(shared) +
+                        random_dna(1000 - 100 * i);
+        bs.add_sequence(boost::make_shared<InMemorySequence>(s));
+        bs.seqs()[i]->set_name(std::string(1, 'a' + i));
+    }
+    HomologyHits hits1, hits4;
+    find(hits1, bs, 1);
+    find(hits4, bs, 4);
+    BOOST_CHECK(hits1.size() >= 10);
+    BOOST_CHECK(hits1 == hits4);
+}
+
@@ -0,0 +1,170 @@
+/*
+ * NPG-explorer, Nucleotide PanGenome explorer
+ * Copyright (C) 2012-2016 Boris Nagaev
+ *
+ * See the LICENSE file for terms of use.
+ */
+
+#include <sstream>
+#include <boost/test/unit_test.hpp>
+#include <boost/foreach.hpp>
+
+#include "ImportBlastHits.hpp"
+#include "Sequence.hpp"
+#include "Fragment.hpp"
+#include "Block.hpp"
+#include "BlockSet.hpp"
+#include "Exception.hpp"
+
+using namespace npge;
+
+static BlockSetPtr make_other() {
+    BlockSetPtr other = new_bs();
+    std::string text = "TGGTCCGAGCGGACGGCCTGGTCCGAGCGGACGGCC";
+    SequencePtr s1 = boost::make_shared<InMemorySequence>(text);
+    SequencePtr s2 = boost::make_shared<InMemorySequence>(text);
+    s1->set_name("s1");
+    s2->set_name("s2");
+    other->add_sequence(s1);
+    other->add_sequence(s2);
+    return other;
+}
+
+static std::string hit(const std::string& query,
+                       const std::string& subject,
+                       const std::string& length,
+                       const std::string& coords) {
+    return query + "\t" + subject + "\t100.00\t" + length +
+           "\t0\t0\t" + coords + "\t1e-5\t20.0";
+}
+
+static bool has_fragment(Block* block, const std::string& seq,
+                         int min_pos, int max_pos, int ori) {
+    BOOST_FOREACH (Fragment* f, *block) {
+        if (f->seq()->name() == seq && f->min_pos() == min_pos &&
+                f->max_pos() == max_pos && f->ori() == ori) {
+            return true;
+        }
+    }
+    return false;
+}
+
+BOOST_AUTO_TEST_CASE (ImportBlastHits_text) {
+    BlockSetPtr other = make_other();
+    BlockSetPtr target = new_bs();
+    ImportBlastHits importer;
+    importer.set_other(other);
+    importer.set_block_set(target);
+    importer.set_opt_value("blast-min-length", 5);
+    importer.set_opt_value("workers", 2);
+    std::string text;
+    text += "\n";
+    text += hit("s1", "s2", "10", "1\t10\t1\t10") + "\r\n";
+    text += "  \t \r\n";
+    // duplicate
+    text += hit("s1", "s2", "10", "1\t10\t1\t10") + "\n";
+    // the same hit from other side
+    text += hit("s2", "s1", "10", "1\t10\t1\t10") + "\n";
+    // too short
+    text += hit("s1", "s2", "3", "20\t22\t20\t22") + "\n";
+    // reverse complement, no newline at the end
+    text += hit("s1", "s2", "10", "11\t20\t30\t21");
+    importer.start_import();
+    importer.import_text(text);
+    BOOST_REQUIRE(target->size() == 2);
+    std::vector<Block*> blocks(target->begin(), target->end());
+    BOOST_CHECK(has_fragment(blocks[0], "s1", 0, 9, 1));
+    BOOST_CHECK(has_fragment(blocks[0], "s2", 0, 9, 1));
+    BOOST_CHECK(has_fragment(blocks[1], "s1", 10, 19, 1));
+    BOOST_CHECK(has_fragment(blocks[1], "s2", 20, 29, -1));
+}
+
+BOOST_AUTO_TEST_CASE (ImportBlastHits_stream) {
+    std::string text;
+    text += hit("s1", "s2", "10", "1\t10\t1\t10") + "\n";
+    text += "\n";
+    text += hit("s1", "s2", "10", "1\t10\t1\t10") + "\n";
+    text += hit("s1", "s2", "10", "11\t20\t30\t21") + "\n";
+    text += hit("s1", "s2", "3", "20\t22\t20\t22");
+    // chunks shorter than a line, with a line end inside, whole text
+    int chunk_sizes[] = {1, 7, 50, 1000};
+    BOOST_FOREACH (int chunk_size, chunk_sizes) {
+        BlockSetPtr other = make_other();
+        BlockSetPtr target = new_bs();
+        ImportBlastHits importer;
+        importer.set_other(other);
+        importer.set_block_set(target);
+        importer.set_opt_value("blast-min-length", 5);
+        importer.start_import();
+        std::istringstream input(text);
+        importer.import_stream(input, chunk_size);
+        BOOST_REQUIRE(target->size() == 2);
+        std::vector<Block*> blocks(target->begin(), target->end());
+        BOOST_CHECK(has_fragment(blocks[0], "s1", 0, 9, 1));
+        BOOST_CHECK(has_fragment(blocks[1], "s2", 20, 29, -1));
+    }
+}
+
+BOOST_AUTO_TEST_CASE (ImportBlastHits_lines) {
+    BlockSetPtr other = make_other();
+    BlockSetPtr target = new_bs();
+    ImportBlastHits importer;
+    importer.set_other(other);
+    importer.set_block_set(target);
+    importer.set_opt_value("blast-min-length", 5);
+    importer.start_import();
+    ImportBlastHits::Part part1, part2;
+    importer.import_line("", part1);
+    importer.import_line("\r", part1);
+    importer.import_line(hit("s1", "s2", "10", "1\t10\t1\t10") + "\r",
+                         part1);
+    importer.import_line(hit("s1", "s2", "10", "1\t10\t1\t10"), part1);
+    importer.import_line(hit("s1", "s2", "10", "1\t10\t1\t10"), part2);
+    importer.import_line(hit("s1", "s2", "10", "11\t20\t30\t21"), part2);
+    importer.import_line(hit("s1", "s2", "3", "20\t22\t20\t22"), part2);
+    BOOST_CHECK(part1.hits.size() == 2);
+    BOOST_CHECK(part2.hits.size() == 2);
+    BOOST_CHECK(target->empty());
+    // duplicates are removed within part and between parts
+    importer.finish_import(part1);
+    BOOST_CHECK(target->size() == 1);
+    BOOST_CHECK(part1.hits.empty());
+    importer.finish_import(part2);
+    BOOST_REQUIRE(target->size() == 2);
+    std::vector<Block*> blocks(target->begin(), target->end());
+    BOOST_CHECK(has_fragment(blocks[0], "s1", 0, 9, 1));
+    BOOST_CHECK(has_fragment(blocks[1], "s2", 20, 29, -1));
+}
+
+BOOST_AUTO_TEST_CASE (ImportBlastHits_bad_lines) {
+    BlockSetPtr other = make_other();
+    BlockSetPtr target = new_bs();
+    ImportBlastHits importer;
+    importer.set_other(other);
+    importer.set_block_set(target);
+    importer.set_opt_value("blast-min-length", 5);
+    importer.start_import();
+    ImportBlastHits::Part part;
+    // 11 fields
+    BOOST_CHECK_THROW(importer.import_line("s1\ts2\t100.00\t10\t0\t0\t"
+                                           "1\t10\t1\t10\t1e-5", part),
+                      Exception);
+    BOOST_CHECK_THROW(importer.import_line(hit("s1", "s2", "10",
+                                           "1\t1x\t1\t10"), part),
+                      Exception);
+    BOOST_CHECK_THROW(importer.import_line(hit("s1", "s2", "10",
+                                           "1\t10\t-\t10"), part),
+                      Exception);
+    BOOST_CHECK_THROW(importer.import_line(hit("s1", "s2", "",
+                                           "1\t10\t1\t10"), part),
+                      Exception);
+    BOOST_CHECK_THROW(importer.import_text(hit("s1", "s2", "10",
+                                           "1\t10\t1\t1 0")),
+                      Exception);
+    BOOST_CHECK(part.hits.empty());
+    importer.import_line(hit("s1", "s2", "+10", "1\t10\t1\t10"), part);
+    BOOST_CHECK(part.hits.size() == 1);
+    importer.finish_import(part);
+    BOOST_CHECK(target->size() == 1);
+}
+
@@ -0,0 +1,92 @@
+/*
+ * NPG-explorer, Nucleotide PanGenome explorer
+ * Copyright (C) 2012-2016 Boris Nagaev
+ *
+ * See the LICENSE file for terms of use.
+ */
+
+#include <cstdlib>
+#include <sstream>
+#include <boost/test/unit_test.hpp>
+#include <boost/make_shared.hpp>
+
+#include "IsPangenome.hpp"
+#include "Meta.hpp"
+#include "Sequence.hpp"
+#include "Fragment.hpp"
+#include "Block.hpp"
+#include "BlockSet.hpp"
+#include "name_to_stream.hpp"
+
+using namespace npge;
+
+static std::string random_dna(int length) {
+    std::string result;
+    for (int i = 0; i < length; i++) {
+        result += "ATGC"[rand() % 4];
+    }
+    return result;
+}
+
+// blocks are not aligned and can be joined
+static BlockSetPtr bad_pangenome() {
+    std::string text = random_dna(600);
+    SequencePtr s1 = boost::make_shared<InMemorySequence>(text);
+    SequencePtr s2 = boost::make_shared<InMemorySequence>(text);
+    s1->set_name("s1");
+    s2->set_name("s2");
+    BlockSetPtr bs = new_bs();
+    bs->add_sequence(s1);
+    bs->add_sequence(s2);
+    for (int start = 0; start < 600; start += 300) {
+        Block* block = new Block;
+        block->insert(new Fragment(s1, start, start + 299));
+        block->insert(new Fragment(s2, start, start + 299));
+        block->set_random_name();
+        bs->insert(block);
+    }
+    return bs;
+}
+
+static std::string check_pangenome(const BlockSetPtr& bs,
+                                   bool parallel, bool fail_fast) {
+    boost::shared_ptr<std::stringstream> out =
+        boost::make_shared<std::stringstream>();
+    set_ostream(":is-pangenome", out);
+    {
+        IsPangenome is_pangenome;
+        is_pangenome.set_options("--out-is-pangenome=:is-pangenome");
+        is_pangenome.set_opt_value("workers", 3);
+        is_pangenome.set_opt_value("parallel-checks", parallel);
+        is_pangenome.set_opt_value("fail-fast", fail_fast);
+        Meta* meta = is_pangenome.meta();
+        AnyAs native = meta->get_opt("BLAST_NATIVE");
+        meta->set_opt("BLAST_NATIVE", true);
+        is_pangenome.apply(bs);
+        meta->set_opt("BLAST_NATIVE", native);
+    }
+    remove_ostream(":is-pangenome");
+    return out->str();
+}
+
+BOOST_AUTO_TEST_CASE (IsPangenome_parallel_checks) {
+    BlockSetPtr bs = bad_pangenome();
+    std::string sequential = check_pangenome(bs, false, false);
+    BOOST_CHECK(sequential.find("Some blocks can be joined") !=
+                std::string::npos);
+    BOOST_CHECK(sequential.find("[not good pangenome]") !=
+                std::string::npos);
+    BOOST_CHECK(check_pangenome(bs, true, false) == sequential);
+    // fail-fast prints checks up to the first failed one
+    std::string sequential_ff = check_pangenome(bs, false, true);
+    BOOST_CHECK(sequential_ff.find("Some blocks can be joined") ==
+                std::string::npos);
+    BOOST_CHECK(sequential_ff.find("[not good pangenome]") !=
+                std::string::npos);
+    std::string verdict = "[not good pangenome]\n";
+    std::string problems = sequential_ff.substr(0,
+                           sequential_ff.size() - verdict.size());
+    BOOST_CHECK(!problems.empty());
+    BOOST_CHECK(sequential.substr(0, problems.size()) == problems);
+    BOOST_CHECK(check_pangenome(bs, true, true) == sequential_ff);
+}
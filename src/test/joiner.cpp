@@ -6,6 +6,7 @@
  */
 
 #include <boost/test/unit_test.hpp>
+#include <boost/foreach.hpp>
 
 #include "Joiner.hpp"
 #include "OriByMajority.hpp"
@@ -326,3 +327,43 @@ BOOST_AUTO_TEST_CASE (Joiner_aligner_4) {
     BOOST_CHECK(block_set->front()->consensus_string() == "ACTGAAT");
 }
 
+BOOST_AUTO_TEST_CASE (Joiner_chain) {
+    using namespace npge;
+    // ##$$###$$###
+    // ACTGAATCCGTT
+    // ACT-AATC-GTT
+    SequencePtr s1(new InMemorySequence("ACTGAATCCGTT"));
+    SequencePtr s2(new InMemorySequence("ACTAATCGTT"));
+    for (int workers = 1; workers <= 3; workers += 2) {
+        Block* b1 = new Block;
+        b1->insert(new Fragment(s1, 0, 2, 1));
+        b1->insert(new Fragment(s2, 0, 2, 1));
+        Block* b2 = new Block;
+        b2->insert(new Fragment(s1, 4, 6, 1));
+        b2->insert(new Fragment(s2, 3, 5, 1));
+        Block* b3 = new Block;
+        b3->insert(new Fragment(s1, 9, 11, 1));
+        b3->insert(new Fragment(s2, 7, 9, 1));
+        BlockSetPtr block_set = new_bs();
+        block_set->insert(b1);
+        block_set->insert(b2);
+        block_set->insert(b3);
+        BOOST_FOREACH (Block* block, *block_set) {
+            BOOST_FOREACH (Fragment* f, *block) {
+                f->set_row(new CompactAlignmentRow(f->str()));
+            }
+        }
+        b2->inverse();
+        Joiner joiner;
+        joiner.set_workers(workers);
+        joiner.apply(block_set);
+        OriByMajority obm;
+        obm.apply(block_set);
+        BOOST_REQUIRE(block_set->size() == 1);
+        Block* block = block_set->front();
+        BOOST_CHECK(block->size() == 2);
+        BOOST_CHECK(block->alignment_length() == 12);
+        BOOST_CHECK(block->consensus_string() == "ACTGAATCCGTT");
+    }
+}
+
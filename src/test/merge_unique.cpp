@@ -0,0 +1,52 @@
+/*
+ * NPG-explorer, Nucleotide PanGenome explorer
+ * Copyright (C) 2012-2016 Boris Nagaev
+ *
+ * See the LICENSE file for terms of use.
+ */
+
+#include <boost/test/unit_test.hpp>
+#include <boost/foreach.hpp>
+
+#include "MergeUnique.hpp"
+#include "Sequence.hpp"
+#include "Fragment.hpp"
+#include "Block.hpp"
+#include "BlockSet.hpp"
+
+using namespace npge;
+
+static BlockSetPtr make_unique_between_blocks() {
+    BlockSetPtr bs = new_bs();
+    Block* a = new Block;
+    Block* b = new Block;
+    bs->insert(a);
+    bs->insert(b);
+    for (int i = 0; i < 3; i++) {
+        SequencePtr s = boost::make_shared<InMemorySequence>("AAAACCCCGGGG");
+        bs->add_sequence(s);
+        a->insert(new Fragment(s, 0, 3));
+        b->insert(new Fragment(s, 8, 11));
+        Block* u = new Block;
+        u->insert(new Fragment(s, 4, 7));
+        bs->insert(u);
+    }
+    return bs;
+}
+
+BOOST_AUTO_TEST_CASE (MergeUnique_main) {
+    for (int workers = 1; workers <= 3; workers += 2) {
+        for (int both = 0; both <= 1; both++) {
+            BlockSetPtr bs = make_unique_between_blocks();
+            MergeUnique mu;
+            mu.set_opt_value("merge-long", true);
+            mu.set_opt_value("both-neighbours", bool(both));
+            mu.set_opt_value("workers", workers);
+            mu.apply(bs);
+            BOOST_REQUIRE(bs->size() == 3);
+            BOOST_FOREACH (Block* block, *bs) {
+                BOOST_CHECK(block->size() == 3);
+            }
+        }
+    }
+}
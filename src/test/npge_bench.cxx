@@ -0,0 +1,517 @@
+/*
+ * NPG-explorer, Nucleotide PanGenome explorer
+ * Copyright (C) 2012-2016 Boris Nagaev
+ *
+ * See the LICENSE file for terms of use.
+ */
+
+#include <iostream>
+#include <sstream>
+#include <algorithm>
+#include "boost-xtime.hpp"
+#include <boost/foreach.hpp>
+#include <boost/function.hpp>
+#include <boost/bind.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/uniform_int_distribution.hpp>
+#include <boost/random/uniform_real_distribution.hpp>
+
+#include "Meta.hpp"
+#include "Sequence.hpp"
+#include "Fragment.hpp"
+#include "Block.hpp"
+#include "BlockSet.hpp"
+#include "AnchorFinder.hpp"
+#include "HomologyFinder.hpp"
+#include "SimilarAligner.hpp"
+#include "Filter.hpp"
+#include "Joiner.hpp"
+#include "OverlaplessUnion.hpp"
+#include "Write.hpp"
+#include "Read.hpp"
+#include "bsa_algo.hpp"
+#include "GeneralAligner.hpp"
+#include "name_to_stream.hpp"
+#include "string_arguments.hpp"
+#include "Exception.hpp"
+#include "cast.hpp"
+
+using namespace npge;
+
+/** Parameters of synthetic pangenome */
+struct BenchConfig {
+    int genomes;
+    int length;
+    double mutations;
+    double indels;
+    int repeats;
+    int window;
+    int seed;
+    int iterations;
+    std::string only;
+    std::string out;
+
+    BenchConfig():
+        genomes(5), length(100000), mutations(0.01), indels(0.001),
+        repeats(10), window(300), seed(1), iterations(3) {
+    }
+};
+
+typedef boost::random::mt19937 Rng;
+
+static int rand_int(Rng& rng, int min, int max) {
+    return boost::random::uniform_int_distribution<int>(min, max)(rng);
+}
+
+static bool rand_event(Rng& rng, double p) {
+    return boost::random::uniform_real_distribution<double>(0, 1)(rng) < p;
+}
+
+static char rand_letter(Rng& rng) {
+    return "ATGC"[rand_int(rng, 0, 3)];
+}
+
+/** Synthetic pangenome.
+Genomes are descendants of common ancestor.
+anc2gen[genome][ancestor_pos] is position in genome or -1 if deleted.
+*/
+struct Synthetic {
+    std::string ancestor;
+    std::vector<SequencePtr> seqs;
+    std::vector<std::vector<int> > anc2gen;
+};
+
+static void make_ancestor(Synthetic& s, const BenchConfig& c, Rng& rng) {
+    s.ancestor.resize(c.length);
+    for (int i = 0; i < c.length; i++) {
+        s.ancestor[i] = rand_letter(rng);
+    }
+    // repeats: copies of random segments of the ancestor
+    int max_repeat = std::min(2000, c.length / 4);
+    for (int r = 0; r < c.repeats && max_repeat >= 100; r++) {
+        int len = rand_int(rng, 100, max_repeat);
+        int from = rand_int(rng, 0, c.length - len);
+        int to = rand_int(rng, 0, c.length - len);
+        std::string copy = s.ancestor.substr(from, len);
+        for (int i = 0; i < len; i++) {
+            if (rand_event(rng, c.mutations)) {
+                copy[i] = rand_letter(rng);
+            }
+        }
+        s.ancestor.replace(to, len, copy);
+    }
+}
+
+static void make_genome(Synthetic& s, int index,
+                        const BenchConfig& c, Rng& rng) {
+    std::string genome;
+    genome.reserve(c.length + c.length / 10);
+    std::vector<int> anc2gen(c.length, -1);
+    for (int i = 0; i < c.length; i++) {
+        if (rand_event(rng, c.indels / 2)) {
+            // insertion
+            int len = rand_int(rng, 1, 10);
+            for (int j = 0; j < len; j++) {
+                genome += rand_letter(rng);
+            }
+        }
+        if (rand_event(rng, c.indels / 2)) {
+            // deletion
+            i += rand_int(rng, 0, 9);
+            continue;
+        }
+        char letter = s.ancestor[i];
+        if (rand_event(rng, c.mutations)) {
+            letter = rand_letter(rng);
+        }
+        anc2gen[i] = genome.size();
+        genome += letter;
+    }
+    SequencePtr seq = boost::make_shared<InMemorySequence>(genome);
+    seq->set_name("g" + TO_S(index) + "&chr1&c");
+    s.seqs.push_back(seq);
+    s.anc2gen.push_back(anc2gen);
+}
+
+static Synthetic make_synthetic(const BenchConfig& c) {
+    Rng rng(c.seed);
+    Synthetic s;
+    make_ancestor(s, c, rng);
+    for (int g = 0; g < c.genomes; g++) {
+        make_genome(s, g, c, rng);
+    }
+    return s;
+}
+
+/** Blockset with sequences only */
+static BlockSetPtr seqs_bs(const Synthetic& s) {
+    BlockSetPtr bs = new_bs();
+    bs->add_sequences(s.seqs);
+    return bs;
+}
+
+/** Blockset of true homologous windows (unaligned).
+\param shift Offset of the first window in the ancestor.
+*/
+static BlockSetPtr true_blocks(const Synthetic& s, int window,
+                               int shift = 0) {
+    BlockSetPtr bs = seqs_bs(s);
+    int length = s.ancestor.size();
+    for (int start = shift; start + window <= length; start += window) {
+        Block* block = new Block;
+        for (int g = 0; g < s.seqs.size(); g++) {
+            const std::vector<int>& a2g = s.anc2gen[g];
+            int min_pos = -1, max_pos = -1;
+            for (int i = start; i < start + window; i++) {
+                if (a2g[i] != -1) {
+                    if (min_pos == -1) {
+                        min_pos = a2g[i];
+                    }
+                    max_pos = a2g[i];
+                }
+            }
+            if (min_pos != -1) {
+                block->insert(new Fragment(s.seqs[g].get(),
+                                           min_pos, max_pos));
+            }
+        }
+        if (block->size() >= 2) {
+            block->set_name_from_fragments();
+            bs->insert(block);
+        } else {
+            delete block;
+        }
+    }
+    return bs;
+}
+
+/** Contents for GeneralAligner (pair of strings) */
+struct StringContents {
+    const std::string* first_;
+    const std::string* second_;
+
+    StringContents():
+        first_(0), second_(0) {
+    }
+
+    int first_size() const {
+        return first_->size();
+    }
+
+    int second_size() const {
+        return second_->size();
+    }
+
+    int substitution(int row, int col) const {
+        return (*first_)[row] == (*second_)[col] ? 0 : 1;
+    }
+};
+
+typedef boost::function<void()> BenchFunc;
+typedef boost::function<BenchFunc()> BenchSetup;
+
+struct BenchResult {
+    std::string name;
+    std::vector<double> seconds;
+    std::string error;
+};
+
+static double seconds_since(const boost::posix_time::ptime& before) {
+    using namespace boost::posix_time;
+    ptime after = microsec_clock::universal_time();
+    return (after - before).total_microseconds() * 1e-6;
+}
+
+/** Run setup and function iterations times, measure only function */
+static BenchResult run_bench(const std::string& name, BenchSetup setup,
+                             int iterations) {
+    using namespace boost::posix_time;
+    BenchResult result;
+    result.name = name;
+    try {
+        for (int i = 0; i < iterations; i++) {
+            BenchFunc func = setup();
+            ptime before = microsec_clock::universal_time();
+            func();
+            result.seconds.push_back(seconds_since(before));
+        }
+    } catch (std::exception& e) {
+        result.error = e.what();
+    } catch (...) {
+        result.error = "unknown error";
+    }
+    std::cerr << name << ": ";
+    if (result.error.empty()) {
+        std::cerr << *std::min_element(result.seconds.begin(),
+                                       result.seconds.end()) << " s\n";
+    } else {
+        std::cerr << "error: " << result.error << "\n";
+    }
+    return result;
+}
+
+static void run_processor(SharedProcessor p, BlockSetPtr target,
+                          BlockSetPtr other) {
+    p->set_bs("target", target);
+    if (other) {
+        p->set_bs("other", other);
+    }
+    p->run();
+}
+
+static BenchFunc processor_func(SharedProcessor p, BlockSetPtr target,
+                                BlockSetPtr other = BlockSetPtr()) {
+    return boost::bind(run_processor, p, target, other);
+}
+
+static BlockSetPtr aligned_blocks(const Synthetic& s,
+                                  const BenchConfig& c, int shift = 0) {
+    BlockSetPtr bs = true_blocks(s, c.window, shift);
+    SimilarAligner aligner;
+    aligner.apply(bs);
+    return bs;
+}
+
+static BenchFunc setup_anchor_finder(const Synthetic* s) {
+    return processor_func(boost::make_shared<AnchorFinder>(), seqs_bs(*s));
+}
+
+static BenchFunc setup_homology_finder(const Synthetic* s) {
+    return processor_func(boost::make_shared<HomologyFinder>(),
+                          seqs_bs(*s));
+}
+
+static BenchFunc setup_similar_aligner(const Synthetic* s,
+                                       const BenchConfig* c) {
+    return processor_func(boost::make_shared<SimilarAligner>(),
+                          true_blocks(*s, c->window));
+}
+
+static void general_aligner(const Strings& firsts, const Strings& seconds) {
+    for (int i = 0; i < firsts.size(); i++) {
+        StringContents contents;
+        contents.first_ = &firsts[i];
+        contents.second_ = &seconds[i];
+        GeneralAligner<StringContents> ga;
+        ga.set_contents(contents);
+        ga.set_gap_range(15);
+        ga.set_max_errors(-1);
+        int first_last, second_last;
+        ga.align(first_last, second_last);
+        PairAlignment aln;
+        ga.export_alignment(first_last, second_last, aln);
+    }
+}
+
+static BenchFunc setup_general_aligner(const Synthetic* s,
+                                       const BenchConfig* c) {
+    BlockSetPtr bs = true_blocks(*s, c->window);
+    Strings firsts, seconds;
+    BOOST_FOREACH (Block* block, *bs) {
+        Fragments fragments(block->begin(), block->end());
+        firsts.push_back(fragments[0]->str());
+        seconds.push_back(fragments[1]->str());
+    }
+    return boost::bind(general_aligner, firsts, seconds);
+}
+
+static void bsa_align_all(BlockSetPtr bs, int genomes) {
+    BSA rows, aln;
+    bsa_make_rows(rows, *bs);
+    bsa_make_aln(aln, rows, genomes);
+}
+
+static BenchFunc setup_bsa_align(const Synthetic* s,
+                                 const BenchConfig* c) {
+    BlockSetPtr bs = true_blocks(*s, c->window);
+    return boost::bind(bsa_align_all, bs, c->genomes);
+}
+
+static BenchFunc setup_filter(const Synthetic* s, const BenchConfig* c) {
+    return processor_func(boost::make_shared<Filter>(),
+                          aligned_blocks(*s, *c));
+}
+
+static BenchFunc setup_joiner(const Synthetic* s, const BenchConfig* c) {
+    return processor_func(boost::make_shared<Joiner>(),
+                          aligned_blocks(*s, *c));
+}
+
+static BenchFunc setup_overlapless_union(const Synthetic* s,
+        const BenchConfig* c) {
+    // candidates: windows and windows shifted by half of window
+    BlockSetPtr other = aligned_blocks(*s, *c);
+    BlockSetPtr shifted = aligned_blocks(*s, *c, c->window / 2);
+    BOOST_FOREACH (Block* block, *shifted) {
+        other->insert(block->clone());
+    }
+    return processor_func(boost::make_shared<OverlaplessUnion>(),
+                          seqs_bs(*s), other);
+}
+
+static const char* const BENCH_STREAM = ":npge_bench";
+
+static BenchFunc setup_write_bs(const Synthetic* s, const BenchConfig* c) {
+    set_sstream(BENCH_STREAM);
+    SharedProcessor writer = boost::make_shared<Write>();
+    writer->set_opt_value("out-file", std::string(BENCH_STREAM));
+    return processor_func(writer, aligned_blocks(*s, *c));
+}
+
+static BenchFunc setup_read_bs(const Synthetic* s, const BenchConfig* c) {
+    set_sstream(BENCH_STREAM);
+    Write writer;
+    writer.set_opt_value("out-file", std::string(BENCH_STREAM));
+    writer.apply(aligned_blocks(*s, *c));
+    SharedProcessor reader = boost::make_shared<Read>();
+    reader->set_opt_value("in-blocks", Strings(1, BENCH_STREAM));
+    return processor_func(reader, new_bs());
+}
+
+static BenchFunc setup_pangenome(const Synthetic* s, Meta* meta) {
+    return processor_func(meta->get("Pangenome"), seqs_bs(*s));
+}
+
+static void print_json_string(std::ostream& o, const std::string& s) {
+    o << '"';
+    BOOST_FOREACH (char c, s) {
+        if (c == '"' || c == '\\') {
+            o << '\\' << c;
+        } else if (c == '\n') {
+            o << "\\n";
+        } else {
+            o << c;
+        }
+    }
+    o << '"';
+}
+
+static void print_json(std::ostream& o, const BenchConfig& c,
+                       const std::vector<BenchResult>& results) {
+    o << "{\n";
+    o << "  \"config\": {";
+    o << "\"genomes\": " << c.genomes << ", ";
+    o << "\"length\": " << c.length << ", ";
+    o << "\"mutations\": " << c.mutations << ", ";
+    o << "\"indels\": " << c.indels << ", ";
+    o << "\"repeats\": " << c.repeats << ", ";
+    o << "\"window\": " << c.window << ", ";
+    o << "\"seed\": " << c.seed << ", ";
+    o << "\"iterations\": " << c.iterations << "},\n";
+    o << "  \"benchmarks\": [";
+    for (int i = 0; i < results.size(); i++) {
+        const BenchResult& r = results[i];
+        o << (i ? ",\n" : "\n");
+        o << "    {\"name\": ";
+        print_json_string(o, r.name);
+        if (!r.error.empty()) {
+            o << ", \"error\": ";
+            print_json_string(o, r.error);
+        } else {
+            std::vector<double> sorted = r.seconds;
+            std::sort(sorted.begin(), sorted.end());
+            o << ", \"min\": " << sorted.front();
+            o << ", \"median\": " << sorted[sorted.size() / 2];
+            o << ", \"max\": " << sorted.back();
+            o << ", \"seconds\": [";
+            for (int j = 0; j < r.seconds.size(); j++) {
+                o << (j ? ", " : "") << r.seconds[j];
+            }
+            o << "]";
+        }
+        o << "}";
+    }
+    o << "\n  ]\n}\n";
+}
+
+template<typename T>
+static void read_arg(const StringToArgv& args, const std::string& name,
+                     T& value) {
+    std::string v = args.get_argument(name);
+    if (!v.empty()) {
+        value = boost::lexical_cast<T>(v);
+    }
+}
+
+static bool selected(const BenchConfig& c, const std::string& name) {
+    if (c.only.empty()) {
+        return true;
+    }
+    std::string list = "," + c.only + ",";
+    return list.find("," + name + ",") != std::string::npos;
+}
+
+int main(int argc, char** argv) {
+    StringToArgv args(argc, argv);
+    if (args.has_argument("-h") || args.has_argument("--help")) {
+        std::cout << "Usage: npge_bench [--genomes N] [--length N] "
+                  "[--mutations P] [--indels P] [--repeats N] "
+                  "[--window N] [--seed N] [--iterations N] "
+                  "[--only name1,name2] [--out file.json]\n";
+        return 0;
+    }
+    BenchConfig c;
+    read_arg(args, "--genomes", c.genomes);
+    read_arg(args, "--length", c.length);
+    read_arg(args, "--mutations", c.mutations);
+    read_arg(args, "--indels", c.indels);
+    read_arg(args, "--repeats", c.repeats);
+    read_arg(args, "--window", c.window);
+    read_arg(args, "--seed", c.seed);
+    read_arg(args, "--iterations", c.iterations);
+    read_arg(args, "--only", c.only);
+    read_arg(args, "--out", c.out);
+    if (c.genomes < 2 || c.length < c.window || c.iterations < 1) {
+        std::cerr << "Bad parameters" << std::endl;
+        return 255;
+    }
+    Meta meta;
+    Synthetic s = make_synthetic(c);
+    typedef std::pair<std::string, BenchSetup> NamedSetup;
+    std::vector<NamedSetup> setups;
+    setups.push_back(NamedSetup("AnchorFinder",
+                                boost::bind(setup_anchor_finder, &s)));
+    setups.push_back(NamedSetup("HomologyFinder",
+                                boost::bind(setup_homology_finder, &s)));
+    setups.push_back(NamedSetup("SimilarAligner",
+                                boost::bind(setup_similar_aligner, &s, &c)));
+    setups.push_back(NamedSetup("GeneralAligner",
+                                boost::bind(setup_general_aligner, &s, &c)));
+    setups.push_back(NamedSetup("bsa_align",
+                                boost::bind(setup_bsa_align, &s, &c)));
+    setups.push_back(NamedSetup("Filter",
+                                boost::bind(setup_filter, &s, &c)));
+    setups.push_back(NamedSetup("Joiner",
+                                boost::bind(setup_joiner, &s, &c)));
+    setups.push_back(NamedSetup("OverlaplessUnion",
+                                boost::bind(setup_overlapless_union, &s, &c)));
+    setups.push_back(NamedSetup("WriteBs",
+                                boost::bind(setup_write_bs, &s, &c)));
+    setups.push_back(NamedSetup("ReadBs",
+                                boost::bind(setup_read_bs, &s, &c)));
+    setups.push_back(NamedSetup("MakePangenome",
+                                boost::bind(setup_pangenome, &s, &meta)));
+    std::vector<BenchResult> results;
+    BOOST_FOREACH (const NamedSetup& setup, setups) {
+        if (selected(c, setup.first)) {
+            results.push_back(run_bench(setup.first, setup.second,
+                                        c.iterations));
+        }
+    }
+    remove_stream(BENCH_STREAM);
+    if (c.out.empty()) {
+        print_json(std::cout, c, results);
+    } else {
+        boost::shared_ptr<std::ostream> out = name_to_ostream(c.out);
+        print_json(*out, c, results);
+    }
+    BOOST_FOREACH (const BenchResult& r, results) {
+        if (!r.error.empty()) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
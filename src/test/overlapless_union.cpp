@@ -0,0 +1,120 @@
+/*
+ * NPG-explorer, Nucleotide PanGenome explorer
+ * Copyright (C) 2012-2016 Boris Nagaev
+ *
+ * See the LICENSE file for terms of use.
+ */
+
+#include <cstdlib>
+#include <set>
+#include <algorithm>
+#include <boost/test/unit_test.hpp>
+#include <boost/foreach.hpp>
+
+#include "OverlaplessUnion.hpp"
+#include "Sequence.hpp"
+#include "Fragment.hpp"
+#include "Block.hpp"
+#include "BlockSet.hpp"
+#include "throw_assert.hpp"
+
+using namespace npge;
+
+static std::string block_key(const Block* block) {
+    std::set<std::string> ids;
+    BOOST_FOREACH (Fragment* f, *block) {
+        ids.insert(f->id());
+    }
+    std::string result;
+    BOOST_FOREACH (const std::string& id, ids) {
+        result += id + " ";
+    }
+    return result;
+}
+
+static std::set<std::string> bs_keys(const BlockSet& bs) {
+    std::set<std::string> result;
+    BOOST_FOREACH (const Block* block, bs) {
+        result.insert(block_key(block));
+    }
+    return result;
+}
+
+static bool blocks_overlap(const Block* a, const Block* b) {
+    BOOST_FOREACH (Fragment* fa, *a) {
+        BOOST_FOREACH (Fragment* fb, *b) {
+            if (fa->common_positions(*fb)) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+static bool priority_less(const Block* a, const Block* b) {
+    if (a->size() != b->size()) {
+        return a->size() > b->size();
+    }
+    if (a->alignment_length() != b->alignment_length()) {
+        return a->alignment_length() > b->alignment_length();
+    }
+    return a->name() > b->name();
+}
+
+BOOST_AUTO_TEST_CASE (OverlaplessUnion_serial_greedy) {
+    std::vector<SequencePtr> seqs;
+    for (int i = 0; i < 3; i++) {
+        seqs.push_back(boost::make_shared<InMemorySequence>(
+                           std::string(2000, 'A')));
+        seqs.back()->set_name("s" + TO_S(i));
+    }
+    BlockSetPtr target = new_bs();
+    BlockSetPtr other = new_bs();
+    for (int i = 0; i < 3; i++) {
+        Block* block = new Block;
+        block->insert(new Fragment(seqs[i], 500 * i, 500 * i + 20));
+        target->insert(block);
+    }
+    for (int i = 0; i < 400; i++) {
+        Block* block = new Block;
+        block->set_name("b" + TO_S(i));
+        int length = 10 + rand() % 50;
+        int fragments = 1 + rand() % 3;
+        for (int j = 0; j < fragments; j++) {
+            SequencePtr seq = seqs[rand() % seqs.size()];
+            int min_pos = rand() % (2000 - length);
+            block->insert(new Fragment(seq, min_pos,
+                                       min_pos + length - 1));
+        }
+        other->insert(block);
+    }
+    // expected result: serial greedy selection
+    Blocks candidates(other->begin(), other->end());
+    std::sort(candidates.begin(), candidates.end(), priority_less);
+    Blocks selected(target->begin(), target->end());
+    std::set<std::string> expected = bs_keys(*target);
+    BOOST_FOREACH (Block* block, candidates) {
+        bool overlaps = false;
+        BOOST_FOREACH (Block* s, selected) {
+            if (blocks_overlap(block, s)) {
+                overlaps = true;
+                break;
+            }
+        }
+        if (!overlaps) {
+            selected.push_back(block);
+            expected.insert(block_key(block));
+        }
+    }
+    BOOST_CHECK(expected.size() > target->size());
+    for (int workers = 1; workers <= 4; workers += 3) {
+        BlockSetPtr result = target->clone();
+        OverlaplessUnion ou;
+        ou.set_bs("target", result);
+        ou.set_bs("other", other);
+        ou.set_workers(workers);
+        ou.run();
+        BOOST_CHECK(bs_keys(*result) == expected);
+    }
+}
+
@@ -0,0 +1,88 @@
+/*
+ * NPG-explorer, Nucleotide PanGenome explorer
+ * Copyright (C) 2012-2016 Boris Nagaev
+ *
+ * See the LICENSE file for terms of use.
+ */
+
+#include <vector>
+#include <cstring>
+#include <boost/test/unit_test.hpp>
+#include "boost-xtime.hpp"
+#include <boost/thread/thread.hpp>
+#include <boost/bind.hpp>
+
+#include "pool_alloc.hpp"
+
+using namespace npge;
+
+typedef std::vector<void*> Ptrs;
+
+// size class not used by model objects
+const std::size_t SIZE = 232;
+const int N = 5000; // several slabs
+
+static void alloc_all(Ptrs* ptrs) {
+    for (int i = 0; i < N; i++) {
+        void* ptr = pool_alloc(SIZE);
+        std::memset(ptr, i % 256, SIZE);
+        ptrs->push_back(ptr);
+    }
+}
+
+static void free_all(Ptrs* ptrs) {
+    for (std::size_t i = 0; i < ptrs->size(); i++) {
+        pool_free((*ptrs)[i], SIZE);
+    }
+    ptrs->clear();
+    pool_flush();
+}
+
+BOOST_AUTO_TEST_CASE (pool_alloc_reuse) {
+    void* a = pool_alloc(40);
+    pool_free(a, 40);
+    void* b = pool_alloc(40);
+    BOOST_CHECK(b == a);
+    pool_free(b, 40);
+    void* big = pool_alloc(1000);
+    std::memset(big, 0, 1000);
+    pool_free(big, 1000);
+    pool_free(0, 40);
+}
+
+BOOST_AUTO_TEST_CASE (pool_alloc_no_overlap) {
+    Ptrs ptrs;
+    alloc_all(&ptrs);
+    for (int i = 0; i < N; i++) {
+        const unsigned char* p = (const unsigned char*)(ptrs[i]);
+        BOOST_REQUIRE(p[0] == i % 256 && p[SIZE - 1] == i % 256);
+    }
+    free_all(&ptrs);
+}
+
+BOOST_AUTO_TEST_CASE (pool_alloc_release_slabs) {
+    std::size_t before = pool_slabs();
+    Ptrs ptrs;
+    alloc_all(&ptrs);
+    BOOST_CHECK(pool_slabs() > before + 10);
+    free_all(&ptrs);
+    // current and spare slabs of the size class can stay
+    BOOST_CHECK(pool_slabs() <= before + 2);
+}
+
+BOOST_AUTO_TEST_CASE (pool_alloc_free_in_other_thread) {
+    std::size_t before = pool_slabs();
+    Ptrs ptrs;
+    alloc_all(&ptrs);
+    boost::thread t(boost::bind(free_all, &ptrs));
+    t.join();
+    BOOST_CHECK(ptrs.empty());
+    BOOST_CHECK(pool_slabs() <= before + 2);
+    // allocate in other thread, free in this one
+    boost::thread t2(boost::bind(alloc_all, &ptrs));
+    t2.join();
+    BOOST_CHECK(ptrs.size() == N);
+    free_all(&ptrs);
+    BOOST_CHECK(pool_slabs() <= before + 2);
+}
+
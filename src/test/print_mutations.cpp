@@ -0,0 +1,202 @@
+/*
+ * NPG-explorer, Nucleotide PanGenome explorer
+ * Copyright (C) 2012-2016 Boris Nagaev
+ *
+ * See the LICENSE file for terms of use.
+ */
+
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <boost/lexical_cast.hpp>
+#include <boost/bind.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include "PrintMutations.hpp"
+#include "Sequence.hpp"
+#include "Fragment.hpp"
+#include "AlignmentRow.hpp"
+#include "Block.hpp"
+#include "BlockMatrix.hpp"
+#include "BlockSet.hpp"
+#include "name_to_stream.hpp"
+#include "read_file.hpp"
+
+using namespace npge;
+
+static std::string run_print_mutations(BlockSetPtr bs,
+                                       const std::string& format,
+                                       int workers) {
+    set_sstream(":mut");
+    PrintMutations pm;
+    pm.set_block_set(bs);
+    pm.set_workers(workers);
+    pm.set_opt_value("file", std::string(":mut"));
+    pm.set_opt_value("format", format);
+    pm.set_opt_value("compress", false);
+    pm.run();
+    std::string result = read_file(":mut");
+    remove_stream(":mut");
+    return result;
+}
+
+static uint32_t get_u32(const std::string& data, int& offset) {
+    uint32_t result = 0;
+    for (int i = 0; i < 4; i++) {
+        result |= uint32_t((unsigned char)(data[offset + i])) << (i * 8);
+    }
+    offset += 4;
+    return result;
+}
+
+static pos_t get_pos(const std::string& data, int& offset) {
+    uint64_t result = 0;
+    for (int i = 0; i < sizeof(pos_t); i++) {
+        result |= uint64_t((unsigned char)(data[offset + i])) << (i * 8);
+    }
+    offset += sizeof(pos_t);
+    return result;
+}
+
+static std::string get_str(const std::string& data, int& offset) {
+    int length = (unsigned char)(data[offset]);
+    length |= int((unsigned char)(data[offset + 1])) << 8;
+    offset += 2;
+    std::string result = data.substr(offset, length);
+    offset += length;
+    return result;
+}
+
+/** Convert binary output to table without header */
+static std::string binary_to_tsv(const std::string& data) {
+    BOOST_REQUIRE(data.substr(0, 7) == "NPGEMUT");
+    // positions are 64-bit in version 2
+    BOOST_REQUIRE(data[7] == ((sizeof(pos_t) == 8) ? 2 : 1));
+    std::stringstream out;
+    int offset = 8;
+    while (offset < data.size()) {
+        int size = get_u32(data, offset);
+        int end = offset + size;
+        std::string block = get_str(data, offset);
+        std::vector<std::string> fragments(get_u32(data, offset));
+        for (int i = 0; i < fragments.size(); i++) {
+            fragments[i] = get_str(data, offset);
+        }
+        int n = get_u32(data, offset);
+        std::vector<uint32_t> fragment_index(n);
+        for (int i = 0; i < n; i++) {
+            fragment_index[i] = get_u32(data, offset);
+        }
+        std::vector<pos_t> positions(2 * n);
+        for (int i = 0; i < 2 * n; i++) {
+            positions[i] = get_pos(data, offset);
+        }
+        for (int i = 0; i < n; i++) {
+            std::string fragment = fragments[fragment_index[i]];
+            pos_t start = positions[i], stop = positions[n + i];
+            char change = data[offset + i];
+            for (pos_t pos = start; pos <= stop; pos++) {
+                out << block << '\t' << fragment << '\t';
+                out << pos << '\t' << change << '\n';
+            }
+        }
+        offset += n;
+        BOOST_REQUIRE(offset == end);
+    }
+    return out.str();
+}
+
+BOOST_AUTO_TEST_CASE (PrintMutations_binary) {
+    const int GENOMES = 4, BLOCKS = 20, LENGTH = 50;
+    BlockSetPtr bs = new_bs();
+    for (int b = 0; b < BLOCKS; b++) {
+        std::string base;
+        for (int i = 0; i < LENGTH; i++) {
+            base += "ATGC"[rand() % 4];
+        }
+        Block* block = new Block;
+        block->set_name("b" + boost::lexical_cast<std::string>(b));
+        for (int g = 0; g < GENOMES; g++) {
+            std::string row = base, text;
+            for (int i = 1; i < LENGTH; i++) {
+                int r = rand() % 100;
+                if (r < 10) {
+                    row[i] = "ATGC"[rand() % 4];
+                } else if (r < 15) {
+                    row[i] = '-';
+                }
+            }
+            for (int i = 0; i < LENGTH; i++) {
+                if (row[i] != '-') {
+                    text += row[i];
+                }
+            }
+            SequencePtr seq(new InMemorySequence(text));
+            seq->set_name("s" + boost::lexical_cast<std::string>(b) +
+                          "_" + boost::lexical_cast<std::string>(g));
+            bs->add_sequence(seq);
+            Fragment* f = new Fragment(seq, 0, text.size() - 1);
+            new CompactAlignmentRow(row, f);
+            block->insert(f);
+        }
+        bs->insert(block);
+    }
+    std::string tsv = run_print_mutations(bs, "tsv", 1);
+    // remove header
+    tsv = tsv.substr(tsv.find('\n') + 1);
+    BOOST_REQUIRE(!tsv.empty());
+    for (int workers = 1; workers <= 3; workers++) {
+        std::string binary = run_print_mutations(bs, "binary", workers);
+        BOOST_CHECK(binary_to_tsv(binary) == tsv);
+    }
+}
+
+
+static void add_mutation(std::vector<Mutation>* mutations,
+                         const Mutation& m) {
+    mutations->push_back(m);
+}
+
+BOOST_AUTO_TEST_CASE (PrintMutations_windows) {
+    const int W = BLOCK_MATRIX_WINDOW;
+    const int LENGTH = 2 * W + 10;
+    std::string text1;
+    for (int i = 0; i < LENGTH; i++) {
+        text1 += "ATGC"[(i * 7 + i / 3) % 4];
+    }
+    // gap run crossing the border of first and second windows
+    std::string row2 = text1;
+    row2.replace(W - 3, 5, "-----");
+    row2[W + 5] = (row2[W + 5] == 'A') ? 'T' : 'A';
+    std::string text2;
+    for (int i = 0; i < LENGTH; i++) {
+        if (row2[i] != '-') {
+            text2 += row2[i];
+        }
+    }
+    SequencePtr s1(new InMemorySequence(text1));
+    SequencePtr s2(new InMemorySequence(text2));
+    Block block;
+    Fragment* f1 = new Fragment(s1, 0, text1.size() - 1);
+    new CompactAlignmentRow(text1, f1);
+    block.insert(f1);
+    Fragment* f2 = new Fragment(s2, 0, text2.size() - 1);
+    new CompactAlignmentRow(row2, f2);
+    block.insert(f2);
+    Fragment* f3 = new Fragment(s1, 0, text1.size() - 1);
+    new CompactAlignmentRow(text1, f3);
+    block.insert(f3);
+    std::vector<Mutation> mutations;
+    PrintMutations pm;
+    pm.find_mutations(&block, boost::bind(add_mutation, &mutations, _1));
+    BOOST_REQUIRE(mutations.size() == 2);
+    BOOST_CHECK(mutations[0].fragment == f2);
+    BOOST_CHECK(mutations[0].start == W - 3);
+    BOOST_CHECK(mutations[0].stop == W + 1);
+    BOOST_CHECK(mutations[0].change == '-');
+    BOOST_CHECK(mutations[1].fragment == f2);
+    BOOST_CHECK(mutations[1].start == W + 5);
+    BOOST_CHECK(mutations[1].stop == W + 5);
+    BOOST_CHECK(mutations[1].change == row2[W + 5]);
+}
@@ -13,6 +13,7 @@
 #include "Pipe.hpp"
 #include "Filter.hpp"
 #include "Decimal.hpp"
+#include "Exception.hpp"
 
 using namespace npge;
 
@@ -187,3 +188,20 @@ BOOST_AUTO_TEST_CASE (processor_parent) {
     delete parent;
 }
 
+
+BOOST_AUTO_TEST_CASE (processor_interruption) {
+    Processor* parent = new Processor;
+    Processor* child = new Processor;
+    child->set_parent(parent);
+    parent->interrupt();
+    BOOST_CHECK(child->is_interrupted());
+    BOOST_CHECK_THROW(child->run(), Exception);
+    BOOST_CHECK(!parent->is_interrupted());
+    child->interrupt();
+    BOOST_CHECK(child->is_interrupted());
+    BOOST_CHECK(!parent->is_interrupted());
+    child->reset_interruption();
+    BOOST_CHECK(!child->is_interrupted());
+    BOOST_CHECK_NO_THROW(child->run());
+    delete parent;
+}
@@ -5,8 +5,11 @@
  * See the LICENSE file for terms of use.
  */
 
+#include <cstdlib>
 #include <map>
 #include <utility>
+#include <vector>
+#include <boost/lexical_cast.hpp>
 #include <boost/test/unit_test.hpp>
 
 #include "tree.hpp"
@@ -266,3 +269,77 @@ BOOST_AUTO_TEST_CASE (tree_branch_str_compatible) {
     BOOST_CHECK(TreeNode::branches_compatible("0011", "0111"));
     BOOST_CHECK(!TreeNode::branches_compatible("0011", "0110"));
 }
+
+static void check_nj_additive(int leafs_number, int workers) {
+    using namespace npge;
+    TreeNode tree;
+    std::vector<TestLeaf*> leafs;
+    Nodes nodes;
+    for (int i = 0; i < leafs_number; i++) {
+        TestLeaf* leaf = new TestLeaf(boost::lexical_cast<std::string>(i));
+        leafs.push_back(leaf);
+        nodes.push_back(leaf);
+        tree.add_child(leaf);
+    }
+    // random tree with lengths of branches from 1 to 10
+    while (nodes.size() > 1) {
+        int i = rand() % nodes.size();
+        TreeNode* a = nodes[i];
+        nodes.erase(nodes.begin() + i);
+        int j = rand() % nodes.size();
+        TreeNode* b = nodes[j];
+        nodes.erase(nodes.begin() + j);
+        TreeNode* parent = new TreeNode;
+        tree.add_child(parent);
+        parent->add_child(a);
+        parent->add_child(b);
+        a->set_length(1 + rand() % 10);
+        b->set_length(1 + rand() % 10);
+        nodes.push_back(parent);
+    }
+    for (int i = 0; i < leafs_number; i++) {
+        for (int j = i + 1; j < leafs_number; j++) {
+            map[make_pair(leafs[i], leafs[j])] =
+                leafs[i]->tree_distance_to(leafs[j]);
+        }
+    }
+    tree.neighbor_joining(workers);
+    // neighbor joining restores additive distances
+    for (int i = 0; i < leafs_number; i++) {
+        for (int j = i + 1; j < leafs_number; j++) {
+            double expected = map[make_pair(leafs[i], leafs[j])];
+            BOOST_CHECK(almost_equal(leafs[i]->tree_distance_to(leafs[j]),
+                                     expected));
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE (tree_nj_additive) {
+    check_nj_additive(4, 1);
+    check_nj_additive(20, 1);
+    check_nj_additive(300, 1);
+    check_nj_additive(300, 4);
+}
+
+BOOST_AUTO_TEST_CASE (tree_nj_workers) {
+    using namespace npge;
+    TreeNode tree1, tree2;
+    std::vector<TestLeaf*> leafs1, leafs2;
+    for (int i = 0; i < 200; i++) {
+        std::string name = boost::lexical_cast<std::string>(i);
+        leafs1.push_back(new TestLeaf(name));
+        tree1.add_child(leafs1.back());
+        leafs2.push_back(new TestLeaf(name));
+        tree2.add_child(leafs2.back());
+    }
+    for (int i = 0; i < leafs1.size(); i++) {
+        for (int j = i + 1; j < leafs1.size(); j++) {
+            double d = rand() % 20; // many equal distances
+            map[make_pair(leafs1[i], leafs1[j])] = d;
+            map[make_pair(leafs2[i], leafs2[j])] = d;
+        }
+    }
+    tree1.neighbor_joining(1);
+    tree2.neighbor_joining(3);
+    BOOST_CHECK(tree1.newick() == tree2.newick());
+}
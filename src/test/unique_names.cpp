@@ -0,0 +1,47 @@
+/*
+ * NPG-explorer, Nucleotide PanGenome explorer
+ * Copyright (C) 2012-2016 Boris Nagaev
+ *
+ * See the LICENSE file for terms of use.
+ */
+
+#include <boost/test/unit_test.hpp>
+
+#include "UniqueNames.hpp"
+#include "Sequence.hpp"
+#include "Fragment.hpp"
+#include "Block.hpp"
+#include "BlockSet.hpp"
+
+using namespace npge;
+
+BOOST_AUTO_TEST_CASE (UniqueNames_main) {
+    SequencePtr s1 = boost::make_shared<InMemorySequence>("AAAACCCCGGGGTTTT");
+    SequencePtr s2 = boost::make_shared<InMemorySequence>("AAAACCCCGGGGTTTT");
+    s1->set_name("s");
+    s2->set_name("s");
+    BlockSetPtr bs = new_bs();
+    bs->add_sequence(s1);
+    bs->add_sequence(s2);
+    Block* b1 = new Block("a");
+    b1->insert(new Fragment(s1, 0, 1));
+    b1->insert(new Fragment(s2, 0, 1));
+    Block* b2 = new Block("a");
+    b2->insert(new Fragment(s1, 2, 7));
+    Block* b3 = new Block("a");
+    b3->insert(new Fragment(s1, 8, 9));
+    Block* b4 = new Block("an1");
+    b4->insert(new Fragment(s2, 2, 9));
+    bs->insert(b1);
+    bs->insert(b2);
+    bs->insert(b3);
+    bs->insert(b4);
+    UniqueNames un;
+    un.set_opt_value("workers", 2);
+    un.apply(bs);
+    BOOST_CHECK(b1->name() == "a");
+    BOOST_CHECK(b2->name() == "an2");
+    BOOST_CHECK(b3->name() == "an3");
+    BOOST_CHECK(b4->name() == "an1");
+    BOOST_CHECK(s1->name() != s2->name());
+}
@@ -4,43 +4,137 @@
 # See the LICENSE file for terms of use.
 
 # This script reads standard input, writes to standard output
+# Input is output of PrintMutations (--format=tsv or --format=binary)
 
+import array
+import struct
 import sys
 
-previous_fields = None
-
-for line in sys.stdin:
-    line = line.strip()
-    fields = line.split('\t')
-    # recover values of "dotted" fields from previous line
-    for i in range(4):
-        if fields[i] == '.':
-            fields[i] = previous_fields[i]
-    block = fields[0]
-    fragment = fields[1]
-    start = fields[2]
-    stop_or_letter = fields[3]
-    if fragment == 'fragment':
-        # skip header line
-        continue
-    start = int(start)
+MAGIC = b'NPGEMUT'
+
+# version byte after MAGIC: 1 for 32-bit positions, 2 for 64-bit
+POS_SIZES = {b'\x01': 4, b'\x02': 8}
+
+def read_exactly(stream, size):
+    data = stream.read(size)
+    if len(data) != size:
+        raise Exception('Unexpected end of mutations file')
+    return data
+
+def read_column(data, offset, n, size):
+    """Read n little-endian unsigned ints of size bytes"""
+    for typecode in 'ILQ':
+        column = array.array(typecode)
+        if column.itemsize == size:
+            break
+    assert column.itemsize == size
+    end = offset + size * n
+    if hasattr(column, 'frombytes'):
+        column.frombytes(data[offset:end])
+    else:
+        column.fromstring(data[offset:end])
+    if sys.byteorder != 'little':
+        column.byteswap()
+    return column, end
+
+def read_str(data, offset):
+    length, = struct.unpack_from('<H', data, offset)
+    offset += 2
+    return data[offset:offset + length].decode('utf-8'), offset + length
+
+def binary_chunks(stream, pos_size):
+    """Yield (block, fragments, fragment, start, stop, change)
+    for each chunk of binary file (after magic and version).
+    fragment, start, stop are arrays of ints,
+    change is string, fragments is list of fragment ids."""
+    while True:
+        size = stream.read(4)
+        if not size:
+            return
+        if len(size) != 4:
+            raise Exception('Unexpected end of mutations file')
+        size, = struct.unpack('<I', size)
+        data = read_exactly(stream, size)
+        block, offset = read_str(data, 0)
+        n_fragments, = struct.unpack_from('<I', data, offset)
+        offset += 4
+        fragments = []
+        for _ in range(n_fragments):
+            fragment, offset = read_str(data, offset)
+            fragments.append(fragment)
+        n, = struct.unpack_from('<I', data, offset)
+        offset += 4
+        fragment, offset = read_column(data, offset, n, 4)
+        start, offset = read_column(data, offset, n, pos_size)
+        stop, offset = read_column(data, offset, n, pos_size)
+        change = data[offset:offset + n].decode('ascii')
+        yield block, fragments, fragment, start, stop, change
+
+def binary_mutations(stream, pos_size):
+    """Yield (block, fragment, start, stop, change)"""
+    for chunk in binary_chunks(stream, pos_size):
+        block, fragments, fragment, start, stop, change = chunk
+        for i in range(len(change)):
+            yield (block, fragments[fragment[i]],
+                   start[i], stop[i], change[i])
+
+def tsv_mutations(lines):
+    """Yield (block, fragment, start, stop, change)"""
+    previous_fields = None
+    for line in lines:
+        line = line.decode('utf-8').strip()
+        fields = line.split('\t')
+        # recover values of "dotted" fields from previous line
+        for i in range(4):
+            if fields[i] == '.':
+                fields[i] = previous_fields[i]
+        previous_fields = fields
+        block = fields[0]
+        fragment = fields[1]
+        start = fields[2]
+        stop_or_letter = fields[3]
+        if fragment == 'fragment':
+            # skip header line
+            continue
+        start = int(start)
+        try:
+            stop = int(stop_or_letter)
+            # gap
+            yield block, fragment, start, stop, '-'
+        except ValueError:
+            # substitution or gap of length 1
+            new_letter = stop_or_letter
+            assert len(new_letter) == 1
+            yield block, fragment, start, start, new_letter
+
+def read_mutations(stream):
+    """Yield (block, fragment, start, stop, change) from binary stream.
+    Format of file (tsv or binary) is detected automatically."""
+    first = stream.read(len(MAGIC) + 1)
+    if first[:len(MAGIC)] == MAGIC:
+        version = first[len(MAGIC):]
+        if version not in POS_SIZES:
+            raise Exception('Unknown version of mutations file')
+        return binary_mutations(stream, POS_SIZES[version])
+    # text file, first line was partially read
+    first_lines = (first + stream.readline()).splitlines(True)
+    def lines():
+        for line in first_lines:
+            yield line
+        for line in stream:
+            yield line
+    return tsv_mutations(lines())
+
+def main():
+    stream = getattr(sys.stdin, 'buffer', sys.stdin)
     format_line = "%(block)s %(fragment)s %(pos)d %(change)s"
-    try:
-        stop = int(stop_or_letter)
-        # gap
+    for block, fragment, start, stop, change in read_mutations(stream):
         for pos in range(start, stop + 1):
             print(format_line % {
                 'block': block,
                 'fragment': fragment,
                 'pos': pos,
-                'change': '-'})
-    except:
-        # substitution or gap of length 1
-        new_letter = stop_or_letter
-        assert len(new_letter) == 1
-        print(format_line % {
-            'block': block,
-            'fragment': fragment,
-            'pos': start,
-            'change': new_letter})
-    previous_fields = fields
+                'change': change})
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,65 @@
+/*
+ * NPG-explorer, Nucleotide PanGenome explorer
+ * Copyright (C) 2012-2016 Boris Nagaev
+ *
+ * See the LICENSE file for terms of use.
+ */
+
+#include <cstring>
+
+#include "CommandReader.hpp"
+#include "Exception.hpp"
+
+#if defined(_WIN32) || defined(__WIN32__)
+#define npge_popen _popen
+#define npge_pclose _pclose
+#else
+#define npge_popen popen
+#define npge_pclose pclose
+#endif
+
+namespace npge {
+
+CommandReader::CommandReader(const std::string& cmd) {
+    pipe_ = npge_popen(cmd.c_str(), "r");
+    if (!pipe_) {
+        throw Exception("Can not start command: " + cmd);
+    }
+}
+
+CommandReader::~CommandReader() {
+    close();
+}
+
+bool CommandReader::getline(std::string& line) {
+    line.clear();
+    if (!pipe_) {
+        return false;
+    }
+    const int BUFFER_SIZE = 4096;
+    char buffer[BUFFER_SIZE];
+    while (std::fgets(buffer, BUFFER_SIZE, pipe_)) {
+        int length = std::strlen(buffer);
+        if (length > 0 && buffer[length - 1] == '\n') {
+            line.append(buffer, length - 1);
+            if (!line.empty() && line[line.size() - 1] == '\r') {
+                line.resize(line.size() - 1);
+            }
+            return true;
+        }
+        line.append(buffer, length);
+    }
+    return !line.empty();
+}
+
+int CommandReader::close() {
+    if (!pipe_) {
+        return 0;
+    }
+    int result = npge_pclose(pipe_);
+    pipe_ = 0;
+    return result;
+}
+
+}
+
@@ -0,0 +1,46 @@
+/*
+ * NPG-explorer, Nucleotide PanGenome explorer
+ * Copyright (C) 2012-2016 Boris Nagaev
+ *
+ * See the LICENSE file for terms of use.
+ */
+
+#ifndef NPGE_COMMAND_READER_HPP_
+#define NPGE_COMMAND_READER_HPP_
+
+#include <cstdio>
+#include <string>
+#include <boost/utility.hpp>
+
+namespace npge {
+
+/** Reader of standard output of external command.
+The command is started by the constructor (using popen).
+Lines of its output can be read while the command runs.
+*/
+class CommandReader : boost::noncopyable {
+public:
+    /** Start the command.
+    Throws Exception if the command can not be started.
+    */
+    CommandReader(const std::string& cmd);
+
+    /** Destructor. Waits for the command if it was not closed */
+    ~CommandReader();
+
+    /** Read next line of output without trailing end of line.
+    Return false if the output is over.
+    */
+    bool getline(std::string& line);
+
+    /** Wait for the command to finish and return its exit code */
+    int close();
+
+private:
+    std::FILE* pipe_;
+};
+
+}
+
+#endif
+
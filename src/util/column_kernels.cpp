@@ -0,0 +1,405 @@
+/*
+ * NPG-explorer, Nucleotide PanGenome explorer
+ * Copyright (C) 2012-2016 Boris Nagaev
+ *
+ * See the LICENSE file for terms of use.
+ */
+
+#include <algorithm>
+
+#include "config.hpp"
+#include "column_kernels.hpp"
+#include "char_to_size.hpp"
+
+#if defined(NPGE_SIMD) && defined(__GNUC__) && \
+    (defined(__x86_64__) || defined(__i386__))
+#define NPGE_X86_KERNELS
+#include <immintrin.h>
+#define NPGE_TARGET(isa) __attribute__((target(isa)))
+#endif
+
+namespace npge {
+
+// Columns are processed in two steps: vectorized loop over rows
+// collects bits of letters seen in each column, then flags are
+// derived from the bits one column at a time.
+
+const unsigned char A_BIT = 1;
+const unsigned char T_BIT = 2;
+const unsigned char G_BIT = 4;
+const unsigned char C_BIT = 8;
+const unsigned char N_BIT = 16;
+const unsigned char GAP_BIT = 32;
+const unsigned char LETTER_BITS = 31;
+
+enum Isa {
+    SCALAR_ISA,
+    SSE2_ISA,
+    AVX2_ISA
+};
+
+static bool is_supported(Isa isa) {
+    if (isa == SCALAR_ISA) {
+        return true;
+    }
+#ifdef NPGE_X86_KERNELS
+    __builtin_cpu_init();
+    if (isa == SSE2_ISA) {
+        return __builtin_cpu_supports("sse2");
+    }
+    if (isa == AVX2_ISA) {
+        return __builtin_cpu_supports("avx2");
+    }
+#endif
+    return false;
+}
+
+static Isa best_isa() {
+    if (is_supported(AVX2_ISA)) {
+        return AVX2_ISA;
+    } else if (is_supported(SSE2_ISA)) {
+        return SSE2_ISA;
+    } else {
+        return SCALAR_ISA;
+    }
+}
+
+static Isa& current_isa() {
+    static Isa isa = best_isa();
+    return isa;
+}
+
+static unsigned char letter_bit(char c, char gap) {
+    if (c == gap) {
+        return GAP_BIT;
+    } else if (c == 'A') {
+        return A_BIT;
+    } else if (c == 'T') {
+        return T_BIT;
+    } else if (c == 'G') {
+        return G_BIT;
+    } else if (c == 'C') {
+        return C_BIT;
+    } else {
+        return N_BIT;
+    }
+}
+
+static unsigned char flags_of(unsigned char seen) {
+    unsigned char letters = seen & LETTER_BITS;
+    unsigned char flags = 0;
+    if ((letters & (letters - 1)) == 0) {
+        flags |= IDENT_COLUMN;
+    }
+    if (seen & GAP_BIT) {
+        flags |= GAP_COLUMN;
+    }
+    if (letters == 0) {
+        flags |= PURE_GAP_COLUMN;
+    }
+    if (seen & N_BIT) {
+        flags |= N_COLUMN;
+    }
+    return flags;
+}
+
+static void seen_scalar(unsigned char* seen, const char* const* rows,
+                        int nrows, int begin, int end, char gap) {
+    std::fill(seen + begin, seen + end, 0);
+    for (int r = 0; r < nrows; r++) {
+        const char* row = rows[r];
+        for (int col = begin; col < end; col++) {
+            seen[col] |= letter_bit(row[col], gap);
+        }
+    }
+}
+
+#ifdef NPGE_X86_KERNELS
+NPGE_TARGET("sse2")
+static int seen_sse2(unsigned char* seen, const char* const* rows,
+                     int nrows, int length, char gap) {
+    const __m128i a = _mm_set1_epi8('A');
+    const __m128i t = _mm_set1_epi8('T');
+    const __m128i g = _mm_set1_epi8('G');
+    const __m128i c = _mm_set1_epi8('C');
+    const __m128i gp = _mm_set1_epi8(gap);
+    const __m128i a_bit = _mm_set1_epi8(A_BIT);
+    const __m128i t_bit = _mm_set1_epi8(T_BIT);
+    const __m128i g_bit = _mm_set1_epi8(G_BIT);
+    const __m128i c_bit = _mm_set1_epi8(C_BIT);
+    const __m128i n_bit = _mm_set1_epi8(N_BIT);
+    const __m128i gap_bit = _mm_set1_epi8(GAP_BIT);
+    int col = 0;
+    for (; col + 16 <= length; col += 16) {
+        __m128i acc = _mm_setzero_si128();
+        for (int r = 0; r < nrows; r++) {
+            __m128i x = _mm_loadu_si128(
+                            reinterpret_cast<const __m128i*>(rows[r] + col));
+            __m128i is_a = _mm_cmpeq_epi8(x, a);
+            __m128i is_t = _mm_cmpeq_epi8(x, t);
+            __m128i is_g = _mm_cmpeq_epi8(x, g);
+            __m128i is_c = _mm_cmpeq_epi8(x, c);
+            __m128i is_gap = _mm_cmpeq_epi8(x, gp);
+            __m128i known = _mm_or_si128(_mm_or_si128(is_a, is_t),
+                                         _mm_or_si128(is_g, is_c));
+            known = _mm_or_si128(known, is_gap);
+            __m128i bits = _mm_andnot_si128(known, n_bit);
+            bits = _mm_or_si128(bits, _mm_and_si128(is_a, a_bit));
+            bits = _mm_or_si128(bits, _mm_and_si128(is_t, t_bit));
+            bits = _mm_or_si128(bits, _mm_and_si128(is_g, g_bit));
+            bits = _mm_or_si128(bits, _mm_and_si128(is_c, c_bit));
+            bits = _mm_or_si128(bits, _mm_and_si128(is_gap, gap_bit));
+            acc = _mm_or_si128(acc, bits);
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(seen + col), acc);
+    }
+    return col;
+}
+
+NPGE_TARGET("avx2")
+static int seen_avx2(unsigned char* seen, const char* const* rows,
+                     int nrows, int length, char gap) {
+    const __m256i a = _mm256_set1_epi8('A');
+    const __m256i t = _mm256_set1_epi8('T');
+    const __m256i g = _mm256_set1_epi8('G');
+    const __m256i c = _mm256_set1_epi8('C');
+    const __m256i gp = _mm256_set1_epi8(gap);
+    const __m256i a_bit = _mm256_set1_epi8(A_BIT);
+    const __m256i t_bit = _mm256_set1_epi8(T_BIT);
+    const __m256i g_bit = _mm256_set1_epi8(G_BIT);
+    const __m256i c_bit = _mm256_set1_epi8(C_BIT);
+    const __m256i n_bit = _mm256_set1_epi8(N_BIT);
+    const __m256i gap_bit = _mm256_set1_epi8(GAP_BIT);
+    int col = 0;
+    for (; col + 32 <= length; col += 32) {
+        __m256i acc = _mm256_setzero_si256();
+        for (int r = 0; r < nrows; r++) {
+            __m256i x = _mm256_loadu_si256(
+                            reinterpret_cast<const __m256i*>(rows[r] + col));
+            __m256i is_a = _mm256_cmpeq_epi8(x, a);
+            __m256i is_t = _mm256_cmpeq_epi8(x, t);
+            __m256i is_g = _mm256_cmpeq_epi8(x, g);
+            __m256i is_c = _mm256_cmpeq_epi8(x, c);
+            __m256i is_gap = _mm256_cmpeq_epi8(x, gp);
+            __m256i known = _mm256_or_si256(_mm256_or_si256(is_a, is_t),
+                                            _mm256_or_si256(is_g, is_c));
+            known = _mm256_or_si256(known, is_gap);
+            __m256i bits = _mm256_andnot_si256(known, n_bit);
+            bits = _mm256_or_si256(bits, _mm256_and_si256(is_a, a_bit));
+            bits = _mm256_or_si256(bits, _mm256_and_si256(is_t, t_bit));
+            bits = _mm256_or_si256(bits, _mm256_and_si256(is_g, g_bit));
+            bits = _mm256_or_si256(bits, _mm256_and_si256(is_c, c_bit));
+            bits = _mm256_or_si256(bits,
+                                   _mm256_and_si256(is_gap, gap_bit));
+            acc = _mm256_or_si256(acc, bits);
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(seen + col), acc);
+    }
+    return col;
+}
+#endif
+
+void classify_columns(unsigned char* flags, const char* const* rows,
+                      int nrows, int length, char gap) {
+    // flags is used as buffer of seen bits
+    int done = 0;
+#ifdef NPGE_X86_KERNELS
+    if (current_isa() == AVX2_ISA) {
+        done = seen_avx2(flags, rows, nrows, length, gap);
+    } else if (current_isa() == SSE2_ISA) {
+        done = seen_sse2(flags, rows, nrows, length, gap);
+    }
+#endif
+    seen_scalar(flags, rows, nrows, done, length, gap);
+    for (int col = 0; col < length; col++) {
+        flags[col] = flags_of(flags[col]);
+    }
+}
+
+// count is indexed by char_to_size
+static void finish_column(char* consensus, int* atgc,
+                          const int* count, int col) {
+    if (consensus) {
+        int best = 0;
+        for (int letter = 1; letter < LETTERS_NUMBER; letter++) {
+            if (count[letter] > count[best]) {
+                best = letter;
+            }
+        }
+        consensus[col] = size_to_char(best);
+    }
+    if (atgc) {
+        for (int letter = 0; letter < LETTERS_NUMBER; letter++) {
+            atgc[letter] += count[letter];
+        }
+    }
+}
+
+static void count_scalar(char* consensus, int* atgc,
+                         const char* const* rows, int nrows,
+                         int begin, int end, char gap) {
+    for (int col = begin; col < end; col++) {
+        int count[LETTERS_NUMBER] = {0};
+        for (int r = 0; r < nrows; r++) {
+            char c = rows[r][col];
+            if (c != gap) {
+                count[char_to_size(c)] += 1;
+            }
+        }
+        finish_column(consensus, atgc, count, col);
+    }
+}
+
+#ifdef NPGE_X86_KERNELS
+// Byte counters overflow after 255 rows
+const int MAX_BYTE_COUNT = 255;
+
+NPGE_TARGET("sse2")
+static int count_sse2(char* consensus, int* atgc,
+                      const char* const* rows, int nrows, int length,
+                      char gap) {
+    const __m128i letters[4] = {
+        _mm_set1_epi8('A'), _mm_set1_epi8('T'),
+        _mm_set1_epi8('G'), _mm_set1_epi8('C')
+    };
+    const __m128i gp = _mm_set1_epi8(gap);
+    int col = 0;
+    for (; col + 16 <= length; col += 16) {
+        // A, T, G, C, gap
+        int count[5][16] = {{0}};
+        for (int r0 = 0; r0 < nrows; r0 += MAX_BYTE_COUNT) {
+            int r1 = std::min(nrows, r0 + MAX_BYTE_COUNT);
+            __m128i acc[5];
+            for (int k = 0; k < 5; k++) {
+                acc[k] = _mm_setzero_si128();
+            }
+            for (int r = r0; r < r1; r++) {
+                __m128i x = _mm_loadu_si128(
+                                reinterpret_cast<const __m128i*>(rows[r] + col));
+                for (int k = 0; k < 4; k++) {
+                    // cmpeq gives -1 for equal bytes
+                    acc[k] = _mm_sub_epi8(acc[k],
+                                          _mm_cmpeq_epi8(x, letters[k]));
+                }
+                acc[4] = _mm_sub_epi8(acc[4], _mm_cmpeq_epi8(x, gp));
+            }
+            for (int k = 0; k < 5; k++) {
+                unsigned char bytes[16];
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(bytes),
+                                 acc[k]);
+                for (int i = 0; i < 16; i++) {
+                    count[k][i] += bytes[i];
+                }
+            }
+        }
+        for (int i = 0; i < 16; i++) {
+            int letter_count[LETTERS_NUMBER];
+            int known = 0;
+            for (int k = 0; k < 4; k++) {
+                letter_count[k] = count[k][i];
+                known += count[k][i];
+            }
+            letter_count[N] = nrows - count[4][i] - known;
+            finish_column(consensus, atgc, letter_count, col + i);
+        }
+    }
+    return col;
+}
+
+NPGE_TARGET("avx2")
+static int count_avx2(char* consensus, int* atgc,
+                      const char* const* rows, int nrows, int length,
+                      char gap) {
+    const __m256i letters[4] = {
+        _mm256_set1_epi8('A'), _mm256_set1_epi8('T'),
+        _mm256_set1_epi8('G'), _mm256_set1_epi8('C')
+    };
+    const __m256i gp = _mm256_set1_epi8(gap);
+    int col = 0;
+    for (; col + 32 <= length; col += 32) {
+        // A, T, G, C, gap
+        int count[5][32] = {{0}};
+        for (int r0 = 0; r0 < nrows; r0 += MAX_BYTE_COUNT) {
+            int r1 = std::min(nrows, r0 + MAX_BYTE_COUNT);
+            __m256i acc[5];
+            for (int k = 0; k < 5; k++) {
+                acc[k] = _mm256_setzero_si256();
+            }
+            for (int r = r0; r < r1; r++) {
+                __m256i x = _mm256_loadu_si256(
+                                reinterpret_cast<const __m256i*>(rows[r] + col));
+                for (int k = 0; k < 4; k++) {
+                    acc[k] = _mm256_sub_epi8(acc[k],
+                                             _mm256_cmpeq_epi8(x, letters[k]));
+                }
+                acc[4] = _mm256_sub_epi8(acc[4], _mm256_cmpeq_epi8(x, gp));
+            }
+            for (int k = 0; k < 5; k++) {
+                unsigned char bytes[32];
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(bytes),
+                                    acc[k]);
+                for (int i = 0; i < 32; i++) {
+                    count[k][i] += bytes[i];
+                }
+            }
+        }
+        for (int i = 0; i < 32; i++) {
+            int letter_count[LETTERS_NUMBER];
+            int known = 0;
+            for (int k = 0; k < 4; k++) {
+                letter_count[k] = count[k][i];
+                known += count[k][i];
+            }
+            letter_count[N] = nrows - count[4][i] - known;
+            finish_column(consensus, atgc, letter_count, col + i);
+        }
+    }
+    return col;
+}
+#endif
+
+void count_columns(char* consensus, int* atgc,
+                   const char* const* rows, int nrows, int length,
+                   char gap) {
+    int done = 0;
+#ifdef NPGE_X86_KERNELS
+    if (current_isa() == AVX2_ISA) {
+        done = count_avx2(consensus, atgc, rows, nrows, length, gap);
+    } else if (current_isa() == SSE2_ISA) {
+        done = count_sse2(consensus, atgc, rows, nrows, length, gap);
+    }
+#endif
+    count_scalar(consensus, atgc, rows, nrows, done, length, gap);
+}
+
+std::string column_kernels_isa() {
+    Isa isa = current_isa();
+    if (isa == AVX2_ISA) {
+        return "avx2";
+    } else if (isa == SSE2_ISA) {
+        return "sse2";
+    } else {
+        return "scalar";
+    }
+}
+
+bool set_column_kernels_isa(const std::string& name) {
+    Isa isa;
+    if (name == "avx2") {
+        isa = AVX2_ISA;
+    } else if (name == "sse2") {
+        isa = SSE2_ISA;
+    } else if (name == "scalar") {
+        isa = SCALAR_ISA;
+    } else {
+        return false;
+    }
+    if (!is_supported(isa)) {
+        return false;
+    }
+    current_isa() = isa;
+    return true;
+}
+
+}
+
@@ -0,0 +1,67 @@
+/*
+ * NPG-explorer, Nucleotide PanGenome explorer
+ * Copyright (C) 2012-2016 Boris Nagaev
+ *
+ * See the LICENSE file for terms of use.
+ */
+
+#ifndef NPGE_COLUMN_KERNELS_HPP_
+#define NPGE_COLUMN_KERNELS_HPP_
+
+#include <string>
+
+namespace npge {
+
+/** Flags of alignment column set by classify_columns() */
+enum ColumnFlag {
+    IDENT_COLUMN = 1, /**< At most one distinct letter */
+    GAP_COLUMN = 2, /**< Has gaps */
+    PURE_GAP_COLUMN = 4, /**< Has only gaps (or no rows) */
+    N_COLUMN = 8 /**< Has letter N */
+};
+
+/** Classify columns of alignment.
+\param flags Output array of length elements, combinations of ColumnFlag
+\param rows Array of nrows pointers to rows, each of length letters
+\param nrows Number of rows
+\param length Number of columns
+\param gap Gap character
+
+Letters are expected to be 'A', 'T', 'G', 'C', 'N'.
+Other non-gap characters are treated as 'N'.
+Columns are processed in groups of 32 or 16 using AVX2
+or SSE2 if supported by CPU.
+*/
+void classify_columns(unsigned char* flags, const char* const* rows,
+                      int nrows, int length, char gap);
+
+/** Count letters in columns of alignment.
+\param consensus Output array of length most frequent letters or 0.
+    The first of most frequent letters (in order of char_to_size)
+    is selected; 'A' is selected for columns of gaps.
+\param atgc Array of LETTERS_NUMBER counters or 0.
+    Numbers of letters in all columns are added to it.
+\param rows Array of nrows pointers to rows, each of length letters
+\param nrows Number of rows
+\param length Number of columns
+\param gap Gap character
+
+Non-gap characters other than 'A', 'T', 'G', 'C' are counted as 'N'.
+*/
+void count_columns(char* consensus, int* atgc,
+                   const char* const* rows, int nrows, int length,
+                   char gap);
+
+/** Return instruction set used by kernels ("avx2", "sse2", "scalar") */
+std::string column_kernels_isa();
+
+/** Select instruction set used by kernels.
+Return false if it is not supported by CPU or by this build.
+By default the best supported one is used.
+*/
+bool set_column_kernels_isa(const std::string& isa);
+
+}
+
+#endif
+
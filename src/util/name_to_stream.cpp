@@ -121,7 +121,7 @@ void remove_istream(const std::string& name) {
     custom_istreams_.erase(name);
 }
 
-OstreamPtr name_to_ostream(const std::string& name) {
+OstreamPtr name_to_ostream(const std::string& name, bool binary) {
     boost::mutex::scoped_lock lock(ostreams_mutex_);
     Omap::const_iterator it = custom_ostreams_.find(name);
     if (it != custom_ostreams_.end()) {
@@ -129,8 +129,12 @@ OstreamPtr name_to_ostream(const std::string& name) {
     } else if (name.empty() || name[0] == ':') {
         return boost::make_shared<std::ostringstream>();
     } else {
+        std::ios_base::openmode mode = std::ios_base::out;
+        if (binary) {
+            mode |= std::ios_base::binary;
+        }
         boost::shared_ptr<std::ofstream> result =
-            boost::make_shared<std::ofstream>(name.c_str());
+            boost::make_shared<std::ofstream>(name.c_str(), mode);
         if (!result->is_open()) {
             throw Exception("Error opening file " + name);
         }
@@ -46,7 +46,8 @@ If name is predefined (see set_ostream()), returns corresponding stream.
 
 If name starts with ':' or is empty, returns std::ostringstream.
 
-Otherwise returns std::ofstream.
+Otherwise returns std::ofstream. If binary is true, the file is
+opened in binary mode (no conversion of newlines).
 
 Previous results are cached. To get them deleted/closed, call remove_ostream().
 
@@ -54,7 +55,8 @@ Such names are accepted by FileWriter, FileReader and AbstractOutput.
 
 This function is thread-safe.
 */
-boost::shared_ptr<std::ostream> name_to_ostream(const std::string& name);
+boost::shared_ptr<std::ostream> name_to_ostream(const std::string& name,
+        bool binary = false);
 
 /** Associate input stream with given filename.
 Predefined input streams (can be changed using this function):
@@ -0,0 +1,286 @@
+/*
+ * NPG-explorer, Nucleotide PanGenome explorer
+ * Copyright (C) 2012-2016 Boris Nagaev
+ *
+ * See the LICENSE file for terms of use.
+ */
+
+#include <new>
+#include <map>
+#include "boost-xtime.hpp"
+#include <boost/thread/tss.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include "pool_alloc.hpp"
+
+namespace npge {
+
+// chunks are aligned as max_align_t
+const std::size_t POOL_STEP = 16;
+const std::size_t POOL_MAX_SIZE = 256;
+const int POOL_CLASSES = POOL_MAX_SIZE / POOL_STEP;
+const std::size_t SLAB_SIZE = 64 * 1024;
+
+// max number of free chunks of one class in thread cache
+const int CACHE_MAX = 1024;
+
+// number of chunks moved between thread cache and global list
+const int CACHE_BATCH = 256;
+
+struct FreeChunk {
+    FreeChunk* next;
+};
+
+struct Slab {
+    char* begin;
+    FreeChunk* free; // chunks returned to this slab
+    int free_count;
+    int carved; // chunks ever handed out of this slab
+    // list of slabs having free chunks, except current slab
+    Slab* prev;
+    Slab* next;
+
+    Slab(char* b):
+        begin(b), free(0), free_count(0), carved(0),
+        prev(0), next(0) {
+    }
+};
+
+typedef std::map<char*, Slab*> Slabs;
+
+struct SizeClass {
+    boost::mutex mutex;
+    Slabs slabs; // all slabs of this class by address
+    Slab* partial; // slabs having free chunks
+    Slab* current; // slab being carved
+    char* slab_pos;
+    char* slab_end;
+    Slab* spare; // empty slab kept to avoid malloc/free thrash
+
+    SizeClass():
+        partial(0), current(0), slab_pos(0), slab_end(0), spare(0) {
+    }
+};
+
+static SizeClass* size_classes() {
+    // never deleted: objects can be freed from static destructors
+    static SizeClass* classes = new SizeClass[POOL_CLASSES];
+    return classes;
+}
+
+static int class_of(std::size_t size) {
+    return (size + POOL_STEP - 1) / POOL_STEP - 1;
+}
+
+static std::size_t chunk_size(int cls) {
+    return (cls + 1) * POOL_STEP;
+}
+
+static void unlink_partial(SizeClass& sc, Slab* slab) {
+    if (slab->prev) {
+        slab->prev->next = slab->next;
+    } else {
+        sc.partial = slab->next;
+    }
+    if (slab->next) {
+        slab->next->prev = slab->prev;
+    }
+    slab->prev = slab->next = 0;
+}
+
+static void link_partial(SizeClass& sc, Slab* slab) {
+    slab->prev = 0;
+    slab->next = sc.partial;
+    if (sc.partial) {
+        sc.partial->prev = slab;
+    }
+    sc.partial = slab;
+}
+
+static void new_current(SizeClass& sc) {
+    Slab* slab = sc.spare;
+    sc.spare = 0;
+    if (!slab) {
+        char* begin = static_cast<char*>(::operator new(SLAB_SIZE));
+        slab = new Slab(begin);
+        sc.slabs[begin] = slab;
+    }
+    sc.current = slab;
+    sc.slab_pos = slab->begin;
+    sc.slab_end = slab->begin + SLAB_SIZE;
+}
+
+/** Release slab if all its chunks are free (locked) */
+static void release_if_empty(SizeClass& sc, Slab* slab) {
+    if (slab == sc.current || slab->free_count != slab->carved) {
+        return;
+    }
+    unlink_partial(sc, slab);
+    slab->free = 0;
+    slab->free_count = 0;
+    slab->carved = 0;
+    if (!sc.spare) {
+        sc.spare = slab;
+    } else {
+        sc.slabs.erase(slab->begin);
+        ::operator delete(slab->begin);
+        delete slab;
+    }
+}
+
+/** Move up to n chunks from global lists to the list (locked) */
+static int take_chunks(int cls, FreeChunk*& list, int n) {
+    SizeClass& sc = size_classes()[cls];
+    boost::mutex::scoped_lock lock(sc.mutex);
+    int taken = 0;
+    while (taken < n && sc.partial) {
+        Slab* slab = sc.partial;
+        while (taken < n && slab->free) {
+            FreeChunk* chunk = slab->free;
+            slab->free = chunk->next;
+            slab->free_count -= 1;
+            chunk->next = list;
+            list = chunk;
+            taken += 1;
+        }
+        if (!slab->free) {
+            unlink_partial(sc, slab);
+        }
+    }
+    std::size_t size = chunk_size(cls);
+    while (taken < n) {
+        if (sc.slab_pos + size > sc.slab_end) {
+            Slab* old = sc.current;
+            new_current(sc);
+            if (old && old->free) {
+                link_partial(sc, old);
+                release_if_empty(sc, old);
+            }
+        }
+        FreeChunk* chunk = reinterpret_cast<FreeChunk*>(sc.slab_pos);
+        sc.slab_pos += size;
+        sc.current->carved += 1;
+        chunk->next = list;
+        list = chunk;
+        taken += 1;
+    }
+    return taken;
+}
+
+/** Move up to n chunks from the list to their slabs (locked) */
+static int give_chunks(int cls, FreeChunk*& list, int n) {
+    SizeClass& sc = size_classes()[cls];
+    boost::mutex::scoped_lock lock(sc.mutex);
+    int given = 0;
+    while (given < n && list) {
+        FreeChunk* chunk = list;
+        list = chunk->next;
+        char* addr = reinterpret_cast<char*>(chunk);
+        Slabs::iterator it = sc.slabs.upper_bound(addr);
+        --it;
+        Slab* slab = it->second;
+        if (!slab->free && slab != sc.current) {
+            link_partial(sc, slab);
+        }
+        chunk->next = slab->free;
+        slab->free = chunk;
+        slab->free_count += 1;
+        release_if_empty(sc, slab);
+        given += 1;
+    }
+    return given;
+}
+
+struct ThreadCache {
+    FreeChunk* free[POOL_CLASSES];
+    int size[POOL_CLASSES];
+
+    ThreadCache() {
+        for (int cls = 0; cls < POOL_CLASSES; cls++) {
+            free[cls] = 0;
+            size[cls] = 0;
+        }
+    }
+
+    ~ThreadCache() {
+        flush();
+    }
+
+    void flush() {
+        for (int cls = 0; cls < POOL_CLASSES; cls++) {
+            size[cls] -= give_chunks(cls, free[cls], size[cls]);
+        }
+    }
+};
+
+static boost::thread_specific_ptr<ThreadCache>& thread_caches() {
+    static boost::thread_specific_ptr<ThreadCache>* tss =
+        new boost::thread_specific_ptr<ThreadCache>;
+    return *tss;
+}
+
+static ThreadCache* thread_cache() {
+    boost::thread_specific_ptr<ThreadCache>& tss = thread_caches();
+    ThreadCache* cache = tss.get();
+    if (!cache) {
+        cache = new ThreadCache;
+        tss.reset(cache);
+    }
+    return cache;
+}
+
+void* pool_alloc(std::size_t size) {
+    if (size == 0 || size > POOL_MAX_SIZE) {
+        return ::operator new(size);
+    }
+    int cls = class_of(size);
+    ThreadCache* cache = thread_cache();
+    if (!cache->free[cls]) {
+        cache->size[cls] += take_chunks(cls, cache->free[cls],
+                                        CACHE_BATCH);
+    }
+    FreeChunk* chunk = cache->free[cls];
+    cache->free[cls] = chunk->next;
+    cache->size[cls] -= 1;
+    return chunk;
+}
+
+void pool_free(void* ptr, std::size_t size) {
+    if (!ptr) {
+        return;
+    }
+    if (size == 0 || size > POOL_MAX_SIZE) {
+        ::operator delete(ptr);
+        return;
+    }
+    int cls = class_of(size);
+    ThreadCache* cache = thread_cache();
+    FreeChunk* chunk = static_cast<FreeChunk*>(ptr);
+    chunk->next = cache->free[cls];
+    cache->free[cls] = chunk;
+    cache->size[cls] += 1;
+    if (cache->size[cls] > CACHE_MAX) {
+        cache->size[cls] -= give_chunks(cls, cache->free[cls],
+                                        CACHE_BATCH);
+    }
+}
+
+void pool_flush() {
+    ThreadCache* cache = thread_caches().get();
+    if (cache) {
+        cache->flush();
+    }
+}
+
+std::size_t pool_slabs() {
+    std::size_t result = 0;
+    for (int cls = 0; cls < POOL_CLASSES; cls++) {
+        SizeClass& sc = size_classes()[cls];
+        boost::mutex::scoped_lock lock(sc.mutex);
+        result += sc.slabs.size();
+    }
+    return result;
+}
+
+}
+
@@ -0,0 +1,68 @@
+/*
+ * NPG-explorer, Nucleotide PanGenome explorer
+ * Copyright (C) 2012-2016 Boris Nagaev
+ *
+ * See the LICENSE file for terms of use.
+ */
+
+#ifndef NPGE_POOL_ALLOC_HPP_
+#define NPGE_POOL_ALLOC_HPP_
+
+#include <cstddef>
+
+namespace npge {
+
+/** Allocate memory of given size from slab pool.
+Small objects (up to 256 bytes) are allocated from slabs of
+size class of the object. Slabs are contiguous arrays of chunks,
+so objects allocated one after another are neighbours in memory.
+Larger objects are allocated by global operator new.
+
+Freed chunks are cached in thread-local free list
+and reused by next allocations of this size class.
+When all chunks of a slab are returned to the pool,
+the slab is returned to the system (one empty slab
+per size class is kept for next allocations).
+
+The pools are process-wide, not owned by a BlockSet:
+blocks and fragments move between blocksets (detach/insert,
+Move, --ou-move), so an arena released together with one
+blockset could free objects still used by another one.
+Memory of temporary blocksets is returned when their blocks
+are deleted instead (see BlockSet::clear()).
+
+Throws std::bad_alloc.
+*/
+void* pool_alloc(std::size_t size);
+
+/** Return memory allocated by pool_alloc to the pool.
+\param size Same size as was passed to pool_alloc.
+*/
+void pool_free(void* ptr, std::size_t size);
+
+/** Return chunks cached by current thread to the pools.
+Slabs which become empty are returned to the system.
+Chunks cached by other threads are not touched.
+*/
+void pool_flush();
+
+/** Return number of slabs allocated by the pools */
+std::size_t pool_slabs();
+
+}
+
+/** Declare class-specific operators new and delete using pool_alloc.
+This is used inside class definition if NPGE_POOL_ALLOC is defined.
+If the class is polymorphic, destructor must be virtual,
+so that operator delete gets the size of dynamic type.
+*/
+#define NPGE_POOL_OPERATORS \
+    static void* operator new(std::size_t size) { \
+        return npge::pool_alloc(size); \
+    } \
+    static void operator delete(void* ptr, std::size_t size) { \
+        npge::pool_free(ptr, size); \
+    }
+
+#endif
+
@@ -9,10 +9,14 @@
 #include <vector>
 #include <sstream>
 #include <set>
+#include <limits>
 #include <boost/foreach.hpp>
+#include <boost/bind.hpp>
+#include <boost/ref.hpp>
 #include <boost/algorithm/string/join.hpp>
 
 #include "tree.hpp"
+#include "simple_task.hpp"
 #include "Exception.hpp"
 #include "throw_assert.hpp"
 
@@ -357,97 +361,274 @@ void TreeNode::upgma() {
     ASSERT_EQ(nodes.size(), 1);
 }
 
-static void calculate_q(Distances& Q, Distances& distances, Nodes& nodes) {
-    for (int i = 0; i < nodes.size(); i++) {
-        TreeNode* node_i = nodes[i];
-        for (int j = i + 1; j < nodes.size(); j++) {
-            TreeNode* node_j = nodes[j];
-            double distance = (nodes.size() - 2.0) *
-                              distances[make_pair(node_i, node_j)];
-            for (int k = 0; k < nodes.size(); k++) {
-                TreeNode* node_k = nodes[k];
-                distance -= distances[make_pair(node_i, node_k)];
-                distance -= distances[make_pair(node_j, node_k)];
+/** Dense distance matrix for neighbor joining.
+Node ids are indices of nodes in nodes_, new node takes
+slot of the matrix of one of joined nodes.
+Row sums are updated incrementally. Entries of each row are
+sorted by distance once, when the row is created, so that
+search for minimum of Q stops early (as in RapidNJ).
+*/
+class NJMatrix {
+public:
+    NJMatrix(const Leafs& leafs):
+        nodes_(leafs.begin(), leafs.end()), n_(leafs.size()),
+        d_(n_ * n_, 0.0), r_(n_, 0.0), rows_(n_),
+        slot_of_(n_), node_of_(n_), order_(n_) {
+        for (int i = 0; i < n_; i++) {
+            for (int j = i + 1; j < n_; j++) {
+                double distance = leafs[i]->distance_to(leafs[j]);
+                d_[i * n_ + j] = distance;
+                d_[j * n_ + i] = distance;
             }
-            Q[make_pair(node_i, node_j)] = distance;
+        }
+        for (int i = 0; i < n_; i++) {
+            slot_of_[i] = i;
+            node_of_[i] = i;
+            order_[i] = i;
+        }
+        for (int i = 0; i < n_; i++) {
+            for (int j = 0; j < n_; j++) {
+                r_[i] += d_[i * n_ + j];
+            }
+            make_row(i);
         }
     }
-}
 
-static double distance_to_first(const Pair& min_pair,
-                                Distances& distances, Nodes& nodes) {
-    double min_distance = distances[min_pair];
-    double s = 0;
-    TreeNode* node_i = min_pair.first;
-    TreeNode* node_j = min_pair.second;
-    for (int k = 0; k < nodes.size(); k++) {
-        TreeNode* node_k = nodes[k];
-        if (node_k != node_i && node_k != node_j) {
-            s += distances[make_pair(node_i, node_k)];
-            s -= distances[make_pair(node_j, node_k)];
+    int size() const {
+        return order_.size();
+    }
+
+    /** Return node by index in order of nodes */
+    TreeNode* node(int index) const {
+        return nodes_[order_[index]];
+    }
+
+    double distance(int index1, int index2) const {
+        return dist(slot_of_[order_[index1]], slot_of_[order_[index2]]);
+    }
+
+    double row_sum(int index) const {
+        return r_[slot_of_[order_[index]]];
+    }
+
+    /** Find pair of nodes (indices in order) with minimum of Q */
+    void find_min_q(int& index1, int& index2, int workers) {
+        pos_.assign(nodes_.size(), -1);
+        r_max_ = -std::numeric_limits<double>::infinity();
+        for (int index = 0; index < size(); index++) {
+            pos_[order_[index]] = index;
+            r_max_ = std::max(r_max_, row_sum(index));
+        }
+        workers = std::max(1, std::min(workers, size() / MIN_ROWS));
+        std::vector<QMin> mins(workers);
+        if (workers == 1) {
+            find_min_q_in(mins[0], 0, 1);
+        } else {
+            Tasks tasks;
+            for (int w = 0; w < workers; w++) {
+                tasks.push_back(boost::bind(&NJMatrix::find_min_q_in,
+                                            this, boost::ref(mins[w]),
+                                            w, workers));
+            }
+            do_tasks(tasks_to_generator(tasks), workers);
+        }
+        QMin best = mins[0];
+        for (int w = 1; w < workers; w++) {
+            if (best.index1 == -1 || (mins[w].index1 != -1 &&
+                                      mins[w] < best)) {
+                best = mins[w];
+            }
+        }
+        index1 = best.index1;
+        index2 = best.index2;
+    }
+
+    /** Replace two nodes with new node.
+    Distance from new node to node k is 0.5 * (d1k + d2k - d12).
+    */
+    void join(int index1, int index2, TreeNode* new_node) {
+        int id1 = order_[index1], id2 = order_[index2];
+        int s1 = slot_of_[id1], s2 = slot_of_[id2];
+        double d12 = dist(s1, s2);
+        int id = nodes_.size();
+        nodes_.push_back(new_node);
+        slot_of_.push_back(s1);
+        slot_of_[id1] = -1;
+        slot_of_[id2] = -1;
+        node_of_[s1] = id;
+        order_.erase(order_.begin() + std::max(index1, index2));
+        order_.erase(order_.begin() + std::min(index1, index2));
+        double r = 0;
+        BOOST_FOREACH (int k, order_) {
+            int sk = slot_of_[k];
+            double d1k = dist(s1, sk), d2k = dist(s2, sk);
+            double d = 0.5 * (d1k + d2k - d12);
+            r_[sk] += d - d1k - d2k;
+            d_[s1 * n_ + sk] = d;
+            d_[sk * n_ + s1] = d;
+            r += d;
+        }
+        r_[s1] = r;
+        order_.push_back(id);
+        make_row(s1);
+        rows_[s2].clear();
+        compact_rows();
+    }
+
+private:
+    struct Entry {
+        double distance;
+        int id;
+
+        bool operator<(const Entry& other) const {
+            return distance < other.distance;
+        }
+    };
+    typedef std::vector<Entry> Row;
+
+    struct QMin {
+        double q;
+        int index1;
+        int index2;
+
+        QMin():
+            q(std::numeric_limits<double>::infinity()),
+            index1(-1), index2(-1) {
+        }
+
+        // ties are broken by order of nodes, as in find_min_pair
+        bool operator<(const QMin& other) const {
+            if (q != other.q) {
+                return q < other.q;
+            }
+            if (index1 != other.index1) {
+                return index1 < other.index1;
+            }
+            return index2 < other.index2;
+        }
+    };
+
+    // minimum number of rows per thread
+    static const int MIN_ROWS = 64;
+
+    Nodes nodes_;
+    int n_;
+    std::vector<double> d_;
+    std::vector<double> r_;
+    std::vector<Row> rows_; // index is slot
+    std::vector<int> slot_of_; // index is node id, -1 for joined
+    std::vector<int> node_of_; // index is slot
+    std::vector<int> order_; // ids of nodes in order of old algorithm
+    std::vector<int> pos_; // index is node id, value is index in order_
+    double r_max_;
+
+    double dist(int slot1, int slot2) const {
+        return d_[slot1 * n_ + slot2];
+    }
+
+    void make_row(int slot) {
+        Row& row = rows_[slot];
+        row.clear();
+        int id = node_of_[slot];
+        BOOST_FOREACH (int k, order_) {
+            if (k != id) {
+                Entry entry;
+                entry.distance = dist(slot, slot_of_[k]);
+                entry.id = k;
+                row.push_back(entry);
+            }
+        }
+        std::sort(row.begin(), row.end());
+    }
+
+    /** Remove entries of joined nodes if they are many */
+    void compact_rows() {
+        BOOST_FOREACH (int id, order_) {
+            Row& row = rows_[slot_of_[id]];
+            if (row.size() > 2 * order_.size()) {
+                Row alive;
+                BOOST_FOREACH (const Entry& entry, row) {
+                    if (slot_of_[entry.id] != -1) {
+                        alive.push_back(entry);
+                    }
+                }
+                row.swap(alive);
+            }
         }
     }
+
+    void find_min_q_in(QMin& best, int first, int step) const {
+        double m2 = size() - 2.0;
+        for (int index = first; index < size(); index += step) {
+            int id = order_[index];
+            int slot = slot_of_[id];
+            double r_i = r_[slot];
+            BOOST_FOREACH (const Entry& entry, rows_[slot]) {
+                if (m2 * entry.distance - r_i - r_max_ > best.q) {
+                    // next entries have greater lower bound of Q
+                    break;
+                }
+                int other_slot = slot_of_[entry.id];
+                if (other_slot == -1) {
+                    continue;
+                }
+                QMin candidate;
+                candidate.q = m2 * entry.distance - r_i - r_[other_slot];
+                int other_index = pos_[entry.id];
+                candidate.index1 = std::min(index, other_index);
+                candidate.index2 = std::max(index, other_index);
+                if (best.index1 == -1 || candidate < best) {
+                    best = candidate;
+                }
+            }
+        }
+    }
+};
+
+/** Return length of branch of first node of joined pair */
+static double distance_to_first(double d12, double r1, double r2,
+                                int nodes) {
     double dist;
-    if (nodes.size() > 2) {
-        dist = 0.5 * min_distance + 0.5 * s / (nodes.size() - 2);
+    if (nodes > 2) {
+        dist = 0.5 * d12 + 0.5 * (r1 - r2) / (nodes - 2);
     } else {
-        dist = 0.5 * min_distance;
+        dist = 0.5 * d12;
     }
     if (dist < 0.0) {
         dist = 0.0;
     }
-    if (dist > min_distance) {
-        dist = min_distance;
+    if (dist > d12) {
+        dist = d12;
     }
     return dist;
 }
 
-static double distance_to_pair(const Pair& min_pair,
-                               Distances& distances, TreeNode* node_k) {
-    double min_distance = distances[min_pair];
-    double dist_f = distances[make_pair(min_pair.first, node_k)];
-    double dist_s = distances[make_pair(min_pair.second, node_k)];
-    return 0.5 * (dist_f + dist_s - min_distance);
-}
-
-static void neighbor_joining_round(TreeNode* tree, Distances& distances,
-                                   Nodes& nodes) {
-    Distances Q;
-    calculate_q(Q, distances, nodes);
-    Pair min_pair = find_min_pair(Q, nodes);
-    if (!min_pair.first || !min_pair.second) {
+static void neighbor_joining_round(TreeNode* tree, NJMatrix& matrix,
+                                   int workers) {
+    int index1, index2;
+    matrix.find_min_q(index1, index2, workers);
+    if (index1 == -1 || index2 == -1) {
         throw Exception("No min element of Q for neighbor joining");
     }
+    TreeNode* first = matrix.node(index1);
+    TreeNode* second = matrix.node(index2);
     TreeNode* new_node = new TreeNode;
     tree->add_child(new_node);
-    new_node->add_child(min_pair.first);
-    new_node->add_child(min_pair.second);
-    double min_distance = distances[min_pair];
-    double distance_to_left = distance_to_first(min_pair, distances, nodes);
-    double distance_to_right = min_distance - distance_to_left;
-    min_pair.first->set_length(distance_to_left);
-    min_pair.second->set_length(distance_to_right);
-    for (int k = 0; k < nodes.size(); k++) {
-        TreeNode* node_k = nodes[k];
-        if (node_k != min_pair.first && node_k != min_pair.second) {
-            double d = distance_to_pair(min_pair, distances, node_k);
-            distances[make_pair(new_node, node_k)] = d;
-            distances.erase(make_pair(min_pair.first, node_k));
-            distances.erase(make_pair(min_pair.second, node_k));
-        }
-    }
-    distances.erase(min_pair);
-    nodes.erase(std::remove_if(nodes.begin(), nodes.end(),
-                               IfRemove(min_pair.first, min_pair.second)),
-                nodes.end());
-    nodes.push_back(new_node);
-}
-
-void TreeNode::neighbor_joining() {
+    new_node->add_child(first);
+    new_node->add_child(second);
+    double d12 = matrix.distance(index1, index2);
+    double distance_to_left = distance_to_first(d12,
+                              matrix.row_sum(index1),
+                              matrix.row_sum(index2), matrix.size());
+    first->set_length(distance_to_left);
+    second->set_length(d12 - distance_to_left);
+    matrix.join(index1, index2, new_node);
+}
+
+void TreeNode::neighbor_joining(int workers) {
     Leafs leafs;
     all_leafs(leafs);
-    Distances distances;
-    build_distances(distances, leafs);
+    NJMatrix matrix(leafs);
     BOOST_FOREACH (LeafNode* leaf, leafs) {
         leaf->detach();
     }
@@ -455,28 +636,25 @@ void TreeNode::neighbor_joining() {
     BOOST_FOREACH (LeafNode* leaf, leafs) {
         add_child(leaf);
     }
-    Nodes nodes(leafs.begin(), leafs.end());
-    if (nodes.size() == 0) {
-        return;
-    } else if (nodes.size() == 1) {
+    if (matrix.size() <= 1) {
         return;
-    } else if (nodes.size() == 2) {
-        double d = distances[make_pair(nodes[0], nodes[1])];
-        nodes[0]->set_length(d / 2.0);
-        nodes[1]->set_length(d / 2.0);
+    } else if (matrix.size() == 2) {
+        double d = matrix.distance(0, 1);
+        matrix.node(0)->set_length(d / 2.0);
+        matrix.node(1)->set_length(d / 2.0);
         return;
     }
-    for (int round = 0; round < int(leafs.size()) - 3; round++) {
-        neighbor_joining_round(this, distances, nodes);
-    }
-    ASSERT_EQ(nodes.size(), 3);
-    Pair pair01 = make_pair(nodes[0], nodes[1]);
-    double l0 = distance_to_first(pair01, distances, nodes);
-    double l1 = distances[pair01] - l0;
-    double l2 = distance_to_pair(pair01, distances, nodes[2]);
-    pair01.first->set_length(l0);
-    pair01.second->set_length(l1);
-    nodes[2]->set_length(l2);
+    while (matrix.size() > 3) {
+        neighbor_joining_round(this, matrix, workers);
+    }
+    double d01 = matrix.distance(0, 1);
+    double l0 = distance_to_first(d01, matrix.row_sum(0),
+                                  matrix.row_sum(1), 3);
+    double l1 = d01 - l0;
+    double l2 = 0.5 * (matrix.distance(0, 2) + matrix.distance(1, 2) - d01);
+    matrix.node(0)->set_length(l0);
+    matrix.node(1)->set_length(l1);
+    matrix.node(2)->set_length(l2);
 }
 
 void TreeNode::branch_table(BranchTable& table, const Leafs& leafs,
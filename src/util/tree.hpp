@@ -102,7 +102,10 @@ public:
 
     void upgma();
 
-    void neighbor_joining();
+    /** Build tree of leafs using neighbor joining.
+    \param workers Number of threads used to find pairs to join.
+    */
+    void neighbor_joining(int workers = 1);
 
     void branch_table(BranchTable& table, const Leafs& leafs,
                       double weight) const;
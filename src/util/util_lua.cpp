@@ -333,6 +333,10 @@ void set_arg(lua_State* L, const Strings& a) {
 struct UselessClass {
 };
 
+static OPtr name_to_ostream1(const std::string& name) {
+    return name_to_ostream(name);
+}
+
 static luabind::scope register_file() {
     using namespace luabind;
     return class_<UselessClass>("file")
@@ -341,6 +345,7 @@ static luabind::scope register_file() {
                def("read_file", &read_file),
                def("name_to_istream", &name_to_istream),
                def("name_to_ostream", &name_to_ostream),
+               def("name_to_ostream", &name_to_ostream1),
                def("set_istream", &set_istream),
                def("remove_istream", &remove_istream),
                def("set_ostream", &set_ostream),